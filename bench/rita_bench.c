@@ -0,0 +1,302 @@
+#define _DEFAULT_SOURCE
+
+/*
+ * Headless hgl_rita benchmark.
+ *
+ * Renders a fixed, deterministic camera orbit around each of the bundled assets for every tile
+ * configuration preset, and prints one line of CSV per (preset, scene) pair on stdout:
+ *
+ *     preset,scene,width,height,frames,ms_min,ms_p50,ms_p90,ms_p99,ms_max,ms_mean,tris_per_s,frags_per_s
+ *
+ * `tris_per_s` counts triangles dispatched to the tile threads (i.e. after backface culling), and
+ * `frags_per_s` counts fragments rasterized by the tile threads (i.e. before depth testing).
+ *
+ * Whether vertex processing is done serially or in parallel is a compile-time setting, so the
+ * benchmark is built twice (see `make bench`). Run it from the repository root.
+ */
+
+#define HGL_RITA_COLLECT_STATS
+#define HGL_RITA_IMPLEMENTATION
+#define HGL_RITA_SHADERS_IMPLEMENTATION
+#include "hgl_rita.h"
+#include "hgl_rita_shaders.h"
+
+/* hgl_flags.h unconditionally defines its own min/max */
+#undef min
+#undef max
+#define HGL_FLAGS_IMPLEMENTATION
+#include "hgl_flags.h"
+
+/* The examples get stb_image from raylib. We don't link raylib, so build it here. */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdouble-promotion"
+#define STB_IMAGE_IMPLEMENTATION
+#include "rita_helpers.h"
+#pragma GCC diagnostic pop
+
+#ifdef HGL_RITA_PARALLEL_VERTEX_PROCESSING
+#  define VERTEX_PROCESSING "PARALLEL_VERTEX_PROCESSING"
+#else
+#  define VERTEX_PROCESSING "SERIAL_VERTEX_PROCESSING"
+#endif
+
+typedef struct
+{
+    const char *name;
+    HglRitaTileConfig config;
+} Preset;
+
+typedef struct
+{
+    const char *name;
+    const char *obj_path;
+    const char *diffuse_path;
+    HglRitaVertShaderFunc vert;
+    HglRitaFragShaderFunc frag;
+    float camera_distance;
+    float camera_height;
+} Scene;
+
+static HglRitaVertex displacement_map_shader(const HglRitaContext *ctx, const HglRitaVertex *in);
+static HglRitaColor normal_map_shader(const HglRitaContext *ctx, const HglRitaFragment *in);
+
+static const Preset presets[] = {
+    { "HGL_RITA_PRESET_128X64X64_"   VERTEX_PROCESSING, { 128, 64,   64 } },
+    { "HGL_RITA_PRESET_192X64X128_"  VERTEX_PROCESSING, { 192, 64,  128 } },
+    { "HGL_RITA_PRESET_256X64X256_"  VERTEX_PROCESSING, { 256, 64,  256 } },
+    { "HGL_RITA_PRESET_256X64X2048_" VERTEX_PROCESSING, { 256, 64, 2048 } },
+    { "HGL_RITA_PRESET_256X64X4096_" VERTEX_PROCESSING, { 256, 64, 4096 } },
+};
+
+static const Scene scenes[] = {
+    { "teapot",     "assets/teapot.obj",     NULL,                HGL_RITA_VERTEX_DIRECTIONAL_LIGHT_SHADER, HGL_RITA_LAMBERT_DIFFUSE, 2.2f, 0.5f },
+    { "cavetroll",  "assets/cavetroll.obj",  NULL,                HGL_RITA_VERTEX_DIRECTIONAL_LIGHT_SHADER, HGL_RITA_LAMBERT_DIFFUSE, 2.2f, 0.3f },
+    { "skull",      "assets/skull.obj",      "assets/skull.png",  HGL_RITA_VERTEX_DIRECTIONAL_LIGHT_SHADER, HGL_RITA_LAMBERT_DIFFUSE, 2.2f, 0.3f },
+    { "penger",     "assets/penger.obj",     "assets/penger.png", HGL_RITA_VERTEX_DIRECTIONAL_LIGHT_SHADER, HGL_RITA_LAMBERT_DIFFUSE, 2.2f, 0.3f },
+    { "plane64x64", "assets/plane64x64.obj", NULL,                displacement_map_shader,                  normal_map_shader,        1.2f, 0.8f },
+};
+
+static HglRitaVertex displacement_map_shader(const HglRitaContext *ctx, const HglRitaVertex *in)
+{
+    HglRitaVertex out = *in;
+    Vec4 v = in->pos;
+    v.w = 1.0f;
+    float h = hgl_rita_sample_unit_uv(HGL_RITA_TEX_DISPLACEMENT, in->uv).r / 255.0f;
+    v.y += 9*powf(h, 1.0f/0.42f);
+    out.pos = mat4_mul_vec4(ctx->tform.mvp, v);
+    return out;
+}
+
+static HglRitaColor normal_map_shader(const HglRitaContext *ctx, const HglRitaFragment *in)
+{
+    (void) ctx;
+    Vec3 T = vec3_normalize(in->world_tangent);
+    Vec3 N = vec3_normalize(in->world_normal);
+    Vec3 B = vec3_cross(N, T);
+    Mat3 TBN = mat3_make(T, B, N);
+
+    HglRitaColor n0c = hgl_rita_sample_unit_uv(HGL_RITA_TEX_NORMAL, in->uv);
+    Vec3 n0 = vec3_make((n0c.r/255.0f) * 2.0f - 1.0f,
+                        (n0c.g/255.0f) * 2.0f - 1.0f,
+                        (n0c.b/255.0f) * 2.0f - 1.0f);
+    N = vec3_normalize(mat3_mul_vec3(TBN, n0));
+
+    float light = clamp(0, 1, vec3_dot(N, vec3_normalize(vec3_make(1,1,1))));
+    return hgl_rita_color_mul_scalar(in->color, light);
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, int n, double p)
+{
+    int idx = (int)(p * (double)(n - 1) + 0.5);
+    return sorted[min(max(idx, 0), n - 1)];
+}
+
+static void compress_texture(HglRitaTexture *tex, HglRitaPixelFormat format)
+{
+    HglRitaTexture compressed = hgl_rita_texture_compress(tex, format);
+    stbi_image_free(tex->data.rgba8);
+    *tex = compressed;
+}
+
+static void free_texture(HglRitaTexture *tex)
+{
+    if (tex->format == HGL_RITA_RGBA8) {
+        stbi_image_free(tex->data.rgba8); // loaded with stb_image
+    } else {
+        hgl_rita_texture_destroy(tex);
+    }
+}
+
+static double now_ms(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return 1e3 * (double)t.tv_sec + 1e-6 * (double)t.tv_nsec;
+}
+
+int main(int argc, char *argv[])
+{
+    int64_t *width      = hgl_flags_add_i64_range("-W,--width", "Framebuffer width", 800, 0, 1, 8192);
+    int64_t *height     = hgl_flags_add_i64_range("-H,--height", "Framebuffer height", 600, 0, 1, 8192);
+    int64_t *n_frames   = hgl_flags_add_i64_range("-n,--frames", "Number of timed frames per scene", 120, 0, 1, 100000);
+    int64_t *n_warmup   = hgl_flags_add_i64_range("-w,--warmup", "Number of untimed warm-up frames per scene", 10, 0, 0, 100000);
+    const char **filter = hgl_flags_add_str("-s,--scene", "Only run scenes whose name contains this string", "", 0);
+    bool *msaa          = hgl_flags_add_bool("--msaa", "Enable 4x MSAA (HGL_RITA_MSAA)", false, 0);
+    bool *compact       = hgl_flags_add_bool("--compact", "Use 16-bit framebuffer formats (HGL_RITA_RGB565 + HGL_RITA_R16)", false, 0);
+    bool *bc            = hgl_flags_add_bool("--bc", "Use block compressed textures (HGL_RITA_BC1 + HGL_RITA_BC4)", false, 0);
+    bool *pin           = hgl_flags_add_bool("--pin", "Pin the tile threads to processors (HGL_RITA_THREAD_PINNING)", false, 0);
+    bool *oit           = hgl_flags_add_bool("--oit", "Draw everything as order-independent transparency (HGL_RITA_ORDER_INDEPENDENT_ALPHA_BLEND)", false, 0);
+    bool *no_header     = hgl_flags_add_bool("--no-header", "Don't print the CSV header", false, 0);
+    bool *help          = hgl_flags_add_bool("-h,--help", "Print this help message and exit", false, 0);
+
+    int err = hgl_flags_parse(argc, argv);
+    if (err != 0 || *help) {
+        printf("Usage: %s [Options]\n", argv[0]);
+        hgl_flags_print();
+        return err != 0;
+    }
+
+    int w = (int)*width;
+    int h = (int)*height;
+
+    hgl_rita_init();
+    if (*pin) {
+        /* before the framebuffer is bound, so that the tile threads get to touch it first */
+        hgl_rita_enable(HGL_RITA_THREAD_PINNING);
+    }
+
+    HglRitaTexture fb_color = hgl_rita_texture_make(w, h, *compact ? HGL_RITA_RGB565 : HGL_RITA_RGBA8);
+    HglRitaTexture fb_depth = hgl_rita_texture_make(w, h, *compact ? HGL_RITA_R16 : HGL_RITA_R32);
+    hgl_rita_bind_texture(HGL_RITA_TEX_FRAME_BUFFER, &fb_color);
+    hgl_rita_bind_texture(HGL_RITA_TEX_DEPTH_BUFFER, &fb_depth);
+    hgl_rita_use_viewport(w, h);
+    hgl_rita_use_texture_filter(HGL_RITA_BILINEAR);
+    hgl_rita_enable(HGL_RITA_BACKFACE_CULLING |
+                    HGL_RITA_DEPTH_TESTING |
+                    HGL_RITA_DEPTH_BUFFER_WRITING |
+                    HGL_RITA_Z_CLIPPING);
+    if (*msaa) {
+        hgl_rita_enable(HGL_RITA_MSAA);
+    }
+    if (*oit) {
+        hgl_rita_enable(HGL_RITA_ORDER_INDEPENDENT_ALPHA_BLEND);
+    }
+
+    HglRitaTexture displacement_map = load_texture("assets/heightmap.png");
+    HglRitaTexture normal_map = load_texture("assets/normalmap.png");
+    if (*bc) {
+        compress_texture(&displacement_map, HGL_RITA_BC4);
+        compress_texture(&normal_map, HGL_RITA_BC1);
+    }
+    hgl_rita_bind_texture(HGL_RITA_TEX_DISPLACEMENT, &displacement_map);
+    hgl_rita_bind_texture(HGL_RITA_TEX_NORMAL, &normal_map);
+
+    double *frame_times = malloc(*n_frames * sizeof(double));
+
+    if (!*no_header) {
+        printf("preset,scene,width,height,frames,ms_min,ms_p50,ms_p90,ms_p99,ms_max,ms_mean,tris_per_s,frags_per_s\n");
+    }
+
+    for (size_t i = 0; i < sizeof(scenes)/sizeof(scenes[0]); i++) {
+        const Scene *scene = &scenes[i];
+        if (strstr(scene->name, *filter) == NULL) {
+            continue;
+        }
+
+        MyModel model = load_model_from_obj(scene->obj_path);
+        model.vertex_shader   = scene->vert;
+        model.fragment_shader = scene->frag;
+        if (scene->diffuse_path != NULL) {
+            model.diffuse = load_texture(scene->diffuse_path);
+            if (*bc) {
+                compress_texture(&model.diffuse, HGL_RITA_BC1);
+            }
+        }
+        hgl_rita_bind_texture(HGL_RITA_TEX_DIFFUSE, NULL);
+
+        /* frame the model using its bounding sphere */
+        Vec3 lo = vec3_make( 1e9f,  1e9f,  1e9f);
+        Vec3 hi = vec3_make(-1e9f, -1e9f, -1e9f);
+        for (int j = 0; j < model.vbuf.length; j++) {
+            Vec3 p = model.vbuf.arr[j].pos.xyz;
+            lo = vec3_make(fminf(lo.x, p.x), fminf(lo.y, p.y), fminf(lo.z, p.z));
+            hi = vec3_make(fmaxf(hi.x, p.x), fmaxf(hi.y, p.y), fmaxf(hi.z, p.z));
+        }
+        Vec3 center = vec3_mul_scalar(vec3_add(lo, hi), 0.5f);
+        float radius = 0.5f * vec3_len(vec3_sub(hi, lo));
+        float dist = scene->camera_distance * radius;
+        hgl_rita_use_perspective_proj(3.1415f/4.0f, (float)w/(float)h, 0.05f*radius, 10.0f*radius);
+
+        for (size_t k = 0; k < sizeof(presets)/sizeof(presets[0]); k++) {
+            hgl_rita_use_tile_config(presets[k].config);
+
+            int n_total = (int)(*n_warmup + *n_frames);
+            for (int f = 0; f < n_total; f++) {
+                int timed = f - (int)*n_warmup;
+                if (timed == 0) {
+                    hgl_rita_reset_stats();
+                }
+
+                /* fixed camera path: one full orbit over the timed frames */
+                float angle = 2.0f * 3.1415926f * (float)f / (float)*n_frames;
+                Vec3 eye = vec3_add(center, vec3_make(dist * sinf(angle),
+                                                      scene->camera_height * dist,
+                                                      dist * cosf(angle)));
+
+                double t0 = now_ms();
+                hgl_rita_use_camera_view(eye, center, vec3_make(0, 1, 0));
+                hgl_rita_clear(HGL_RITA_COLOR | HGL_RITA_DEPTH);
+                draw_model(&model);
+                hgl_rita_finish();
+                double t1 = now_ms();
+
+                if (timed >= 0) {
+                    frame_times[timed] = t1 - t0;
+                }
+            }
+
+            HglRitaStats stats = hgl_rita_get_stats();
+            double total_ms = 0.0;
+            for (int f = 0; f < *n_frames; f++) {
+                total_ms += frame_times[f];
+            }
+            qsort(frame_times, *n_frames, sizeof(double), compare_doubles);
+
+            int n = (int)*n_frames;
+            printf("%s,%s,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.0f,%.0f\n",
+                   presets[k].name, scene->name, w, h, n,
+                   frame_times[0],
+                   percentile(frame_times, n, 0.50),
+                   percentile(frame_times, n, 0.90),
+                   percentile(frame_times, n, 0.99),
+                   frame_times[n - 1],
+                   total_ms / n,
+                   1e3 * (double)stats.n_triangles / total_ms,
+                   1e3 * (double)stats.n_fragments / total_ms);
+            fflush(stdout);
+        }
+
+        hgl_rita_bind_texture(HGL_RITA_TEX_DIFFUSE, NULL);
+        if (model.diffuse.data.rgba8 != NULL) {
+            free_texture(&model.diffuse);
+        }
+        hgl_rita_buf_destroy(&model.vbuf);
+        hgl_rita_buf_destroy(&model.ibuf);
+    }
+
+    hgl_rita_final();
+    free(frame_times);
+    free_texture(&displacement_map);
+    free_texture(&normal_map);
+    hgl_rita_texture_destroy(&fb_color);
+    hgl_rita_texture_destroy(&fb_depth);
+
+    return 0;
+}
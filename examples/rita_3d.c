@@ -1,11 +1,15 @@
 #define _DEFAULT_SOURCE
 
+#define HGL_WORKER_POOL_IMPLEMENTATION
+#include "hgl_worker_pool.h"
+
 #define HGL_RITA_PRESET_256X64X256_PARALLEL_VERTEX_PROCESSING
 #define HGL_RITA_IMPLEMENTATION
 #define HGL_RITA_SHADERS_IMPLEMENTATION
 #include "hgl_rita.h"
 #include "hgl_rita_shaders.h"
 #include "rita_helpers.h"
+#include "hgl_rita_assets.h"
 
 #define HGL_PROFILE_IMPLEMENTATION
 #include "hgl_profile.h"
@@ -134,32 +138,42 @@ int main()
                     HGL_RITA_DEPTH_BUFFER_WRITING | 
                     HGL_RITA_Z_CLIPPING);
 
-    /* Load models */
+    /* Load models & textures (in parallel, on one worker per processor) */
     MyModel models[4];
+    HglRitaTexture skybox;
     memset(models, 0, sizeof(models));
-    models[0] = load_model_from_obj("assets/cube.obj");
-    models[0].diffuse = load_texture("assets/box64x64.png");
+    HglRitaAssetLoader *loader = hgl_rita_assets_create(0);
+    hgl_rita_assets_load_obj(loader, "assets/cube.obj", &models[0].vbuf, &models[0].ibuf);
+    hgl_rita_assets_load_texture(loader, "assets/box64x64.png", &models[0].diffuse);
+    hgl_rita_assets_load_obj(loader, "assets/skull.obj", &models[1].vbuf, &models[1].ibuf);
+    hgl_rita_assets_load_texture(loader, "assets/skull.png", &models[1].diffuse);
+    hgl_rita_assets_load_obj(loader, "assets/hcandersen.obj", &models[2].vbuf, &models[2].ibuf);
+    hgl_rita_assets_load_texture(loader, "assets/hcandersen_albedo.png", &models[2].diffuse);
+    hgl_rita_assets_load_obj(loader, "assets/cavetroll.obj", &models[3].vbuf, &models[3].ibuf);
+    hgl_rita_assets_load_texture(loader, "assets/cavetroll.png", &models[3].diffuse);
+    hgl_rita_assets_load_texture(loader, "assets/skybox_cubemap.png", &skybox);
+    int n_failed = hgl_rita_assets_wait(loader);
+    hgl_rita_assets_destroy(loader);
+    if (n_failed != 0) {
+        fprintf(stderr, "Failed to load %d asset(s)\n", n_failed);
+        hgl_rita_final();
+        return 1;
+    }
+
+    models[0].tform = mat4_make_identity();
     models[0].tform = mat4_scale(models[0].tform, vec3_make(10, 10, 10));
-    models[1] = load_model_from_obj("assets/skull.obj");
-    models[1].diffuse = load_texture("assets/skull.png");
+    models[1].tform = mat4_make_identity();
     models[1].tform = mat4_scale(models[1].tform, vec3_make(1, 1, 1));
     models[1].tform = mat4_rotate(models[1].tform, -3.1415f/2.0f, vec3_make(1, 0, 0));
     models[1].tform = mat4_translate(models[1].tform, vec3_make(0, -10, 0));
-    models[2] = load_model_from_obj("assets/hcandersen.obj");
-    models[2].diffuse = load_texture("assets/hcandersen_albedo.png");
+    models[2].tform = mat4_make_identity();
     models[2].tform = mat4_scale(models[2].tform, vec3_make(1, 1, 1));
     models[2].tform = mat4_translate(models[2].tform, vec3_make(0, -20, 0));
-    models[3] = load_model_from_obj("assets/cavetroll.obj");
-    models[3].diffuse = load_texture("assets/cavetroll.png");
     models[3].tform = mat4_scale(models[2].tform, vec3_make(8, 8, 8));
 
     /* Setup hgl_rita to render our models */
     hgl_rita_use_vertex_buffer_mode(HGL_RITA_INDEXED);
 
-    /* Load skybox texture */
-    HglRitaTexture skybox;
-    skybox = load_texture("assets/skybox_cubemap.png");
-
     /* Raylib stuff: IGNORE */
     InitWindow(DISPLAY_SCALE*WIDTH, DISPLAY_SCALE*HEIGHT, "HglRita: Hello Cube!");
     Image color_image = (Image) {
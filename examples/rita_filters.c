@@ -129,9 +129,37 @@ static inline HglRitaColor sobel_sharpen(const HglRitaContext *ctx, const HglRit
     };
 }
 
+static void gaussian_blur(void)
+{
+    hgl_rita_filter_gaussian_blur(0, 0, WIDTH, HEIGHT, 4.0f);
+}
+
+static void box_blur(void)
+{
+    hgl_rita_filter_box_blur(0, 0, WIDTH, HEIGHT, 8);
+}
+
+static void sobel(void)
+{
+    hgl_rita_filter_sobel(0, 0, WIDTH, HEIGHT);
+}
+
+static void motion_blur(void)
+{
+    /* horizontal box blur; the vertical kernel is a single tap in the middle */
+    float kernel_x[2*16 + 1];
+    float kernel_y[2*16 + 1] = {0};
+    for (int i = 0; i < 2*16 + 1; i++) {
+        kernel_x[i] = 1.0f / (2*16 + 1);
+    }
+    kernel_y[16] = 1.0f;
+    hgl_rita_filter_separable(0, 0, WIDTH, HEIGHT, kernel_x, kernel_y, 16);
+}
+
 static struct {
     const char *name;
     HglRitaFragShaderFunc func;
+    void (*filter)(void); /* applied after the blit */
 } shaders[] = {
     {.name = "NULL",            .func = NULL},
     {.name = "ANALOG_CAMERA",   .func = analog_camera},
@@ -140,6 +168,10 @@ static struct {
     {.name = "DITHER_4X4_1BPP", .func = HGL_RITA_DITHER_4X4_1BPP},
     {.name = "DITHER_4X4_2BPP", .func = HGL_RITA_DITHER_4X4_2BPP},
     {.name = "DITHER_4X4_3BPP", .func = HGL_RITA_DITHER_4X4_3BPP},
+    {.name = "GAUSSIAN_BLUR",   .func = NULL, .filter = gaussian_blur},
+    {.name = "BOX_BLUR",        .func = NULL, .filter = box_blur},
+    {.name = "SOBEL",           .func = NULL, .filter = sobel},
+    {.name = "MOTION_BLUR",     .func = NULL, .filter = motion_blur},
 };
 
 int main()
@@ -182,6 +214,9 @@ int main()
                       (shaders[shader_in_use].func != NULL) ? HGL_RITA_SHADER : 
                                                               HGL_RITA_BOXCOORD,
                       shaders[shader_in_use].func);
+        if (shaders[shader_in_use].filter != NULL) {
+            shaders[shader_in_use].filter();
+        }
         hgl_rita_blit(10, 10, 1000, 80, NULL, 
                       HGL_RITA_MULTIPLY, 
                       HGL_RITA_EVERYWHERE, 
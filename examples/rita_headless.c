@@ -0,0 +1,105 @@
+#define _DEFAULT_SOURCE
+
+#define HGL_IO_IMPLEMENTATION
+#include "hgl_io.h"
+
+#define HGL_RITA_IMPLEMENTATION
+#include "hgl_rita.h"
+#include "hgl_rita_stream.h"
+
+#include <stdlib.h>
+
+#define WIDTH          (640)
+#define HEIGHT         (480)
+
+/*
+ * Renders a spinning cube without a display and streams the frames to stdout
+ * (or to the path given as the first argument) as PAM frames. E.g.:
+ *
+ *     $ ./build/examples/rita_headless | ffmpeg -y -f pam_pipe -i - cube.mp4
+ *     $ ./build/examples/rita_headless "|ffmpeg -y -f pam_pipe -i - cube.mp4" 300
+ *     $ ./build/examples/rita_headless frames.pam 10
+ */
+int main(int argc, char *argv[])
+{
+    const char *path = (argc > 1) ? argv[1] : "-";
+    int n_frames     = (argc > 2) ? atoi(argv[2]) : 120;
+
+    /* Initialize hgl_rita */
+    hgl_rita_init();
+    hgl_rita_use_clear_color(HGL_RITA_MORTEL_BLACK);
+
+    /* Open the output stream. This creates & binds the (double buffered) framebuffer. */
+    HglRitaStream *stream = hgl_rita_stream_open(path, HGL_RITA_STREAM_PAM, WIDTH, HEIGHT);
+    if (stream == NULL) {
+        return 1;
+    }
+
+    /* The depth buffer is not streamed, so a single one is enough */
+    HglRitaTexture fb_depth = hgl_rita_texture_make(WIDTH, HEIGHT, HGL_RITA_R32);
+    hgl_rita_bind_texture(HGL_RITA_TEX_DEPTH_BUFFER, &fb_depth);
+
+    /* Setup the camera */
+    hgl_rita_use_camera_view(vec3_make(0, 0, 3), vec3_make(0, 0, 0), vec3_make(0, 1, 0));
+    hgl_rita_use_proj_matrix(mat4_make_perspective(3.1415f/4.0f, (float)WIDTH/(float)HEIGHT, 1.0f, 1000.0f));
+    hgl_rita_use_viewport(WIDTH, HEIGHT);
+
+    hgl_rita_enable(HGL_RITA_DEPTH_BUFFER_WRITING);
+    hgl_rita_enable(HGL_RITA_DEPTH_TESTING);
+    hgl_rita_disable(HGL_RITA_BACKFACE_CULLING);
+    hgl_rita_use_vertex_buffer_mode(HGL_RITA_INDEXED);
+
+    /* Create a vertex buffer and fill it with the vertices of a cube. */
+    HglRitaVertexBuffer vbuf = {0};
+    hgl_rita_buf_push(&vbuf, (HglRitaVertex){.pos = vec4_make(-0.5f, -0.5f, -0.5f, 1.0f), .color = HGL_RITA_MORTEL_RED});
+    hgl_rita_buf_push(&vbuf, (HglRitaVertex){.pos = vec4_make( 0.5f, -0.5f, -0.5f, 1.0f), .color = HGL_RITA_MORTEL_GREEN});
+    hgl_rita_buf_push(&vbuf, (HglRitaVertex){.pos = vec4_make(-0.5f,  0.5f, -0.5f, 1.0f), .color = HGL_RITA_MORTEL_BLUE});
+    hgl_rita_buf_push(&vbuf, (HglRitaVertex){.pos = vec4_make( 0.5f,  0.5f, -0.5f, 1.0f), .color = HGL_RITA_MORTEL_YELLOW});
+    hgl_rita_buf_push(&vbuf, (HglRitaVertex){.pos = vec4_make(-0.5f, -0.5f,  0.5f, 1.0f), .color = HGL_RITA_MORTEL_MAGENTA});
+    hgl_rita_buf_push(&vbuf, (HglRitaVertex){.pos = vec4_make( 0.5f, -0.5f,  0.5f, 1.0f), .color = HGL_RITA_MORTEL_CYAN});
+    hgl_rita_buf_push(&vbuf, (HglRitaVertex){.pos = vec4_make(-0.5f,  0.5f,  0.5f, 1.0f), .color = HGL_RITA_MORTEL_WHITE});
+    hgl_rita_buf_push(&vbuf, (HglRitaVertex){.pos = vec4_make( 0.5f,  0.5f,  0.5f, 1.0f), .color = HGL_RITA_MORTEL_BLACK});
+
+    /* Create an index buffer with the 12 triangles of the cube */
+    static const int indices[] = {
+        0, 2, 1,  1, 2, 3, // back
+        4, 5, 6,  5, 7, 6, // front
+        0, 4, 2,  2, 4, 6, // left
+        1, 3, 5,  3, 7, 5, // right
+        2, 6, 3,  3, 6, 7, // top
+        0, 1, 4,  1, 5, 4, // bottom
+    };
+    HglRitaIndexBuffer ibuf = {0};
+    for (size_t i = 0; i < sizeof(indices)/sizeof(indices[0]); i++) {
+        hgl_rita_buf_push(&ibuf, indices[i]);
+    }
+
+    hgl_rita_bind_buffer(HGL_RITA_VERTEX_BUFFER, &vbuf);
+    hgl_rita_bind_buffer(HGL_RITA_INDEX_BUFFER, &ibuf);
+
+    Mat4 model = mat4_make_identity();
+    for (int i = 0; i < n_frames; i++) {
+        hgl_rita_use_model_matrix(model);
+
+        /* Draw! */
+        hgl_rita_clear(HGL_RITA_COLOR | HGL_RITA_DEPTH);
+        hgl_rita_draw(HGL_RITA_TRIANGLES);
+
+        /* Hand frame `i` off to the writer thread. Frame `i + 1` renders while it's written. */
+        hgl_rita_stream_submit(stream);
+
+        model = mat4_rotate(model, 0.03f, vec3_normalize(vec3_make(0.3f, 1.0f, 0.4f)));
+    }
+
+    int err = hgl_rita_stream_close(stream);
+    if (err != 0) {
+        fprintf(stderr, "Error writing frames to `%s`\n", path);
+    }
+
+    hgl_rita_buf_destroy(&vbuf);
+    hgl_rita_buf_destroy(&ibuf);
+    hgl_rita_texture_destroy(&fb_depth);
+    hgl_rita_final();
+
+    return (err != 0);
+}
@@ -128,7 +128,7 @@ static inline MyModel load_model_from_obj(const char *filepath)
             v.pos.x = mesh->positions[pos_idx*3];
             v.pos.y = mesh->positions[pos_idx*3 + 1];
             v.pos.z = mesh->positions[pos_idx*3 + 2];
-            v.pos.w = 0.0f;
+            v.pos.w = 1.0f;
         }
         if (n_idx != 0) {
             v.normal.x = mesh->normals[n_idx*3];
@@ -146,29 +146,13 @@ static inline MyModel load_model_from_obj(const char *filepath)
         }
         v.color = mtl_kd;
 
-#if 0
-        /*
-         * Insert `v` into `vbuf` if there's not already an identical
-         * vertex in it. O(n^2). Could be better with a hash table/set.
-         */
-        int idx;
-        for (idx = 0; idx < model.vbuf.length; idx++) {
-            if (hgl_rita_vertex_eq(v, model.vbuf.arr[idx])) {
-                break;
-            }
-        }
-        if (idx % 10000 == 0) printf("%d\n", idx);
-        if (idx == model.vbuf.length) {
-            hgl_rita_vbuf_push(&model.vbuf, v);
-        }
-        hgl_rita_ibuf_push(&model.ibuf, (int)idx);
-#else
-        /* or just shove 'em all in there lol. */
         hgl_rita_buf_push(&model.vbuf, v);
         hgl_rita_buf_push(&model.ibuf, (int)model.vbuf.length - 1);
-#endif
     }
 
+    /* weld the vertex soup & reorder it for vertex cache efficiency */
+    hgl_rita_mesh_optimize(&model.vbuf, &model.ibuf);
+
     fast_obj_destroy(mesh);
     free(tangents);
 
@@ -30,8 +30,8 @@ static inline HglRitaVertex my_vertex_shader(const HglRitaContext *ctx, const Hg
     v = mat4_mul_vec4(ctx->tform.mvp, v);
 
     out.pos     = v;
-    out.normal  = mat3_mul_vec3(ctx->tform.normals, in->normal);
-    out.tangent = mat3_mul_vec3(ctx->tform.normals, in->tangent);
+    out.normal  = vec3_normalize(mat3_mul_vec3(ctx->tform.normals, in->normal));
+    out.tangent = vec3_normalize(mat3_mul_vec3(ctx->tform.normals, in->tangent));
     out.uv      = in->uv;
     out.color   = in->color;
 
@@ -77,6 +77,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdio.h>
 
 typedef enum
 {
@@ -180,6 +181,27 @@ HglImage hgl_io_image_read_netpbm(const char *filepath);
  */
 int hgl_io_image_write_netpbm(const char *filepath, HglImage *image);
 
+/**
+ * Same as hgl_io_image_write_netpbm, but writes to the already opened stream
+ * `fp` (e.g. a pipe, or stdout). Returns -1 on error, 0 otherwise.
+ */
+int hgl_io_image_fwrite_netpbm(FILE *fp, HglImage *image);
+
+/**
+ * Writes the image data in `image` to the file at `filepath` as a PAM (P7)
+ * file. Unlike hgl_io_image_write_netpbm, the alpha channel of RGBA8 images
+ * is kept. Only the 8-bit formats (R8, RGB8, RGBA8) are supported. The pixel
+ * data is written as-is, without any intermediate conversion. Returns -1 on
+ * error, 0 otherwise.
+ */
+int hgl_io_image_write_pam(const char *filepath, HglImage *image);
+
+/**
+ * Same as hgl_io_image_write_pam, but writes to the already opened stream
+ * `fp` (e.g. a pipe, or stdout). Returns -1 on error, 0 otherwise.
+ */
+int hgl_io_image_fwrite_pam(FILE *fp, HglImage *image);
+
 #endif /* HGL_IO_H */
 
 #ifdef HGL_IO_IMPLEMENTATION
@@ -680,6 +702,19 @@ out_err:
 }
 
 int hgl_io_image_write_netpbm(const char *filepath, HglImage *image)
+{
+    FILE *fp = fopen(filepath, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "[hgl_io_image_write_netpbm] Error: errno=%s\n", strerror(errno));
+        return -1;
+    }
+
+    int err = hgl_io_image_fwrite_netpbm(fp, image);
+    fclose(fp);
+    return err;
+}
+
+int hgl_io_image_fwrite_netpbm(FILE *fp, HglImage *image)
 {
     const char *magic;
     int maxval;
@@ -693,7 +728,6 @@ int hgl_io_image_write_netpbm(const char *filepath, HglImage *image)
             return -1;
     }
 
-    FILE *fp = fopen(filepath, "wb");
     fprintf(fp, "%s\n", magic);
     fprintf(fp, "# Generated by hgl_io.h\n");
     fprintf(fp, "%zu %zu\n", image->width, image->height);
@@ -744,8 +778,49 @@ int hgl_io_image_write_netpbm(const char *filepath, HglImage *image)
         } break;
     }
 
+    return ferror(fp) ? -1 : 0;
+}
+
+int hgl_io_image_write_pam(const char *filepath, HglImage *image)
+{
+    FILE *fp = fopen(filepath, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "[hgl_io_image_write_pam] Error: errno=%s\n", strerror(errno));
+        return -1;
+    }
+
+    int err = hgl_io_image_fwrite_pam(fp, image);
     fclose(fp);
-    return 0;
+    return err;
+}
+
+int hgl_io_image_fwrite_pam(FILE *fp, HglImage *image)
+{
+    int depth;
+    const char *tupltype;
+    switch (image->format) {
+        case HGL_IO_PIXEL_FORMAT_RGBA8: depth = 4; tupltype = "RGB_ALPHA"; break;
+        case HGL_IO_PIXEL_FORMAT_RGB8:  depth = 3; tupltype = "RGB";       break;
+        case HGL_IO_PIXEL_FORMAT_R8:    depth = 1; tupltype = "GRAYSCALE"; break;
+        default:
+            return -1;
+    }
+
+    fprintf(fp, "P7\n");
+    fprintf(fp, "WIDTH %zu\n", image->width);
+    fprintf(fp, "HEIGHT %zu\n", image->height);
+    fprintf(fp, "DEPTH %d\n", depth);
+    fprintf(fp, "MAXVAL 255\n");
+    fprintf(fp, "TUPLTYPE %s\n", tupltype);
+    fprintf(fp, "ENDHDR\n");
+
+    size_t n_bytes = (size_t)depth * image->width * image->height;
+    size_t n_written_bytes = fwrite(image->data, 1, n_bytes, fp);
+    if (n_written_bytes != n_bytes) {
+        return -1;
+    }
+
+    return ferror(fp) ? -1 : 0;
 }
 
 #endif
@@ -62,7 +62,7 @@
  *     - A handful of standalone functions for dealing with vertex- and index buffers,
  *       colors, textures, vertex and fragment interpolation, etc.
  *     - Low-level customization of the parallel rendering engine. The user may specify,
- *       at compile time, details such as tile dimensions, tile operation-queue size,
+ *       at compile time or at runtime, details such as tile dimensions and tile operation-queue size,
  *       and decide whether vertex processing will be done serially or in parallel.
  *
  * The hgl_rita.h rendering engine is based on a tiled (a.k.a sort middle) rasterizer architecture. By default,
@@ -72,6 +72,11 @@
  * processing is done up-front and in parallel. HGL_RITA_PARALLEL_VERTEX_PROCESSING typically yields better
  * performance when drawing large meshes (at least on my machine).
  *
+ * With HGL_RITA_PARALLEL_VERTEX_PROCESSING, large HGL_RITA_TRIANGLES draw calls are also assembled, culled
+ * and binned in parallel. The triangles are split into segments of at least HGL_RITA_MIN_BIN_SEGMENT_SIZE
+ * (default: 2048) triangles, one per producer thread. Each producer writes into its own set of per-tile
+ * bins, which the tile threads then rasterize in producer order, so draw order is preserved.
+ *
  * The frame- and depth buffers are divided into a number of 2D tiles. Each tile has its own thread,
  * conveniently referred to as a `tile thread`. Each tile thread is soley responsible for rendering into
  * its assigned area of the frame and depth buffer, with one exception (see below). Each tile has its own
@@ -79,9 +84,11 @@
  * is placed onto the end of the operation queues of all tiles intersecting it. operations are processed
  * by the tile thread in-order. For regular draw calls (OP_RASTER_POINT, OP_RASTERIZE_LINE, OP_RASTERIZE_TRI)
  * the tile threads performs rasterization, fragment shading, and subsequent writing to the frame and depth
- * buffer. Tile threads are also used to parallelize blit operations issued via `hgl_rita_blit()` (OP_BLIT).
+ * buffer. Tile threads are also used to parallelize blit operations issued via `hgl_rita_blit()` (OP_BLIT)
+ * and image filters issued via `hgl_rita_filter_*()` (OP_FILTER_ROWS, OP_FILTER_COLS), and to composite
+ * order-independent transparency (OP_RESOLVE_TRANSPARENCY).
  * Tile threads may also be used for up-front vertex processing iff HGL_RITA_PARALLEL_VERTEX_PROCESSING
- * is defined (OP_PROCESS_VERTICES). To ensure that all tile threads have completed their work, the user
+ * is defined (OP_PROCESS_VERTICES, OP_BIN_SEGMENT, OP_RASTERIZE_BINS). To ensure that all tile threads have completed their work, the user
  * must call `hgl_rita_finish()`. `hgl_rita_finish()` will block until all tile op-queues are empty and
  * all tile threads themselves are blocked, waiting for new operations to arrive on the op-queue. The
  * only operation on the frame buffer which is not parallelized is `hgl_rita_draw_text()`.
@@ -90,8 +97,8 @@
  *
  * By default, each tile is 256 pixels wide, 64 pixels high and has an op-queue with a capacity of 256.
  * These settings tend to give consistently decent performance for most workloads on my machine. The
- * optimum settings, however, may differ depending on workload and on your machine. These values can
- * be changed at compile-time by defining the following macros before including hgl_rita.h:
+ * optimum settings, however, may differ depending on workload and on your machine. The default values
+ * can be changed at compile-time by defining the following macros before including hgl_rita.h:
  *
  *     HGL_RITA_TILE_SIZE_X
  *     HGL_RITA_TILE_SIZE_Y
@@ -101,16 +108,24 @@
  * which may be defined instead, before including hgl_rita.h:
  *
  *     HGL_RITA_PRESET_128X64X64_SERIAL_VERTEX_PROCESSING
- *     HGL_RITA_PRESET_194X64X128_SERIAL_VERTEX_PROCESSING
+ *     HGL_RITA_PRESET_192X64X128_SERIAL_VERTEX_PROCESSING
  *     HGL_RITA_PRESET_256X64X256_SERIAL_VERTEX_PROCESSING
  *     HGL_RITA_PRESET_256X64X2048_SERIAL_VERTEX_PROCESSING
  *     HGL_RITA_PRESET_256X64X4096_SERIAL_VERTEX_PROCESSING
  *     HGL_RITA_PRESET_128X64X64_PARALLEL_VERTEX_PROCESSING
- *     HGL_RITA_PRESET_194X64X128_PARALLEL_VERTEX_PROCESSING
+ *     HGL_RITA_PRESET_192X64X128_PARALLEL_VERTEX_PROCESSING
  *     HGL_RITA_PRESET_256X64X256_PARALLEL_VERTEX_PROCESSING
  *     HGL_RITA_PRESET_256X64X2048_PARALLEL_VERTEX_PROCESSING
  *     HGL_RITA_PRESET_256X64X4096_PARALLEL_VERTEX_PROCESSING
  *
+ * The tile dimensions and op-queue capacity may also be changed at runtime using
+ * `hgl_rita_use_tile_config()`. Alternatively, `hgl_rita_autotune()` may be used to render a
+ * representative probe workload using a set of candidate configurations and pick the fastest one
+ * for the current machine:
+ *
+ *     hgl_rita_bind_texture(HGL_RITA_TEX_FRAME_BUFFER, &fb);
+ *     HglRitaTileConfig cfg = hgl_rita_autotune(draw_my_frame, &my_scene, 16);
+ *
  * The vertex and fragment specifications may be changed from DEFAULT to SIMPLE by defining:
  *
  *     HGL_RITA_SIMPLE
@@ -120,6 +135,106 @@
  * doing simpler 2D rendering, or when attributes such as tangent/bitangent vectors aren't needed,
  * to gain a tiny bit of performance.
  *
+ * 4x multisample anti-aliasing may be enabled at runtime with `hgl_rita_enable(HGL_RITA_MSAA)`.
+ * Coverage and depth are then evaluated at 4 (rotated grid) samples per pixel, but each pixel is
+ * only shaded once. Pixels that are completely covered by a triangle are written straight to the
+ * bound framebuffer. Only pixels along triangle edges get samples of their own, allocated from a
+ * tile-local arena, so the sample memory scales with the number of edge pixels rather than the
+ * framebuffer size. Uncovered samples of such pixels start out as the framebuffer color and depth
+ * buffer value of the pixel, so triangles blend with blits and pre-filled depth as expected. The
+ * samples are resolved (the average color, and the nearest depth) into the bound framebuffer by
+ * each tile thread when it is flushed: by `hgl_rita_finish()`, and before blits, filters and clears.
+ *
+ * hgl_rita.h also contains a handful of mesh preprocessing functions (`hgl_rita_mesh_*`) for
+ * welding duplicate vertices, generating index buffers, and reordering triangles and vertices
+ * for better vertex cache efficiency and memory locality. E.g. for a freshly loaded vertex soup:
+ *
+ *     hgl_rita_mesh_optimize(&vbuf, &ibuf);
+ *     hgl_rita_use_vertex_buffer_mode(HGL_RITA_INDEXED);
+ *
+ * When vertices are processed serially, indexed triangle draws go through a small post-transform
+ * vertex cache of HGL_RITA_VERTEX_CACHE_SIZE (default: 32, must be a power of two) entries.
+ *
+ * Draw calls may be given model space bounds (a box or a sphere) using `hgl_rita_use_bounds()`. The
+ * bounds are tested against the view frustum (tform.mvp) before any vertex is processed, and the draw
+ * call is skipped if they are outside it. Note that the bounds stay in use until they are replaced, so
+ * use `hgl_rita_use_bounds((HglRitaBounds){.kind = HGL_RITA_BOUNDS_NONE})` to turn culling off again.
+ * For scenes with many objects, a bounding volume hierarchy may be built over their world space bounds
+ * using `hgl_rita_bvh_make()`. `hgl_rita_bvh_cull()` then returns the potentially visible objects:
+ *
+ *     hgl_rita_bvh_cull(&bvh, &visible);
+ *     for (int i = 0; i < visible.length; i++) {
+ *         Object *obj = &objects[visible.arr[i]];
+ *         hgl_rita_use_model_matrix(obj->model);
+ *         hgl_rita_use_bounds(obj->bounds);
+ *         ...
+ *         hgl_rita_draw(HGL_RITA_TRIANGLES);
+ *     }
+ *
+ * The color attachment may be either HGL_RITA_RGBA8 or HGL_RITA_RGB565, and the depth attachment
+ * either HGL_RITA_R32 or HGL_RITA_R16 (16-bit unorm). The 16-bit formats halve the memory traffic of
+ * each fragment at the cost of precision. RGB565 has no alpha channel, and R16 depth is tested at the
+ * precision it is stored at. All formats can also be sampled as regular textures.
+ *
+ * Textures that are only sampled may be block compressed using `hgl_rita_texture_compress()`. HGL_RITA_BC1
+ * (color, 1-bit alpha) and HGL_RITA_BC4 (single channel) store each 4x4 block of texels in 64 bits, i.e.
+ * 8 and 4 times less than HGL_RITA_RGBA8 and HGL_RITA_R32 respectively. Blocks are decoded on the fly when
+ * sampled, and each thread keeps the last HGL_RITA_BLOCK_CACHE_SIZE (default: 64, must be a power of two)
+ * decoded blocks in a small cache. E.g.:
+ *
+ *     HglRitaTexture albedo_bc1 = hgl_rita_texture_compress(&albedo, HGL_RITA_BC1);
+ *     hgl_rita_bind_texture(HGL_RITA_TEX_DIFFUSE, &albedo_bc1);
+ *
+ * Fragment shaders may also be written to shade a batch of fragments at a time, and bound using
+ * `hgl_rita_bind_frag_shader_batch()`. When rasterizing a triangle, fragments that pass the depth test
+ * are then collected into batches of up to HGL_RITA_FRAG_BATCH_SIZE (default: 8) fragments, which lets
+ * the shader work on all of them at once, e.g. using SIMD. `hgl_rita_blit_batch()` does the same for
+ * shader blits. Points, lines and MSAA fragments are passed to the batch shader one at a time. See
+ * hgl_rita_shaders.h for a handful of batch shaders.
+ *
+ * Separable image filters (`hgl_rita_filter_*`) are applied in place to a region of the color attachment.
+ * A filter runs as two passes on the tile threads: a row pass, which convolves each row of the region
+ * horizontally into a float scratch buffer, followed by a column pass, which convolves the scratch buffer
+ * vertically and writes the result back. An N-tap kernel thus costs 2N multiply-adds per pixel and channel
+ * instead of N^2. Since each tile's row pass reads pixels from its neighbours (the "halo") and each column
+ * pass reads rows produced by its neighbours, the calling thread waits for all tile threads before each
+ * pass, but not after the last one. Pixels outside the region are never read; the region's edge pixels
+ * are repeated instead. Kernels may have at most 2*HGL_RITA_FILTER_MAX_RADIUS + 1 (default: 65) taps. E.g.:
+ *
+ *     hgl_rita_draw(HGL_RITA_TRIANGLES);
+ *     hgl_rita_filter_gaussian_blur(0, 0, WIDTH, HEIGHT, 2.5f);
+ *
+ * By default, the tile threads may run on any processor. With `hgl_rita_enable(HGL_RITA_THREAD_PINNING)`
+ * each tile thread is instead pinned to a single processor. The processors are ordered by package (socket),
+ * shared L3 cache, and core (read from /sys/devices/system/cpu), and the tiles are assigned to them in
+ * row-major order, so that neighbouring tiles run on processors that share caches. Each tile thread also
+ * does the first write to its own part of a newly bound frame- or depth buffer, and clears it on
+ * `hgl_rita_clear()`. On NUMA machines, where the kernel places a page on the node of the processor that
+ * first writes to it, each tile thread thereby gets its part of the framebuffer in local memory. For this
+ * to work, the framebuffer memory must not be written to before it's bound. E.g.:
+ *
+ *     hgl_rita_enable(HGL_RITA_THREAD_PINNING);
+ *     HglRitaTexture fb = hgl_rita_texture_make(WIDTH, HEIGHT, HGL_RITA_RGBA8);
+ *     hgl_rita_bind_texture(HGL_RITA_TEX_FRAME_BUFFER, &fb);
+ *
+ * HGL_RITA_ORDER_DEPENDENT_ALPHA_BLEND blends each fragment onto the framebuffer as it arrives, so transparent
+ * geometry must be sorted back to front by the application. With HGL_RITA_ORDER_INDEPENDENT_ALPHA_BLEND,
+ * fragments that pass the depth test are instead appended to a per-pixel list in tile-local memory, and
+ * are not written to the depth buffer. The lists are sorted and composited (back to front) onto the framebuffer
+ * by the tile threads the next time `hgl_rita_finish()` is called, a blit is issued, or the frame- or depth buffer
+ * is rebound. Binding other textures between transparent draw calls is fine. Only the nearest HGL_RITA_OIT_MAX_LAYERS
+ * (default: 16) fragments of each pixel are kept. Since enabling or disabling it waits for the tile threads,
+ * opaque geometry should be drawn first, and all transparent geometry after it, e.g.:
+ *
+ *     hgl_rita_draw(HGL_RITA_TRIANGLES); // opaque
+ *     hgl_rita_enable(HGL_RITA_ORDER_INDEPENDENT_ALPHA_BLEND);
+ *     hgl_rita_draw(HGL_RITA_TRIANGLES); // transparent, in any order
+ *     hgl_rita_disable(HGL_RITA_ORDER_INDEPENDENT_ALPHA_BLEND);
+ *
+ * If HGL_RITA_COLLECT_STATS is defined, hgl_rita.h keeps count of the number of draw calls, dispatched
+ * triangles, and rasterized fragments. The counters can be read using `hgl_rita_get_stats()`. This is
+ * mainly useful for benchmarking (see bench/rita_bench.c).
+ *
  * USAGE:
  *
  * Import hgl_rita.h like this:
@@ -179,6 +294,10 @@
 #  define HGL_RITA_MAX_N_TILES               1024
 #endif
 
+#ifndef HGL_RITA_MAX_N_CPUS
+#  define HGL_RITA_MAX_N_CPUS                1024
+#endif
+
 #ifdef HGL_RITA_PRESET_128X64X64_SERIAL_VERTEX_PROCESSING
 #  define HGL_RITA_TILE_SIZE_X                128
 #  define HGL_RITA_TILE_SIZE_Y                 64
@@ -257,7 +376,40 @@
 #  define HGL_RITA_TILE_OP_QUEUE_CAPACITY     256
 #endif
 
+#ifndef HGL_RITA_VERTEX_CACHE_SIZE
+#  define HGL_RITA_VERTEX_CACHE_SIZE           32
+#endif
+
+#ifndef HGL_RITA_BVH_LEAF_SIZE
+#  define HGL_RITA_BVH_LEAF_SIZE                4
+#endif
+
+#ifndef HGL_RITA_MIN_BIN_SEGMENT_SIZE
+#  define HGL_RITA_MIN_BIN_SEGMENT_SIZE      2048
+#endif
+
+#ifndef HGL_RITA_BLOCK_CACHE_SIZE
+#  define HGL_RITA_BLOCK_CACHE_SIZE            64
+#endif
+
+#ifndef HGL_RITA_FRAG_BATCH_SIZE
+#  define HGL_RITA_FRAG_BATCH_SIZE              8
+#endif
+
+#ifndef HGL_RITA_FILTER_MAX_RADIUS
+#  define HGL_RITA_FILTER_MAX_RADIUS           32
+#endif
+
+#ifndef HGL_RITA_FILTER_STRIP_SIZE
+#  define HGL_RITA_FILTER_STRIP_SIZE           64
+#endif
+
+#ifndef HGL_RITA_OIT_MAX_LAYERS
+#  define HGL_RITA_OIT_MAX_LAYERS              16
+#endif
+
 #define HGL_RITA_TEXT_BUFFER_MAX_SIZE 4096
+#define HGL_RITA_MSAA_N_SAMPLES 4
 
 #if !defined(HGL_RITA_ALLOC) && \
     !defined(HGL_RITA_REALLOC) && \
@@ -337,12 +489,11 @@
 /*--- Thread queue macro implementation -------------------------------------------------*/
 /*---------------------------------------------------------------------------------------*/
 
-#define HGL_RITA_TQ_ARR_DECL_ASSERT(T, N) T arr[(N > 1 && N <= UINT16_MAX) ? N : -1] // Assert that N is in the range [2, 2^16]
-
-#define HglRitaThreadQueue(T, N)                                                          \
+#define HglRitaThreadQueue(T)                                                             \
     struct                                                                                \
     {                                                                                     \
-        HGL_RITA_TQ_ARR_DECL_ASSERT(T, N);                                                \
+        T *arr;                                                                           \
+        uint32_t capacity;                                                                \
         pthread_mutex_t mutex;                                                            \
         pthread_cond_t cvar_writable;                                                     \
         pthread_cond_t cvar_readable;                                                     \
@@ -351,12 +502,17 @@
         _Atomic int n_idle;                                                               \
     }
 
-#define hgl_rita_queue_capacity(q) (sizeof((q)->arr) / sizeof((q)->arr[0]))
+#define hgl_rita_queue_capacity(q) ((q)->capacity)
 #define hgl_rita_queue_is_empty(q) ((q)->rp == (q)->wp)
 #define hgl_rita_queue_is_full(q) ((((q)->wp + 1) & (hgl_rita_queue_capacity(q) - 1)) == (q)->rp)
 
-#define hgl_rita_queue_init(q)                                                            \
+/* Note: `n` must be a power of two in the range [2, 2^16] */
+#define hgl_rita_queue_init(q, n)                                                         \
     do {                                                                                  \
+        assert(((n) > 1) && ((n) <= UINT16_MAX + 1) && (((n) & ((n) - 1)) == 0));         \
+        (q)->arr = HGL_RITA_ALLOC((n) * sizeof(*(q)->arr));                               \
+        assert((q)->arr != NULL);                                                         \
+        (q)->capacity = (n);                                                              \
         (q)->wp = 0;                                                                      \
         (q)->rp = 0;                                                                      \
         (q)->n_idle = 0;                                                                  \
@@ -376,6 +532,8 @@
         assert(0 == pthread_mutex_destroy(&(q)->mutex));                                  \
         assert(0 == pthread_cond_destroy(&(q)->cvar_writable));                           \
         assert(0 == pthread_cond_destroy(&(q)->cvar_readable));                           \
+        HGL_RITA_FREE((q)->arr);                                                          \
+        (q)->arr = NULL;                                                                  \
     } while (0)
 
 #define hgl_rita_queue_push(q, item)                                                      \
@@ -436,12 +594,15 @@ typedef enum
 
 typedef enum
 {
-    HGL_RITA_BACKFACE_CULLING            = (1 << 0),
-    HGL_RITA_DEPTH_TESTING               = (1 << 1),
-    HGL_RITA_ORDER_DEPENDENT_ALPHA_BLEND = (1 << 2),
-    HGL_RITA_Z_CLIPPING                  = (1 << 3),
-    HGL_RITA_DEPTH_BUFFER_WRITING        = (1 << 4),
-    HGL_RITA_WIRE_FRAMES                 = (1 << 5),
+    HGL_RITA_BACKFACE_CULLING              = (1 << 0),
+    HGL_RITA_DEPTH_TESTING                 = (1 << 1),
+    HGL_RITA_ORDER_DEPENDENT_ALPHA_BLEND   = (1 << 2),
+    HGL_RITA_Z_CLIPPING                    = (1 << 3),
+    HGL_RITA_DEPTH_BUFFER_WRITING          = (1 << 4),
+    HGL_RITA_WIRE_FRAMES                   = (1 << 5),
+    HGL_RITA_MSAA                          = (1 << 6),
+    HGL_RITA_THREAD_PINNING                = (1 << 7),
+    HGL_RITA_ORDER_INDEPENDENT_ALPHA_BLEND = (1 << 8),
 } HglRitaOpt;
 
 typedef enum
@@ -572,6 +733,10 @@ typedef enum
 {
     HGL_RITA_RGBA8,
     HGL_RITA_R32,
+    HGL_RITA_R16,    /* 16-bit unorm. E.g. for depth buffers that don't need the full precision */
+    HGL_RITA_RGB565, /* 16-bit packed color, no alpha */
+    HGL_RITA_BC1,    /* Block compressed (4x4 texels in 64 bits) color with 1-bit alpha. Read-only */
+    HGL_RITA_BC4,    /* Block compressed (4x4 texels in 64 bits) single channel. Read-only */
 } HglRitaPixelFormat;
 
 typedef struct
@@ -580,6 +745,10 @@ typedef struct
     union {
         HglRitaColor *rgba8;
         float *r32;
+        uint16_t *r16;
+        uint16_t *rgb565;
+        uint64_t *bc1;
+        uint64_t *bc4;
     } data;
     int width;
     int height;
@@ -594,6 +763,43 @@ typedef struct
     int max_y;
 } HglRitaAABB;
 
+typedef enum
+{
+    HGL_RITA_BOUNDS_NONE,
+    HGL_RITA_BOUNDS_BOX,
+    HGL_RITA_BOUNDS_SPHERE,
+} HglRitaBoundsKind;
+
+typedef struct
+{
+    HglRitaBoundsKind kind;
+    union {
+        struct {
+            Vec3 min;
+            Vec3 max;
+        } box;
+        struct {
+            Vec3 center;
+            float radius;
+        } sphere;
+    };
+} HglRitaBounds;
+
+typedef struct
+{
+    Vec3 min;
+    Vec3 max;
+    int first; /* Inner node: index of the left child (the right child is `first + 1`). Leaf: index of the first object in `objects` */
+    int count; /* Inner node: 0. Leaf: the number of objects */
+} HglRitaBVHNode;
+
+typedef struct
+{
+    HglRitaDynamicBuffer(HglRitaBVHNode) nodes;
+    HglRitaDynamicBuffer(HglRitaBounds) boxes; /* object bounds (as boxes). Same order as `objects` */
+    HglRitaIndexBuffer objects;                /* object indices, grouped by leaf */
+} HglRitaBVH;
+
 typedef struct
 {
     HglRitaFragment f0;
@@ -618,10 +824,19 @@ typedef struct
     int end_idx;
 } HglRitaVertexBufferSegment;
 
+typedef struct
+{
+    int start_idx;   /* first triangle of the segment */
+    int end_idx;     /* one past the last triangle of the segment */
+    int producer;    /* the set of bins the segment is binned into */
+    int n_producers; /* the number of producers of the draw call */
+} HglRitaBinSegment;
+
 struct HglRitaContext;
 
 typedef HglRitaVertex (*HglRitaVertShaderFunc)(const struct HglRitaContext *ctx, const HglRitaVertex *in);
 typedef HglRitaColor (*HglRitaFragShaderFunc)(const struct HglRitaContext *ctx, const HglRitaFragment *in);
+typedef void (*HglRitaFragShaderBatchFunc)(const struct HglRitaContext *ctx, const HglRitaFragment *in, HglRitaColor *out, int n);
 
 typedef struct
 {
@@ -631,18 +846,66 @@ typedef struct
     HglRitaBlitFBMask mask;
     HglRitaBlitFBSampler sampler;
     HglRitaFragShaderFunc shader;
+    HglRitaFragShaderBatchFunc shader_batch; /* Used instead of `shader` if non-NULL */
 } HglRitaBlitInfo;
 
+typedef enum
+{
+    HGL_RITA_FILTER_CONVOLVE, /* Convolves every channel with `filter.kernel_x` and `filter.kernel_y` */
+    HGL_RITA_FILTER_SOBEL,    /* Sobel gradient magnitude of the luminance */
+} HglRitaFilterMode;
+
+typedef struct
+{
+    HglRitaAABB aabb; /* The filtered region, clipped to the framebuffer */
+    HglRitaFilterMode mode;
+} HglRitaFilterInfo;
+
 typedef enum
 {
     HGL_RITA_OP_RASTERIZE_TRIANGLE,
     HGL_RITA_OP_RASTERIZE_LINE,
     HGL_RITA_OP_RASTERIZE_POINT,
     HGL_RITA_OP_PROCESS_VBUF_SEGMENT,
+    HGL_RITA_OP_BIN_SEGMENT,
+    HGL_RITA_OP_RASTERIZE_BINS,
     HGL_RITA_OP_BLIT,
+    HGL_RITA_OP_FILTER_ROWS,
+    HGL_RITA_OP_FILTER_COLS,
+    HGL_RITA_OP_CLEAR,
+    HGL_RITA_OP_FIRST_TOUCH,
+    HGL_RITA_OP_RESOLVE_TRANSPARENCY,
+    HGL_RITA_OP_RESOLVE_MSAA,
     HGL_RITA_OP_TERMINATE,
 } HglRitaTileOpKind;
 
+typedef struct
+{
+    int idx[3];             /* vertex buffer indices of the primitive (fetched from the fragment buffer when rasterized) */
+    HglRitaTileOpKind kind; /* HGL_RITA_OP_RASTERIZE_TRIANGLE or HGL_RITA_OP_RASTERIZE_LINE */
+} HglRitaBinnedPrimitive;
+
+typedef HglRitaDynamicBuffer(HglRitaBinnedPrimitive) HglRitaBin;
+
+typedef struct
+{
+    HglRitaColor color;
+    float depth;
+    uint32_t coverage; /* the MSAA samples covered by the fragment */
+    int next;          /* index of the next node of the same pixel, or -1 */
+} HglRitaOITNode;
+
+typedef HglRitaDynamicBuffer(HglRitaOITNode) HglRitaOITNodeBuffer;
+
+typedef struct
+{
+    HglRitaColor color[HGL_RITA_MSAA_N_SAMPLES];
+    float depth[HGL_RITA_MSAA_N_SAMPLES];
+    int pixel; /* index of the pixel within the tile */
+} HglRitaMSAAPixel;
+
+typedef HglRitaDynamicBuffer(HglRitaMSAAPixel) HglRitaMSAAPixelBuffer;
+
 typedef struct
 {
     union {
@@ -650,33 +913,86 @@ typedef struct
         HglRitaLine line;
         HglRitaPoint point;
         HglRitaVertexBufferSegment vbuf_segment;
+        HglRitaBinSegment bin_segment;
         HglRitaBlitInfo blit_info;
+        HglRitaFilterInfo filter_info;
+        uint32_t attachments;    /* HGL_RITA_OP_CLEAR */
+        HglRitaTexture *texture; /* HGL_RITA_OP_FIRST_TOUCH */
     };
     HglRitaTileOpKind kind;
 } HglRitaTileOp;
 
-typedef HglRitaThreadQueue(HglRitaTileOp, HGL_RITA_TILE_OP_QUEUE_CAPACITY) HglRitaTileOpQueue;
+typedef HglRitaThreadQueue(HglRitaTileOp) HglRitaTileOpQueue;
+
+typedef struct
+{
+    int tile_size_x;
+    int tile_size_y;
+    int op_queue_capacity;
+} HglRitaTileConfig;
 
 typedef struct
 {
     pthread_t thread;
     HglRitaTileOpQueue op_queue;
     HglRitaAABB aabb;
+    int *msaa_slots;          /* The samples (index into `msaa_pixels`) of each pixel of the tile, or -1 if the pixel has none. NULL until HGL_RITA_MSAA is used */
+    HglRitaMSAAPixelBuffer msaa_pixels; /* Tile-local arena the samples of edge pixels are allocated from. Emptied when resolved */
+    int cpu;                  /* The processor the tile thread is pinned to, or -1 */
+    int *oit_heads;           /* The first node of the transparent fragment list of each pixel of the tile, or -1. NULL until HGL_RITA_ORDER_INDEPENDENT_ALPHA_BLEND is used */
+    HglRitaOITNodeBuffer oit_nodes; /* Tile-local arena the transparent fragment lists are allocated from. Emptied when resolved */
+    HglRitaPixelFormat fb_format; /* Format of the color attachment. Looked up once per op by the tile thread */
+    HglRitaPixelFormat db_format; /* Format of the depth attachment (HGL_RITA_R32 if there is none). Looked up once per op by the tile thread */
+#ifdef HGL_RITA_COLLECT_STATS
+    uint64_t n_fragments;
+#endif
 } HglRitaTile;
 
+typedef struct
+{
+    const uint64_t *block;   /* NULL if the entry is empty */
+    uint32_t epoch;
+    HglRitaColor texels[16];
+} HglRitaBlockCacheEntry;
+
+typedef struct
+{
+    const HglRitaTexture *src;
+    HglRitaTexture *dst;
+    int first_block_row;
+    int block_row_step;
+    pthread_t thread;
+    bool spawned;
+} HglRitaCompressJob;
+
+typedef struct
+{
+    uint64_t n_draw_calls;
+    uint64_t n_culled_draw_calls;
+    uint64_t n_triangles;
+    uint64_t n_fragments;
+} HglRitaStats;
+
 typedef struct HglRitaContext
 {
     struct {
         HglRitaVertShaderFunc vert;
         HglRitaFragShaderFunc frag;
+        HglRitaFragShaderBatchFunc frag_batch;
     } shaders;
 
     struct {
         HglRitaVertexBufferMode  mode;
         HglRitaVertexBuffer     *vbuf;
         HglRitaIndexBuffer      *ibuf;
+        HglRitaBounds            bounds;
 #ifdef HGL_RITA_PARALLEL_VERTEX_PROCESSING
         HglRitaFragmentBuffer    fbuf;
+#else
+        struct {
+            int tag[HGL_RITA_VERTEX_CACHE_SIZE];
+            HglRitaFragment frag[HGL_RITA_VERTEX_CACHE_SIZE];
+        } cache;
 #endif
         int counter;
     } vertices;
@@ -692,6 +1008,9 @@ typedef struct HglRitaContext
         bool z_clipping_enabled;
         bool depth_buffer_writing_enabled;
         bool draw_wire_frames;
+        bool msaa_enabled;
+        bool thread_pinning_enabled;
+        bool order_independent_alpha_blending_enabled;
     } opts;
 
     struct {
@@ -716,12 +1035,35 @@ typedef struct HglRitaContext
 
     HglRitaTexture *tex_unit[HGL_RITA_N_TEXTURE_UNITS];
 
+    struct {
+        float kernel_x[2*HGL_RITA_FILTER_MAX_RADIUS + 1];
+        float kernel_y[2*HGL_RITA_FILTER_MAX_RADIUS + 1];
+        int radius;
+        float *scratch;       /* 4 planes (one per channel) of the row pass output. One float per pixel of the filtered region */
+        size_t scratch_size;  /* in floats */
+    } filter;
+
     struct {
         HglRitaTile tile[HGL_RITA_MAX_N_TILES];
+        HglRitaTileConfig tile_config;
         int n_tiles;
         int n_tile_cols;
         int n_tile_rows;
+        int fb_width;
+        int fb_height;
         int n_procs;
+        _Atomic uint32_t block_cache_epoch; /* Bumped whenever block compressed texture memory is allocated or freed. Invalidates all block caches. */
+        const void *first_touched[4];       /* The most recently first-touched frame- and depth buffers (data pointers) of the current tile threads. See HGL_RITA_THREAD_PINNING */
+        int n_first_touched;
+        bool oit_pending;                   /* true if transparent fragments may have been collected since the last `hgl_rita_finish()` */
+#ifdef HGL_RITA_PARALLEL_VERTEX_PROCESSING
+        HglRitaBin *bins; /* n_procs x n_tiles bins. `bins[p*n_tiles + i]` holds the primitives producer `p` binned to tile `i` */
+#endif
+#ifdef HGL_RITA_COLLECT_STATS
+        uint64_t n_draw_calls;
+        uint64_t n_culled_draw_calls;
+        _Atomic uint64_t n_triangles;
+#endif
     } renderer;
 
 } HglRitaContext;
@@ -737,6 +1079,7 @@ static inline void hgl_rita_bind_buffer(HglRitaBuffer buffer, void *item);
 static inline void hgl_rita_bind_texture(HglRitaTexUnit unit, HglRitaTexture *tex);         /* binds a texture to the specified texture unit in the current context. */
 static inline void hgl_rita_bind_vert_shader(HglRitaVertShaderFunc vert);                   /* binds the specified vertex shader in the current context. A value of NULL uses default vertex processing */
 static inline void hgl_rita_bind_frag_shader(HglRitaFragShaderFunc frag);                   /* binds the specified fragment shader in the current context. A value of NULL uses default fragment processing */
+static inline void hgl_rita_bind_frag_shader_batch(HglRitaFragShaderBatchFunc frag);        /* binds the specified batch fragment shader in the current context. Takes precedence over the regular fragment shader. A value of NULL unbinds it. */
 static inline void hgl_rita_enable(uint32_t opts);                                          /* Enables the specified options in the current context (options may be bitwise OR:ed together. See HglRitaOpt.). */
 static inline void hgl_rita_disable(uint32_t opts);                                         /* Disables the specified options in the current context (options may be bitwise OR:ed together. See HglRitaOpt.). */
 static inline void hgl_rita_use_frontface_winding_order(HglRitaWindingOrder winding_order); /* Use the specified winding order to determine which triangle faces are front-facing in the current context. */
@@ -754,10 +1097,16 @@ static inline void hgl_rita_use_orthographic_proj(float left, float right,
                                                   float bottom, float top,
                                                   float near, float far);                   /* Construct an orthographic projection matrix and use it (tform.proj). Will populate the respective `tform.camera` attributes. */
 static inline void hgl_rita_use_viewport(int width, int height);                            /* Use the specified viewport dimensions in the current context. These values determine the transformation from NDC space to pixel coordinates. */
+static inline void hgl_rita_use_tile_config(HglRitaTileConfig config);                      /* Use the specified tile dimensions and tile op-queue capacity in the current context. Tile threads are respawned if a framebuffer is bound. */
+static inline HglRitaTileConfig hgl_rita_get_tile_config(void);                             /* Returns the tile configuration of the current context. */
+static inline HglRitaTileConfig hgl_rita_autotune(void (*probe)(void *userdata),
+                                                  void *userdata, int n_frames);            /* Renders `n_frames` frames of the workload `probe` for each of a set of candidate tile configurations, uses the fastest one, and returns it. A framebuffer must be bound. */
+static inline HglRitaStats hgl_rita_get_stats(void);                                        /* Returns the number of draw calls, culled draw calls, dispatched triangles, and rasterized fragments since the last reset. Always zero unless HGL_RITA_COLLECT_STATS is defined. */
+static inline void hgl_rita_reset_stats(void);                                              /* Resets the counters returned by `hgl_rita_get_stats()`. */
 
 /* Drawing */
 static inline void hgl_rita_clear(uint32_t attachments);                                    /* Clears the specified attachments of the currently bound framebuffer(attachments may be bitwise OR:ed together. See HglRitaFramebufferAttachment). */
-static inline void hgl_rita_finish(void);                                                   /* Waits until all asynchronous operations (hgl_rita_draw, hgl_rita_blit) have finished. */
+static inline void hgl_rita_finish(void);                                                   /* Waits until all asynchronous operations (hgl_rita_draw, hgl_rita_blit) have finished. Collected transparent fragments (see HGL_RITA_ORDER_INDEPENDENT_ALPHA_BLEND) are resolved first. */
 static inline void hgl_rita_draw_text(int pos_x, int pos_y,
                                       float scale,
                                       HglRitaColor color,
@@ -769,6 +1118,20 @@ static inline void hgl_rita_blit(int x, int y, int w, int h,
                                  HglRitaBlitFBMask mask,
                                  HglRitaBlitFBSampler sampling_method,
                                  HglRitaFragShaderFunc shader);                             /* Blits `src` onto the framebuffer color attachment at the specified region. This is an asynchronous operation. */
+static inline void hgl_rita_blit_batch(int x, int y, int w, int h,
+                                       HglRitaTexture *src,
+                                       HglRitaBlendMethod blend_method,
+                                       HglRitaBlitFBMask mask,
+                                       HglRitaFragShaderBatchFunc shader);                  /* Same as `hgl_rita_blit()` with HGL_RITA_SHADER sampling, but shades HGL_RITA_FRAG_BATCH_SIZE pixels per call to the batch shader `shader`. */
+
+/* Filters */
+static inline void hgl_rita_filter_separable(int x, int y, int w, int h,
+                                             const float *kernel_x,
+                                             const float *kernel_y,
+                                             int radius);                                   /* Convolves the framebuffer color attachment at the specified region with the separable kernel `kernel_x` (horizontal) and `kernel_y` (vertical), each with 2*`radius` + 1 taps. Blocks until the row pass has finished. */
+static inline void hgl_rita_filter_box_blur(int x, int y, int w, int h, int radius);        /* Box blurs the framebuffer color attachment at the specified region. The box is 2*`radius` + 1 pixels wide. */
+static inline void hgl_rita_filter_gaussian_blur(int x, int y, int w, int h, float sigma);  /* Gaussian blurs the framebuffer color attachment at the specified region. The kernel is cut off at 3*`sigma`. */
+static inline void hgl_rita_filter_sobel(int x, int y, int w, int h);                       /* Replaces the framebuffer color attachment at the specified region with the (grayscale) sobel gradient magnitude of its luminance. */
 
 /* HglRitaTexture: standalone functions */
 static inline HglRitaTexture hgl_rita_texture_make(int width, int height,
@@ -777,7 +1140,9 @@ static inline void hgl_rita_texture_destroy(HglRitaTexture *tex);
 static inline HglRitaTexture hgl_rita_texture_get_subtexture(HglRitaTexture tex,
                                                              int x, int y,
                                                              int width, int height);        /* Creates a subtexture of `tex` at the given region. Must not be freed.*/
-static inline void hgl_rita_texture_flip_vertically(HglRitaTexture *tex);                   /* Vertically flips the texture `tex`. */
+static inline void hgl_rita_texture_flip_vertically(HglRitaTexture *tex);                   /* Vertically flips the texture `tex`. Thread-safe for distinct textures. */
+static inline HglRitaTexture hgl_rita_texture_compress(const HglRitaTexture *src,
+                                                       HglRitaPixelFormat format);          /* Encodes `src` into a new block compressed texture of format HGL_RITA_BC1 or HGL_RITA_BC4. Uses one thread per processor. Should be free'd using `hgl_rita_texture_destroy()` */
 static inline void hgl_rita_texture_blit(HglRitaTexture dst,
                                          HglRitaTexture src,
                                          HglRitaBlendMethod blend_method,
@@ -785,6 +1150,28 @@ static inline void hgl_rita_texture_blit(HglRitaTexture dst,
 
 /* HglRitaVertex: standalone functions */
 static inline bool hgl_rita_vertex_eq(HglRitaVertex v0, HglRitaVertex v1);                  /* Returns true if `v0` and `v1` are equal */
+static inline uint32_t hgl_rita_vertex_hash(const HglRitaVertex *v);                        /* Returns a hash of `v`, such that vertices that are equal according to `hgl_rita_vertex_eq()` hash equally. */
+
+/* Mesh preprocessing (triangle lists) */
+static inline void hgl_rita_mesh_weld(HglRitaVertexBuffer *vbuf, HglRitaIndexBuffer *ibuf); /* Removes duplicate vertices from `vbuf` and remaps `ibuf`. If `ibuf` is empty, `vbuf` is treated as an HGL_RITA_ARRAY vertex soup, and `ibuf` is generated. */
+static inline void hgl_rita_mesh_optimize_vertex_cache(HglRitaIndexBuffer *ibuf,
+                                                       int n_vertices,
+                                                       int cache_size);                     /* Reorders the triangles of `ibuf` for post-transform vertex cache efficiency (Tipsify). */
+static inline void hgl_rita_mesh_optimize_vertex_fetch(HglRitaVertexBuffer *vbuf,
+                                                       HglRitaIndexBuffer *ibuf);           /* Reorders `vbuf` in the order its vertices are first referenced by `ibuf`, and remaps `ibuf`. Unreferenced vertices are removed. */
+static inline void hgl_rita_mesh_optimize(HglRitaVertexBuffer *vbuf,
+                                          HglRitaIndexBuffer *ibuf);                        /* Does all of the above, in order, with a cache size of HGL_RITA_VERTEX_CACHE_SIZE. */
+
+/* Bounds & visibility culling */
+static inline void hgl_rita_use_bounds(HglRitaBounds bounds);                               /* Use `bounds` (model space) as the bounds of subsequent draw calls. Draw calls whose bounds are outside the view frustum are skipped. HGL_RITA_BOUNDS_NONE disables culling. */
+static inline HglRitaBounds hgl_rita_bounds_make_box(Vec3 min, Vec3 max);                   /* Creates axis-aligned box bounds */
+static inline HglRitaBounds hgl_rita_bounds_make_sphere(Vec3 center, float radius);         /* Creates sphere bounds */
+static inline HglRitaBounds hgl_rita_bounds_from_vertex_buffer(const HglRitaVertexBuffer *vbuf); /* Creates the smallest axis-aligned box bounds containing all vertices of `vbuf` */
+static inline HglRitaBounds hgl_rita_bounds_transform(HglRitaBounds bounds, Mat4 m);        /* Returns bounds containing `bounds` transformed by the affine transform `m`. Boxes stay axis-aligned, so they may grow. */
+static inline bool hgl_rita_bounds_visible(HglRitaBounds bounds, Mat4 m);                   /* Returns false if `bounds` are guaranteed to be outside the view frustum given by the clip space transform `m` (e.g. tform.mvp). */
+static inline HglRitaBVH hgl_rita_bvh_make(const HglRitaBounds *bounds, int n);             /* Builds a bounding volume hierarchy over `n` objects with the (world space) bounds `bounds`. Should be free'd using `hgl_rita_bvh_destroy()` */
+static inline void hgl_rita_bvh_destroy(HglRitaBVH *bvh);                                   /* Destroys `bvh`. */
+static inline void hgl_rita_bvh_cull(const HglRitaBVH *bvh, HglRitaIndexBuffer *visible);   /* Frustum culls the objects of `bvh` against the current view and projection matrices. The indices of the potentially visible objects are written to `visible`. */
 
 /* HglRitaColor: standalone functions */
 static inline HglRitaColor hgl_rita_color_blend(HglRitaColor c0,
@@ -799,6 +1186,8 @@ static inline bool hgl_rita_color_eq(HglRitaColor c0, HglRitaColor c1);
 static inline float hgl_rita_color_luminance(HglRitaColor c0);                              /* Calculates the luminance of `c0` normalized to [0, 1]. */
 static inline Vec4 hgl_rita_color_as_vector(HglRitaColor c0);                               /* Returns a vector where the x, y, z, and w components are the color channels r, g, b, and a normalized to [0, 1]. */
 static inline HglRitaColor hgl_rita_color_from_vector(Vec4 v);                              /* Does the inverse of `hgl_rita_color_as_vector()` */
+static inline uint16_t hgl_rita_color_to_rgb565(HglRitaColor c0);                           /* Packs `c0` into a 16-bit RGB565 pixel. The alpha channel is dropped. */
+static inline HglRitaColor hgl_rita_color_from_rgb565(uint16_t p);                          /* Unpacks the 16-bit RGB565 pixel `p`. The alpha channel is set to 255. */
 
 /* HglRitaAABB: standalone functions */
 static inline HglRitaAABB hgl_rita_aabb_make(int x, int y, int w, int h);                   /* Creates n 2D Axis-aligned bounding box (AABB) with the given dimensions. */
@@ -820,15 +1209,137 @@ static inline HglRitaColor hgl_rita_sample_unit_rectilinear(HglRitaTexUnit unit,
 static inline HglRitaColor hgl_rita_sample_unit_cubemap(HglRitaTexUnit unit, Vec3 dir);     /* Samples the texture bound to texture unit `unit` using cubemap projection at the 3D view direction `dir` */
 
 /* internal functions */
+static inline void hgl_rita_wait_internal_(void);                                           /* Waits until all tile op-queues are empty and all tile threads are idle. Unlike `hgl_rita_finish()`, collected transparent fragments are not resolved. */
+static inline void hgl_rita_resolve_transparency_internal_(void);                           /* Dispatches the resolve of the transparent fragments collected since the last resolve (if any) to all tiles. */
+static inline void hgl_rita_resolve_msaa_internal_(void);                                   /* Dispatches the resolve of the MSAA samples (if MSAA is enabled) to all tiles. */
+static inline void hgl_rita_spawn_tiles_internal_(int fb_width, int fb_height);             /* Spawns tile threads covering a framebuffer of size `fb_width` x `fb_height`, using the current tile configuration. With HGL_RITA_THREAD_PINNING, also first-touches the bound frame- and depth buffers. */
+static inline void hgl_rita_despawn_tiles_internal_(void);                                  /* Terminates all tile threads and destroys their op-queues. */
 static inline void *hgl_rita_tile_thread_internal_(void *arg);                              /* This function contains the main work-loop of each spawned tile thread. */
+static inline int hgl_rita_cpu_order_internal_(int *cpus);                                  /* Stores the processors the process may run on in `cpus`, ordered by package, shared L3 cache, and core, and returns the number of them. */
+static inline int hgl_rita_cpu_topology_internal_(int cpu, const char *attr);               /* Reads the topology attribute `attr` (e.g. "topology/core_id") of processor `cpu` from sysfs. Returns -1 if it's not available. */
+static inline void hgl_rita_pin_thread_internal_(int cpu);                                  /* Pins the calling thread to processor `cpu`. */
+static inline void hgl_rita_first_touch_internal_(HglRitaTexture *tex);                     /* Has each tile thread write to its own part of `tex`, and waits for them to finish. Does nothing if that was recently done for `tex`. */
+static inline void hgl_rita_clear_tile_internal_(HglRitaTile *tile, uint32_t attachments);  /* Clears the part of the specified attachments covered by `tile`, including its MSAA sample buffers. */
 static inline void hgl_rita_dispatch_point_internal_(HglRitaFragment f0);                   /* Dispatches a point/pixel primitive to the thread of the tile containing it */
 static inline void hgl_rita_dispatch_line_internal_(HglRitaFragment f0,
                                                     HglRitaFragment f1);                    /* Dispatches a line primitive to the threads of the tiles intersecting its AABB */
 static inline void hgl_rita_dispatch_tri_internal_(HglRitaFragment f0,
                                                    HglRitaFragment f1,
                                                    HglRitaFragment f2);                     /* Dispatches a triangle primitive to the threads of the tiles intersecting its AABB */
+static inline bool hgl_rita_tri_is_culled_internal_(const HglRitaFragment *f0,
+                                                    const HglRitaFragment *f1,
+                                                    const HglRitaFragment *f2);             /* Returns true if the triangle is discarded by clipping or back-face culling */
+static inline HglRitaAABB hgl_rita_tri_coverage_aabb_internal_(HglRitaTriangle tri);        /* Returns the AABB (inclusive) of the pixels `tri` may cover, i.e. the ones its rasterization visits. Used by both the dispatch and the rasterization, so that they agree */
+#ifdef HGL_RITA_PARALLEL_VERTEX_PROCESSING
+static inline bool hgl_rita_draw_triangles_binned_internal_(void);                          /* Assembles, culls and bins the triangles of the current draw call on multiple producer threads. Returns false if the draw call is too small to be worth it. */
+static inline void hgl_rita_bin_segment_internal_(HglRitaBinSegment seg);                   /* Assembles, culls and bins the triangles of `seg` into the bins of producer `seg.producer` */
+static inline void hgl_rita_bin_primitive_internal_(HglRitaBin *bins,
+                                                    HglRitaAABB aabb,
+                                                    HglRitaBinnedPrimitive prim);           /* Appends `prim` to the bins (one per tile) of the tiles intersecting `aabb` */
+static inline HglRitaTileOp hgl_rita_unbin_primitive_internal_(HglRitaBinnedPrimitive prim); /* Turns a binned primitive back into a rasterization op, using the fragment buffer */
+#endif
 static inline HglRitaFragment hgl_rita_process_vertex_internal_(const HglRitaVertex *in);   /* Processes a single vertex into a fragment and returns it. This function contains the VERTEX SHADER step! */
-static inline void hgl_rita_process_fragment_internal_(HglRitaFragment *in);                /* Processes a single fragment. If the fragment is accepted, it is drawn to the frame buffer. This function contains the FRAGMENT SHADER step! */
+#ifndef HGL_RITA_PARALLEL_VERTEX_PROCESSING
+static inline HglRitaFragment hgl_rita_process_vertex_cached_internal_(int idx);            /* Same as `hgl_rita_process_vertex_internal_()`, but looks up (and stores) the result in the post-transform vertex cache. */
+#endif
+static inline void hgl_rita_process_fragment_internal_(HglRitaTile *tile,
+                                                       HglRitaFragment *in);                /* Processes a single fragment. If the fragment is accepted, it is drawn to the frame buffer. This function contains the FRAGMENT SHADER step! */
+static inline void hgl_rita_process_fragment_msaa_internal_(HglRitaTile *tile,
+                                                            HglRitaFragment *in,
+                                                            uint32_t coverage,
+                                                            const float *sample_depth);     /* Same as above, but for the samples in `coverage` of the pixel. Shades once. Completely covered pixels without samples of their own are written straight to the framebuffer. `sample_depth` may be NULL. */
+static inline HglRitaColor hgl_rita_shade_fragment_internal_(HglRitaFragment *in);          /* Runs the FRAGMENT SHADER (or default shading) on `in` and returns the resulting color. */
+static inline bool hgl_rita_fragment_depth_test_internal_(const HglRitaTile *tile,
+                                                          const HglRitaFragment *in,
+                                                          int *idx, float *depth);          /* Runs the depth test (if enabled) on `in`. Returns false if it's rejected. Stores the framebuffer index and depth of `in` in `idx` and `depth`. */
+static inline void hgl_rita_fragment_write_internal_(const HglRitaTile *tile,
+                                                     int idx, float depth,
+                                                     HglRitaColor color);                   /* Blends (if enabled) and writes `color`, and writes `depth` (if enabled), at `idx` of the framebuffer. */
+static inline void hgl_rita_flush_fragment_batch_internal_(HglRitaTile *tile,
+                                                           HglRitaFragment *frags,
+                                                           const int *idx,
+                                                           const float *depth,
+                                                           int n);                          /* Shades `n` depth tested fragments with a single call to the batch FRAGMENT SHADER, and writes them to the framebuffer. */
+static inline void hgl_rita_oit_insert_internal_(HglRitaTile *tile, int x, int y,
+                                                 HglRitaColor color, float depth,
+                                                 uint32_t coverage);                        /* Appends a transparent fragment to the list of pixel (`x`, `y`) of `tile` */
+static inline void hgl_rita_oit_resolve_internal_(HglRitaTile *tile);                       /* Sorts the transparent fragment lists of `tile`, composites them onto the framebuffer (and MSAA samples), and empties them */
+static inline HglRitaColor hgl_rita_msaa_resolve_internal_(const HglRitaColor *samples);    /* Returns the average of the HGL_RITA_MSAA_N_SAMPLES samples `samples` */
+static inline HglRitaMSAAPixel *hgl_rita_msaa_pixel_internal_(HglRitaTile *tile,
+                                                              int x, int y);                /* Returns the samples of pixel (`x`, `y`) of `tile`. If it has none, they are allocated and initialized to the framebuffer color and depth buffer value of the pixel. */
+static inline void hgl_rita_msaa_resolve_tile_internal_(HglRitaTile *tile);                 /* Resolves the samples of `tile` into the framebuffer (average color) and depth buffer (nearest depth), and frees them. */
+static inline void hgl_rita_flush_blit_batch_internal_(const HglRitaTile *tile,
+                                                       const HglRitaBlitInfo *info,
+                                                       HglRitaFragment *frags,
+                                                       const int *idx,
+                                                       const HglRitaColor *dst,
+                                                       int n);                              /* Shades `n` blitted pixels with a single call to the batch shader of `info`, and blends them onto `dst` in the framebuffer. */
+static inline void hgl_rita_dispatch_blit_internal_(HglRitaBlitInfo info);                  /* Dispatches a blit operation to the threads of all tiles intersecting it */
+static inline void hgl_rita_dispatch_region_internal_(HglRitaTileOp op, HglRitaAABB aabb);  /* Dispatches `op` to the threads of all tiles intersecting `aabb` */
+static inline void hgl_rita_filter_internal_(int x, int y, int w, int h,
+                                             HglRitaFilterMode mode);                       /* Runs the row pass, then dispatches the column pass, of a filter using the kernels in `hgl_rita_ctx__.filter` */
+static inline void hgl_rita_filter_rows_internal_(HglRitaFilterInfo info, HglRitaAABB aabb); /* Row pass of a filter: convolves the rows of `aabb` (a part of the filtered region) horizontally into the scratch buffer */
+static inline void hgl_rita_filter_cols_internal_(HglRitaFilterInfo info, HglRitaAABB aabb); /* Column pass of a filter: convolves the scratch buffer vertically and writes the rows of `aabb` to the framebuffer */
+static inline void hgl_rita_convolve_row_internal_(float *out, const float *in,
+                                                   const float *kernel, int n_taps,
+                                                   int n);                                  /* out[i] = sum_k kernel[k]*in[i + k], for i in [0, n) */
+static inline void hgl_rita_convolve_col_internal_(float *out, const float *plane,
+                                                   int stride, int height, int y,
+                                                   const float *kernel, int radius,
+                                                   int n);                                  /* Convolves `n` columns of row `y` of `plane` vertically. Rows outside [0, `height`) are clamped. */
+static inline HglRitaColor hgl_rita_fb_read_rgba8_internal_(const HglRitaTexture *fb, int idx);  /* Reads the color at `idx` of the HGL_RITA_RGBA8 color attachment `fb` */
+static inline HglRitaColor hgl_rita_fb_read_rgb565_internal_(const HglRitaTexture *fb, int idx); /* Reads the color at `idx` of the HGL_RITA_RGB565 color attachment `fb` */
+static inline void hgl_rita_fb_write_rgba8_internal_(HglRitaTexture *fb, int idx,
+                                                     HglRitaColor color);                   /* Writes `color` at `idx` of the HGL_RITA_RGBA8 color attachment `fb` */
+static inline void hgl_rita_fb_write_rgb565_internal_(HglRitaTexture *fb, int idx,
+                                                      HglRitaColor color);                  /* Writes `color` at `idx` of the HGL_RITA_RGB565 color attachment `fb` */
+static inline float hgl_rita_depth_read_r32_internal_(const HglRitaTexture *db, int idx);   /* Reads the depth at `idx` of the HGL_RITA_R32 depth attachment `db` */
+static inline float hgl_rita_depth_read_r16_internal_(const HglRitaTexture *db, int idx);   /* Reads the depth at `idx` of the HGL_RITA_R16 depth attachment `db` */
+static inline bool hgl_rita_depth_test_r32_internal_(const HglRitaTexture *db, int idx,
+                                                     float depth);                          /* Returns true if `depth` passes the depth test at `idx` of the HGL_RITA_R32 depth attachment `db` */
+static inline bool hgl_rita_depth_test_r16_internal_(const HglRitaTexture *db, int idx,
+                                                     float depth);                          /* Returns true if `depth` passes the depth test at `idx` of the HGL_RITA_R16 depth attachment `db`. Compares at 16-bit precision. */
+static inline void hgl_rita_depth_write_r32_internal_(HglRitaTexture *db, int idx,
+                                                      float depth);                         /* Writes `depth` at `idx` of the HGL_RITA_R32 depth attachment `db` */
+static inline void hgl_rita_depth_write_r16_internal_(HglRitaTexture *db, int idx,
+                                                      float depth);                         /* Writes `depth` at `idx` of the HGL_RITA_R16 depth attachment `db` */
+static inline HglRitaColor hgl_rita_fb_read_internal_(const HglRitaTexture *fb,
+                                                      HglRitaPixelFormat format, int idx);  /* Reads the color at `idx` of the color attachment `fb` of format `format`. Callers look `format` up once per op, so that this is a predictable branch between two inlined reads. */
+static inline void hgl_rita_fb_write_internal_(HglRitaTexture *fb, HglRitaPixelFormat format,
+                                               int idx, HglRitaColor color);                /* Writes `color` at `idx` of the color attachment `fb` of format `format` */
+static inline float hgl_rita_depth_read_internal_(const HglRitaTexture *db,
+                                                  HglRitaPixelFormat format, int idx);      /* Reads the depth at `idx` of the depth attachment `db` of format `format` */
+static inline bool hgl_rita_depth_test_internal_(const HglRitaTexture *db, HglRitaPixelFormat format,
+                                                 int idx, float depth);                     /* Returns true if `depth` passes the depth test at `idx` of the depth attachment `db` of format `format` */
+static inline void hgl_rita_depth_write_internal_(HglRitaTexture *db, HglRitaPixelFormat format,
+                                                  int idx, float depth);                    /* Writes `depth` at `idx` of the depth attachment `db` of format `format` */
+static inline float hgl_rita_texel_r_internal_(const HglRitaTexture *tex, int x, int y);   /* Reads the single channel texel (`x`, `y`) of `tex` (HGL_RITA_R32, HGL_RITA_R16 or HGL_RITA_BC4), normalized to [0, 1] */
+static inline HglRitaColor hgl_rita_texel_internal_(const HglRitaTexture *tex, int x, int y); /* Reads the texel (`x`, `y`) of `tex` as a color. Single channel formats are returned in the red channel. */
+static inline const HglRitaColor *hgl_rita_block_fetch_internal_(const HglRitaTexture *tex,
+                                                                 int x, int y);             /* Returns the 16 decoded texels of the block containing texel (`x`, `y`) of the block compressed `tex`. Decoded blocks are kept in a small per-thread cache. */
+static inline void hgl_rita_bc1_palette_internal_(uint16_t c0, uint16_t c1,
+                                                  HglRitaColor palette[4]);                 /* Computes the 4 color palette of a BC1 block with endpoints `c0` and `c1`. */
+static inline void hgl_rita_bc4_palette_internal_(uint8_t r0, uint8_t r1,
+                                                  uint8_t palette[8]);                      /* Computes the 8 value palette of a BC4 block with endpoints `r0` and `r1`. */
+static inline uint64_t hgl_rita_bc1_encode_block_internal_(const HglRitaColor texels[16]);  /* Encodes a 4x4 block of texels as BC1. Texels with alpha < 128 are encoded as transparent. */
+static inline uint64_t hgl_rita_bc4_encode_block_internal_(const uint8_t values[16]);       /* Encodes a 4x4 block of single channel values as BC4. */
+static inline void hgl_rita_bc1_decode_block_internal_(uint64_t block,
+                                                       HglRitaColor texels[16]);            /* Decodes a BC1 block into 16 texels. */
+static inline void hgl_rita_bc4_decode_block_internal_(uint64_t block,
+                                                       HglRitaColor texels[16]);            /* Decodes a BC4 block into 16 texels. The value is returned in the red channel. */
+static inline void *hgl_rita_compress_thread_internal_(void *arg);                          /* Encodes every `block_row_step`:th row of blocks of a `HglRitaCompressJob`, starting at `first_block_row`. */
+static inline float hgl_rita_atan2_internal_(float y, float x);                             /* Polynomial approximation of atan2f. The absolute error is less than 1e-5 radians. */
+static inline int hgl_rita_cubemap_face_internal_(Vec3 dir, Vec2 *uv);                      /* Returns the cubemap face (see `hgl_rita_cubemap_faces__`) that `dir` points at, and stores the texture coordinate on that face in `uv` */
+static inline void hgl_rita_msaa_free_internal_(HglRitaTile *tile);                         /* Frees the tile-local MSAA sample buffers of `tile`. */
+static inline int hgl_rita_frustum_planes_internal_(Mat4 m, Vec4 planes[6]);              /* Extracts the view frustum planes (pointing inwards) of the clip space transform `m`. The far plane is only included if z-clipping is enabled. Returns the number of planes. */
+static inline int hgl_rita_box_frustum_test_internal_(const Vec4 *planes, int n_planes,
+                                                      Vec3 min, Vec3 max);                  /* Tests an axis-aligned box against the frustum planes. Returns 0 if it's outside, 1 if it intersects, and 2 if it's inside. */
+static inline void hgl_rita_bvh_build_internal_(HglRitaBVH *bvh, int node,
+                                                const HglRitaBounds *boxes,
+                                                const Vec3 *centroids);                     /* Recursively splits the objects of `node` at the midpoint of the longest axis of their centroids */
+static inline void hgl_rita_bvh_cull_internal_(const HglRitaBVH *bvh, int node,
+                                               const Vec4 *planes, int n_planes,
+                                               bool inside, HglRitaIndexBuffer *visible);   /* Recursively culls `node`. If `inside` is true, all objects below `node` are visible. */
 static inline HglRitaFragment hgl_rita_frag_lerp_internal_(int x, int y,
                                                            HglRitaFragment f0,
                                                            HglRitaFragment f1,
@@ -842,6 +1353,7 @@ static inline float hgl_rita_det_internal_(int f0_x, int f0_y,
                                            int f1_x, int f1_y,
                                            int f2_x, int f2_y);                             /* Cheeky determinant which isn't really a determinant. Something to do with a '2D cross product'. */
 static inline int hgl_rita_next_vbuf_index_internal_(void);                                 /* Fetches the next vertex in the vertex buffer given the current vertex buffer mode (HGL_RITA_ARRAY or HGL_RITA_INDEXED) */
+static inline int hgl_rita_vbuf_index_internal_(int i);                                     /* Same as above, but fetches the `i`:th vertex, without touching the vertex counter */
 
 #endif /* HGL_RITA_H */
 
@@ -853,7 +1365,9 @@ static inline int hgl_rita_next_vbuf_index_internal_(void);
 #include <pthread.h>
 #include <unistd.h>
 #include <errno.h>
+#include <time.h>
 #include <sys/sysinfo.h>
+#include <sys/syscall.h>
 
 /*--- Private function prototypes -------------------------------------------------------*/
 
@@ -861,6 +1375,31 @@ static inline int hgl_rita_next_vbuf_index_internal_(void);
 
 static HglRitaContext hgl_rita_ctx__;
 
+/* Decoded block cache. Since it's thread-local, each tile thread gets its own */
+static _Thread_local HglRitaBlockCacheEntry hgl_rita_block_cache__[HGL_RITA_BLOCK_CACHE_SIZE];
+
+/*
+ * Cubemap faces in the order +x, +y, +z, -x, -y, -z. For each face: the axis (and sign) of the direction
+ * vector that maps to u, the same for v, and the column and row of the face in the cubemap texture. See
+ * `hgl_rita_sample_cubemap()`.
+ */
+static const int hgl_rita_cubemap_faces__[6][6] = {
+    {2,  1,  1,  1,  2, 1},
+    {0,  1,  2,  1,  1, 2},
+    {0, -1,  1,  1,  3, 1},
+    {2,  1,  1, -1,  0, 1},
+    {0, -1,  2,  1,  1, 0},
+    {0, -1,  1, -1,  1, 1},
+};
+
+/* Rotated grid sample positions, relative to the pixel position */
+static const float hgl_rita_msaa_pattern__[HGL_RITA_MSAA_N_SAMPLES][2] = {
+    {-0.125f, -0.375f},
+    { 0.375f, -0.125f},
+    { 0.125f,  0.375f},
+    {-0.375f,  0.125f},
+};
+
 /*--- Public functions ------------------------------------------------------------------*/
 
 /*---------------------------------------------------------------------------------------*/
@@ -883,22 +1422,25 @@ static inline void hgl_rita_init()
     hgl_rita_ctx__.vertices.mode = HGL_RITA_ARRAY;
     hgl_rita_ctx__.vertices.vbuf = NULL;
     hgl_rita_ctx__.vertices.ibuf = NULL;
+    hgl_rita_ctx__.vertices.bounds = (HglRitaBounds){.kind = HGL_RITA_BOUNDS_NONE};
 #ifdef HGL_RITA_PARALLEL_VERTEX_PROCESSING
     hgl_rita_ctx__.vertices.fbuf = (HglRitaFragmentBuffer){0};
     hgl_rita_buf_reserve(&hgl_rita_ctx__.vertices.fbuf, 4096);
 #endif
 
     /* setup default opts */
-    hgl_rita_ctx__.opts.frontface_winding                       = HGL_RITA_CCW;
-    hgl_rita_ctx__.opts.clear_color                             = HGL_RITA_MORTEL_BLACK;
-    hgl_rita_ctx__.opts.texture_filter                          = HGL_RITA_NEAREST;
-    hgl_rita_ctx__.opts.texture_wrapping                        = HGL_RITA_NO_WRAPPING;
-    hgl_rita_ctx__.opts.backface_culling_enabled                = false;
-    hgl_rita_ctx__.opts.depth_test_enabled                      = false;
-    hgl_rita_ctx__.opts.order_dependent_alpha_blending_enabled  = false;
-    hgl_rita_ctx__.opts.z_clipping_enabled                      = false;
-    hgl_rita_ctx__.opts.depth_buffer_writing_enabled            = true;
-    hgl_rita_ctx__.opts.draw_wire_frames                        = false;
+    hgl_rita_ctx__.opts.frontface_winding                        = HGL_RITA_CCW;
+    hgl_rita_ctx__.opts.clear_color                              = HGL_RITA_MORTEL_BLACK;
+    hgl_rita_ctx__.opts.texture_filter                           = HGL_RITA_NEAREST;
+    hgl_rita_ctx__.opts.texture_wrapping                         = HGL_RITA_NO_WRAPPING;
+    hgl_rita_ctx__.opts.backface_culling_enabled                 = false;
+    hgl_rita_ctx__.opts.depth_test_enabled                       = false;
+    hgl_rita_ctx__.opts.order_dependent_alpha_blending_enabled   = false;
+    hgl_rita_ctx__.opts.z_clipping_enabled                       = false;
+    hgl_rita_ctx__.opts.depth_buffer_writing_enabled             = true;
+    hgl_rita_ctx__.opts.draw_wire_frames                         = false;
+    hgl_rita_ctx__.opts.msaa_enabled                             = false;
+    hgl_rita_ctx__.opts.order_independent_alpha_blending_enabled = false;
 
     /* setup default transforms */
     hgl_rita_ctx__.tform.model           = mat4_make_identity();
@@ -921,10 +1463,24 @@ static inline void hgl_rita_init()
     }
 
     /* Initialize renderer */
+    hgl_rita_ctx__.renderer.tile_config.tile_size_x       = HGL_RITA_TILE_SIZE_X;
+    hgl_rita_ctx__.renderer.tile_config.tile_size_y       = HGL_RITA_TILE_SIZE_Y;
+    hgl_rita_ctx__.renderer.tile_config.op_queue_capacity = HGL_RITA_TILE_OP_QUEUE_CAPACITY;
     hgl_rita_ctx__.renderer.n_tiles = 0;
     hgl_rita_ctx__.renderer.n_tile_cols = 0;
     hgl_rita_ctx__.renderer.n_tile_rows = 0;
+    hgl_rita_ctx__.renderer.fb_width = 0;
+    hgl_rita_ctx__.renderer.fb_height = 0;
     hgl_rita_ctx__.renderer.n_procs = get_nprocs();
+    hgl_rita_ctx__.renderer.oit_pending = false;
+#ifdef HGL_RITA_PARALLEL_VERTEX_PROCESSING
+    hgl_rita_ctx__.renderer.bins = NULL;
+#endif
+#ifdef HGL_RITA_COLLECT_STATS
+    hgl_rita_ctx__.renderer.n_draw_calls = 0;
+    hgl_rita_ctx__.renderer.n_culled_draw_calls = 0;
+    hgl_rita_ctx__.renderer.n_triangles = 0;
+#endif
 }
 
 static inline void hgl_rita_final(void)
@@ -933,13 +1489,11 @@ static inline void hgl_rita_final(void)
     hgl_rita_buf_destroy(&hgl_rita_ctx__.vertices.fbuf);
 #endif
 
-    for (int i = 0; i < hgl_rita_ctx__.renderer.n_tiles; i++) {
-        HglRitaTileOp op = { .kind = HGL_RITA_OP_TERMINATE };
-        hgl_rita_queue_push(&hgl_rita_ctx__.renderer.tile[i].op_queue, op);
-        pthread_join(hgl_rita_ctx__.renderer.tile[i].thread, NULL);
-        hgl_rita_queue_destroy(&hgl_rita_ctx__.renderer.tile[i].op_queue);
-    }
-    hgl_rita_ctx__.renderer.n_tiles = 0;
+    hgl_rita_despawn_tiles_internal_();
+
+    HGL_RITA_FREE(hgl_rita_ctx__.filter.scratch);
+    hgl_rita_ctx__.filter.scratch = NULL;
+    hgl_rita_ctx__.filter.scratch_size = 0;
 }
 
 static inline void hgl_rita_bind_buffer(HglRitaBuffer buffer, void *item)
@@ -957,43 +1511,32 @@ static inline void hgl_rita_bind_buffer(HglRitaBuffer buffer, void *item)
 
 static inline void hgl_rita_bind_texture(HglRitaTexUnit unit, HglRitaTexture *tex)
 {
-    hgl_rita_finish();
+    /* transparent fragments are only resolved onto the framebuffer they were drawn to */
+    if ((unit == HGL_RITA_TEX_FRAME_BUFFER) || (unit == HGL_RITA_TEX_DEPTH_BUFFER)) {
+        hgl_rita_finish();
+    } else {
+        hgl_rita_wait_internal_();
+    }
     if (unit == HGL_RITA_TEX_FRAME_BUFFER) {
-        assert(tex->format == HGL_RITA_RGBA8);
-
-        int w = tex->width;
-        int h = tex->height;
-        int cols = (w - 1) / HGL_RITA_TILE_SIZE_X + 1;
-        int rows = (h - 1) / HGL_RITA_TILE_SIZE_Y + 1;
-        int n_active_tiles = hgl_rita_ctx__.renderer.n_tiles;
-        int n_needed_tiles = cols * rows;
-
-        /* Needs more tiles than allowed? */
-        if (n_needed_tiles > HGL_RITA_MAX_N_TILES) {
-            fprintf(stderr, "framebuffer texture too large. Consider increasing HGL_RITA_MAX_N_TILES\n");
-            fprintf(stderr, "or the tile dimensions HGL_RITA_TILE_SIZE_X/HGL_RITA_TILE_SIZE_Y.");
-            exit(1);
-        }
-
-        /* Spawn more tile workers if necessary */
-        for (int i = n_active_tiles; i < n_needed_tiles; i++) {
-            HglRitaTile *tile = &hgl_rita_ctx__.renderer.tile[i];
-            hgl_rita_queue_init(&tile->op_queue);
-            tile->aabb = hgl_rita_aabb_make((i%cols)*HGL_RITA_TILE_SIZE_X,
-                                            (i/cols)*HGL_RITA_TILE_SIZE_Y,
-                                            HGL_RITA_TILE_SIZE_X,
-                                            HGL_RITA_TILE_SIZE_Y);
-            tile->aabb = hgl_rita_aabb_clip(tile->aabb, 0, 0, w, h);
-            pthread_create(&tile->thread, NULL, hgl_rita_tile_thread_internal_, (void *)tile);
-        }
-        hgl_rita_ctx__.renderer.n_tiles = n_needed_tiles;
-        hgl_rita_ctx__.renderer.n_tile_cols = cols;
-        hgl_rita_ctx__.renderer.n_tile_rows = rows;
+        assert(tex->format == HGL_RITA_RGBA8 || tex->format == HGL_RITA_RGB565);
+
+        /* (Re)spawn tile workers if the tile layout changed */
+        if ((hgl_rita_ctx__.renderer.n_tiles == 0) ||
+            (hgl_rita_ctx__.renderer.fb_width != tex->width) ||
+            (hgl_rita_ctx__.renderer.fb_height != tex->height)) {
+            hgl_rita_spawn_tiles_internal_(tex->width, tex->height);
+        }
     } else if (unit == HGL_RITA_TEX_DEPTH_BUFFER) {
-        assert(tex->format == HGL_RITA_R32);
+        assert(tex->format == HGL_RITA_R32 || tex->format == HGL_RITA_R16);
     }
 
     hgl_rita_ctx__.tex_unit[unit] = tex;
+
+    /* place the pages of each tile on the memory node of its thread */
+    if (hgl_rita_ctx__.opts.thread_pinning_enabled &&
+        ((unit == HGL_RITA_TEX_FRAME_BUFFER) || (unit == HGL_RITA_TEX_DEPTH_BUFFER))) {
+        hgl_rita_first_touch_internal_(tex);
+    }
 }
 
 static inline void hgl_rita_bind_vert_shader(HglRitaVertShaderFunc vert)
@@ -1006,6 +1549,11 @@ static inline void hgl_rita_bind_frag_shader(HglRitaFragShaderFunc frag)
     hgl_rita_ctx__.shaders.frag = frag;
 }
 
+static inline void hgl_rita_bind_frag_shader_batch(HglRitaFragShaderBatchFunc frag)
+{
+    hgl_rita_ctx__.shaders.frag_batch = frag;
+}
+
 static inline void hgl_rita_enable(uint32_t opts)
 {
     if (opts & HGL_RITA_BACKFACE_CULLING) {
@@ -1017,6 +1565,10 @@ static inline void hgl_rita_enable(uint32_t opts)
     if (opts & HGL_RITA_ORDER_DEPENDENT_ALPHA_BLEND) {
         hgl_rita_ctx__.opts.order_dependent_alpha_blending_enabled = true;
     }
+    if ((opts & HGL_RITA_ORDER_INDEPENDENT_ALPHA_BLEND) && !hgl_rita_ctx__.opts.order_independent_alpha_blending_enabled) {
+        hgl_rita_finish();
+        hgl_rita_ctx__.opts.order_independent_alpha_blending_enabled = true;
+    }
     if (opts & HGL_RITA_Z_CLIPPING) {
         hgl_rita_ctx__.opts.z_clipping_enabled = true;
     }
@@ -1026,6 +1578,19 @@ static inline void hgl_rita_enable(uint32_t opts)
     if (opts & HGL_RITA_WIRE_FRAMES) {
         hgl_rita_ctx__.opts.draw_wire_frames = true;
     }
+    if ((opts & HGL_RITA_MSAA) && !hgl_rita_ctx__.opts.msaa_enabled) {
+        /* Note: the sample buffers are allocated by the tile threads themselves, when first needed */
+        hgl_rita_finish();
+        hgl_rita_ctx__.opts.msaa_enabled = true;
+    }
+    if ((opts & HGL_RITA_THREAD_PINNING) && !hgl_rita_ctx__.opts.thread_pinning_enabled) {
+        hgl_rita_finish();
+        hgl_rita_ctx__.opts.thread_pinning_enabled = true;
+        HglRitaTexture *fb = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER];
+        if (fb != NULL) {
+            hgl_rita_spawn_tiles_internal_(fb->width, fb->height);
+        }
+    }
 }
 
 static inline void hgl_rita_disable(uint32_t opts)
@@ -1039,6 +1604,10 @@ static inline void hgl_rita_disable(uint32_t opts)
     if (opts & HGL_RITA_ORDER_DEPENDENT_ALPHA_BLEND) {
         hgl_rita_ctx__.opts.order_dependent_alpha_blending_enabled = false;
     }
+    if ((opts & HGL_RITA_ORDER_INDEPENDENT_ALPHA_BLEND) && hgl_rita_ctx__.opts.order_independent_alpha_blending_enabled) {
+        hgl_rita_finish();
+        hgl_rita_ctx__.opts.order_independent_alpha_blending_enabled = false;
+    }
     if (opts & HGL_RITA_Z_CLIPPING) {
         hgl_rita_ctx__.opts.z_clipping_enabled = false;
     }
@@ -1048,6 +1617,23 @@ static inline void hgl_rita_disable(uint32_t opts)
     if (opts & HGL_RITA_WIRE_FRAMES) {
         hgl_rita_ctx__.opts.draw_wire_frames = false;
     }
+    if ((opts & HGL_RITA_MSAA) && hgl_rita_ctx__.opts.msaa_enabled) {
+        hgl_rita_finish(); // resolves the samples
+        hgl_rita_ctx__.opts.msaa_enabled = false;
+        for (int i = 0; i < hgl_rita_ctx__.renderer.n_tiles; i++) {
+            hgl_rita_msaa_free_internal_(&hgl_rita_ctx__.renderer.tile[i]);
+        }
+    }
+    if ((opts & HGL_RITA_THREAD_PINNING) && hgl_rita_ctx__.opts.thread_pinning_enabled) {
+        hgl_rita_finish();
+        hgl_rita_ctx__.opts.thread_pinning_enabled = false;
+
+        /* respawn the tile threads without pinning them */
+        HglRitaTexture *fb = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER];
+        if (fb != NULL) {
+            hgl_rita_spawn_tiles_internal_(fb->width, fb->height);
+        }
+    }
 }
 
 static inline void hgl_rita_use_frontface_winding_order(HglRitaWindingOrder winding_order)
@@ -1078,20 +1664,16 @@ static inline void hgl_rita_use_vertex_buffer_mode(HglRitaVertexBufferMode mode)
 static inline void hgl_rita_use_model_matrix(Mat4 m)
 {
     hgl_rita_ctx__.tform.model = m;
-    Mat3 m_normals = mat3_make_from_mat4(m);
-    float c0_len = vec3_len(m_normals.c0);
-    float c1_len = vec3_len(m_normals.c1);
-    float c2_len = vec3_len(m_normals.c2);
-    m_normals.c0 = vec3_mul_scalar(m_normals.c0, 1.0f / c0_len);
-    m_normals.c1 = vec3_mul_scalar(m_normals.c1, 1.0f / c1_len);
-    m_normals.c2 = vec3_mul_scalar(m_normals.c2, 1.0f / c2_len);
-    hgl_rita_ctx__.tform.normals = m_normals;
+
+    /* inverse transpose, so normals stay perpendicular to surfaces under non-uniform scaling.
+     * Transformed normals are not unit length in general; shaders must renormalize. */
+    hgl_rita_ctx__.tform.normals = mat3_inverse_transpose(mat3_make_from_mat4(m));
 }
 
 static inline void hgl_rita_use_view_matrix(Mat4 m)
 {
     hgl_rita_ctx__.tform.view = m;
-    hgl_rita_ctx__.tform.iview = mat3_transpose(mat3_make_from_mat4(m));
+    hgl_rita_ctx__.tform.iview = mat3_inverse(mat3_make_from_mat4(m));
 }
 
 static inline void hgl_rita_use_proj_matrix(Mat4 m)
@@ -1139,6 +1721,116 @@ static inline void hgl_rita_use_viewport(int width, int height)
     hgl_rita_ctx__.tform.viewport = m;
 }
 
+static inline void hgl_rita_use_tile_config(HglRitaTileConfig config)
+{
+    assert(config.tile_size_x > 0);
+    assert(config.tile_size_y > 0);
+    assert((config.op_queue_capacity > 1) &&
+           (config.op_queue_capacity <= UINT16_MAX + 1) &&
+           ((config.op_queue_capacity & (config.op_queue_capacity - 1)) == 0) &&
+           "op-queue capacity must be a power of two in the range [2, 2^16]");
+
+    hgl_rita_finish();
+    hgl_rita_ctx__.renderer.tile_config = config;
+
+    /* respawn tile workers using the new configuration */
+    HglRitaTexture *fb = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER];
+    if (fb != NULL) {
+        hgl_rita_spawn_tiles_internal_(fb->width, fb->height);
+    }
+}
+
+static inline HglRitaTileConfig hgl_rita_get_tile_config(void)
+{
+    return hgl_rita_ctx__.renderer.tile_config;
+}
+
+static inline HglRitaStats hgl_rita_get_stats(void)
+{
+    HglRitaStats stats = {0};
+#ifdef HGL_RITA_COLLECT_STATS
+    hgl_rita_wait_internal_();
+    stats.n_draw_calls = hgl_rita_ctx__.renderer.n_draw_calls;
+    stats.n_culled_draw_calls = hgl_rita_ctx__.renderer.n_culled_draw_calls;
+    stats.n_triangles  = hgl_rita_ctx__.renderer.n_triangles;
+    for (int i = 0; i < hgl_rita_ctx__.renderer.n_tiles; i++) {
+        stats.n_fragments += hgl_rita_ctx__.renderer.tile[i].n_fragments;
+    }
+#endif
+    return stats;
+}
+
+static inline void hgl_rita_reset_stats(void)
+{
+#ifdef HGL_RITA_COLLECT_STATS
+    hgl_rita_wait_internal_();
+    hgl_rita_ctx__.renderer.n_draw_calls = 0;
+    hgl_rita_ctx__.renderer.n_culled_draw_calls = 0;
+    hgl_rita_ctx__.renderer.n_triangles = 0;
+    for (int i = 0; i < hgl_rita_ctx__.renderer.n_tiles; i++) {
+        hgl_rita_ctx__.renderer.tile[i].n_fragments = 0;
+    }
+#endif
+}
+
+static inline HglRitaTileConfig hgl_rita_autotune(void (*probe)(void *userdata), void *userdata, int n_frames)
+{
+    static const HglRitaTileConfig candidates[] = {
+        { .tile_size_x =  64, .tile_size_y =  64, .op_queue_capacity =  256 },
+        { .tile_size_x = 128, .tile_size_y =  64, .op_queue_capacity =   64 },
+        { .tile_size_x = 128, .tile_size_y =  64, .op_queue_capacity =  256 },
+        { .tile_size_x = 128, .tile_size_y = 128, .op_queue_capacity =  256 },
+        { .tile_size_x = 192, .tile_size_y =  64, .op_queue_capacity =  128 },
+        { .tile_size_x = 256, .tile_size_y =  32, .op_queue_capacity =  256 },
+        { .tile_size_x = 256, .tile_size_y =  64, .op_queue_capacity =  256 },
+        { .tile_size_x = 256, .tile_size_y =  64, .op_queue_capacity = 2048 },
+        { .tile_size_x = 256, .tile_size_y =  64, .op_queue_capacity = 4096 },
+        { .tile_size_x = 512, .tile_size_y =  64, .op_queue_capacity =  256 },
+    };
+    const int n_candidates = sizeof(candidates) / sizeof(candidates[0]);
+
+    HglRitaTexture *fb = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER];
+    assert(fb != NULL && "hgl_rita_autotune() requires a bound framebuffer");
+    assert(probe != NULL);
+    n_frames = max(n_frames, 1);
+
+    HglRitaTileConfig best = hgl_rita_ctx__.renderer.tile_config;
+    double best_time = -1.0;
+    for (int i = 0; i < n_candidates; i++) {
+        HglRitaTileConfig config = candidates[i];
+
+        /* skip configurations requiring too many tiles */
+        int cols = (fb->width - 1) / config.tile_size_x + 1;
+        int rows = (fb->height - 1) / config.tile_size_y + 1;
+        if (cols * rows > HGL_RITA_MAX_N_TILES) {
+            continue;
+        }
+
+        hgl_rita_use_tile_config(config);
+
+        /* warm-up */
+        probe(userdata);
+        hgl_rita_finish();
+
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (int j = 0; j < n_frames; j++) {
+            probe(userdata);
+            hgl_rita_finish();
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        double t = (double)(t1.tv_sec - t0.tv_sec) + 1e-9 * (double)(t1.tv_nsec - t0.tv_nsec);
+        if (best_time < 0.0 || t < best_time) {
+            best_time = t;
+            best = config;
+        }
+    }
+
+    hgl_rita_use_tile_config(best);
+    return best;
+}
+
 
 /*---------------------------------------------------------------------------------------*/
 /*--- Drawing ---------------------------------------------------------------------------*/
@@ -1148,28 +1840,64 @@ static inline void hgl_rita_clear(uint32_t attachments)
 {
     int w, h;
 
+    /* transparent fragments drawn before the clear must not end up on top of it */
+    if (hgl_rita_ctx__.renderer.oit_pending) {
+        hgl_rita_finish();
+    }
+
+    /*
+     * Have each tile thread clear its own part of the framebuffer if the threads are pinned, or
+     * if MSAA is enabled (the tile threads own the samples, and must resolve them first).
+     */
+    if ((hgl_rita_ctx__.opts.thread_pinning_enabled || hgl_rita_ctx__.opts.msaa_enabled) &&
+        (hgl_rita_ctx__.renderer.n_tiles > 0)) {
+        for (int i = 0; i < hgl_rita_ctx__.renderer.n_tiles; i++) {
+            HglRitaTileOp op = {
+                .attachments = attachments,
+                .kind = HGL_RITA_OP_CLEAR,
+            };
+            hgl_rita_queue_push(&hgl_rita_ctx__.renderer.tile[i].op_queue, op);
+        }
+        return;
+    }
+
     if (attachments & HGL_RITA_COLOR) {
-        w = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER]->width;
-        h = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER]->height;
-        for (int i = 0; i < w*h; i++) {
-            hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER]->data.rgba8[i] = hgl_rita_ctx__.opts.clear_color;
+        HglRitaTexture *fb = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER];
+        w = fb->width;
+        h = fb->height;
+        if (fb->format == HGL_RITA_RGB565) {
+            uint16_t p = hgl_rita_color_to_rgb565(hgl_rita_ctx__.opts.clear_color);
+            for (int i = 0; i < w*h; i++) {
+                fb->data.rgb565[i] = p;
+            }
+        } else {
+            for (int i = 0; i < w*h; i++) {
+                fb->data.rgba8[i] = hgl_rita_ctx__.opts.clear_color;
+            }
         }
     }
 
     if (attachments & HGL_RITA_DEPTH) {
-        w = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_DEPTH_BUFFER]->width;
-        h = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_DEPTH_BUFFER]->height;
-        for (int i = 0; i < w*h; i++) {
-            hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_DEPTH_BUFFER]->data.r32[i] = 1.0f;
+        HglRitaTexture *db = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_DEPTH_BUFFER];
+        w = db->width;
+        h = db->height;
+        if (db->format == HGL_RITA_R16) {
+            for (int i = 0; i < w*h; i++) {
+                db->data.r16[i] = UINT16_MAX;
+            }
+        } else {
+            for (int i = 0; i < w*h; i++) {
+                db->data.r32[i] = 1.0f;
+            }
         }
     }
 }
 
 static inline void hgl_rita_finish(void)
 {
-    for (int i = 0; i < hgl_rita_ctx__.renderer.n_tiles; i++) {
-        hgl_rita_queue_wait_until_idle(&hgl_rita_ctx__.renderer.tile[i].op_queue, 1);
-    }
+    hgl_rita_resolve_transparency_internal_();
+    hgl_rita_resolve_msaa_internal_();
+    hgl_rita_wait_internal_();
 }
 
 static inline void hgl_rita_draw_text(int pos_x, int pos_y, float scale, HglRitaColor color, const char *fmt, ...)
@@ -1280,8 +2008,10 @@ static inline void hgl_rita_draw_text(int pos_x, int pos_y, float scale, HglRita
     const int og_pos_x = pos_x;
     const float x_spacing = 1.0f;
     const float y_spacing = 1.0f;
-    const int fb_w = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER]->width;
-    const int fb_h = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER]->height;
+    HglRitaTexture *fb = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER];
+    const HglRitaPixelFormat fb_format = fb->format;
+    const int fb_w = fb->width;
+    const int fb_h = fb->height;
     (void) fb_h;
 
     /* print formatted string into scratch buffer */
@@ -1331,7 +2061,7 @@ static inline void hgl_rita_draw_text(int pos_x, int pos_y, float scale, HglRita
                         int row = v * 6;
                         int col = u * glyph.stride;
                         if (((glyph.bitmap[row] >> ((glyph.stride - 1) - col)) & 1) != 0) {
-                            hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER]->data.rgba8[idx] = color;
+                            hgl_rita_fb_write_internal_(fb, fb_format, idx, color);
                         }
                     }
                 }
@@ -1358,6 +2088,21 @@ static inline void hgl_rita_draw(HglRitaPrimitiveMode primitive_mode)
     /* reset counter used to get next vertex */
     hgl_rita_ctx__.vertices.counter = 0;
 
+#ifndef HGL_RITA_PARALLEL_VERTEX_PROCESSING
+    /* invalidate the post-transform vertex cache. The transforms may have changed. */
+    for (int i = 0; i < HGL_RITA_VERTEX_CACHE_SIZE; i++) {
+        hgl_rita_ctx__.vertices.cache.tag[i] = -1;
+    }
+#endif
+
+#ifdef HGL_RITA_COLLECT_STATS
+    hgl_rita_ctx__.renderer.n_draw_calls++;
+#endif
+
+    if (hgl_rita_ctx__.opts.order_independent_alpha_blending_enabled) {
+        hgl_rita_ctx__.renderer.oit_pending = true;
+    }
+
     /* compute mvp matrix to (potentially) be used in vertex shader */
     Mat4 M = hgl_rita_ctx__.tform.model;
     Mat4 V = hgl_rita_ctx__.tform.view;
@@ -1365,6 +2110,14 @@ static inline void hgl_rita_draw(HglRitaPrimitiveMode primitive_mode)
     hgl_rita_ctx__.tform.mv = mat4_mul_mat4(V, M);
     hgl_rita_ctx__.tform.mvp = mat4_mul_mat4(P, mat4_mul_mat4(V, M));
 
+    /* skip the draw call entirely if its bounds are outside the view frustum */
+    if (!hgl_rita_bounds_visible(hgl_rita_ctx__.vertices.bounds, hgl_rita_ctx__.tform.mvp)) {
+#ifdef HGL_RITA_COLLECT_STATS
+        hgl_rita_ctx__.renderer.n_culled_draw_calls++;
+#endif
+        return;
+    }
+
 #ifdef HGL_RITA_DEBUG
     HglRitaTexture *fb = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER];
     HglRitaTexture *db = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_DEPTH_BUFFER];
@@ -1391,13 +2144,13 @@ static inline void hgl_rita_draw(HglRitaPrimitiveMode primitive_mode)
      * make sure previous drawcall has finished so that we don't modify
      * the fragment buffer as it is being used
      */
-    hgl_rita_finish();
+    hgl_rita_wait_internal_();
 
     /* Dispatch chunks of the vertex buffer to be proceesed in parallel */
     hgl_rita_buf_reserve(&hgl_rita_ctx__.vertices.fbuf,
                          hgl_rita_ctx__.vertices.vbuf->length);
     int n_seg = min(hgl_rita_ctx__.renderer.n_procs - 1, hgl_rita_ctx__.renderer.n_tiles);
-    int seg_sz = hgl_rita_ctx__.vertices.vbuf->length / n_seg;
+    int seg_sz = (n_seg > 0) ? hgl_rita_ctx__.vertices.vbuf->length / n_seg : 0;
     for (int i = 0; i < n_seg; i++) {
         HglRitaTileOp op = {
             .vbuf_segment = {
@@ -1487,6 +2240,11 @@ static inline void hgl_rita_draw(HglRitaPrimitiveMode primitive_mode)
         } break;
 
         case HGL_RITA_TRIANGLES: {
+#ifdef HGL_RITA_PARALLEL_VERTEX_PROCESSING
+            if (hgl_rita_draw_triangles_binned_internal_()) {
+                break;
+            }
+#endif
             for (;;) {
                 i0 = hgl_rita_next_vbuf_index_internal_();
                 i1 = hgl_rita_next_vbuf_index_internal_();
@@ -1500,12 +2258,18 @@ static inline void hgl_rita_draw(HglRitaPrimitiveMode primitive_mode)
                 f1 = hgl_rita_ctx__.vertices.fbuf.arr[i1];
                 f2 = hgl_rita_ctx__.vertices.fbuf.arr[i2];
 #else
-                v0 = &hgl_rita_ctx__.vertices.vbuf->arr[i0];
-                v1 = &hgl_rita_ctx__.vertices.vbuf->arr[i1];
-                v2 = &hgl_rita_ctx__.vertices.vbuf->arr[i2];
-                f0 = hgl_rita_process_vertex_internal_(v0);
-                f1 = hgl_rita_process_vertex_internal_(v1);
-                f2 = hgl_rita_process_vertex_internal_(v2);
+                if (hgl_rita_ctx__.vertices.mode == HGL_RITA_INDEXED) {
+                    f0 = hgl_rita_process_vertex_cached_internal_(i0);
+                    f1 = hgl_rita_process_vertex_cached_internal_(i1);
+                    f2 = hgl_rita_process_vertex_cached_internal_(i2);
+                } else {
+                    v0 = &hgl_rita_ctx__.vertices.vbuf->arr[i0];
+                    v1 = &hgl_rita_ctx__.vertices.vbuf->arr[i1];
+                    v2 = &hgl_rita_ctx__.vertices.vbuf->arr[i2];
+                    f0 = hgl_rita_process_vertex_internal_(v0);
+                    f1 = hgl_rita_process_vertex_internal_(v1);
+                    f2 = hgl_rita_process_vertex_internal_(v2);
+                }
 #endif
                 hgl_rita_dispatch_tri_internal_(f0, f1, f2);
             }
@@ -1610,34 +2374,82 @@ static inline void hgl_rita_blit(int x, int y, int w, int h,
                                  HglRitaBlitFBSampler sampling_method,
                                  HglRitaFragShaderFunc shader)
 {
-    HglRitaAABB blit_aabb = hgl_rita_aabb_make(x, y, w, h);
-    HglRitaTileOp op = {
-        .blit_info = {
-            .aabb          = blit_aabb,
-            .texture       = src,
-            .blend_method  = blend_method,
-            .mask          = mask,
-            .sampler       = sampling_method,
-            .shader        = shader
-        },
-        .kind = HGL_RITA_OP_BLIT,
-    };
+    hgl_rita_dispatch_blit_internal_((HglRitaBlitInfo) {
+        .aabb          = hgl_rita_aabb_make(x, y, w, h),
+        .texture       = src,
+        .blend_method  = blend_method,
+        .mask          = mask,
+        .sampler       = sampling_method,
+        .shader        = shader
+    });
+}
 
-    /* dispatch blit operation to intersecting tiles */
-    int fb_w = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER]->width;
-    int fb_h = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER]->height;
-    HglRitaAABB aabb = hgl_rita_aabb_clip(blit_aabb, 0, 0, fb_w - 1, fb_h - 1);
-    int start_x = aabb.min_x / HGL_RITA_TILE_SIZE_X;
-    int start_y = aabb.min_y / HGL_RITA_TILE_SIZE_Y;
-    int end_x = aabb.max_x / HGL_RITA_TILE_SIZE_X + 1;
-    int end_y = aabb.max_y / HGL_RITA_TILE_SIZE_Y + 1;
-    int stride = hgl_rita_ctx__.renderer.n_tile_cols;
-    for (y = start_y; y < end_y; y++) {
-        for (x = start_x; x < end_x; x++) {
-            int i = y*stride + x;
-            hgl_rita_queue_push(&(hgl_rita_ctx__.renderer.tile[i].op_queue), op);
-        }
+static inline void hgl_rita_blit_batch(int x, int y, int w, int h,
+                                       HglRitaTexture *src,
+                                       HglRitaBlendMethod blend_method,
+                                       HglRitaBlitFBMask mask,
+                                       HglRitaFragShaderBatchFunc shader)
+{
+    hgl_rita_dispatch_blit_internal_((HglRitaBlitInfo) {
+        .aabb          = hgl_rita_aabb_make(x, y, w, h),
+        .texture       = src,
+        .blend_method  = blend_method,
+        .mask          = mask,
+        .sampler       = HGL_RITA_SHADER,
+        .shader_batch  = shader
+    });
+}
+
+/*---------------------------------------------------------------------------------------*/
+/*--- Filters ---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------------------*/
+
+static inline void hgl_rita_filter_separable(int x, int y, int w, int h,
+                                             const float *kernel_x,
+                                             const float *kernel_y,
+                                             int radius)
+{
+    assert(radius >= 0 && radius <= HGL_RITA_FILTER_MAX_RADIUS);
+
+    /* wait for the previous filter (if any) to stop using the kernels */
+    hgl_rita_finish();
+    memcpy(hgl_rita_ctx__.filter.kernel_x, kernel_x, (2*radius + 1) * sizeof(float));
+    memcpy(hgl_rita_ctx__.filter.kernel_y, kernel_y, (2*radius + 1) * sizeof(float));
+    hgl_rita_ctx__.filter.radius = radius;
+    hgl_rita_filter_internal_(x, y, w, h, HGL_RITA_FILTER_CONVOLVE);
+}
+
+static inline void hgl_rita_filter_box_blur(int x, int y, int w, int h, int radius)
+{
+    float kernel[2*HGL_RITA_FILTER_MAX_RADIUS + 1];
+    radius = min(max(radius, 0), HGL_RITA_FILTER_MAX_RADIUS);
+    for (int i = 0; i < 2*radius + 1; i++) {
+        kernel[i] = 1.0f / (float)(2*radius + 1);
     }
+    hgl_rita_filter_separable(x, y, w, h, kernel, kernel, radius);
+}
+
+static inline void hgl_rita_filter_gaussian_blur(int x, int y, int w, int h, float sigma)
+{
+    float kernel[2*HGL_RITA_FILTER_MAX_RADIUS + 1];
+    int radius = (sigma > 0.0f) ? (int)ceilf(3.0f * sigma) : 0;
+    radius = min(radius, HGL_RITA_FILTER_MAX_RADIUS);
+    float sum = 0.0f;
+    for (int i = 0; i < 2*radius + 1; i++) {
+        float d = (float)(i - radius);
+        kernel[i] = (radius > 0) ? expf(-(d*d) / (2.0f*sigma*sigma)) : 1.0f;
+        sum += kernel[i];
+    }
+    for (int i = 0; i < 2*radius + 1; i++) {
+        kernel[i] /= sum;
+    }
+    hgl_rita_filter_separable(x, y, w, h, kernel, kernel, radius);
+}
+
+static inline void hgl_rita_filter_sobel(int x, int y, int w, int h)
+{
+    hgl_rita_finish();
+    hgl_rita_filter_internal_(x, y, w, h, HGL_RITA_FILTER_SOBEL);
 }
 
 /*---------------------------------------------------------------------------------------*/
@@ -1660,6 +2472,18 @@ static inline HglRitaTexture hgl_rita_texture_make(int width, int height, HglRit
         case HGL_RITA_R32: {
             tex.data.r32   = HGL_RITA_ALLOC(sizeof(float) * width * height);
         } break;
+        case HGL_RITA_R16: {
+            tex.data.r16   = HGL_RITA_ALLOC(sizeof(uint16_t) * width * height);
+        } break;
+        case HGL_RITA_RGB565: {
+            tex.data.rgb565 = HGL_RITA_ALLOC(sizeof(uint16_t) * width * height);
+        } break;
+        case HGL_RITA_BC1:
+        case HGL_RITA_BC4: {
+            int n_blocks = ((width + 3) / 4) * ((height + 3) / 4);
+            tex.data.bc1 = HGL_RITA_ALLOC(sizeof(uint64_t) * n_blocks);
+            hgl_rita_ctx__.renderer.block_cache_epoch++;
+        } break;
     }
 
     return tex;
@@ -1670,6 +2494,9 @@ static inline void hgl_rita_texture_destroy(HglRitaTexture *tex)
     assert((tex->stride == tex->width) && "Trying to free a texture with stride != width. Is this a subtexture?");
     HGL_RITA_FREE(tex->data.rgba8);
     tex->data.rgba8 = NULL;
+    if (tex->format == HGL_RITA_BC1 || tex->format == HGL_RITA_BC4) {
+        hgl_rita_ctx__.renderer.block_cache_epoch++;
+    }
 }
 
 static inline HglRitaTexture hgl_rita_texture_get_subtexture(HglRitaTexture tex,
@@ -1697,6 +2524,17 @@ static inline HglRitaTexture hgl_rita_texture_get_subtexture(HglRitaTexture tex,
         case HGL_RITA_R32: {
             subtex.data.r32 = tex.data.r32 + y*tex.stride + x;
         } break;
+        case HGL_RITA_R16: {
+            subtex.data.r16 = tex.data.r16 + y*tex.stride + x;
+        } break;
+        case HGL_RITA_RGB565: {
+            subtex.data.rgb565 = tex.data.rgb565 + y*tex.stride + x;
+        } break;
+        case HGL_RITA_BC1:
+        case HGL_RITA_BC4: {
+            assert((x % 4 == 0) && (y % 4 == 0) && "Subtextures of block compressed textures must be aligned to the 4x4 blocks.");
+            subtex.data.bc1 = tex.data.bc1 + (y/4)*((tex.stride + 3)/4) + x/4;
+        } break;
     }
 
     return subtex;
@@ -1713,17 +2551,67 @@ static inline void hgl_rita_texture_flip_vertically(HglRitaTexture *tex)
         case HGL_RITA_R32: {
             row_size = tex->stride * sizeof(float);
         } break;
+        case HGL_RITA_R16:
+        case HGL_RITA_RGB565: {
+            row_size = tex->stride * sizeof(uint16_t);
+        } break;
+        case HGL_RITA_BC1:
+        case HGL_RITA_BC4: {
+            assert(false && "Can't vertically flip a block compressed texture. Flip it before compressing it.");
+        } break;
     }
-    static unsigned char temp_row[8192];
-    assert((tex->width < 8192) && "Texture is way too big, lmao. This is a toy library.");
     assert((tex->stride == tex->width) && "Trying to vertically flip a subtexture. Not gonna happen.");
+
+    /* swap the rows piece by piece through a small stack buffer, so that this is thread-safe */
+    unsigned char temp[1024];
     for (int y = 0; y < tex->height / 2; y++) {
-        void *upper_row = (void *) &tex->data.rgba8[y * tex->stride];
-        void *lower_row = (void *) &tex->data.rgba8[(tex->height - y - 1) * tex->stride];
-        memcpy(temp_row, lower_row, row_size);
-        memcpy(lower_row, upper_row, row_size);
-        memcpy(upper_row, temp_row, row_size);
+        unsigned char *upper_row = (unsigned char *) tex->data.rgba8 + y * row_size;
+        unsigned char *lower_row = (unsigned char *) tex->data.rgba8 + (tex->height - y - 1) * row_size;
+        for (size_t i = 0; i < row_size; i += sizeof(temp)) {
+            size_t n = min(sizeof(temp), row_size - i);
+            memcpy(temp, lower_row + i, n);
+            memcpy(lower_row + i, upper_row + i, n);
+            memcpy(upper_row + i, temp, n);
+        }
+    }
+}
+
+static inline HglRitaTexture hgl_rita_texture_compress(const HglRitaTexture *src,
+                                                       HglRitaPixelFormat format)
+{
+    assert((format == HGL_RITA_BC1 || format == HGL_RITA_BC4) && "Not a block compressed format.");
+
+    HglRitaTexture dst = hgl_rita_texture_make(src->width, src->height, format);
+
+    int n_block_rows = (src->height + 3) / 4;
+    int n_threads = hgl_rita_ctx__.renderer.n_procs;
+    n_threads = clamp(1, n_block_rows, n_threads);
+
+    HglRitaCompressJob *jobs = HGL_RITA_ALLOC(n_threads * sizeof(HglRitaCompressJob));
+    for (int i = 0; i < n_threads; i++) {
+        jobs[i] = (HglRitaCompressJob) {
+            .src             = src,
+            .dst             = &dst,
+            .first_block_row = i,
+            .block_row_step  = n_threads,
+        };
+    }
+
+    /* the calling thread takes the first job */
+    for (int i = 1; i < n_threads; i++) {
+        jobs[i].spawned = (pthread_create(&jobs[i].thread, NULL, hgl_rita_compress_thread_internal_, &jobs[i]) == 0);
+    }
+    hgl_rita_compress_thread_internal_(&jobs[0]);
+    for (int i = 1; i < n_threads; i++) {
+        if (jobs[i].spawned) {
+            pthread_join(jobs[i].thread, NULL);
+        } else {
+            hgl_rita_compress_thread_internal_(&jobs[i]);
+        }
     }
+
+    HGL_RITA_FREE(jobs);
+    return dst;
 }
 
 static inline void hgl_rita_texture_blit(HglRitaTexture dst,
@@ -1732,7 +2620,6 @@ static inline void hgl_rita_texture_blit(HglRitaTexture dst,
                                          bool flip_vertical)
 {
     assert(dst.format == HGL_RITA_RGBA8);
-    assert(src.format == HGL_RITA_RGBA8);
     int w = dst.width;
     int h = dst.height;
     int s = dst.stride;
@@ -1781,6 +2668,418 @@ static inline bool hgl_rita_vertex_eq(HglRitaVertex v0, HglRitaVertex v1)
            (v0.color.a == v1.color.a);
 }
 
+static inline uint32_t hgl_rita_vertex_hash(const HglRitaVertex *v)
+{
+    float fields[] = {
+        v->pos.x, v->pos.y, v->pos.z, v->pos.w,
+        v->normal.x, v->normal.y, v->normal.z,
+#ifndef HGL_RITA_SIMPLE
+        v->tangent.x, v->tangent.y, v->tangent.z,
+#endif
+        v->uv.x, v->uv.y,
+    };
+
+    /* FNV-1a over the bit patterns of the attributes */
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        uint32_t bits;
+        memcpy(&bits, &fields[i], sizeof(bits));
+        if (bits == 0x80000000u) {
+            bits = 0; // -0.0f == 0.0f
+        }
+        hash = (hash ^ bits) * 16777619u;
+    }
+    uint32_t color = ((uint32_t)v->color.r << 24) | ((uint32_t)v->color.g << 16) |
+                     ((uint32_t)v->color.b << 8)  | ((uint32_t)v->color.a);
+    hash = (hash ^ color) * 16777619u;
+
+    return hash;
+}
+
+/*---------------------------------------------------------------------------------------*/
+/*--- Mesh preprocessing ----------------------------------------------------------------*/
+/*---------------------------------------------------------------------------------------*/
+
+static inline void hgl_rita_mesh_weld(HglRitaVertexBuffer *vbuf, HglRitaIndexBuffer *ibuf)
+{
+    int n_vertices = vbuf->length;
+    if (n_vertices == 0) {
+        return;
+    }
+
+    /* open addressing hash table of indices into the (compacted) vertex buffer */
+    int table_size = 16;
+    while (table_size < 2 * n_vertices) {
+        table_size *= 2;
+    }
+    uint32_t mask = (uint32_t) table_size - 1;
+    int *table = HGL_RITA_ALLOC(table_size * sizeof(int));
+    int *remap = HGL_RITA_ALLOC(n_vertices * sizeof(int));
+    assert((table != NULL) && (remap != NULL));
+    memset(table, 0xFF, table_size * sizeof(int));
+
+    /* compact the vertex buffer in-place. Slot `n_unique` is always <= `i`. */
+    int n_unique = 0;
+    for (int i = 0; i < n_vertices; i++) {
+        const HglRitaVertex *v = &vbuf->arr[i];
+        uint32_t h = hgl_rita_vertex_hash(v) & mask;
+        for (;;) {
+            int j = table[h];
+            if (j == -1) {
+                table[h] = n_unique;
+                vbuf->arr[n_unique] = *v;
+                remap[i] = n_unique++;
+                break;
+            }
+            if (hgl_rita_vertex_eq(vbuf->arr[j], *v)) {
+                remap[i] = j;
+                break;
+            }
+            h = (h + 1) & mask;
+        }
+    }
+    vbuf->length = n_unique;
+
+    if (ibuf->length == 0) {
+        /* vertex soup: generate the index buffer */
+        hgl_rita_buf_reserve_exact(ibuf, n_vertices);
+        memcpy(ibuf->arr, remap, n_vertices * sizeof(int));
+        ibuf->length = n_vertices;
+    } else {
+        for (int i = 0; i < ibuf->length; i++) {
+            ibuf->arr[i] = remap[ibuf->arr[i]];
+        }
+    }
+
+    HGL_RITA_FREE(table);
+    HGL_RITA_FREE(remap);
+}
+
+static inline void hgl_rita_mesh_optimize_vertex_cache(HglRitaIndexBuffer *ibuf,
+                                                       int n_vertices,
+                                                       int cache_size)
+{
+    /*
+     * Tipsify, as described in "Fast Triangle Reordering for Vertex Locality and
+     * Reduced Overdraw" by Sander, Nehab, and Barczak (2007). Linear time.
+     */
+    assert((ibuf->length % 3) == 0);
+    int n_indices = ibuf->length;
+    int n_tris = n_indices / 3;
+    if (n_tris == 0) {
+        return;
+    }
+
+    int *live      = HGL_RITA_ALLOC(n_vertices * sizeof(int));       // number of unemitted triangles using vertex
+    int *offsets   = HGL_RITA_ALLOC((n_vertices + 1) * sizeof(int)); // vertex -> triangle adjacency (CSR)
+    int *adjacency = HGL_RITA_ALLOC(n_indices * sizeof(int));
+    int *timestamp = HGL_RITA_ALLOC(n_vertices * sizeof(int));       // time at which vertex entered the cache
+    int *dead_end  = HGL_RITA_ALLOC(n_indices * sizeof(int));        // stack of recently referenced vertices
+    int *cands     = HGL_RITA_ALLOC(n_indices * sizeof(int));        // 1-ring candidates of the fanning vertex
+    bool *emitted  = HGL_RITA_ALLOC(n_tris * sizeof(bool));
+    int *out       = HGL_RITA_ALLOC(n_indices * sizeof(int));
+    assert((live != NULL) && (offsets != NULL) && (adjacency != NULL) && (timestamp != NULL) &&
+           (dead_end != NULL) && (cands != NULL) && (emitted != NULL) && (out != NULL));
+
+    /* build adjacency */
+    memset(live, 0, n_vertices * sizeof(int));
+    memset(timestamp, 0, n_vertices * sizeof(int));
+    memset(emitted, 0, n_tris * sizeof(bool));
+    for (int i = 0; i < n_indices; i++) {
+        assert((ibuf->arr[i] >= 0) && (ibuf->arr[i] < n_vertices));
+        live[ibuf->arr[i]]++;
+    }
+    offsets[0] = 0;
+    for (int v = 0; v < n_vertices; v++) {
+        offsets[v + 1] = offsets[v] + live[v];
+    }
+    int *fill = timestamp; // borrowed. Reset below.
+    for (int i = 0; i < n_indices; i++) {
+        int v = ibuf->arr[i];
+        adjacency[offsets[v] + fill[v]++] = i / 3;
+    }
+    memset(timestamp, 0, n_vertices * sizeof(int));
+
+    int n_out = 0;
+    int n_dead_end = 0;
+    int time = cache_size + 1;
+    int cursor = 0;
+    int fanning = 0;
+    while (fanning >= 0) {
+        int n_cands = 0;
+
+        /* emit all remaining triangles around the fanning vertex */
+        for (int a = offsets[fanning]; a < offsets[fanning + 1]; a++) {
+            int t = adjacency[a];
+            if (emitted[t]) {
+                continue;
+            }
+            for (int k = 0; k < 3; k++) {
+                int v = ibuf->arr[3*t + k];
+                out[n_out++] = v;
+                dead_end[n_dead_end++] = v;
+                cands[n_cands++] = v;
+                live[v]--;
+                if (time - timestamp[v] > cache_size) {
+                    timestamp[v] = time++;
+                }
+            }
+            emitted[t] = true;
+        }
+
+        /* pick the next fanning vertex: the candidate which is still in cache the longest */
+        int best = -1;
+        int best_priority = -1;
+        for (int c = 0; c < n_cands; c++) {
+            int v = cands[c];
+            if (live[v] <= 0) {
+                continue;
+            }
+            int priority = 0;
+            if (time - timestamp[v] + 2 * live[v] <= cache_size) {
+                priority = time - timestamp[v];
+            }
+            if (priority > best_priority) {
+                best_priority = priority;
+                best = v;
+            }
+        }
+
+        /* dead end: backtrack through recently referenced vertices, or scan for any live vertex */
+        if (best == -1) {
+            while (n_dead_end > 0) {
+                int v = dead_end[--n_dead_end];
+                if (live[v] > 0) {
+                    best = v;
+                    break;
+                }
+            }
+        }
+        if (best == -1) {
+            while (cursor < n_vertices) {
+                if (live[cursor] > 0) {
+                    best = cursor;
+                    break;
+                }
+                cursor++;
+            }
+        }
+
+        fanning = best;
+    }
+    assert(n_out == n_indices);
+    memcpy(ibuf->arr, out, n_indices * sizeof(int));
+
+    HGL_RITA_FREE(live);
+    HGL_RITA_FREE(offsets);
+    HGL_RITA_FREE(adjacency);
+    HGL_RITA_FREE(timestamp);
+    HGL_RITA_FREE(dead_end);
+    HGL_RITA_FREE(cands);
+    HGL_RITA_FREE(emitted);
+    HGL_RITA_FREE(out);
+}
+
+static inline void hgl_rita_mesh_optimize_vertex_fetch(HglRitaVertexBuffer *vbuf,
+                                                       HglRitaIndexBuffer *ibuf)
+{
+    int n_vertices = vbuf->length;
+    if (n_vertices == 0) {
+        return;
+    }
+
+    int *remap = HGL_RITA_ALLOC(n_vertices * sizeof(int));
+    HglRitaVertex *reordered = HGL_RITA_ALLOC(n_vertices * sizeof(HglRitaVertex));
+    assert((remap != NULL) && (reordered != NULL));
+    memset(remap, 0xFF, n_vertices * sizeof(int));
+
+    int n_used = 0;
+    for (int i = 0; i < ibuf->length; i++) {
+        int v = ibuf->arr[i];
+        if (remap[v] == -1) {
+            reordered[n_used] = vbuf->arr[v];
+            remap[v] = n_used++;
+        }
+        ibuf->arr[i] = remap[v];
+    }
+
+    memcpy(vbuf->arr, reordered, n_used * sizeof(HglRitaVertex));
+    vbuf->length = n_used;
+
+    HGL_RITA_FREE(remap);
+    HGL_RITA_FREE(reordered);
+}
+
+static inline void hgl_rita_mesh_optimize(HglRitaVertexBuffer *vbuf, HglRitaIndexBuffer *ibuf)
+{
+    hgl_rita_mesh_weld(vbuf, ibuf);
+    hgl_rita_mesh_optimize_vertex_cache(ibuf, vbuf->length, HGL_RITA_VERTEX_CACHE_SIZE);
+    hgl_rita_mesh_optimize_vertex_fetch(vbuf, ibuf);
+}
+
+
+/*---------------------------------------------------------------------------------------*/
+/*--- Bounds & visibility culling -------------------------------------------------------*/
+/*---------------------------------------------------------------------------------------*/
+
+static inline void hgl_rita_use_bounds(HglRitaBounds bounds)
+{
+    hgl_rita_ctx__.vertices.bounds = bounds;
+}
+
+static inline HglRitaBounds hgl_rita_bounds_make_box(Vec3 min, Vec3 max)
+{
+    return (HglRitaBounds) {
+        .kind = HGL_RITA_BOUNDS_BOX,
+        .box = {min, max},
+    };
+}
+
+static inline HglRitaBounds hgl_rita_bounds_make_sphere(Vec3 center, float radius)
+{
+    return (HglRitaBounds) {
+        .kind = HGL_RITA_BOUNDS_SPHERE,
+        .sphere = {center, radius},
+    };
+}
+
+static inline HglRitaBounds hgl_rita_bounds_from_vertex_buffer(const HglRitaVertexBuffer *vbuf)
+{
+    if (vbuf->length == 0) {
+        return (HglRitaBounds) {.kind = HGL_RITA_BOUNDS_NONE};
+    }
+
+    Vec3 min = vbuf->arr[0].pos.xyz;
+    Vec3 max = vbuf->arr[0].pos.xyz;
+    for (int i = 1; i < vbuf->length; i++) {
+        Vec3 p = vbuf->arr[i].pos.xyz;
+        min = vec3_make(fminf(min.x, p.x), fminf(min.y, p.y), fminf(min.z, p.z));
+        max = vec3_make(fmaxf(max.x, p.x), fmaxf(max.y, p.y), fmaxf(max.z, p.z));
+    }
+    return hgl_rita_bounds_make_box(min, max);
+}
+
+static inline HglRitaBounds hgl_rita_bounds_transform(HglRitaBounds bounds, Mat4 m)
+{
+    switch (bounds.kind) {
+        case HGL_RITA_BOUNDS_NONE: {
+            return bounds;
+        } break;
+
+        case HGL_RITA_BOUNDS_BOX: {
+            /* Arvo's method: transform the center, then accumulate the extents along each axis */
+            Vec3 c = vec3_mul_scalar(vec3_add(bounds.box.min, bounds.box.max), 0.5f);
+            Vec3 e = vec3_mul_scalar(vec3_sub(bounds.box.max, bounds.box.min), 0.5f);
+            Vec3 tc = mat4_mul_vec4(m, vec4_make(c.x, c.y, c.z, 1.0f)).xyz;
+            Vec3 te = vec3_make(fabsf(m.m00)*e.x + fabsf(m.m01)*e.y + fabsf(m.m02)*e.z,
+                                fabsf(m.m10)*e.x + fabsf(m.m11)*e.y + fabsf(m.m12)*e.z,
+                                fabsf(m.m20)*e.x + fabsf(m.m21)*e.y + fabsf(m.m22)*e.z);
+            return hgl_rita_bounds_make_box(vec3_sub(tc, te), vec3_add(tc, te));
+        } break;
+
+        case HGL_RITA_BOUNDS_SPHERE: {
+            /* scale the radius by the largest scale factor of `m` */
+            Vec3 c = bounds.sphere.center;
+            Vec3 tc = mat4_mul_vec4(m, vec4_make(c.x, c.y, c.z, 1.0f)).xyz;
+            float s = fmaxf(vec3_len(m.c0.xyz), fmaxf(vec3_len(m.c1.xyz), vec3_len(m.c2.xyz)));
+            return hgl_rita_bounds_make_sphere(tc, bounds.sphere.radius * s);
+        } break;
+    }
+    assert(0 && "not reachable");
+    return bounds;
+}
+
+static inline bool hgl_rita_bounds_visible(HglRitaBounds bounds, Mat4 m)
+{
+    Vec4 planes[6];
+    int n_planes = hgl_rita_frustum_planes_internal_(m, planes);
+
+    switch (bounds.kind) {
+        case HGL_RITA_BOUNDS_NONE: {
+            return true;
+        } break;
+
+        case HGL_RITA_BOUNDS_BOX: {
+            return hgl_rita_box_frustum_test_internal_(planes, n_planes, bounds.box.min, bounds.box.max) != 0;
+        } break;
+
+        case HGL_RITA_BOUNDS_SPHERE: {
+            Vec3 c = bounds.sphere.center;
+            for (int i = 0; i < n_planes; i++) {
+                Vec4 p = planes[i];
+                float d = p.x*c.x + p.y*c.y + p.z*c.z + p.w;
+                if (d < -bounds.sphere.radius * vec3_len(p.xyz)) {
+                    return false;
+                }
+            }
+            return true;
+        } break;
+    }
+    assert(0 && "not reachable");
+    return true;
+}
+
+static inline HglRitaBVH hgl_rita_bvh_make(const HglRitaBounds *bounds, int n)
+{
+    HglRitaBVH bvh = {0};
+    if (n <= 0) {
+        return bvh;
+    }
+
+    /* Everything is built from boxes. Spheres are replaced by their enclosing boxes. */
+    HglRitaBounds *boxes = HGL_RITA_ALLOC(n * sizeof(HglRitaBounds));
+    Vec3 *centroids = HGL_RITA_ALLOC(n * sizeof(Vec3));
+    assert(boxes != NULL && centroids != NULL);
+    for (int i = 0; i < n; i++) {
+        boxes[i] = bounds[i];
+        if (bounds[i].kind == HGL_RITA_BOUNDS_SPHERE) {
+            Vec3 c = bounds[i].sphere.center;
+            float r = bounds[i].sphere.radius;
+            boxes[i] = hgl_rita_bounds_make_box(vec3_sub(c, vec3_make(r, r, r)),
+                                                vec3_add(c, vec3_make(r, r, r)));
+        }
+        assert(boxes[i].kind == HGL_RITA_BOUNDS_BOX && "BVH objects must have bounds");
+        centroids[i] = vec3_mul_scalar(vec3_add(boxes[i].box.min, boxes[i].box.max), 0.5f);
+        hgl_rita_buf_push(&bvh.objects, i);
+    }
+
+    /* A binary tree with leaves of at least one object has at most 2n - 1 nodes */
+    hgl_rita_buf_reserve_exact(&bvh.nodes, 2*n - 1);
+    hgl_rita_buf_push(&bvh.nodes, (HglRitaBVHNode) {.first = 0, .count = n});
+    hgl_rita_bvh_build_internal_(&bvh, 0, boxes, centroids);
+
+    /* keep the object bounds around in leaf order, for per-object tests in partially visible leaves */
+    hgl_rita_buf_reserve_exact(&bvh.boxes, n);
+    for (int i = 0; i < n; i++) {
+        hgl_rita_buf_push(&bvh.boxes, boxes[bvh.objects.arr[i]]);
+    }
+
+    HGL_RITA_FREE(boxes);
+    HGL_RITA_FREE(centroids);
+    return bvh;
+}
+
+static inline void hgl_rita_bvh_destroy(HglRitaBVH *bvh)
+{
+    hgl_rita_buf_destroy(&bvh->nodes);
+    hgl_rita_buf_destroy(&bvh->boxes);
+    hgl_rita_buf_destroy(&bvh->objects);
+    *bvh = (HglRitaBVH) {0};
+}
+
+static inline void hgl_rita_bvh_cull(const HglRitaBVH *bvh, HglRitaIndexBuffer *visible)
+{
+    hgl_rita_buf_clear(visible);
+    if (bvh->nodes.length == 0) {
+        return;
+    }
+
+    Vec4 planes[6];
+    Mat4 vp = mat4_mul_mat4(hgl_rita_ctx__.tform.proj, hgl_rita_ctx__.tform.view);
+    int n_planes = hgl_rita_frustum_planes_internal_(vp, planes);
+    hgl_rita_bvh_cull_internal_(bvh, 0, planes, n_planes, false, visible);
+}
+
 
 /*---------------------------------------------------------------------------------------*/
 /*--- HglRitaColor: standalone functions ------------------------------------------------*/
@@ -1932,6 +3231,25 @@ static inline HglRitaColor hgl_rita_color_from_vector(Vec4 v)
     };
 }
 
+static inline uint16_t hgl_rita_color_to_rgb565(HglRitaColor c0)
+{
+    return (uint16_t) (((c0.r >> 3) << 11) | ((c0.g >> 2) << 5) | (c0.b >> 3));
+}
+
+static inline HglRitaColor hgl_rita_color_from_rgb565(uint16_t p)
+{
+    /* replicate the high bits into the low bits, so that 0x1F -> 0xFF, etc. */
+    uint8_t r = (p >> 11) & 0x1F;
+    uint8_t g = (p >> 5) & 0x3F;
+    uint8_t b = p & 0x1F;
+    return (HglRitaColor) {
+        .r = (r << 3) | (r >> 2),
+        .g = (g << 2) | (g >> 4),
+        .b = (b << 3) | (b >> 2),
+        .a = 255,
+    };
+}
+
 
 /*---------------------------------------------------------------------------------------*/
 /*--- HglRitaAABB: standalone functions -------------------------------------------------*/
@@ -2045,14 +3363,9 @@ static inline HglRitaColor hgl_rita_sample(HglRitaTexture *tex, int x, int y)
     HglRitaColor color = {0};
     x = clamp(0, tex->width - 1, x);
     y = clamp(0, tex->height - 1, y);
-    int idx = y * tex->stride + x;
-    switch (tex->format) {
-        case HGL_RITA_RGBA8: {
-            color = tex->data.rgba8[idx];
-        } break;
-        case HGL_RITA_R32: {
-            color.r = 255*tex->data.r32[idx];
-        } break;
+    color = hgl_rita_texel_internal_(tex, x, y);
+    if (tex->format == HGL_RITA_R32 || tex->format == HGL_RITA_R16 || tex->format == HGL_RITA_BC4) {
+        color.a = 0;
     }
     return color;
 }
@@ -2063,13 +3376,11 @@ static inline HglRitaColor hgl_rita_sample_uv(HglRitaTexture *tex, Vec2 uv)
         return HGL_RITA_MAGENTA;
     }
 
-    assert(tex->format == HGL_RITA_RGBA8 && "format not supported yet");
     assert(tex->stride != 0 && "Texture has a stride of 0. ");
     HglRitaColor color;
     const float BIAS = 0.001f;
     int w = tex->width;
     int h = tex->height;
-    int s = tex->stride;
 
     switch (hgl_rita_ctx__.opts.texture_wrapping) {
         case HGL_RITA_NO_WRAPPING: break;
@@ -2095,15 +3406,7 @@ static inline HglRitaColor hgl_rita_sample_uv(HglRitaTexture *tex, Vec2 uv)
             int y = uv.y * (h - BIAS);
             //int x = uv.x * w;
             //int y = uv.y * h;
-            switch (tex->format) {
-                case HGL_RITA_RGBA8: {
-                    color = tex->data.rgba8[y*s + x];
-                } break;
-                case HGL_RITA_R32: {
-                    color = HGL_RITA_BLACK;
-                    color.r = 255*tex->data.r32[y*s + x];
-                } break;
-            }
+            color = hgl_rita_texel_internal_(tex, x, y);
         } break;
 
         case HGL_RITA_BILINEAR: {
@@ -2118,22 +3421,26 @@ static inline HglRitaColor hgl_rita_sample_uv(HglRitaTexture *tex, Vec2 uv)
             float t_x = x - l;
             float t_y = y - t;
             switch (tex->format) {
-                case HGL_RITA_RGBA8: {
+                case HGL_RITA_RGBA8:
+                case HGL_RITA_RGB565:
+                case HGL_RITA_BC1: {
                     HglRitaColor ul, ur, ll, lr, left, right;
-                    ul = tex->data.rgba8[t*s + l];
-                    ur = tex->data.rgba8[t*s + r];
-                    ll = tex->data.rgba8[b*s + l];
-                    lr = tex->data.rgba8[b*s + r];
+                    ul = hgl_rita_texel_internal_(tex, l, t);
+                    ur = hgl_rita_texel_internal_(tex, r, t);
+                    ll = hgl_rita_texel_internal_(tex, l, b);
+                    lr = hgl_rita_texel_internal_(tex, r, b);
                     left = hgl_rita_color_lerp(ul, ll, t_y);
                     right = hgl_rita_color_lerp(ur, lr, t_y);
                     color = hgl_rita_color_lerp(left, right, t_x);
                 } break;
-                case HGL_RITA_R32: {
+                case HGL_RITA_R32:
+                case HGL_RITA_R16:
+                case HGL_RITA_BC4: {
                     float ul, ur, ll, lr, left, right;
-                    ul = tex->data.r32[t*s + l];
-                    ur = tex->data.r32[t*s + r];
-                    ll = tex->data.r32[b*s + l];
-                    lr = tex->data.r32[b*s + r];
+                    ul = hgl_rita_texel_r_internal_(tex, l, t);
+                    ur = hgl_rita_texel_r_internal_(tex, r, t);
+                    ll = hgl_rita_texel_r_internal_(tex, l, b);
+                    lr = hgl_rita_texel_r_internal_(tex, r, b);
                     left = lerp(ul, ll, t_y);
                     right = lerp(ur, lr, t_y);
                     color = HGL_RITA_BLACK;
@@ -2149,7 +3456,7 @@ static inline HglRitaColor hgl_rita_sample_uv(HglRitaTexture *tex, Vec2 uv)
 static inline HglRitaColor hgl_rita_sample_rectilinear(HglRitaTexture *tex, Vec3 dir)
 {
     Vec2 uv;
-    uv.x = atan2f(dir.z, dir.x) / (2.0f * (float)PI) + 0.5f;
+    uv.x = hgl_rita_atan2_internal_(dir.z, dir.x) / (2.0f * (float)PI) + 0.5f;
     uv.y = dir.y * 0.5f + 0.5f;
     return hgl_rita_sample_uv(tex, uv);
 }
@@ -2167,55 +3474,14 @@ static inline HglRitaColor hgl_rita_sample_cubemap(HglRitaTexture *tex, Vec3 dir
      *        | B  |
      *        +----+
      */
-    uint32_t major_axis = 1; // x=1, y=2, z=4, -x=8, -y=16, -z=32
-    float abs_x = fabsf(dir.x);
-    float abs_y = fabsf(dir.y);
-    float abs_z = fabsf(dir.z);
-    if (abs_x >= abs_y && abs_x >= abs_z) major_axis = 1; else
-    if (abs_y >= abs_x && abs_y >= abs_z) major_axis = 2; else
-    if (abs_z >= abs_x && abs_z >= abs_y) major_axis = 4;
-    if ((major_axis & 1) && dir.x < 0) major_axis <<= 3; else
-    if ((major_axis & 2) && dir.y < 0) major_axis <<= 3; else
-    if ((major_axis & 4) && dir.z < 0) major_axis <<= 3;
+    Vec2 uv;
+    int face = hgl_rita_cubemap_face_internal_(dir, &uv);
     const int x_step = tex->width / 4;
     const int y_step = tex->height / 3;
-
-    Vec2 uv;
-    HglRitaTexture dir_subtex;
-    switch(major_axis) {
-        case 1: {
-            uv.x = 0.5f * (dir.z / dir.x) + 0.5f;
-            uv.y = 0.5f * (dir.y / dir.x) + 0.5f;
-            dir_subtex = hgl_rita_texture_get_subtexture(*tex, 2*x_step, 1*y_step, x_step, y_step);
-        } break;
-        case 2: {
-            uv.x = 0.5f * (dir.x / dir.y) + 0.5f;
-            uv.y = 0.5f * (dir.z / dir.y) + 0.5f;
-            dir_subtex = hgl_rita_texture_get_subtexture(*tex, 1*x_step, 2*y_step, x_step, y_step);
-        } break;
-        case 4: {
-            uv.x = 0.5f * (-dir.x / dir.z) + 0.5f;
-            uv.y = 0.5f * (dir.y / dir.z) + 0.5f;
-            dir_subtex = hgl_rita_texture_get_subtexture(*tex, 3*x_step, 1*y_step, x_step, y_step);
-        } break;
-        case 8: {
-            uv.x = 0.5f * (dir.z / dir.x) + 0.5f;
-            uv.y = 0.5f * (-dir.y / dir.x) + 0.5f;
-            dir_subtex = hgl_rita_texture_get_subtexture(*tex, 0*x_step, 1*y_step, x_step, y_step);
-        } break;
-        case 16: {
-            uv.x = 0.5f * (-dir.x / dir.y) + 0.5f;
-            uv.y = 0.5f * (dir.z / dir.y) + 0.5f;
-            dir_subtex = hgl_rita_texture_get_subtexture(*tex, 1*x_step, 0*y_step, x_step, y_step);
-        } break;
-        case 32: {
-            uv.x = 0.5f * (-dir.x / dir.z) + 0.5f;
-            uv.y = 0.5f * (-dir.y / dir.z) + 0.5f;
-            dir_subtex = hgl_rita_texture_get_subtexture(*tex, 1*x_step, 1*y_step, x_step, y_step);
-        } break;
-        default: return HGL_RITA_CYAN; // shouldn't happen
-    }
-
+    HglRitaTexture dir_subtex = hgl_rita_texture_get_subtexture(*tex,
+                                                               hgl_rita_cubemap_faces__[face][4]*x_step,
+                                                               hgl_rita_cubemap_faces__[face][5]*y_step,
+                                                               x_step, y_step);
     return hgl_rita_sample_uv(&dir_subtex, uv);
 }
 
@@ -2244,6 +3510,135 @@ static inline HglRitaColor hgl_rita_sample_unit_cubemap(HglRitaTexUnit unit, Vec
 /*--- Internal functions ----------------------------------------------------------------*/
 /*---------------------------------------------------------------------------------------*/
 
+static inline void hgl_rita_wait_internal_(void)
+{
+    for (int i = 0; i < hgl_rita_ctx__.renderer.n_tiles; i++) {
+        hgl_rita_queue_wait_until_idle(&hgl_rita_ctx__.renderer.tile[i].op_queue, 1);
+    }
+}
+
+static inline void hgl_rita_resolve_transparency_internal_(void)
+{
+    if (!hgl_rita_ctx__.renderer.oit_pending) {
+        return;
+    }
+    hgl_rita_ctx__.renderer.oit_pending = false;
+    for (int i = 0; i < hgl_rita_ctx__.renderer.n_tiles; i++) {
+        HglRitaTileOp op = { .kind = HGL_RITA_OP_RESOLVE_TRANSPARENCY };
+        hgl_rita_queue_push(&hgl_rita_ctx__.renderer.tile[i].op_queue, op);
+    }
+}
+
+static inline void hgl_rita_resolve_msaa_internal_(void)
+{
+    if (!hgl_rita_ctx__.opts.msaa_enabled) {
+        return;
+    }
+    for (int i = 0; i < hgl_rita_ctx__.renderer.n_tiles; i++) {
+        HglRitaTileOp op = { .kind = HGL_RITA_OP_RESOLVE_MSAA };
+        hgl_rita_queue_push(&hgl_rita_ctx__.renderer.tile[i].op_queue, op);
+    }
+}
+
+static inline void hgl_rita_spawn_tiles_internal_(int fb_width, int fb_height)
+{
+    HglRitaTileConfig config = hgl_rita_ctx__.renderer.tile_config;
+    int cols = (fb_width - 1) / config.tile_size_x + 1;
+    int rows = (fb_height - 1) / config.tile_size_y + 1;
+    int n_needed_tiles = cols * rows;
+
+    /* Needs more tiles than allowed? */
+    if (n_needed_tiles > HGL_RITA_MAX_N_TILES) {
+        fprintf(stderr, "framebuffer texture too large. Consider increasing HGL_RITA_MAX_N_TILES\n");
+        fprintf(stderr, "or the tile dimensions (see hgl_rita_use_tile_config()).");
+        exit(1);
+    }
+
+    /* Tile threads cache their AABB, so any existing ones must be respawned */
+    hgl_rita_despawn_tiles_internal_();
+
+    /* Contiguous runs of tiles (in row-major order) are assigned to contiguous runs of processors */
+    int cpus[HGL_RITA_MAX_N_CPUS];
+    int n_cpus = 0;
+    hgl_rita_ctx__.renderer.n_first_touched = 0;
+    if (hgl_rita_ctx__.opts.thread_pinning_enabled) {
+        n_cpus = hgl_rita_cpu_order_internal_(cpus);
+    }
+
+    for (int i = 0; i < n_needed_tiles; i++) {
+        HglRitaTile *tile = &hgl_rita_ctx__.renderer.tile[i];
+        hgl_rita_queue_init(&tile->op_queue, config.op_queue_capacity);
+#ifdef HGL_RITA_COLLECT_STATS
+        tile->n_fragments = 0;
+#endif
+        tile->aabb = hgl_rita_aabb_make((i%cols)*config.tile_size_x,
+                                        (i/cols)*config.tile_size_y,
+                                        config.tile_size_x,
+                                        config.tile_size_y);
+        tile->aabb = hgl_rita_aabb_clip(tile->aabb, 0, 0, fb_width, fb_height);
+        tile->msaa_slots = NULL;
+        tile->msaa_pixels = (HglRitaMSAAPixelBuffer){0};
+        tile->oit_heads = NULL;
+        tile->oit_nodes = (HglRitaOITNodeBuffer){0};
+        tile->cpu = (n_cpus > 0) ? cpus[((int64_t)i * n_cpus) / n_needed_tiles] : -1;
+        pthread_create(&tile->thread, NULL, hgl_rita_tile_thread_internal_, (void *)tile);
+    }
+    hgl_rita_ctx__.renderer.n_tiles = n_needed_tiles;
+    hgl_rita_ctx__.renderer.n_tile_cols = cols;
+    hgl_rita_ctx__.renderer.n_tile_rows = rows;
+    hgl_rita_ctx__.renderer.fb_width = fb_width;
+    hgl_rita_ctx__.renderer.fb_height = fb_height;
+
+#ifdef HGL_RITA_PARALLEL_VERTEX_PROCESSING
+    int n_bins = hgl_rita_ctx__.renderer.n_procs * n_needed_tiles;
+    hgl_rita_ctx__.renderer.bins = HGL_RITA_ALLOC(n_bins * sizeof(HglRitaBin));
+    assert(hgl_rita_ctx__.renderer.bins != NULL);
+    memset(hgl_rita_ctx__.renderer.bins, 0, n_bins * sizeof(HglRitaBin));
+#endif
+
+    /* the new threads may run on other nodes, so have them touch the buffers that are already bound */
+    if (hgl_rita_ctx__.opts.thread_pinning_enabled) {
+        HglRitaTexture *bound[2] = {
+            hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER],
+            hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_DEPTH_BUFFER],
+        };
+        for (int i = 0; i < 2; i++) {
+            /* a framebuffer about to be replaced by one of another size is skipped */
+            if ((bound[i] != NULL) && (bound[i]->width == fb_width) && (bound[i]->height == fb_height)) {
+                hgl_rita_first_touch_internal_(bound[i]);
+            }
+        }
+    }
+}
+
+static inline void hgl_rita_despawn_tiles_internal_(void)
+{
+    for (int i = 0; i < hgl_rita_ctx__.renderer.n_tiles; i++) {
+        HglRitaTileOp op = { .kind = HGL_RITA_OP_TERMINATE };
+        hgl_rita_queue_push(&hgl_rita_ctx__.renderer.tile[i].op_queue, op);
+        pthread_join(hgl_rita_ctx__.renderer.tile[i].thread, NULL);
+        hgl_rita_queue_destroy(&hgl_rita_ctx__.renderer.tile[i].op_queue);
+        hgl_rita_msaa_free_internal_(&hgl_rita_ctx__.renderer.tile[i]);
+        HGL_RITA_FREE(hgl_rita_ctx__.renderer.tile[i].oit_heads);
+        hgl_rita_buf_destroy(&hgl_rita_ctx__.renderer.tile[i].oit_nodes);
+    }
+#ifdef HGL_RITA_PARALLEL_VERTEX_PROCESSING
+    if (hgl_rita_ctx__.renderer.bins != NULL) {
+        int n_bins = hgl_rita_ctx__.renderer.n_procs * hgl_rita_ctx__.renderer.n_tiles;
+        for (int i = 0; i < n_bins; i++) {
+            hgl_rita_buf_destroy(&hgl_rita_ctx__.renderer.bins[i]);
+        }
+        HGL_RITA_FREE(hgl_rita_ctx__.renderer.bins);
+        hgl_rita_ctx__.renderer.bins = NULL;
+    }
+#endif
+    hgl_rita_ctx__.renderer.n_tiles = 0;
+    hgl_rita_ctx__.renderer.n_tile_cols = 0;
+    hgl_rita_ctx__.renderer.n_tile_rows = 0;
+    hgl_rita_ctx__.renderer.fb_width = 0;
+    hgl_rita_ctx__.renderer.fb_height = 0;
+}
+
 static inline void *hgl_rita_tile_thread_internal_(void *arg)
 {
     errno = 0;
@@ -2253,28 +3648,70 @@ static inline void *hgl_rita_tile_thread_internal_(void *arg)
     }
 
     HglRitaTile *tile = (HglRitaTile *) arg;
+    if (tile->cpu >= 0) {
+        hgl_rita_pin_thread_internal_(tile->cpu);
+    }
+
     HglRitaTileOpQueue *q = &tile->op_queue;
     HglRitaAABB tile_aabb = tile->aabb;
+#ifdef HGL_RITA_PARALLEL_VERTEX_PROCESSING
+    /* Cursor into the per-producer bins of this tile. See HGL_RITA_OP_RASTERIZE_BINS */
+    int tile_idx = (int)(tile - hgl_rita_ctx__.renderer.tile);
+    int bin_stride = 0;
+    int n_bin_producers = 0;
+    int bin_producer = 0;
+    int bin_idx = 0;
+#endif
 
     for (;;) {
 
-        HglRitaTileOp op = hgl_rita_queue_pop(q, HglRitaTileOp);
-
-        switch (op.kind) {
-
-            /**
-             * Triangles
-             *
-             * TODO top left bias?
+        HglRitaTileOp op;
+#ifdef HGL_RITA_PARALLEL_VERTEX_PROCESSING
+        /* binned primitives are rasterized, in producer order, before anything else is popped off the queue */
+        HglRitaBin *bin = NULL;
+        while (bin_producer < n_bin_producers) {
+            bin = &hgl_rita_ctx__.renderer.bins[bin_producer*bin_stride + tile_idx];
+            if (bin_idx < bin->length) {
+                break;
+            }
+            bin = NULL;
+            bin_producer++;
+            bin_idx = 0;
+        }
+        if (bin != NULL) {
+            op = hgl_rita_unbin_primitive_internal_(bin->arr[bin_idx++]);
+        } else {
+            op = hgl_rita_queue_pop(q, HglRitaTileOp);
+        }
+#else
+        op = hgl_rita_queue_pop(q, HglRitaTileOp);
+#endif
+
+        /* the attachments can't be rebound while ops are in flight, so their formats are fixed for the whole op */
+        if (hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER] != NULL) {
+            tile->fb_format = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER]->format;
+        }
+        tile->db_format = (hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_DEPTH_BUFFER] != NULL) ?
+                          hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_DEPTH_BUFFER]->format : HGL_RITA_R32;
+
+        switch (op.kind) {
+
+            /**
+             * Triangles
+             *
+             * TODO top left bias?
              */
             case HGL_RITA_OP_RASTERIZE_TRIANGLE: {
                 HglRitaFragment f0 = op.triangle.f0;
                 HglRitaFragment f1 = op.triangle.f1;
                 HglRitaFragment f2 = op.triangle.f2;
 
-                HglRitaAABB aabb = hgl_rita_aabb_intersection(hgl_rita_aabb_from_tri(op.triangle), tile_aabb);
-                //aabb.max_x--;
-                //aabb.max_y--;
+                HglRitaAABB aabb = hgl_rita_tri_coverage_aabb_internal_(op.triangle);
+                aabb.max_x++;
+                aabb.max_y++;
+                aabb = hgl_rita_aabb_intersection(aabb, tile_aabb);
+
+                bool msaa = hgl_rita_ctx__.opts.msaa_enabled;
 
                 float det = hgl_rita_det_internal_(f2.x, f2.y, f1.x, f1.y, f0.x, f0.y);
                 if (fabsf(det) < 0.001f) break;
@@ -2288,6 +3725,25 @@ static inline void *hgl_rita_tile_thread_internal_(void *arg)
                 float delta_w1_row = (f2.x - f0.x);
                 float delta_w2_row = (f0.x - f1.x);
 
+                /* edge function offsets of each sample relative to the pixel position */
+                float sample_w0[HGL_RITA_MSAA_N_SAMPLES];
+                float sample_w1[HGL_RITA_MSAA_N_SAMPLES];
+                float sample_w2[HGL_RITA_MSAA_N_SAMPLES];
+                for (int s = 0; s < HGL_RITA_MSAA_N_SAMPLES; s++) {
+                    float dx = hgl_rita_msaa_pattern__[s][0];
+                    float dy = hgl_rita_msaa_pattern__[s][1];
+                    sample_w0[s] = dx*delta_w0_col + dy*delta_w0_row;
+                    sample_w1[s] = dx*delta_w1_col + dy*delta_w1_row;
+                    sample_w2[s] = dx*delta_w2_col + dy*delta_w2_row;
+                }
+
+                /* fragments that passed the depth test, waiting to be shaded by the batch shader */
+                bool batched = (hgl_rita_ctx__.shaders.frag_batch != NULL) && !msaa;
+                HglRitaFragment batch[HGL_RITA_FRAG_BATCH_SIZE];
+                int batch_idx[HGL_RITA_FRAG_BATCH_SIZE];
+                float batch_depth[HGL_RITA_FRAG_BATCH_SIZE];
+                int n_batched = 0;
+
                 int x = aabb.min_x;
                 int y = aabb.min_y;
                 float w0_row = hgl_rita_det_internal_(x, y, f1.x, f1.y, f2.x, f2.y); // + bias0;
@@ -2306,12 +3762,59 @@ static inline void *hgl_rita_tile_thread_internal_(void *arg)
                             is_inside = w0 <= 0 && w1 <= 0 && w2 <= 0;
                         }
 
-                        if (is_inside) {
+                        if (msaa) {
+                            /* coverage & depth per sample. Shade at the pixel, or at a covered sample if the pixel isn't */
+                            uint32_t coverage = 0;
+                            float sample_depth[HGL_RITA_MSAA_N_SAMPLES];
+                            float u = -w0 * r_area;
+                            float v = -w1 * r_area;
+                            for (int s = 0; s < HGL_RITA_MSAA_N_SAMPLES; s++) {
+                                float sw0 = w0 + sample_w0[s];
+                                float sw1 = w1 + sample_w1[s];
+                                float sw2 = w2 + sample_w2[s];
+                                bool sample_inside = frontfacing ? (sw0 >= 0 && sw1 >= 0 && sw2 >= 0) :
+                                                                   (sw0 <= 0 && sw1 <= 0 && sw2 <= 0);
+                                if (!sample_inside) {
+                                    continue;
+                                }
+                                float su = -sw0 * r_area;
+                                float sv = -sw1 * r_area;
+                                float inv_z = su*f0.inv_z + sv*f1.inv_z + (1.0f - su - sv)*f2.inv_z;
+                                sample_depth[s] = clamp(0, 1, 1.0f / inv_z);
+                                if ((coverage == 0) && !is_inside) {
+                                    u = su;
+                                    v = sv;
+                                }
+                                coverage |= 1u << s;
+                            }
+
+                            if (coverage != 0) {
+                                HglRitaFragment frag = hgl_rita_frag_berp_internal_(f0, f1, f2, u, v, x, y);
+                                hgl_rita_process_fragment_msaa_internal_(tile, &frag, coverage, sample_depth);
+#ifdef HGL_RITA_COLLECT_STATS
+                                tile->n_fragments++;
+#endif
+                            }
+                        } else if (is_inside) {
                             float u = -w0 * r_area;
                             float v = -w1 * r_area;
 
                             HglRitaFragment frag = hgl_rita_frag_berp_internal_(f0, f1, f2, u, v, x, y);
-                            hgl_rita_process_fragment_internal_(&frag);
+                            if (batched) {
+                                /* each pixel is covered at most once per triangle, so shading may be deferred */
+                                if (hgl_rita_fragment_depth_test_internal_(tile, &frag, &batch_idx[n_batched], &batch_depth[n_batched])) {
+                                    batch[n_batched++] = frag;
+                                    if (n_batched == HGL_RITA_FRAG_BATCH_SIZE) {
+                                        hgl_rita_flush_fragment_batch_internal_(tile, batch, batch_idx, batch_depth, n_batched);
+                                        n_batched = 0;
+                                    }
+                                }
+                            } else {
+                                hgl_rita_process_fragment_internal_(tile, &frag);
+                            }
+#ifdef HGL_RITA_COLLECT_STATS
+                            tile->n_fragments++;
+#endif
                         }
 
                         w0 += delta_w0_col;
@@ -2323,6 +3826,10 @@ static inline void *hgl_rita_tile_thread_internal_(void *arg)
                     w1_row += delta_w1_row;
                     w2_row += delta_w2_row;
                 }
+
+                if (n_batched > 0) {
+                    hgl_rita_flush_fragment_batch_internal_(tile, batch, batch_idx, batch_depth, n_batched);
+                }
             } break;
 
             /**
@@ -2445,7 +3952,10 @@ static inline void *hgl_rita_tile_thread_internal_(void *arg)
                         int x = f0.x + i;
                         int y = f0.y + i*y_step;
                         HglRitaFragment frag = hgl_rita_frag_lerp_internal_(x, y, f0, f1, t);
-                        hgl_rita_process_fragment_internal_(&frag);
+                        hgl_rita_process_fragment_internal_(tile, &frag);
+#ifdef HGL_RITA_COLLECT_STATS
+                        tile->n_fragments++;
+#endif
                     }
                 } else {
                     /* swap so we iterate on y in the positive direction */
@@ -2459,7 +3969,10 @@ static inline void *hgl_rita_tile_thread_internal_(void *arg)
                         int x = f0.x + i*x_step;
                         int y = f0.y + i;
                         HglRitaFragment frag = hgl_rita_frag_lerp_internal_(x, y, f0, f1, t);
-                        hgl_rita_process_fragment_internal_(&frag);
+                        hgl_rita_process_fragment_internal_(tile, &frag);
+#ifdef HGL_RITA_COLLECT_STATS
+                        tile->n_fragments++;
+#endif
                     }
                 }
             } break;
@@ -2469,7 +3982,10 @@ static inline void *hgl_rita_tile_thread_internal_(void *arg)
              */
             case HGL_RITA_OP_RASTERIZE_POINT: {
                 HglRitaFragment f0 = op.line.f0;
-                hgl_rita_process_fragment_internal_(&f0); // a bit more straight forward this time
+                hgl_rita_process_fragment_internal_(tile, &f0); // a bit more straight forward this time
+#ifdef HGL_RITA_COLLECT_STATS
+                tile->n_fragments++;
+#endif
             } break;
 
             /**
@@ -2486,12 +4002,35 @@ static inline void *hgl_rita_tile_thread_internal_(void *arg)
 #endif
             } break;
 
+            /**
+             * Primitive assembly & binning
+             */
+            case HGL_RITA_OP_BIN_SEGMENT: {
+#ifdef HGL_RITA_PARALLEL_VERTEX_PROCESSING
+                hgl_rita_bin_segment_internal_(op.bin_segment);
+#endif
+            } break;
+
+            case HGL_RITA_OP_RASTERIZE_BINS: {
+#ifdef HGL_RITA_PARALLEL_VERTEX_PROCESSING
+                bin_stride = hgl_rita_ctx__.renderer.n_tiles;
+                n_bin_producers = op.bin_segment.n_producers;
+                bin_producer = 0;
+                bin_idx = 0;
+#endif
+            } break;
+
             /**
              * Blit
              */
             case HGL_RITA_OP_BLIT: {
+                /* blits see (and overwrite) the resolved framebuffer */
+                hgl_rita_msaa_resolve_tile_internal_(tile);
+
                 HglRitaTexture *fb = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER];
                 HglRitaTexture *db = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_DEPTH_BUFFER];
+                HglRitaPixelFormat fb_format = tile->fb_format;
+                HglRitaPixelFormat db_format = tile->db_format;
 
                 HglRitaTexture *src                  = op.blit_info.texture;
                 HglRitaBlendMethod blend_method      = op.blit_info.blend_method;
@@ -2502,6 +4041,12 @@ static inline void *hgl_rita_tile_thread_internal_(void *arg)
                 int fb_h = fb->height;
                 int fb_s = fb->stride;
 
+                /* compare against the clear color as stored in the framebuffer */
+                HglRitaColor clear_color = hgl_rita_ctx__.opts.clear_color;
+                if (fb->format == HGL_RITA_RGB565) {
+                    clear_color = hgl_rita_color_from_rgb565(hgl_rita_color_to_rgb565(clear_color));
+                }
+
                 //Mat4 view_to_world_dir;
                 //float z = hgl_rita_ctx__.tform.proj.m11;
 
@@ -2522,46 +4067,75 @@ static inline void *hgl_rita_tile_thread_internal_(void *arg)
                 int box_w = op.blit_info.aabb.max_x - op.blit_info.aabb.min_x - 1;
                 int box_h = op.blit_info.aabb.max_y - op.blit_info.aabb.min_y - 1;
 
+                /*
+                 * The view direction is linear in screen_x: dir = dir_row + screen_x*dir_dx, where dir_row
+                 * is computed once per row. The cubemap faces are only looked up once per blit.
+                 */
+                float aspect = hgl_rita_ctx__.tform.camera.aspect;
+                Vec3 dir_dx = mat3_mul_vec3(hgl_rita_ctx__.tform.iview, vec3_make(2.0f * aspect / (float)fb_w, 0.0f, 0.0f));
+                Vec3 dir_row = vec3_make(0.0f, 0.0f, 0.0f);
+                HglRitaTexture cubemap_faces[6];
+                if (sampling_method == HGL_RITA_VIEW_DIR_CUBEMAP && src != NULL) {
+                    for (int face = 0; face < 6; face++) {
+                        cubemap_faces[face] = hgl_rita_texture_get_subtexture(*src,
+                                                                              hgl_rita_cubemap_faces__[face][4]*(src->width/4),
+                                                                              hgl_rita_cubemap_faces__[face][5]*(src->height/3),
+                                                                              src->width/4, src->height/3);
+                    }
+                }
+
+                /* pixels waiting to be shaded by the batch shader */
+                HglRitaFragment batch[HGL_RITA_FRAG_BATCH_SIZE];
+                int batch_idx[HGL_RITA_FRAG_BATCH_SIZE];
+                HglRitaColor batch_dst[HGL_RITA_FRAG_BATCH_SIZE];
+                int n_batched = 0;
+
                 for (int j = 0; j < h; j++) {
+                    if (sampling_method == HGL_RITA_VIEW_DIR_RECTILINEAR ||
+                        sampling_method == HGL_RITA_VIEW_DIR_CUBEMAP) {
+                        float sn_y = 2.0f*((float)(y + j) / (float)fb_h) - 1.0f;
+                        float z = hgl_rita_ctx__.tform.proj.m11;
+                        dir_row = mat3_mul_vec3(hgl_rita_ctx__.tform.iview, vec3_make(-aspect, -sn_y, -z));
+                    }
                     for (int i = 0; i < w; i++) {
                         int screen_y =  y + j;
                         int screen_x =  x + i;
                         int box_y = screen_y - op.blit_info.aabb.min_y;
                         int box_x = screen_x - op.blit_info.aabb.min_x;
                         HglRitaColor src_color = HGL_RITA_BLACK;
-                        HglRitaColor *dst_color = NULL;
-                        float *dst_depth = NULL;
+                        HglRitaColor dst_color;
+                        float dst_depth;
 
                         int idx = screen_y * fb_s + screen_x;
-                        dst_color = &fb->data.rgba8[idx];
+                        dst_color = hgl_rita_fb_read_internal_(fb, fb_format, idx);
 
                         switch (mask) {
                             case HGL_RITA_EVERYWHERE: break;
 
                             case HGL_RITA_CLEAR_COLOR: {
-                                if (!hgl_rita_color_eq(*dst_color, hgl_rita_ctx__.opts.clear_color)) {
+                                if (!hgl_rita_color_eq(dst_color, clear_color)) {
                                     continue;
                                 }
                             } break;
 
                             case HGL_RITA_NON_CLEAR_COLOR: {
-                                if (hgl_rita_color_eq(*dst_color, hgl_rita_ctx__.opts.clear_color)) {
+                                if (hgl_rita_color_eq(dst_color, clear_color)) {
                                     continue;
                                 }
                             } break;
 
                             case HGL_RITA_DEPTH_INF: {
                                 assert(db != NULL && "Missing depth attachment in framebuffer (Note: Needed by HGL_RITA_DEPTH_INF mask)");
-                                dst_depth = &db->data.r32[idx];
-                                if (*dst_depth != 1.0f) {
+                                dst_depth = hgl_rita_depth_read_internal_(db, db_format, idx);
+                                if (dst_depth != 1.0f) {
                                     continue;
                                 }
                             } break;
 
                             case HGL_RITA_DEPTH_NON_INF: {
                                 assert(db != NULL && "Missing depth attachment in framebuffer (Note: Needed by HGL_RITA_DEPTH_NON_INF mask)");
-                                dst_depth = &db->data.r32[idx];
-                                if (*dst_depth != 1.0f) {
+                                dst_depth = hgl_rita_depth_read_internal_(db, db_format, idx);
+                                if (dst_depth != 1.0f) {
                                     continue;
                                 }
                             } break;
@@ -2585,30 +4159,28 @@ static inline void *hgl_rita_tile_thread_internal_(void *arg)
                             } break;
 
                             case HGL_RITA_VIEW_DIR_RECTILINEAR: {
-                                float sn_x = 2.0f*((float)screen_x / (float)fb_w) - 1.0f;
-                                float sn_y = 2.0f*((float)screen_y / (float)fb_h) - 1.0f;
-                                float z = hgl_rita_ctx__.tform.proj.m11;
-                                Vec3 dir = vec3_make(hgl_rita_ctx__.tform.camera.aspect * sn_x, -sn_y, -z);
+                                Vec3 dir = vec3_add(dir_row, vec3_mul_scalar(dir_dx, (float)screen_x));
                                 dir = vec3_normalize(dir);
-                                dir = mat3_mul_vec3(hgl_rita_ctx__.tform.iview, dir);
                                 src_color = hgl_rita_sample_rectilinear(src, dir);
                             } break;
 
                             case HGL_RITA_VIEW_DIR_CUBEMAP: {
-                                float sn_x = 2.0f*((float)screen_x / (float)fb_w) - 1.0f;
-                                float sn_y = 2.0f*((float)screen_y / (float)fb_h) - 1.0f;
-                                float z = hgl_rita_ctx__.tform.proj.m11;
-                                Vec3 dir = vec3_make(hgl_rita_ctx__.tform.camera.aspect * sn_x, -sn_y, -z);
+                                Vec3 dir = vec3_add(dir_row, vec3_mul_scalar(dir_dx, (float)screen_x));
                                 //dir = vec3_normalize(dir); // not needed
-                                dir = mat3_mul_vec3(hgl_rita_ctx__.tform.iview, dir);
-                                src_color = hgl_rita_sample_cubemap(src, dir);
+                                if (src == NULL) {
+                                    src_color = hgl_rita_sample_uv(NULL, (Vec2){0});
+                                    break;
+                                }
+                                Vec2 uv;
+                                int face = hgl_rita_cubemap_face_internal_(dir, &uv);
+                                src_color = hgl_rita_sample_uv(&cubemap_faces[face], uv);
                             } break;
 
                             case HGL_RITA_SHADER: {
                                 HglRitaFragment frag;
                                 frag.x = screen_x;
                                 frag.y = screen_y;
-                                frag.inv_z = (db != NULL) ? db->data.r32[idx] : 0.0f;
+                                frag.inv_z = (db != NULL) ? hgl_rita_depth_read_internal_(db, db_format, idx) : 0.0f;
                                 frag.uv = (Vec2) {
                                     //(float)screen_x / (float)(fb_w - 1),
                                     //((float)screen_y / (float)(fb_h - 1)),
@@ -2616,15 +4188,77 @@ static inline void *hgl_rita_tile_thread_internal_(void *arg)
                                     ((float)box_y / (float)(box_h)),
                                 };
                                 frag.color = hgl_rita_sample_uv(src, frag.uv);
+                                if (op.blit_info.shader_batch != NULL) {
+                                    batch[n_batched] = frag;
+                                    batch_idx[n_batched] = idx;
+                                    batch_dst[n_batched] = dst_color;
+                                    n_batched++;
+                                    if (n_batched == HGL_RITA_FRAG_BATCH_SIZE) {
+                                        hgl_rita_flush_blit_batch_internal_(tile, &op.blit_info, batch, batch_idx, batch_dst, n_batched);
+                                        n_batched = 0;
+                                    }
+                                    continue;
+                                }
                                 src_color = op.blit_info.shader(&hgl_rita_ctx__, &frag);
                             } break;
                         }
 
-                        *dst_color = hgl_rita_color_blend(*dst_color, src_color, blend_method);
+                        hgl_rita_fb_write_internal_(fb, fb_format, idx, hgl_rita_color_blend(dst_color, src_color, blend_method));
+                    }
+                }
+
+                if (n_batched > 0) {
+                    hgl_rita_flush_blit_batch_internal_(tile, &op.blit_info, batch, batch_idx, batch_dst, n_batched);
+                }
+            } break;
+
+            /**
+             * Filters
+             */
+            case HGL_RITA_OP_FILTER_ROWS: {
+                hgl_rita_msaa_resolve_tile_internal_(tile);
+                hgl_rita_filter_rows_internal_(op.filter_info, hgl_rita_aabb_intersection(tile_aabb, op.filter_info.aabb));
+            } break;
+
+            case HGL_RITA_OP_FILTER_COLS: {
+                hgl_rita_msaa_resolve_tile_internal_(tile);
+                hgl_rita_filter_cols_internal_(op.filter_info, hgl_rita_aabb_intersection(tile_aabb, op.filter_info.aabb));
+            } break;
+
+            case HGL_RITA_OP_CLEAR: {
+                /* the samples may hold depth that isn't cleared */
+                hgl_rita_msaa_resolve_tile_internal_(tile);
+                hgl_rita_clear_tile_internal_(tile, op.attachments);
+            } break;
+
+            case HGL_RITA_OP_FIRST_TOUCH: {
+                /* Rewrites every cache line of the tile's rows with its current contents */
+                HglRitaTexture *tex = op.texture;
+                size_t texel_size = (tex->format == HGL_RITA_R16 || tex->format == HGL_RITA_RGB565) ? 2 : 4;
+                for (int y = tile_aabb.min_y; y < tile_aabb.max_y; y++) {
+                    volatile uint8_t *row = (volatile uint8_t *) tex->data.rgba8 +
+                                            ((size_t)y * tex->stride + tile_aabb.min_x) * texel_size;
+                    size_t n_bytes = (size_t)(tile_aabb.max_x - tile_aabb.min_x) * texel_size;
+                    for (size_t i = 0; i < n_bytes; i += 64) {
+                        row[i] = row[i];
                     }
                 }
             } break;
 
+            /**
+             * Order-independent transparency
+             */
+            case HGL_RITA_OP_RESOLVE_TRANSPARENCY: {
+                hgl_rita_oit_resolve_internal_(tile);
+            } break;
+
+            /**
+             * MSAA
+             */
+            case HGL_RITA_OP_RESOLVE_MSAA: {
+                hgl_rita_msaa_resolve_tile_internal_(tile);
+            } break;
+
             case HGL_RITA_OP_TERMINATE: {
                 return NULL;
             } break;
@@ -2632,6 +4266,163 @@ static inline void *hgl_rita_tile_thread_internal_(void *arg)
     }
 }
 
+static inline int hgl_rita_cpu_order_internal_(int *cpus)
+{
+    /* the processors this process may run on */
+    unsigned long mask[HGL_RITA_MAX_N_CPUS / (8 * sizeof(unsigned long))] = {0};
+    int n_cpus = 0;
+    if (syscall(SYS_sched_getaffinity, 0, sizeof(mask), mask) < 0) {
+        fprintf(stderr, "Unable to get the processor affinity. <%s:%d>\n", __FILE__, __LINE__);
+        return 0;
+    }
+
+    int keys[HGL_RITA_MAX_N_CPUS][3];
+    for (int cpu = 0; cpu < HGL_RITA_MAX_N_CPUS; cpu++) {
+        if (!(mask[cpu / (8 * sizeof(unsigned long))] & (1UL << (cpu % (8 * sizeof(unsigned long)))))) {
+            continue;
+        }
+        cpus[n_cpus] = cpu;
+        keys[n_cpus][0] = hgl_rita_cpu_topology_internal_(cpu, "topology/physical_package_id");
+        keys[n_cpus][1] = hgl_rita_cpu_topology_internal_(cpu, "cache/index3/id");
+        keys[n_cpus][2] = hgl_rita_cpu_topology_internal_(cpu, "topology/core_id");
+        n_cpus++;
+    }
+
+    /* insertion sort by (package, L3 cache, core, processor). SMT siblings end up next to each other */
+    for (int i = 1; i < n_cpus; i++) {
+        int cpu = cpus[i];
+        int key[3] = {keys[i][0], keys[i][1], keys[i][2]};
+        int j = i - 1;
+        while (j >= 0) {
+            int cmp = (keys[j][0] != key[0]) ? keys[j][0] - key[0] :
+                      (keys[j][1] != key[1]) ? keys[j][1] - key[1] :
+                      (keys[j][2] != key[2]) ? keys[j][2] - key[2] : cpus[j] - cpu;
+            if (cmp <= 0) {
+                break;
+            }
+            cpus[j + 1] = cpus[j];
+            memcpy(keys[j + 1], keys[j], sizeof(keys[j]));
+            j--;
+        }
+        cpus[j + 1] = cpu;
+        memcpy(keys[j + 1], key, sizeof(key));
+    }
+
+    return n_cpus;
+}
+
+static inline int hgl_rita_cpu_topology_internal_(int cpu, const char *attr)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/%s", cpu, attr);
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        return -1;
+    }
+    int value = -1;
+    if (fscanf(fp, "%d", &value) != 1) {
+        value = -1;
+    }
+    fclose(fp);
+    return value;
+}
+
+static inline void hgl_rita_pin_thread_internal_(int cpu)
+{
+    unsigned long mask[HGL_RITA_MAX_N_CPUS / (8 * sizeof(unsigned long))] = {0};
+    mask[cpu / (8 * sizeof(unsigned long))] = 1UL << (cpu % (8 * sizeof(unsigned long)));
+    if (syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask) < 0) {
+        fprintf(stderr, "Unable to pin tile thread to processor %d. <%s:%d>\n", cpu, __FILE__, __LINE__);
+    }
+}
+
+static inline void hgl_rita_first_touch_internal_(HglRitaTexture *tex)
+{
+    if (tex == NULL) {
+        return;
+    }
+
+    /* double buffered framebuffers are rebound every frame, but only need to be touched once */
+    int n_touched = min(hgl_rita_ctx__.renderer.n_first_touched, 4);
+    for (int i = 0; i < n_touched; i++) {
+        if (hgl_rita_ctx__.renderer.first_touched[i] == tex->data.rgba8) {
+            return;
+        }
+    }
+    hgl_rita_ctx__.renderer.first_touched[hgl_rita_ctx__.renderer.n_first_touched++ % 4] = tex->data.rgba8;
+
+    for (int i = 0; i < hgl_rita_ctx__.renderer.n_tiles; i++) {
+        HglRitaTileOp op = {
+            .texture = tex,
+            .kind = HGL_RITA_OP_FIRST_TOUCH,
+        };
+        hgl_rita_queue_push(&hgl_rita_ctx__.renderer.tile[i].op_queue, op);
+    }
+    hgl_rita_finish();
+}
+
+static inline void hgl_rita_clear_tile_internal_(HglRitaTile *tile, uint32_t attachments)
+{
+    HglRitaAABB aabb = tile->aabb;
+    int w = aabb.max_x - aabb.min_x;
+
+    if (attachments & HGL_RITA_COLOR) {
+        HglRitaTexture *fb = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER];
+        uint16_t p = hgl_rita_color_to_rgb565(hgl_rita_ctx__.opts.clear_color);
+        for (int y = aabb.min_y; y < aabb.max_y; y++) {
+            int idx = y * fb->stride + aabb.min_x;
+            if (fb->format == HGL_RITA_RGB565) {
+                for (int i = 0; i < w; i++) fb->data.rgb565[idx + i] = p;
+            } else {
+                for (int i = 0; i < w; i++) fb->data.rgba8[idx + i] = hgl_rita_ctx__.opts.clear_color;
+            }
+        }
+    }
+
+    if (attachments & HGL_RITA_DEPTH) {
+        HglRitaTexture *db = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_DEPTH_BUFFER];
+        for (int y = aabb.min_y; y < aabb.max_y; y++) {
+            int idx = y * db->stride + aabb.min_x;
+            if (db->format == HGL_RITA_R16) {
+                for (int i = 0; i < w; i++) db->data.r16[idx + i] = UINT16_MAX;
+            } else {
+                for (int i = 0; i < w; i++) db->data.r32[idx + i] = 1.0f;
+            }
+        }
+    }
+}
+
+static inline void hgl_rita_dispatch_blit_internal_(HglRitaBlitInfo info)
+{
+    /* blits see the framebuffer with the transparent fragments drawn before them */
+    hgl_rita_resolve_transparency_internal_();
+
+    HglRitaTileOp op = {
+        .blit_info = info,
+        .kind = HGL_RITA_OP_BLIT,
+    };
+    hgl_rita_dispatch_region_internal_(op, info.aabb);
+}
+
+static inline void hgl_rita_dispatch_region_internal_(HglRitaTileOp op, HglRitaAABB aabb)
+{
+    /* dispatch operation to intersecting tiles */
+    int fb_w = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER]->width;
+    int fb_h = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER]->height;
+    aabb = hgl_rita_aabb_clip(aabb, 0, 0, fb_w - 1, fb_h - 1);
+    int start_x = aabb.min_x / hgl_rita_ctx__.renderer.tile_config.tile_size_x;
+    int start_y = aabb.min_y / hgl_rita_ctx__.renderer.tile_config.tile_size_y;
+    int end_x = aabb.max_x / hgl_rita_ctx__.renderer.tile_config.tile_size_x + 1;
+    int end_y = aabb.max_y / hgl_rita_ctx__.renderer.tile_config.tile_size_y + 1;
+    int stride = hgl_rita_ctx__.renderer.n_tile_cols;
+    for (int y = start_y; y < end_y; y++) {
+        for (int x = start_x; x < end_x; x++) {
+            int i = y*stride + x;
+            hgl_rita_queue_push(&(hgl_rita_ctx__.renderer.tile[i].op_queue), op);
+        }
+    }
+}
+
 static inline void hgl_rita_dispatch_point_internal_(HglRitaFragment f0)
 {
     HglRitaTileOp op = {
@@ -2645,8 +4436,8 @@ static inline void hgl_rita_dispatch_point_internal_(HglRitaFragment f0)
     }
 
     /* dispatch point primitive to intersecting tile */
-    int x = f0.x / HGL_RITA_TILE_SIZE_X;
-    int y = f0.y / HGL_RITA_TILE_SIZE_Y;
+    int x = f0.x / hgl_rita_ctx__.renderer.tile_config.tile_size_x;
+    int y = f0.y / hgl_rita_ctx__.renderer.tile_config.tile_size_y;
     int stride = hgl_rita_ctx__.renderer.n_tile_cols;
     int i = y*stride + x;
     hgl_rita_queue_push(&(hgl_rita_ctx__.renderer.tile[i].op_queue), op);
@@ -2669,10 +4460,10 @@ static inline void hgl_rita_dispatch_line_internal_(HglRitaFragment f0, HglRitaF
     int w = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER]->width;
     int h = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER]->height;
     HglRitaAABB aabb = hgl_rita_aabb_clip(hgl_rita_aabb_from_line(op.line), 0, 0, w - 1, h - 1);
-    int start_x = aabb.min_x / HGL_RITA_TILE_SIZE_X;
-    int start_y = aabb.min_y / HGL_RITA_TILE_SIZE_Y;
-    int end_x = aabb.max_x / HGL_RITA_TILE_SIZE_X + 1;
-    int end_y = aabb.max_y / HGL_RITA_TILE_SIZE_Y + 1;
+    int start_x = aabb.min_x / hgl_rita_ctx__.renderer.tile_config.tile_size_x;
+    int start_y = aabb.min_y / hgl_rita_ctx__.renderer.tile_config.tile_size_y;
+    int end_x = aabb.max_x / hgl_rita_ctx__.renderer.tile_config.tile_size_x + 1;
+    int end_y = aabb.max_y / hgl_rita_ctx__.renderer.tile_config.tile_size_y + 1;
     int stride = hgl_rita_ctx__.renderer.n_tile_cols;
     for (int y = start_y; y < end_y; y++) {
         for (int x = start_x; x < end_x; x++) {
@@ -2696,39 +4487,208 @@ static inline void hgl_rita_dispatch_tri_internal_(HglRitaFragment f0, HglRitaFr
         .kind = HGL_RITA_OP_RASTERIZE_TRIANGLE,
     };
 
-    /* discard clipping (not completely valid to do this, but hey) */
-    if ((f0.clipping) &&
-        (f1.clipping) &&
-        (f2.clipping)) {
+    /* discard clipping and back-facing triangles */
+    if (hgl_rita_tri_is_culled_internal_(&f0, &f1, &f2)) {
         return;
     }
 
+#ifdef HGL_RITA_COLLECT_STATS
+    hgl_rita_ctx__.renderer.n_triangles++;
+#endif
+
+    /* dispatch triangle primitive to intersecting tiles */
+    int w = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER]->width;
+    int h = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER]->height;
+    HglRitaAABB aabb = hgl_rita_aabb_clip(hgl_rita_tri_coverage_aabb_internal_(op.triangle), 0, 0, w - 1, h - 1);
+    int start_x = aabb.min_x / hgl_rita_ctx__.renderer.tile_config.tile_size_x;
+    int start_y = aabb.min_y / hgl_rita_ctx__.renderer.tile_config.tile_size_y;
+    int end_x = aabb.max_x / hgl_rita_ctx__.renderer.tile_config.tile_size_x + 1;
+    int end_y = aabb.max_y / hgl_rita_ctx__.renderer.tile_config.tile_size_y + 1;
+    int stride = hgl_rita_ctx__.renderer.n_tile_cols;
+    for (int y = start_y; y < end_y; y++) {
+        for (int x = start_x; x < end_x; x++) {
+            int i = y*stride + x;
+            hgl_rita_queue_push(&(hgl_rita_ctx__.renderer.tile[i].op_queue), op);
+        }
+    }
+}
+
+static inline HglRitaAABB hgl_rita_tri_coverage_aabb_internal_(HglRitaTriangle tri)
+{
+    /*
+     * Vertices are at whole pixel positions, so pixels on the max edges are never inside (see
+     * HGL_RITA_OP_RASTERIZE_TRIANGLE), but with MSAA, their samples left of and above the pixel
+     * position may be.
+     */
+    HglRitaAABB aabb = hgl_rita_aabb_from_tri(tri);
+    if (!hgl_rita_ctx__.opts.msaa_enabled) {
+        aabb.max_x--;
+        aabb.max_y--;
+    }
+    return aabb;
+}
+
+static inline bool hgl_rita_tri_is_culled_internal_(const HglRitaFragment *f0,
+                                                    const HglRitaFragment *f1,
+                                                    const HglRitaFragment *f2)
+{
+    /* discard clipping (not completely valid to do this, but hey) */
+    if ((f0->clipping) &&
+        (f1->clipping) &&
+        (f2->clipping)) {
+        return true;
+    }
+
     /* cull back-facing triangles */
     if (hgl_rita_ctx__.opts.backface_culling_enabled) {
-        float det = hgl_rita_det_internal_(f0.x, f0.y, f1.x, f1.y, f2.x, f2.y);
+        float det = hgl_rita_det_internal_(f0->x, f0->y, f1->x, f1->y, f2->x, f2->y);
         bool frontfacing = (hgl_rita_ctx__.opts.frontface_winding == HGL_RITA_CCW) ? (det > 0) : (det < 0);
         if (!frontfacing) {
-            return;
+            return true;
         }
     }
 
-    /* dispatch triangle primitive to intersecting tiles */
+    return false;
+}
+
+#ifdef HGL_RITA_PARALLEL_VERTEX_PROCESSING
+static inline bool hgl_rita_draw_triangles_binned_internal_(void)
+{
+    int n_indices = (hgl_rita_ctx__.vertices.mode == HGL_RITA_INDEXED) ?
+                    hgl_rita_ctx__.vertices.ibuf->length :
+                    hgl_rita_ctx__.vertices.vbuf->length;
+    int n_tris = n_indices / 3;
+
+    /* producers are tile threads 0..n_producers-2, plus the current thread */
+    int n_producers = min(hgl_rita_ctx__.renderer.n_procs, hgl_rita_ctx__.renderer.n_tiles + 1);
+    n_producers = min(n_producers, n_tris / HGL_RITA_MIN_BIN_SEGMENT_SIZE);
+    if (n_producers < 2) {
+        return false;
+    }
+
+    /* Dispatch segments of the triangle list to be binned in parallel */
+    int seg_sz = n_tris / n_producers;
+    for (int i = 0; i < n_producers - 1; i++) {
+        HglRitaTileOp op = {
+            .bin_segment = {
+                .start_idx   = i * seg_sz,
+                .end_idx     = (i + 1) * seg_sz,
+                .producer    = i,
+                .n_producers = n_producers,
+            },
+            .kind = HGL_RITA_OP_BIN_SEGMENT,
+        };
+        hgl_rita_queue_push(&hgl_rita_ctx__.renderer.tile[i].op_queue, op);
+    }
+
+    /* bin the last segment (including the remainder) in the current thread */
+    hgl_rita_bin_segment_internal_((HglRitaBinSegment) {
+        .start_idx   = (n_producers - 1) * seg_sz,
+        .end_idx     = n_tris,
+        .producer    = n_producers - 1,
+        .n_producers = n_producers,
+    });
+
+    /* rendezvous with the producers */
+    for (int i = 0; i < n_producers - 1; i++) {
+        hgl_rita_queue_wait_until_idle(&hgl_rita_ctx__.renderer.tile[i].op_queue, 1);
+    }
+
+    /* Have every tile rasterize its bins, in producer order */
+    for (int i = 0; i < hgl_rita_ctx__.renderer.n_tiles; i++) {
+        HglRitaTileOp op = {
+            .bin_segment = { .n_producers = n_producers },
+            .kind = HGL_RITA_OP_RASTERIZE_BINS,
+        };
+        hgl_rita_queue_push(&hgl_rita_ctx__.renderer.tile[i].op_queue, op);
+    }
+
+    return true;
+}
+
+static inline void hgl_rita_bin_segment_internal_(HglRitaBinSegment seg)
+{
+    int n_tiles = hgl_rita_ctx__.renderer.n_tiles;
+    HglRitaBin *bins = &hgl_rita_ctx__.renderer.bins[seg.producer * n_tiles];
+    const HglRitaFragment *fbuf = hgl_rita_ctx__.vertices.fbuf.arr;
+#ifdef HGL_RITA_COLLECT_STATS
+    uint64_t n_triangles = 0;
+#endif
+
+    for (int i = 0; i < n_tiles; i++) {
+        hgl_rita_buf_clear(&bins[i]);
+    }
+
+    for (int t = seg.start_idx; t < seg.end_idx; t++) {
+        int i0 = hgl_rita_vbuf_index_internal_(3*t + 0);
+        int i1 = hgl_rita_vbuf_index_internal_(3*t + 1);
+        int i2 = hgl_rita_vbuf_index_internal_(3*t + 2);
+        const HglRitaFragment *f0 = &fbuf[i0];
+        const HglRitaFragment *f1 = &fbuf[i1];
+        const HglRitaFragment *f2 = &fbuf[i2];
+
+        if (hgl_rita_ctx__.opts.draw_wire_frames) {
+            HglRitaBinnedPrimitive l01 = {.idx = {i0, i1}, .kind = HGL_RITA_OP_RASTERIZE_LINE};
+            HglRitaBinnedPrimitive l12 = {.idx = {i1, i2}, .kind = HGL_RITA_OP_RASTERIZE_LINE};
+            HglRitaBinnedPrimitive l20 = {.idx = {i2, i0}, .kind = HGL_RITA_OP_RASTERIZE_LINE};
+            hgl_rita_bin_primitive_internal_(bins, hgl_rita_aabb_from_line((HglRitaLine){*f0, *f1}), l01);
+            hgl_rita_bin_primitive_internal_(bins, hgl_rita_aabb_from_line((HglRitaLine){*f1, *f2}), l12);
+            hgl_rita_bin_primitive_internal_(bins, hgl_rita_aabb_from_line((HglRitaLine){*f2, *f0}), l20);
+            continue;
+        }
+
+        /* discard clipping and back-facing triangles */
+        if (hgl_rita_tri_is_culled_internal_(f0, f1, f2)) {
+            continue;
+        }
+
+#ifdef HGL_RITA_COLLECT_STATS
+        n_triangles++;
+#endif
+
+        HglRitaBinnedPrimitive tri = {.idx = {i0, i1, i2}, .kind = HGL_RITA_OP_RASTERIZE_TRIANGLE};
+        hgl_rita_bin_primitive_internal_(bins, hgl_rita_tri_coverage_aabb_internal_((HglRitaTriangle){*f0, *f1, *f2}), tri);
+    }
+
+#ifdef HGL_RITA_COLLECT_STATS
+    hgl_rita_ctx__.renderer.n_triangles += n_triangles;
+#endif
+}
+
+static inline void hgl_rita_bin_primitive_internal_(HglRitaBin *bins,
+                                                    HglRitaAABB aabb,
+                                                    HglRitaBinnedPrimitive prim)
+{
     int w = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER]->width;
     int h = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER]->height;
-    HglRitaAABB aabb = hgl_rita_aabb_clip(hgl_rita_aabb_from_tri(op.triangle), 0, 0, w - 1, h - 1);
-    int start_x = aabb.min_x / HGL_RITA_TILE_SIZE_X;
-    int start_y = aabb.min_y / HGL_RITA_TILE_SIZE_Y;
-    int end_x = aabb.max_x / HGL_RITA_TILE_SIZE_X + 1;
-    int end_y = aabb.max_y / HGL_RITA_TILE_SIZE_Y + 1;
+    aabb = hgl_rita_aabb_clip(aabb, 0, 0, w - 1, h - 1);
+    int start_x = aabb.min_x / hgl_rita_ctx__.renderer.tile_config.tile_size_x;
+    int start_y = aabb.min_y / hgl_rita_ctx__.renderer.tile_config.tile_size_y;
+    int end_x = aabb.max_x / hgl_rita_ctx__.renderer.tile_config.tile_size_x + 1;
+    int end_y = aabb.max_y / hgl_rita_ctx__.renderer.tile_config.tile_size_y + 1;
     int stride = hgl_rita_ctx__.renderer.n_tile_cols;
     for (int y = start_y; y < end_y; y++) {
         for (int x = start_x; x < end_x; x++) {
             int i = y*stride + x;
-            hgl_rita_queue_push(&(hgl_rita_ctx__.renderer.tile[i].op_queue), op);
+            hgl_rita_buf_push(&bins[i], prim);
         }
     }
 }
 
+static inline HglRitaTileOp hgl_rita_unbin_primitive_internal_(HglRitaBinnedPrimitive prim)
+{
+    const HglRitaFragment *fbuf = hgl_rita_ctx__.vertices.fbuf.arr;
+    HglRitaTileOp op;
+    op.kind = prim.kind;
+    if (prim.kind == HGL_RITA_OP_RASTERIZE_TRIANGLE) {
+        op.triangle = (HglRitaTriangle){fbuf[prim.idx[0]], fbuf[prim.idx[1]], fbuf[prim.idx[2]]};
+    } else {
+        op.line = (HglRitaLine){fbuf[prim.idx[0]], fbuf[prim.idx[1]]};
+    }
+    return op;
+}
+#endif
+
 static inline HglRitaFragment hgl_rita_process_vertex_internal_(const HglRitaVertex *in)
 {
     HglRitaVertex vert_out;
@@ -2748,9 +4708,9 @@ static inline HglRitaFragment hgl_rita_process_vertex_internal_(const HglRitaVer
         Mat3 m_normals = hgl_rita_ctx__.tform.normals;
 
         vert_out.pos     = mat4_mul_vec4(m_mvp, v_ls);
-        vert_out.normal  = mat3_mul_vec3(m_normals, in->normal);
+        vert_out.normal  = vec3_normalize(mat3_mul_vec3(m_normals, in->normal));
 #ifndef HGL_RITA_SIMPLE
-        vert_out.tangent = mat3_mul_vec3(m_normals, in->tangent);
+        vert_out.tangent = vec3_normalize(mat3_mul_vec3(m_normals, in->tangent));
 #endif
         vert_out.uv      = in->uv;
         vert_out.color   = in->color;
@@ -2790,19 +4750,55 @@ static inline HglRitaFragment hgl_rita_process_vertex_internal_(const HglRitaVer
     return frag_out;
 }
 
-static inline void hgl_rita_process_fragment_internal_(HglRitaFragment *in)
+#ifndef HGL_RITA_PARALLEL_VERTEX_PROCESSING
+static inline HglRitaFragment hgl_rita_process_vertex_cached_internal_(int idx)
+{
+    /* direct mapped. Works well with vertex buffers ordered by `hgl_rita_mesh_optimize_vertex_fetch()` */
+    int slot = idx & (HGL_RITA_VERTEX_CACHE_SIZE - 1);
+    if (hgl_rita_ctx__.vertices.cache.tag[slot] != idx) {
+        const HglRitaVertex *v = &hgl_rita_ctx__.vertices.vbuf->arr[idx];
+        hgl_rita_ctx__.vertices.cache.frag[slot] = hgl_rita_process_vertex_internal_(v);
+        hgl_rita_ctx__.vertices.cache.tag[slot] = idx;
+    }
+    return hgl_rita_ctx__.vertices.cache.frag[slot];
+}
+#endif
+
+static inline void hgl_rita_process_fragment_internal_(HglRitaTile *tile, HglRitaFragment *in)
+{
+    if (hgl_rita_ctx__.opts.msaa_enabled) {
+        /* points & lines cover all samples of a pixel */
+        hgl_rita_process_fragment_msaa_internal_(tile, in, (1u << HGL_RITA_MSAA_N_SAMPLES) - 1, NULL);
+        return;
+    }
+
+    int idx;
+    float depth;
+    if (!hgl_rita_fragment_depth_test_internal_(tile, in, &idx, &depth)) {
+        return;
+    }
+
+    HglRitaColor color = hgl_rita_shade_fragment_internal_(in);
+    if (hgl_rita_ctx__.opts.order_independent_alpha_blending_enabled) {
+        hgl_rita_oit_insert_internal_(tile, in->x, in->y, color, depth, (1u << HGL_RITA_MSAA_N_SAMPLES) - 1);
+        return;
+    }
+    hgl_rita_fragment_write_internal_(tile, idx, depth, color);
+}
+
+static inline bool hgl_rita_fragment_depth_test_internal_(const HglRitaTile *tile, const HglRitaFragment *in, int *idx, float *depth)
 {
     int x = in->x;
     int y = in->y;
-    float depth = clamp(0, 1, 1.0f / in->inv_z);
     int s = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER]->stride;
-    int idx = y * s + x;
+    *idx = y * s + x;
+    *depth = clamp(0, 1, 1.0f / in->inv_z);
 
 #if 0
     /* framebuffer bounds test (shouldn't be necessary anymore) */
     if ((x < 0 || x >= w) ||
         (y < 0 || y >= h)) {
-        return;
+        return false;
     }
 #endif
 
@@ -2810,36 +4806,1039 @@ static inline void hgl_rita_process_fragment_internal_(HglRitaFragment *in)
     if ((hgl_rita_ctx__.opts.depth_test_enabled)) {
         assert(hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_DEPTH_BUFFER] != NULL &&
                "Missing depth attachment in framebuffer (Note: Needed by HGL_RITA_DEPTH_TESTING)");
-        if (hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_DEPTH_BUFFER]->data.r32[idx] < depth) {
-            return;
+        if (!hgl_rita_depth_test_internal_(hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_DEPTH_BUFFER], tile->db_format, *idx, *depth)) {
+            return false;
         }
     }
 
-    HglRitaColor color;
-    if (hgl_rita_ctx__.shaders.frag == NULL) {
-        /* do default shading */
-        if (hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_DIFFUSE] != NULL) {
-            color = hgl_rita_color_mul(in->color, hgl_rita_sample_unit_uv(HGL_RITA_TEX_DIFFUSE, in->uv));
-        } else {
-            color = in->color;
-        }
-    } else {
-        color = hgl_rita_ctx__.shaders.frag(&hgl_rita_ctx__, in);
-    }
+    return true;
+}
 
-    /* alpha blending */
+static inline void hgl_rita_fragment_write_internal_(const HglRitaTile *tile, int idx, float depth, HglRitaColor color)
+{
+    HglRitaTexture *fb = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER];
+
+    /* alpha blending */
     if (hgl_rita_ctx__.opts.order_dependent_alpha_blending_enabled) {
         float a = (float)color.a / 256.0f;
-        color = hgl_rita_color_lerp(hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER]->data.rgba8[idx], color, a);
+        color = hgl_rita_color_lerp(hgl_rita_fb_read_internal_(fb, tile->fb_format, idx), color, a);
         color.a = 255;
     }
 
-    hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER]->data.rgba8[idx] = color;
+    hgl_rita_fb_write_internal_(fb, tile->fb_format, idx, color);
     if (hgl_rita_ctx__.opts.depth_buffer_writing_enabled) {
         assert(hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_DEPTH_BUFFER] != NULL &&
                "Missing depth attachment in framebuffer (Note: Needed by HGL_RITA_DEPTH_BUFFER_WRITING)");
-        hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_DEPTH_BUFFER]->data.r32[idx] = depth;
+        hgl_rita_depth_write_internal_(hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_DEPTH_BUFFER], tile->db_format, idx, depth);
+    }
+}
+
+static inline void hgl_rita_flush_fragment_batch_internal_(HglRitaTile *tile,
+                                                           HglRitaFragment *frags,
+                                                           const int *idx,
+                                                           const float *depth,
+                                                           int n)
+{
+    HglRitaColor colors[HGL_RITA_FRAG_BATCH_SIZE];
+    hgl_rita_ctx__.shaders.frag_batch(&hgl_rita_ctx__, frags, colors, n);
+    if (hgl_rita_ctx__.opts.order_independent_alpha_blending_enabled) {
+        for (int i = 0; i < n; i++) {
+            hgl_rita_oit_insert_internal_(tile, frags[i].x, frags[i].y, colors[i], depth[i], (1u << HGL_RITA_MSAA_N_SAMPLES) - 1);
+        }
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        hgl_rita_fragment_write_internal_(tile, idx[i], depth[i], colors[i]);
+    }
+}
+
+static inline void hgl_rita_oit_insert_internal_(HglRitaTile *tile, int x, int y,
+                                                 HglRitaColor color, float depth,
+                                                 uint32_t coverage)
+{
+    int tile_w = tile->aabb.max_x - tile->aabb.min_x;
+    int tile_h = tile->aabb.max_y - tile->aabb.min_y;
+
+    /* allocated by the tile thread itself, i.e. on its own memory node */
+    if (tile->oit_heads == NULL) {
+        tile->oit_heads = HGL_RITA_ALLOC(tile_w * tile_h * sizeof(int));
+        assert(tile->oit_heads != NULL);
+        for (int i = 0; i < tile_w * tile_h; i++) {
+            tile->oit_heads[i] = -1;
+        }
+    }
+
+    int *head = &tile->oit_heads[(y - tile->aabb.min_y) * tile_w + (x - tile->aabb.min_x)];
+    hgl_rita_buf_push(&tile->oit_nodes, (HglRitaOITNode) {
+        .color    = color,
+        .depth    = depth,
+        .coverage = coverage,
+        .next     = *head,
+    });
+    *head = tile->oit_nodes.length - 1;
+}
+
+static inline void hgl_rita_oit_resolve_internal_(HglRitaTile *tile)
+{
+    if (tile->oit_nodes.length == 0) {
+        return;
+    }
+
+    HglRitaTexture *fb = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER];
+    HglRitaPixelFormat fb_format = tile->fb_format;
+    const HglRitaOITNode *nodes = tile->oit_nodes.arr;
+    int tile_w = tile->aabb.max_x - tile->aabb.min_x;
+    int tile_h = tile->aabb.max_y - tile->aabb.min_y;
+
+    HglRitaOITNode layers[HGL_RITA_OIT_MAX_LAYERS];
+    for (int ty = 0; ty < tile_h; ty++) {
+        for (int tx = 0; tx < tile_w; tx++) {
+            int *head = &tile->oit_heads[ty * tile_w + tx];
+            if (*head < 0) {
+                continue;
+            }
+
+            /*
+             * Insertion sort, far to near. The list is in reverse submission order, so
+             * fragments at equal depth are ordered by submission. If the list is too long,
+             * the farthest fragments are dropped.
+             */
+            int n_layers = 0;
+            for (int i = *head; i >= 0; i = nodes[i].next) {
+                HglRitaOITNode node = nodes[i];
+                if (n_layers == HGL_RITA_OIT_MAX_LAYERS) {
+                    if (node.depth >= layers[0].depth) {
+                        continue;
+                    }
+                    memmove(&layers[0], &layers[1], --n_layers * sizeof(HglRitaOITNode));
+                }
+                int j = n_layers++;
+                while ((j > 0) && (layers[j - 1].depth <= node.depth)) {
+                    layers[j] = layers[j - 1];
+                    j--;
+                }
+                layers[j] = node;
+            }
+            *head = -1;
+
+            /* composite. Partially covering layers go into the samples of the pixel, resolved later */
+            int idx = (tile->aabb.min_y + ty) * fb->stride + tile->aabb.min_x + tx;
+            bool has_samples = (tile->msaa_slots != NULL) && (tile->msaa_slots[ty * tile_w + tx] >= 0);
+            for (int i = 0; i < n_layers; i++) {
+                has_samples = has_samples || (layers[i].coverage != (1u << HGL_RITA_MSAA_N_SAMPLES) - 1);
+            }
+            if (has_samples) {
+                HglRitaColor *samples = hgl_rita_msaa_pixel_internal_(tile, tile->aabb.min_x + tx, tile->aabb.min_y + ty)->color;
+                for (int s = 0; s < HGL_RITA_MSAA_N_SAMPLES; s++) {
+                    for (int i = 0; i < n_layers; i++) {
+                        if (layers[i].coverage & (1u << s)) {
+                            samples[s] = hgl_rita_color_lerp(samples[s], layers[i].color, (float)layers[i].color.a / 256.0f);
+                            samples[s].a = 255;
+                        }
+                    }
+                }
+            } else {
+                HglRitaColor color = hgl_rita_fb_read_internal_(fb, fb_format, idx);
+                for (int i = 0; i < n_layers; i++) {
+                    color = hgl_rita_color_lerp(color, layers[i].color, (float)layers[i].color.a / 256.0f);
+                    color.a = 255;
+                }
+                hgl_rita_fb_write_internal_(fb, fb_format, idx, color);
+            }
+        }
+    }
+
+    hgl_rita_buf_clear(&tile->oit_nodes);
+}
+
+static inline void hgl_rita_flush_blit_batch_internal_(const HglRitaTile *tile,
+                                                       const HglRitaBlitInfo *info,
+                                                       HglRitaFragment *frags,
+                                                       const int *idx,
+                                                       const HglRitaColor *dst,
+                                                       int n)
+{
+    HglRitaColor colors[HGL_RITA_FRAG_BATCH_SIZE];
+    info->shader_batch(&hgl_rita_ctx__, frags, colors, n);
+    HglRitaTexture *fb = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER];
+    for (int i = 0; i < n; i++) {
+        hgl_rita_fb_write_internal_(fb, tile->fb_format, idx[i], hgl_rita_color_blend(dst[i], colors[i], info->blend_method));
+    }
+}
+
+static inline void hgl_rita_filter_internal_(int x, int y, int w, int h, HglRitaFilterMode mode)
+{
+    HglRitaTexture *fb = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER];
+    assert(fb != NULL && "Missing color attachment in framebuffer");
+
+    HglRitaFilterInfo info = {
+        .aabb = hgl_rita_aabb_clip(hgl_rita_aabb_make(x, y, w, h), 0, 0, fb->width, fb->height),
+        .mode = mode,
+    };
+    int rw = info.aabb.max_x - info.aabb.min_x;
+    int rh = info.aabb.max_y - info.aabb.min_y;
+    if (rw <= 0 || rh <= 0) {
+        return;
+    }
+
+    /* Note: the caller has already waited for the tile threads, so the scratch buffer is unused */
+    size_t scratch_size = 4 * (size_t)rw * (size_t)rh;
+    if (scratch_size > hgl_rita_ctx__.filter.scratch_size) {
+        HGL_RITA_FREE(hgl_rita_ctx__.filter.scratch);
+        hgl_rita_ctx__.filter.scratch = HGL_RITA_ALLOC(scratch_size * sizeof(float));
+        assert(hgl_rita_ctx__.filter.scratch != NULL);
+        hgl_rita_ctx__.filter.scratch_size = scratch_size;
+    }
+
+    /* row pass. Wait for it to finish, since the column pass of each tile reads the rows of its neighbours */
+    hgl_rita_dispatch_region_internal_((HglRitaTileOp) {.filter_info = info, .kind = HGL_RITA_OP_FILTER_ROWS}, info.aabb);
+    hgl_rita_finish();
+
+    /* column pass */
+    hgl_rita_dispatch_region_internal_((HglRitaTileOp) {.filter_info = info, .kind = HGL_RITA_OP_FILTER_COLS}, info.aabb);
+}
+
+static inline void hgl_rita_filter_rows_internal_(HglRitaFilterInfo info, HglRitaAABB aabb)
+{
+    static const float smooth[3] = { 1.0f, 2.0f, 1.0f};
+    static const float diff[3]   = {-1.0f, 0.0f, 1.0f};
+
+    const HglRitaTexture *fb = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER];
+    HglRitaPixelFormat fb_format = fb->format;
+    HglRitaAABB region = info.aabb;
+    int rw = region.max_x - region.min_x;
+    int rh = region.max_y - region.min_y;
+    size_t plane_size = (size_t)rw * (size_t)rh;
+    float *scratch = hgl_rita_ctx__.filter.scratch;
+    int radius = (info.mode == HGL_RITA_FILTER_SOBEL) ? 1 : hgl_rita_ctx__.filter.radius;
+
+    /* one strip of pixels, plus the halo on either side, per channel */
+    float in[4][HGL_RITA_FILTER_STRIP_SIZE + 2*HGL_RITA_FILTER_MAX_RADIUS];
+
+    for (int y = aabb.min_y; y < aabb.max_y; y++) {
+        for (int x0 = aabb.min_x; x0 < aabb.max_x; x0 += HGL_RITA_FILTER_STRIP_SIZE) {
+            int n = min(HGL_RITA_FILTER_STRIP_SIZE, aabb.max_x - x0);
+            float *out = &scratch[(y - region.min_y) * rw + (x0 - region.min_x)];
+
+            /* unpack the strip. The halo may reach into neighbouring tiles, but not outside the region */
+            for (int i = 0; i < n + 2*radius; i++) {
+                int x = min(max(x0 - radius + i, region.min_x), region.max_x - 1);
+                HglRitaColor c = hgl_rita_fb_read_internal_(fb, fb_format, y * fb->stride + x);
+                in[0][i] = (float)c.r;
+                in[1][i] = (float)c.g;
+                in[2][i] = (float)c.b;
+                in[3][i] = (float)c.a;
+            }
+
+            if (info.mode == HGL_RITA_FILTER_SOBEL) {
+                for (int i = 0; i < n + 2; i++) {
+                    in[0][i] = 0.299f*in[0][i] + 0.587f*in[1][i] + 0.114f*in[2][i];
+                }
+                hgl_rita_convolve_row_internal_(out, in[0], smooth, 3, n);
+                hgl_rita_convolve_row_internal_(out + plane_size, in[0], diff, 3, n);
+                continue;
+            }
+
+            for (int c = 0; c < 4; c++) {
+                hgl_rita_convolve_row_internal_(out + c*plane_size, in[c], hgl_rita_ctx__.filter.kernel_x, 2*radius + 1, n);
+            }
+        }
+    }
+}
+
+static inline void hgl_rita_filter_cols_internal_(HglRitaFilterInfo info, HglRitaAABB aabb)
+{
+    static const float smooth[3] = { 1.0f, 2.0f, 1.0f};
+    static const float diff[3]   = {-1.0f, 0.0f, 1.0f};
+
+    HglRitaTexture *fb = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER];
+    HglRitaPixelFormat fb_format = fb->format;
+    HglRitaAABB region = info.aabb;
+    int rw = region.max_x - region.min_x;
+    int rh = region.max_y - region.min_y;
+    size_t plane_size = (size_t)rw * (size_t)rh;
+    const float *scratch = hgl_rita_ctx__.filter.scratch;
+
+    float out[4][HGL_RITA_FILTER_STRIP_SIZE];
+
+    for (int y = aabb.min_y; y < aabb.max_y; y++) {
+        for (int x0 = aabb.min_x; x0 < aabb.max_x; x0 += HGL_RITA_FILTER_STRIP_SIZE) {
+            int n = min(HGL_RITA_FILTER_STRIP_SIZE, aabb.max_x - x0);
+            const float *in = &scratch[x0 - region.min_x];
+            int row = y - region.min_y;
+            int idx = y * fb->stride + x0;
+
+            if (info.mode == HGL_RITA_FILTER_SOBEL) {
+                /* plane 0 is smoothed horizontally, plane 1 is differentiated horizontally */
+                hgl_rita_convolve_col_internal_(out[0], in + plane_size, rw, rh, row, smooth, 1, n);
+                hgl_rita_convolve_col_internal_(out[1], in, rw, rh, row, diff, 1, n);
+                for (int i = 0; i < n; i++) {
+                    out[0][i] = sqrtf(out[0][i]*out[0][i] + out[1][i]*out[1][i]);
+                }
+                for (int i = 0; i < n; i++) {
+                    uint8_t v = (uint8_t) clamp(0.0f, 255.0f, out[0][i] + 0.5f);
+                    hgl_rita_fb_write_internal_(fb, fb_format, idx + i, (HglRitaColor){.r = v, .g = v, .b = v, .a = 255});
+                }
+                continue;
+            }
+
+            for (int c = 0; c < 4; c++) {
+                hgl_rita_convolve_col_internal_(out[c], in + c*plane_size, rw, rh, row,
+                                                hgl_rita_ctx__.filter.kernel_y, hgl_rita_ctx__.filter.radius, n);
+            }
+            for (int i = 0; i < n; i++) {
+                hgl_rita_fb_write_internal_(fb, fb_format, idx + i, (HglRitaColor) {
+                    .r = (uint8_t) clamp(0.0f, 255.0f, out[0][i] + 0.5f),
+                    .g = (uint8_t) clamp(0.0f, 255.0f, out[1][i] + 0.5f),
+                    .b = (uint8_t) clamp(0.0f, 255.0f, out[2][i] + 0.5f),
+                    .a = (uint8_t) clamp(0.0f, 255.0f, out[3][i] + 0.5f),
+                });
+            }
+        }
+    }
+}
+
+static inline void hgl_rita_convolve_row_internal_(float *out, const float *in,
+                                                   const float *kernel, int n_taps,
+                                                   int n)
+{
+    /* taps in the outer loop, so that the inner loop vectorizes */
+    for (int i = 0; i < n; i++) {
+        out[i] = 0.0f;
+    }
+    for (int k = 0; k < n_taps; k++) {
+        float weight = kernel[k];
+        const float *src = &in[k];
+        for (int i = 0; i < n; i++) {
+            out[i] += weight * src[i];
+        }
+    }
+}
+
+static inline void hgl_rita_convolve_col_internal_(float *out, const float *plane,
+                                                   int stride, int height, int y,
+                                                   const float *kernel, int radius,
+                                                   int n)
+{
+    for (int i = 0; i < n; i++) {
+        out[i] = 0.0f;
+    }
+    for (int k = 0; k < 2*radius + 1; k++) {
+        float weight = kernel[k];
+        const float *src = &plane[min(max(y + k - radius, 0), height - 1) * stride];
+        for (int i = 0; i < n; i++) {
+            out[i] += weight * src[i];
+        }
+    }
+}
+
+static inline void hgl_rita_process_fragment_msaa_internal_(HglRitaTile *tile,
+                                                            HglRitaFragment *in,
+                                                            uint32_t coverage,
+                                                            const float *sample_depth)
+{
+    const uint32_t all_samples = (1u << HGL_RITA_MSAA_N_SAMPLES) - 1;
+    HglRitaTexture *db = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_DEPTH_BUFFER];
+    int x = in->x;
+    int y = in->y;
+    int idx = y * hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER]->stride + x;
+    int tile_w = tile->aabb.max_x - tile->aabb.min_x;
+    int slot = (tile->msaa_slots != NULL) ? tile->msaa_slots[(y - tile->aabb.min_y) * tile_w + (x - tile->aabb.min_x)] : -1;
+
+    float pixel_depth = clamp(0, 1, 1.0f / in->inv_z);
+    float depth[HGL_RITA_MSAA_N_SAMPLES];
+    for (int i = 0; i < HGL_RITA_MSAA_N_SAMPLES; i++) {
+        depth[i] = (sample_depth != NULL) ? sample_depth[i] : pixel_depth;
+    }
+
+    /* per-sample depth test, against the samples of the pixel if it has any, otherwise against the depth buffer */
+    if (hgl_rita_ctx__.opts.depth_test_enabled) {
+        assert(db != NULL && "Missing depth attachment in framebuffer (Note: Needed by HGL_RITA_DEPTH_TESTING)");
+        for (int i = 0; i < HGL_RITA_MSAA_N_SAMPLES; i++) {
+            if (!(coverage & (1u << i))) {
+                continue;
+            }
+            bool passed = (slot >= 0) ? (tile->msaa_pixels.arr[slot].depth[i] >= depth[i]) :
+                                        hgl_rita_depth_test_internal_(db, tile->db_format, idx, depth[i]);
+            if (!passed) {
+                coverage &= ~(1u << i);
+            }
+        }
+    }
+    if (coverage == 0) {
+        return;
+    }
+
+    /* shade once per pixel */
+    HglRitaColor color = hgl_rita_shade_fragment_internal_(in);
+    if (hgl_rita_ctx__.opts.order_independent_alpha_blending_enabled) {
+        hgl_rita_oit_insert_internal_(tile, x, y, color, pixel_depth, coverage);
+        return;
+    }
+
+    /* completely covered pixels without samples of their own don't need any */
+    if ((slot < 0) && (coverage == all_samples)) {
+        hgl_rita_fragment_write_internal_(tile, idx, pixel_depth, color);
+        return;
+    }
+
+    HglRitaMSAAPixel *pixel = hgl_rita_msaa_pixel_internal_(tile, x, y);
+    float a = (float)color.a / 256.0f;
+    for (int i = 0; i < HGL_RITA_MSAA_N_SAMPLES; i++) {
+        if (!(coverage & (1u << i))) {
+            continue;
+        }
+        if (hgl_rita_ctx__.opts.order_dependent_alpha_blending_enabled) {
+            pixel->color[i] = hgl_rita_color_lerp(pixel->color[i], color, a);
+            pixel->color[i].a = 255;
+        } else {
+            pixel->color[i] = color;
+        }
+        if (hgl_rita_ctx__.opts.depth_buffer_writing_enabled) {
+            pixel->depth[i] = depth[i];
+        }
+    }
+}
+
+static inline HglRitaColor hgl_rita_shade_fragment_internal_(HglRitaFragment *in)
+{
+    HglRitaColor color;
+    if (hgl_rita_ctx__.shaders.frag_batch != NULL) {
+        /* a batch of one (points, lines, MSAA) */
+        hgl_rita_ctx__.shaders.frag_batch(&hgl_rita_ctx__, in, &color, 1);
+    } else if (hgl_rita_ctx__.shaders.frag == NULL) {
+        /* do default shading */
+        if (hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_DIFFUSE] != NULL) {
+            color = hgl_rita_color_mul(in->color, hgl_rita_sample_unit_uv(HGL_RITA_TEX_DIFFUSE, in->uv));
+        } else {
+            color = in->color;
+        }
+    } else {
+        color = hgl_rita_ctx__.shaders.frag(&hgl_rita_ctx__, in);
+    }
+    return color;
+}
+
+static inline HglRitaColor hgl_rita_fb_read_rgba8_internal_(const HglRitaTexture *fb, int idx)
+{
+    return fb->data.rgba8[idx];
+}
+
+static inline HglRitaColor hgl_rita_fb_read_rgb565_internal_(const HglRitaTexture *fb, int idx)
+{
+    return hgl_rita_color_from_rgb565(fb->data.rgb565[idx]);
+}
+
+static inline void hgl_rita_fb_write_rgba8_internal_(HglRitaTexture *fb, int idx, HglRitaColor color)
+{
+    fb->data.rgba8[idx] = color;
+}
+
+static inline void hgl_rita_fb_write_rgb565_internal_(HglRitaTexture *fb, int idx, HglRitaColor color)
+{
+    fb->data.rgb565[idx] = hgl_rita_color_to_rgb565(color);
+}
+
+static inline float hgl_rita_depth_read_r32_internal_(const HglRitaTexture *db, int idx)
+{
+    return db->data.r32[idx];
+}
+
+static inline float hgl_rita_depth_read_r16_internal_(const HglRitaTexture *db, int idx)
+{
+    return (float) db->data.r16[idx] / (float) UINT16_MAX;
+}
+
+static inline bool hgl_rita_depth_test_r32_internal_(const HglRitaTexture *db, int idx, float depth)
+{
+    return db->data.r32[idx] >= depth;
+}
+
+static inline bool hgl_rita_depth_test_r16_internal_(const HglRitaTexture *db, int idx, float depth)
+{
+    /* N.B. `depth` is in [0, 1]. R16 depth is tested as integers, at the precision it is stored at */
+    return db->data.r16[idx] >= (uint16_t) (depth * (float) UINT16_MAX + 0.5f);
+}
+
+static inline void hgl_rita_depth_write_r32_internal_(HglRitaTexture *db, int idx, float depth)
+{
+    db->data.r32[idx] = depth;
+}
+
+static inline void hgl_rita_depth_write_r16_internal_(HglRitaTexture *db, int idx, float depth)
+{
+    db->data.r16[idx] = (uint16_t) (depth * (float) UINT16_MAX + 0.5f);
+}
+
+static inline HglRitaColor hgl_rita_fb_read_internal_(const HglRitaTexture *fb, HglRitaPixelFormat format, int idx)
+{
+    return (format == HGL_RITA_RGBA8) ? hgl_rita_fb_read_rgba8_internal_(fb, idx) :
+                                        hgl_rita_fb_read_rgb565_internal_(fb, idx);
+}
+
+static inline void hgl_rita_fb_write_internal_(HglRitaTexture *fb, HglRitaPixelFormat format, int idx, HglRitaColor color)
+{
+    if (format == HGL_RITA_RGBA8) {
+        hgl_rita_fb_write_rgba8_internal_(fb, idx, color);
+    } else {
+        hgl_rita_fb_write_rgb565_internal_(fb, idx, color);
+    }
+}
+
+static inline float hgl_rita_depth_read_internal_(const HglRitaTexture *db, HglRitaPixelFormat format, int idx)
+{
+    return (format == HGL_RITA_R32) ? hgl_rita_depth_read_r32_internal_(db, idx) :
+                                      hgl_rita_depth_read_r16_internal_(db, idx);
+}
+
+static inline bool hgl_rita_depth_test_internal_(const HglRitaTexture *db, HglRitaPixelFormat format, int idx, float depth)
+{
+    return (format == HGL_RITA_R32) ? hgl_rita_depth_test_r32_internal_(db, idx, depth) :
+                                      hgl_rita_depth_test_r16_internal_(db, idx, depth);
+}
+
+static inline void hgl_rita_depth_write_internal_(HglRitaTexture *db, HglRitaPixelFormat format, int idx, float depth)
+{
+    if (format == HGL_RITA_R32) {
+        hgl_rita_depth_write_r32_internal_(db, idx, depth);
+    } else {
+        hgl_rita_depth_write_r16_internal_(db, idx, depth);
+    }
+}
+
+static inline float hgl_rita_texel_r_internal_(const HglRitaTexture *tex, int x, int y)
+{
+    int idx = y * tex->stride + x;
+    switch (tex->format) {
+        case HGL_RITA_R16: return (float) tex->data.r16[idx] / (float) UINT16_MAX;
+        case HGL_RITA_BC4: return (float) hgl_rita_block_fetch_internal_(tex, x, y)[(y & 3)*4 + (x & 3)].r / 255.0f;
+        default:           return tex->data.r32[idx];
+    }
+}
+
+static inline HglRitaColor hgl_rita_texel_internal_(const HglRitaTexture *tex, int x, int y)
+{
+    int idx = y * tex->stride + x;
+    HglRitaColor color = HGL_RITA_BLACK;
+    switch (tex->format) {
+        case HGL_RITA_RGBA8: {
+            color = tex->data.rgba8[idx];
+        } break;
+        case HGL_RITA_RGB565: {
+            color = hgl_rita_color_from_rgb565(tex->data.rgb565[idx]);
+        } break;
+        case HGL_RITA_R32:
+        case HGL_RITA_R16: {
+            color.r = 255*hgl_rita_texel_r_internal_(tex, x, y);
+        } break;
+        case HGL_RITA_BC1:
+        case HGL_RITA_BC4: {
+            color = hgl_rita_block_fetch_internal_(tex, x, y)[(y & 3)*4 + (x & 3)];
+        } break;
+    }
+    return color;
+}
+
+static inline const HglRitaColor *hgl_rita_block_fetch_internal_(const HglRitaTexture *tex, int x, int y)
+{
+    const uint64_t *block = tex->data.bc1 + (y >> 2)*((tex->stride + 3) >> 2) + (x >> 2);
+    uint32_t epoch = hgl_rita_ctx__.renderer.block_cache_epoch;
+
+    /* direct mapped. Neighbouring blocks of a row land in neighbouring entries */
+    uintptr_t h = (uintptr_t) block >> 3;
+    h ^= h >> 9;
+    HglRitaBlockCacheEntry *entry = &hgl_rita_block_cache__[h & (HGL_RITA_BLOCK_CACHE_SIZE - 1)];
+    if (entry->block != block || entry->epoch != epoch) {
+        if (tex->format == HGL_RITA_BC1) {
+            hgl_rita_bc1_decode_block_internal_(*block, entry->texels);
+        } else {
+            hgl_rita_bc4_decode_block_internal_(*block, entry->texels);
+        }
+        entry->block = block;
+        entry->epoch = epoch;
+    }
+    return entry->texels;
+}
+
+static inline void hgl_rita_bc1_palette_internal_(uint16_t c0, uint16_t c1, HglRitaColor palette[4])
+{
+    palette[0] = hgl_rita_color_from_rgb565(c0);
+    palette[1] = hgl_rita_color_from_rgb565(c1);
+    if (c0 > c1) {
+        palette[2] = (HglRitaColor) {
+            .r = (2*palette[0].r + palette[1].r) / 3,
+            .g = (2*palette[0].g + palette[1].g) / 3,
+            .b = (2*palette[0].b + palette[1].b) / 3,
+            .a = 255,
+        };
+        palette[3] = (HglRitaColor) {
+            .r = (palette[0].r + 2*palette[1].r) / 3,
+            .g = (palette[0].g + 2*palette[1].g) / 3,
+            .b = (palette[0].b + 2*palette[1].b) / 3,
+            .a = 255,
+        };
+    } else {
+        palette[2] = (HglRitaColor) {
+            .r = (palette[0].r + palette[1].r) / 2,
+            .g = (palette[0].g + palette[1].g) / 2,
+            .b = (palette[0].b + palette[1].b) / 2,
+            .a = 255,
+        };
+        palette[3] = (HglRitaColor) {0}; // transparent
+    }
+}
+
+static inline void hgl_rita_bc4_palette_internal_(uint8_t r0, uint8_t r1, uint8_t palette[8])
+{
+    palette[0] = r0;
+    palette[1] = r1;
+    if (r0 > r1) {
+        for (int i = 2; i < 8; i++) {
+            palette[i] = ((8 - i)*r0 + (i - 1)*r1) / 7;
+        }
+    } else {
+        for (int i = 2; i < 6; i++) {
+            palette[i] = ((6 - i)*r0 + (i - 1)*r1) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+static inline uint64_t hgl_rita_bc1_encode_block_internal_(const HglRitaColor texels[16])
+{
+    /* fit the endpoints along the principal axis of the (opaque) block colors */
+    float mean[3] = {0};
+    int n_opaque = 0;
+    for (int i = 0; i < 16; i++) {
+        if (texels[i].a < 128) continue;
+        mean[0] += texels[i].r;
+        mean[1] += texels[i].g;
+        mean[2] += texels[i].b;
+        n_opaque++;
+    }
+    bool has_alpha = (n_opaque < 16);
+    if (n_opaque == 0) {
+        return 0xFFFFFFFFull << 32; // all transparent
+    }
+    for (int c = 0; c < 3; c++) {
+        mean[c] /= (float) n_opaque;
+    }
+
+    float cov[6] = {0}; // rr, rg, rb, gg, gb, bb
+    for (int i = 0; i < 16; i++) {
+        if (texels[i].a < 128) continue;
+        float r = texels[i].r - mean[0];
+        float g = texels[i].g - mean[1];
+        float b = texels[i].b - mean[2];
+        cov[0] += r*r; cov[1] += r*g; cov[2] += r*b;
+        cov[3] += g*g; cov[4] += g*b; cov[5] += b*b;
+    }
+
+    /* power iteration */
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int k = 0; k < 4; k++) {
+        float v[3] = {
+            cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2],
+            cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2],
+            cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2],
+        };
+        float m = fmaxf(fabsf(v[0]), fmaxf(fabsf(v[1]), fabsf(v[2])));
+        if (m < 1e-6f) break;
+        axis[0] = v[0] / m;
+        axis[1] = v[1] / m;
+        axis[2] = v[2] / m;
+    }
+    float len2 = axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2];
+
+    float t_min = 0.0f;
+    float t_max = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        if (texels[i].a < 128) continue;
+        float t = ((texels[i].r - mean[0])*axis[0] +
+                   (texels[i].g - mean[1])*axis[1] +
+                   (texels[i].b - mean[2])*axis[2]) / len2;
+        t_min = fminf(t_min, t);
+        t_max = fmaxf(t_max, t);
+    }
+
+    uint16_t endpoint[2];
+    float ts[2] = {t_max, t_min};
+    for (int e = 0; e < 2; e++) {
+        float r = clamp(0.0f, 255.0f, mean[0] + ts[e]*axis[0]);
+        float g = clamp(0.0f, 255.0f, mean[1] + ts[e]*axis[1]);
+        float b = clamp(0.0f, 255.0f, mean[2] + ts[e]*axis[2]);
+        endpoint[e] = (uint16_t) (((int)(r * 31.0f / 255.0f + 0.5f) << 11) |
+                                  ((int)(g * 63.0f / 255.0f + 0.5f) << 5) |
+                                  ((int)(b * 31.0f / 255.0f + 0.5f)));
+    }
+
+    /* c0 > c1 selects the 4 color mode, c0 <= c1 the 3 color + transparent mode */
+    uint16_t c0 = endpoint[0];
+    uint16_t c1 = endpoint[1];
+    if ((has_alpha && c0 > c1) || (!has_alpha && c0 < c1)) {
+        c0 = endpoint[1];
+        c1 = endpoint[0];
+    }
+
+    HglRitaColor palette[4];
+    hgl_rita_bc1_palette_internal_(c0, c1, palette);
+    int n_colors = (c0 > c1) ? 4 : 3;
+
+    uint32_t indices = 0;
+    for (int i = 0; i < 16; i++) {
+        int best = 3;
+        if (texels[i].a >= 128) {
+            int best_dist = INT32_MAX;
+            for (int j = 0; j < n_colors; j++) {
+                int dr = texels[i].r - palette[j].r;
+                int dg = texels[i].g - palette[j].g;
+                int db = texels[i].b - palette[j].b;
+                int dist = dr*dr + dg*dg + db*db;
+                if (dist < best_dist) {
+                    best_dist = dist;
+                    best = j;
+                }
+            }
+        }
+        indices |= (uint32_t) best << (2*i);
+    }
+
+    return (uint64_t) c0 | ((uint64_t) c1 << 16) | ((uint64_t) indices << 32);
+}
+
+static inline uint64_t hgl_rita_bc4_encode_block_internal_(const uint8_t values[16])
+{
+    uint8_t r0 = 0;
+    uint8_t r1 = 255;
+    for (int i = 0; i < 16; i++) {
+        r0 = (values[i] > r0) ? values[i] : r0;
+        r1 = (values[i] < r1) ? values[i] : r1;
+    }
+
+    uint8_t palette[8];
+    hgl_rita_bc4_palette_internal_(r0, r1, palette);
+
+    uint64_t indices = 0;
+    for (int i = 0; i < 16; i++) {
+        int best = 0;
+        int best_dist = INT32_MAX;
+        for (int j = 0; j < 8; j++) {
+            int dist = abs(values[i] - palette[j]);
+            if (dist < best_dist) {
+                best_dist = dist;
+                best = j;
+            }
+        }
+        indices |= (uint64_t) best << (3*i);
+    }
+
+    return (uint64_t) r0 | ((uint64_t) r1 << 8) | (indices << 16);
+}
+
+static inline void hgl_rita_bc1_decode_block_internal_(uint64_t block, HglRitaColor texels[16])
+{
+    HglRitaColor palette[4];
+    hgl_rita_bc1_palette_internal_(block & 0xFFFF, (block >> 16) & 0xFFFF, palette);
+    uint32_t indices = block >> 32;
+    for (int i = 0; i < 16; i++) {
+        texels[i] = palette[(indices >> (2*i)) & 0x3];
+    }
+}
+
+static inline void hgl_rita_bc4_decode_block_internal_(uint64_t block, HglRitaColor texels[16])
+{
+    uint8_t palette[8];
+    hgl_rita_bc4_palette_internal_(block & 0xFF, (block >> 8) & 0xFF, palette);
+    uint64_t indices = block >> 16;
+    for (int i = 0; i < 16; i++) {
+        texels[i] = HGL_RITA_BLACK;
+        texels[i].r = palette[(indices >> (3*i)) & 0x7];
+    }
+}
+
+static inline void *hgl_rita_compress_thread_internal_(void *arg)
+{
+    HglRitaCompressJob *job = (HglRitaCompressJob *) arg;
+    const HglRitaTexture *src = job->src;
+    HglRitaTexture *dst = job->dst;
+    int n_block_cols = (dst->width + 3) / 4;
+    int n_block_rows = (dst->height + 3) / 4;
+
+    for (int by = job->first_block_row; by < n_block_rows; by += job->block_row_step) {
+        for (int bx = 0; bx < n_block_cols; bx++) {
+            /* gather the 4x4 texels. Blocks on the right/bottom edge repeat the edge texels */
+            HglRitaColor texels[16];
+            for (int i = 0; i < 16; i++) {
+                int x = min(4*bx + (i & 3), src->width - 1);
+                int y = min(4*by + (i >> 2), src->height - 1);
+                texels[i] = hgl_rita_texel_internal_(src, x, y);
+            }
+
+            uint64_t block;
+            if (dst->format == HGL_RITA_BC1) {
+                block = hgl_rita_bc1_encode_block_internal_(texels);
+            } else {
+                uint8_t values[16];
+                for (int i = 0; i < 16; i++) {
+                    values[i] = texels[i].r;
+                }
+                block = hgl_rita_bc4_encode_block_internal_(values);
+            }
+            dst->data.bc1[by*((dst->stride + 3) >> 2) + bx] = block;
+        }
+    }
+
+    return NULL;
+}
+
+static inline float hgl_rita_atan2_internal_(float y, float x)
+{
+    /* atan on [0, 1]. Abramowitz & Stegun 4.4.49 */
+    float abs_x = fabsf(x);
+    float abs_y = fabsf(y);
+    float hi = max(abs_x, abs_y);
+    float lo = min(abs_x, abs_y);
+    float a = (hi > 0.0f) ? lo / hi : 0.0f;
+    float s = a*a;
+    float r = a * (0.9998660f + s*(-0.3302995f + s*(0.1801410f + s*(-0.0851330f + s*0.0208351f))));
+
+    /* reflect back into the right octant */
+    if (abs_y > abs_x) r = 0.5f*(float)PI - r;
+    if (x < 0.0f) r = (float)PI - r;
+    if (y < 0.0f) r = -r;
+    return r;
+}
+
+static inline int hgl_rita_cubemap_face_internal_(Vec3 dir, Vec2 *uv)
+{
+    float d[3] = {dir.x, dir.y, dir.z};
+    float abs_x = fabsf(dir.x);
+    float abs_y = fabsf(dir.y);
+    float abs_z = fabsf(dir.z);
+    int axis = (abs_x >= abs_y && abs_x >= abs_z) ? 0 :
+               (abs_y >= abs_z)                   ? 1 : 2;
+    int face = (d[axis] < 0.0f) ? axis + 3 : axis;
+
+    /* a single division per direction */
+    const int *f = hgl_rita_cubemap_faces__[face];
+    float half_inv = 0.5f / d[axis];
+    uv->x = (float)f[1] * d[f[0]] * half_inv + 0.5f;
+    uv->y = (float)f[3] * d[f[2]] * half_inv + 0.5f;
+    return face;
+}
+
+static inline HglRitaColor hgl_rita_msaa_resolve_internal_(const HglRitaColor *samples)
+{
+    uint32_t r = 0, g = 0, b = 0, a = 0;
+    for (int i = 0; i < HGL_RITA_MSAA_N_SAMPLES; i++) {
+        r += samples[i].r;
+        g += samples[i].g;
+        b += samples[i].b;
+        a += samples[i].a;
+    }
+    return (HglRitaColor) {
+        .r = (r + HGL_RITA_MSAA_N_SAMPLES/2) / HGL_RITA_MSAA_N_SAMPLES,
+        .g = (g + HGL_RITA_MSAA_N_SAMPLES/2) / HGL_RITA_MSAA_N_SAMPLES,
+        .b = (b + HGL_RITA_MSAA_N_SAMPLES/2) / HGL_RITA_MSAA_N_SAMPLES,
+        .a = (a + HGL_RITA_MSAA_N_SAMPLES/2) / HGL_RITA_MSAA_N_SAMPLES,
+    };
+}
+
+static inline HglRitaMSAAPixel *hgl_rita_msaa_pixel_internal_(HglRitaTile *tile, int x, int y)
+{
+    int tile_w = tile->aabb.max_x - tile->aabb.min_x;
+    int tile_h = tile->aabb.max_y - tile->aabb.min_y;
+
+    /* allocated by the tile thread itself, i.e. on its own memory node */
+    if (tile->msaa_slots == NULL) {
+        tile->msaa_slots = HGL_RITA_ALLOC(tile_w * tile_h * sizeof(int));
+        assert(tile->msaa_slots != NULL);
+        for (int i = 0; i < tile_w * tile_h; i++) {
+            tile->msaa_slots[i] = -1;
+        }
+    }
+
+    int p = (y - tile->aabb.min_y) * tile_w + (x - tile->aabb.min_x);
+    if (tile->msaa_slots[p] >= 0) {
+        return &tile->msaa_pixels.arr[tile->msaa_slots[p]];
+    }
+
+    /* samples not covered by anything yet are whatever the framebuffer holds */
+    const HglRitaTexture *fb = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER];
+    const HglRitaTexture *db = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_DEPTH_BUFFER];
+    int idx = y * fb->stride + x;
+    HglRitaMSAAPixel pixel = {.pixel = p};
+    HglRitaColor color = hgl_rita_fb_read_internal_(fb, tile->fb_format, idx);
+    float depth = (db != NULL) ? hgl_rita_depth_read_internal_(db, tile->db_format, idx) : 1.0f;
+    for (int i = 0; i < HGL_RITA_MSAA_N_SAMPLES; i++) {
+        pixel.color[i] = color;
+        pixel.depth[i] = depth;
+    }
+    hgl_rita_buf_push(&tile->msaa_pixels, pixel);
+    tile->msaa_slots[p] = tile->msaa_pixels.length - 1;
+    return &tile->msaa_pixels.arr[tile->msaa_slots[p]];
+}
+
+static inline void hgl_rita_msaa_resolve_tile_internal_(HglRitaTile *tile)
+{
+    if (tile->msaa_pixels.length == 0) {
+        return;
+    }
+
+    HglRitaTexture *fb = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER];
+    HglRitaTexture *db = hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_DEPTH_BUFFER];
+    HglRitaPixelFormat fb_format = tile->fb_format;
+    HglRitaPixelFormat db_format = tile->db_format;
+    int tile_w = tile->aabb.max_x - tile->aabb.min_x;
+    for (int i = 0; i < tile->msaa_pixels.length; i++) {
+        const HglRitaMSAAPixel *pixel = &tile->msaa_pixels.arr[i];
+        int x = tile->aabb.min_x + pixel->pixel % tile_w;
+        int y = tile->aabb.min_y + pixel->pixel / tile_w;
+        int idx = y * fb->stride + x;
+        hgl_rita_fb_write_internal_(fb, fb_format, idx, hgl_rita_msaa_resolve_internal_(pixel->color));
+
+        /* the samples started out at the depth buffer value, so they can only be nearer */
+        float min_depth = 1.0f;
+        for (int s = 0; s < HGL_RITA_MSAA_N_SAMPLES; s++) {
+            min_depth = min(min_depth, pixel->depth[s]);
+        }
+        if ((db != NULL) && (min_depth < hgl_rita_depth_read_internal_(db, db_format, idx))) {
+            hgl_rita_depth_write_internal_(db, db_format, idx, min_depth);
+        }
+        tile->msaa_slots[pixel->pixel] = -1;
+    }
+    hgl_rita_buf_clear(&tile->msaa_pixels);
+}
+
+static inline void hgl_rita_msaa_free_internal_(HglRitaTile *tile)
+{
+    HGL_RITA_FREE(tile->msaa_slots);
+    hgl_rita_buf_destroy(&tile->msaa_pixels);
+    tile->msaa_slots = NULL;
+}
+
+static inline int hgl_rita_frustum_planes_internal_(Mat4 m, Vec4 planes[6])
+{
+    /* Gribb & Hartmann. The planes are in the space `m` transforms from, and aren't normalized. */
+    Vec4 r0 = vec4_make(m.m00, m.m01, m.m02, m.m03);
+    Vec4 r1 = vec4_make(m.m10, m.m11, m.m12, m.m13);
+    Vec4 r2 = vec4_make(m.m20, m.m21, m.m22, m.m23);
+    Vec4 r3 = vec4_make(m.m30, m.m31, m.m32, m.m33);
+    planes[0] = vec4_add(r3, r0); /* left */
+    planes[1] = vec4_sub(r3, r0); /* right */
+    planes[2] = vec4_add(r3, r1); /* bottom */
+    planes[3] = vec4_sub(r3, r1); /* top */
+    planes[4] = vec4_add(r3, r2); /* near */
+    planes[5] = vec4_sub(r3, r2); /* far */
+    return hgl_rita_ctx__.opts.z_clipping_enabled ? 6 : 5;
+}
+
+static inline int hgl_rita_box_frustum_test_internal_(const Vec4 *planes, int n_planes,
+                                                      Vec3 min, Vec3 max)
+{
+    int result = 2;
+    for (int i = 0; i < n_planes; i++) {
+        Vec4 p = planes[i];
+
+        /* the corners furthest along (p) and against (n) the plane normal */
+        Vec3 pv = vec3_make(p.x >= 0 ? max.x : min.x, p.y >= 0 ? max.y : min.y, p.z >= 0 ? max.z : min.z);
+        Vec3 nv = vec3_make(p.x >= 0 ? min.x : max.x, p.y >= 0 ? min.y : max.y, p.z >= 0 ? min.z : max.z);
+        if (p.x*pv.x + p.y*pv.y + p.z*pv.z + p.w < 0) {
+            return 0;
+        }
+        if (p.x*nv.x + p.y*nv.y + p.z*nv.z + p.w < 0) {
+            result = 1;
+        }
+    }
+    return result;
+}
+
+static inline void hgl_rita_bvh_build_internal_(HglRitaBVH *bvh, int node,
+                                                const HglRitaBounds *boxes,
+                                                const Vec3 *centroids)
+{
+    int first = bvh->nodes.arr[node].first;
+    int count = bvh->nodes.arr[node].count;
+    int *objs = &bvh->objects.arr[first];
+
+    /* compute the bounds of the node and of the centroids of its objects */
+    Vec3 min  = boxes[objs[0]].box.min;
+    Vec3 max  = boxes[objs[0]].box.max;
+    Vec3 cmin = centroids[objs[0]];
+    Vec3 cmax = centroids[objs[0]];
+    for (int i = 1; i < count; i++) {
+        Vec3 bmin = boxes[objs[i]].box.min;
+        Vec3 bmax = boxes[objs[i]].box.max;
+        Vec3 c    = centroids[objs[i]];
+        min  = vec3_make(fminf(min.x, bmin.x), fminf(min.y, bmin.y), fminf(min.z, bmin.z));
+        max  = vec3_make(fmaxf(max.x, bmax.x), fmaxf(max.y, bmax.y), fmaxf(max.z, bmax.z));
+        cmin = vec3_make(fminf(cmin.x, c.x), fminf(cmin.y, c.y), fminf(cmin.z, c.z));
+        cmax = vec3_make(fmaxf(cmax.x, c.x), fmaxf(cmax.y, c.y), fmaxf(cmax.z, c.z));
+    }
+    bvh->nodes.arr[node].min = min;
+    bvh->nodes.arr[node].max = max;
+
+    if (count <= HGL_RITA_BVH_LEAF_SIZE) {
+        return;
     }
+
+    /* partition the objects around the midpoint of the longest centroid axis */
+    Vec3 extent = vec3_sub(cmax, cmin);
+    int axis = (extent.x > extent.y) ? ((extent.x > extent.z) ? 0 : 2) : ((extent.y > extent.z) ? 1 : 2);
+    float mid = (axis == 0) ? 0.5f * (cmin.x + cmax.x) :
+                (axis == 1) ? 0.5f * (cmin.y + cmax.y) :
+                              0.5f * (cmin.z + cmax.z);
+    int n_left = 0;
+    for (int i = 0; i < count; i++) {
+        Vec3 c = centroids[objs[i]];
+        float v = (axis == 0) ? c.x : (axis == 1) ? c.y : c.z;
+        if (v < mid) {
+            int tmp = objs[i]; objs[i] = objs[n_left]; objs[n_left] = tmp;
+            n_left++;
+        }
+    }
+
+    /* all centroids (nearly) coincide. Split in half */
+    if (n_left == 0 || n_left == count) {
+        n_left = count / 2;
+    }
+
+    int left = bvh->nodes.length;
+    hgl_rita_buf_push(&bvh->nodes, (HglRitaBVHNode) {.first = first, .count = n_left});
+    hgl_rita_buf_push(&bvh->nodes, (HglRitaBVHNode) {.first = first + n_left, .count = count - n_left});
+    bvh->nodes.arr[node].first = left;
+    bvh->nodes.arr[node].count = 0;
+    hgl_rita_bvh_build_internal_(bvh, left, boxes, centroids);
+    hgl_rita_bvh_build_internal_(bvh, left + 1, boxes, centroids);
+}
+
+static inline void hgl_rita_bvh_cull_internal_(const HglRitaBVH *bvh, int node,
+                                               const Vec4 *planes, int n_planes,
+                                               bool inside, HglRitaIndexBuffer *visible)
+{
+    const HglRitaBVHNode *n = &bvh->nodes.arr[node];
+
+    if (!inside) {
+        int result = hgl_rita_box_frustum_test_internal_(planes, n_planes, n->min, n->max);
+        if (result == 0) {
+            return;
+        }
+        inside = (result == 2);
+    }
+
+    if (n->count > 0) {
+        for (int i = n->first; i < n->first + n->count; i++) {
+            const HglRitaBounds *b = &bvh->boxes.arr[i];
+            if (inside || hgl_rita_box_frustum_test_internal_(planes, n_planes, b->box.min, b->box.max) != 0) {
+                hgl_rita_buf_push(visible, bvh->objects.arr[i]);
+            }
+        }
+        return;
+    }
+
+    hgl_rita_bvh_cull_internal_(bvh, n->first, planes, n_planes, inside, visible);
+    hgl_rita_bvh_cull_internal_(bvh, n->first + 1, planes, n_planes, inside, visible);
 }
 
 static inline HglRitaFragment hgl_rita_frag_lerp_internal_(int x, int y, HglRitaFragment f0, HglRitaFragment f1, float t)
@@ -2923,6 +5922,11 @@ static inline int hgl_rita_next_vbuf_index_internal_(void)
     }
 }
 
+static inline int hgl_rita_vbuf_index_internal_(int i)
+{
+    return (hgl_rita_ctx__.vertices.mode == HGL_RITA_INDEXED) ? hgl_rita_ctx__.vertices.ibuf->arr[i] : i;
+}
+
 #endif /* HGL_RITA_IMPLEMENTATION */
 
 // TODO Better (lockless) queues
@@ -0,0 +1,1011 @@
+
+/**
+ * LICENSE:
+ *
+ * MIT License
+ *
+ * Copyright (c) 2025 Henrik A. Glass
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * MIT License
+ *
+ *
+ * ABOUT:
+ *
+ * hgl_rita_assets.h implements an asynchronous asset loader for hgl_rita.h. Wavefront
+ * OBJ meshes and images (anything stb_image.h can decode) are decoded in parallel on a
+ * worker pool, straight into the HglRitaVertexBuffer, HglRitaIndexBuffer and
+ * HglRitaTexture given by the caller.
+ *
+ * Input files are mmap'd, and read-ahead is requested as soon as a load is submitted,
+ * so the kernel is reading the next file while the workers are busy decoding the
+ * previous ones. Assets may also be loaded from memory the caller already has.
+ *
+ * Images are decoded one per worker, directly into the memory that becomes the
+ * texture's data buffer. OBJ files are split into ~HGL_RITA_ASSETS_CHUNK_SIZE byte
+ * chunks (at line boundaries) that are parsed in parallel in a few phases:
+ *
+ *     1. Every chunk counts its v/vt/vn lines and the triangles of its f lines.
+ *     2. Every chunk parses its v/vt/vn lines into place (the prefix sums of the
+ *        counts give each chunk its offsets).
+ *     3. Every chunk parses its f lines and writes its triangles straight into the
+ *        vertex buffer. Polygons are fan triangulated.
+ *     4. Every chunk orthonormalizes the tangents of its vertices (not with
+ *        HGL_RITA_SIMPLE).
+ *
+ * Finally, if an index buffer was given, the vertex soup is welded and optimized
+ * using `hgl_rita_mesh_optimize()`. The phases of different assets overlap freely.
+ *
+ * Vertices get the position (with w = 1), normal, texture coordinate and (per normal index
+ * accumulated) tangent from the OBJ file, and the diffuse color (Kd) of the last used
+ * material as color. If no material library can be found, the color is white.
+ *
+ *
+ * USAGE:
+ *
+ * hgl_rita_assets.h depends on hgl_rita.h, hgl_worker_pool.h and stb_image.h. Include
+ * it like this:
+ *
+ *     #define HGL_WORKER_POOL_IMPLEMENTATION
+ *     #include "hgl_worker_pool.h"
+ *     #define STB_IMAGE_IMPLEMENTATION
+ *     #include "stb_image.h"
+ *     #define HGL_RITA_IMPLEMENTATION
+ *     #include "hgl_rita.h"
+ *     #include "hgl_rita_assets.h"
+ *
+ * Submit any number of loads, then wait for all of them at once:
+ *
+ *     HglRitaAssetLoader *loader = hgl_rita_assets_create(0);
+ *     hgl_rita_assets_load_obj(loader, "assets/skull.obj", &skull_vbuf, &skull_ibuf);
+ *     hgl_rita_assets_load_texture(loader, "assets/skull.png", &skull_diffuse);
+ *     hgl_rita_assets_load_obj(loader, "assets/teapot.obj", &teapot_vbuf, &teapot_ibuf);
+ *     int n_failed = hgl_rita_assets_wait(loader);
+ *     hgl_rita_assets_destroy(loader);
+ *
+ * The buffers and textures must not be touched between the call to load them and
+ * the call to `hgl_rita_assets_wait()`. Buffers should be empty to begin with.
+ * Passing NULL as the index buffer leaves the vertex buffer as a vertex soup, to be
+ * drawn using HGL_RITA_ARRAY.
+ *
+ * Textures are HGL_RITA_RGBA8 and flipped vertically (i.e. the first row is the
+ * bottom of the image), unless `loader->flip_textures` is set to false. Their memory
+ * is allocated by stb_image, so STBI_MALLOC and HGL_RITA_FREE must be compatible for
+ * `hgl_rita_texture_destroy()` to work (they are by default).
+ *
+ * Note: `hgl_rita_assets_load_obj_from_memory()` has no path to resolve a material
+ *       library against. Its vertices are always white.
+ *
+ *
+ * EXAMPLES:
+ *
+ * See examples/rita_3d.c
+ *
+ *
+ * AUTHOR: Henrik A. Glass
+ *
+ */
+
+#ifndef HGL_RITA_ASSETS_H
+#define HGL_RITA_ASSETS_H
+
+#ifndef HGL_WORKER_POOL_H
+#  error "hgl_rita_assets.h requires hgl_worker_pool.h to be included first"
+#endif
+#ifndef STBI_INCLUDE_STB_IMAGE_H
+#  error "hgl_rita_assets.h requires stb_image.h to be included first"
+#endif
+
+#include <stdio.h>
+#include <ctype.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#ifndef HGL_RITA_ASSETS_CHUNK_SIZE
+#  define HGL_RITA_ASSETS_CHUNK_SIZE (1 << 20) /* Approximate number of bytes of an OBJ file parsed per job */
+#endif
+
+typedef struct
+{
+    HglWorkerPool *pool;
+    int n_workers;
+    int max_in_flight;       /* Submitting more assets than this blocks until one finishes. Keeps the job queue from filling up. */
+    bool flip_textures;      /* Vertically flip loaded textures. True by default */
+    pthread_mutex_t mutex;
+    pthread_cond_t cvar;
+    int n_in_flight;
+    int n_failed;
+} HglRitaAssetLoader;
+
+typedef struct
+{
+    const unsigned char *data;
+    size_t size;
+    bool is_mapped;
+    char *path;              /* NULL if loaded from memory */
+} HglRitaAssetSource;
+
+typedef struct
+{
+    HglRitaAssetLoader *loader;
+    HglRitaAssetSource src;
+    HglRitaTexture *tex;
+} HglRitaAssetTextureJob;
+
+typedef enum
+{
+    HGL_RITA_ASSETS_OBJ_COUNT,
+    HGL_RITA_ASSETS_OBJ_ATTRIBS,
+    HGL_RITA_ASSETS_OBJ_FACES,
+    HGL_RITA_ASSETS_OBJ_TANGENTS,
+} HglRitaAssetObjPhase;
+
+struct HglRitaAssetObjJob;
+
+typedef struct
+{
+    struct HglRitaAssetObjJob *obj;
+    const char *begin;
+    const char *end;
+    int n_v;                 /* Counted in phase 1 */
+    int n_vt;
+    int n_vn;
+    int n_tris;
+    int v_base;              /* Prefix sums of the above */
+    int vt_base;
+    int vn_base;
+    int tri_base;
+    const char *usemtl;      /* Name of the last material used in this chunk (not NUL-terminated) */
+    const char *mtllib;      /* Path of the last material library referenced in this chunk (not NUL-terminated) */
+} HglRitaAssetObjChunk;
+
+typedef struct HglRitaAssetObjJob
+{
+    HglRitaAssetLoader *loader;
+    HglRitaAssetSource src;
+    HglRitaVertexBuffer *vbuf;
+    HglRitaIndexBuffer *ibuf;
+    HglRitaAssetObjPhase phase;
+    HglRitaAssetObjChunk *chunks;
+    int n_chunks;
+    atomic_int n_remaining;  /* Number of chunks yet to finish the current phase */
+    atomic_int err;
+    int n_v;
+    int n_vt;
+    int n_vn;
+    int n_tris;
+    Vec3 *positions;
+    Vec2 *texcoords;
+    Vec3 *normals;
+#ifndef HGL_RITA_SIMPLE
+    Vec3 *face_tangents;     /* One per triangle */
+    int *normal_indices;     /* One per vertex. -1 if the vertex has no normal */
+    Vec3 *tangents;          /* One per normal */
+#endif
+    HglRitaColor color;
+} HglRitaAssetObjJob;
+
+static inline HglRitaAssetLoader *hgl_rita_assets_create(int n_workers);                  /* Creates an asset loader with `n_workers` worker threads (0 = one per processor). Returns NULL on error. */
+static inline int hgl_rita_assets_load_texture(HglRitaAssetLoader *loader, const char *path,
+                                               HglRitaTexture *tex);                      /* Submits the image at `path` to be decoded into `tex`. Returns -1 if the file couldn't be opened, 0 otherwise. */
+static inline int hgl_rita_assets_load_texture_from_memory(HglRitaAssetLoader *loader,
+                                                           const void *data, size_t size,
+                                                           HglRitaTexture *tex);          /* Submits the encoded image `data` to be decoded into `tex`. `data` must stay valid until `hgl_rita_assets_wait()` returns. Returns 0. */
+static inline int hgl_rita_assets_load_obj(HglRitaAssetLoader *loader, const char *path,
+                                           HglRitaVertexBuffer *vbuf,
+                                           HglRitaIndexBuffer *ibuf);                     /* Submits the OBJ file at `path` to be loaded into `vbuf` and `ibuf` (or only `vbuf`, as a vertex soup, if `ibuf` is NULL). Returns -1 if the file couldn't be opened, 0 otherwise. */
+static inline int hgl_rita_assets_load_obj_from_memory(HglRitaAssetLoader *loader,
+                                                       const void *data, size_t size,
+                                                       HglRitaVertexBuffer *vbuf,
+                                                       HglRitaIndexBuffer *ibuf);         /* Like `hgl_rita_assets_load_obj()`, but parses `data`. `data` must stay valid until `hgl_rita_assets_wait()` returns. Returns 0. */
+static inline int hgl_rita_assets_wait(HglRitaAssetLoader *loader);                       /* Blocks until all submitted assets are loaded. Returns the number of assets that failed to load since the last call. */
+static inline void hgl_rita_assets_destroy(HglRitaAssetLoader *loader);                   /* Waits for all submitted assets to load, then destroys `loader`. */
+
+static inline int hgl_rita_assets_map_internal_(const char *path, HglRitaAssetSource *src); /* Maps the file at `path` into memory and requests read-ahead of it. Returns -1 on error, 0 otherwise. */
+static inline void hgl_rita_assets_unmap_internal_(HglRitaAssetSource *src);             /* Unmaps (or forgets) `src`. */
+static inline void hgl_rita_assets_begin_internal_(HglRitaAssetLoader *loader);          /* Blocks while `loader` has `max_in_flight` assets in flight, then counts one more. */
+static inline void hgl_rita_assets_end_internal_(HglRitaAssetLoader *loader, bool failed); /* Counts one asset less in flight, and one more failure if `failed`. */
+static inline void hgl_rita_assets_texture_job_internal_(void *arg);                     /* Decodes a single texture. */
+static inline void hgl_rita_assets_obj_begin_job_internal_(void *arg);                   /* Splits an OBJ file into chunks and starts phase 1. */
+static inline void hgl_rita_assets_obj_chunk_job_internal_(void *arg);                   /* Runs the current phase on a single chunk. The last chunk to finish advances the OBJ to the next phase. */
+static inline void hgl_rita_assets_obj_advance_internal_(HglRitaAssetObjJob *obj);       /* Does the serial work in between two phases, and enqueues the next phase (or finishes the OBJ). */
+static inline void hgl_rita_assets_obj_enqueue_internal_(HglRitaAssetObjJob *obj);       /* Enqueues the current phase of every chunk. `obj` may be freed by the time it returns. */
+static inline void hgl_rita_assets_obj_finish_internal_(HglRitaAssetObjJob *obj);        /* Optimizes the mesh (if an index buffer was given) and frees the job. */
+static inline void hgl_rita_assets_obj_count_internal_(HglRitaAssetObjChunk *chunk);     /* Phase 1. */
+static inline void hgl_rita_assets_obj_attribs_internal_(HglRitaAssetObjChunk *chunk);   /* Phase 2. */
+static inline void hgl_rita_assets_obj_faces_internal_(HglRitaAssetObjChunk *chunk);     /* Phase 3. */
+static inline void hgl_rita_assets_obj_tangents_internal_(HglRitaAssetObjChunk *chunk);  /* Phase 4. */
+static inline HglRitaColor hgl_rita_assets_obj_material_color_internal_(HglRitaAssetObjJob *obj,
+                                                                        const char *mtllib,
+                                                                        const char *usemtl); /* Returns the diffuse color (Kd) of material `usemtl` (or of the last material if NULL) from the library `mtllib`, relative to the OBJ file. White on error. */
+static inline const char *hgl_rita_assets_next_line_internal_(const char *p, const char *end); /* Returns a pointer to the first character of the line after the one `p` is on. */
+static inline const char *hgl_rita_assets_skip_space_internal_(const char *p, const char *end); /* Skips spaces and tabs (but not newlines). */
+static inline const char *hgl_rita_assets_parse_float_internal_(const char *p, const char *end, float *out); /* Parses a decimal float at `p`. Returns a pointer past it. */
+static inline const char *hgl_rita_assets_parse_int_internal_(const char *p, const char *end, int *out); /* Parses a (signed) decimal integer at `p`. Returns a pointer past it. */
+static inline int hgl_rita_assets_count_corners_internal_(const char *p, const char *end); /* Returns the number of corners of the face on the f line `p` points into (after the 'f'). */
+
+#endif /* HGL_RITA_ASSETS_H */
+
+#ifdef HGL_RITA_IMPLEMENTATION
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static inline HglRitaAssetLoader *hgl_rita_assets_create(int n_workers)
+{
+    HglRitaAssetLoader *loader = HGL_RITA_ALLOC(sizeof(HglRitaAssetLoader));
+    if (loader == NULL) {
+        fprintf(stderr, "[hgl_rita_assets_create] Error: call to HGL_RITA_ALLOC returned NULL.\n");
+        return NULL;
+    }
+    memset(loader, 0, sizeof(*loader));
+
+    if (n_workers <= 0) {
+        n_workers = get_nprocs();
+    }
+    loader->n_workers     = n_workers;
+    loader->max_in_flight = 2 * n_workers;
+    loader->flip_textures = true;
+
+    /*
+     * Workers enqueue the jobs of the next phase of an OBJ themselves, so they must never
+     * block on a full job queue (they could end up waiting for each other). At most
+     * `n_workers` jobs per asset in flight are ever queued, so this is enough room.
+     */
+    uint32_t capacity = 2;
+    while (capacity < (uint32_t) (loader->max_in_flight * n_workers + 1)) {
+        capacity *= 2;
+    }
+    loader->pool = hgl_worker_pool_init(n_workers, capacity);
+    if (loader->pool == NULL) {
+        fprintf(stderr, "[hgl_rita_assets_create] Error: Failed to create the worker pool.\n");
+        HGL_RITA_FREE(loader);
+        return NULL;
+    }
+
+    pthread_mutex_init(&loader->mutex, NULL);
+    pthread_cond_init(&loader->cvar, NULL);
+    return loader;
+}
+
+static inline int hgl_rita_assets_load_texture(HglRitaAssetLoader *loader, const char *path,
+                                               HglRitaTexture *tex)
+{
+    HglRitaAssetSource src;
+    if (hgl_rita_assets_map_internal_(path, &src) != 0) {
+        return -1;
+    }
+
+    HglRitaAssetTextureJob *job = HGL_RITA_ALLOC(sizeof(HglRitaAssetTextureJob));
+    assert(job != NULL);
+    *job = (HglRitaAssetTextureJob) {.loader = loader, .src = src, .tex = tex};
+
+    hgl_rita_assets_begin_internal_(loader);
+    hgl_worker_pool_add_job(loader->pool, hgl_rita_assets_texture_job_internal_, job);
+    return 0;
+}
+
+static inline int hgl_rita_assets_load_texture_from_memory(HglRitaAssetLoader *loader,
+                                                           const void *data, size_t size,
+                                                           HglRitaTexture *tex)
+{
+    HglRitaAssetTextureJob *job = HGL_RITA_ALLOC(sizeof(HglRitaAssetTextureJob));
+    assert(job != NULL);
+    *job = (HglRitaAssetTextureJob) {
+        .loader = loader,
+        .src    = {.data = data, .size = size, .is_mapped = false, .path = NULL},
+        .tex    = tex,
+    };
+
+    hgl_rita_assets_begin_internal_(loader);
+    hgl_worker_pool_add_job(loader->pool, hgl_rita_assets_texture_job_internal_, job);
+    return 0;
+}
+
+static inline int hgl_rita_assets_load_obj(HglRitaAssetLoader *loader, const char *path,
+                                           HglRitaVertexBuffer *vbuf,
+                                           HglRitaIndexBuffer *ibuf)
+{
+    HglRitaAssetSource src;
+    if (hgl_rita_assets_map_internal_(path, &src) != 0) {
+        return -1;
+    }
+
+    HglRitaAssetObjJob *obj = HGL_RITA_ALLOC(sizeof(HglRitaAssetObjJob));
+    assert(obj != NULL);
+    memset(obj, 0, sizeof(*obj));
+    obj->loader = loader;
+    obj->src    = src;
+    obj->vbuf   = vbuf;
+    obj->ibuf   = ibuf;
+    assert((vbuf->length == 0) && "The vertex buffer should be empty");
+    assert((ibuf == NULL || ibuf->length == 0) && "The index buffer should be empty");
+
+    hgl_rita_assets_begin_internal_(loader);
+    hgl_worker_pool_add_job(loader->pool, hgl_rita_assets_obj_begin_job_internal_, obj);
+    return 0;
+}
+
+static inline int hgl_rita_assets_load_obj_from_memory(HglRitaAssetLoader *loader,
+                                                       const void *data, size_t size,
+                                                       HglRitaVertexBuffer *vbuf,
+                                                       HglRitaIndexBuffer *ibuf)
+{
+    HglRitaAssetObjJob *obj = HGL_RITA_ALLOC(sizeof(HglRitaAssetObjJob));
+    assert(obj != NULL);
+    memset(obj, 0, sizeof(*obj));
+    obj->loader = loader;
+    obj->src    = (HglRitaAssetSource) {.data = data, .size = size, .is_mapped = false, .path = NULL};
+    obj->vbuf   = vbuf;
+    obj->ibuf   = ibuf;
+    assert((vbuf->length == 0) && "The vertex buffer should be empty");
+    assert((ibuf == NULL || ibuf->length == 0) && "The index buffer should be empty");
+
+    hgl_rita_assets_begin_internal_(loader);
+    hgl_worker_pool_add_job(loader->pool, hgl_rita_assets_obj_begin_job_internal_, obj);
+    return 0;
+}
+
+static inline int hgl_rita_assets_wait(HglRitaAssetLoader *loader)
+{
+    pthread_mutex_lock(&loader->mutex);
+    while (loader->n_in_flight > 0) {
+        pthread_cond_wait(&loader->cvar, &loader->mutex);
+    }
+    int n_failed = loader->n_failed;
+    loader->n_failed = 0;
+    pthread_mutex_unlock(&loader->mutex);
+    return n_failed;
+}
+
+static inline void hgl_rita_assets_destroy(HglRitaAssetLoader *loader)
+{
+    hgl_rita_assets_wait(loader);
+    hgl_worker_pool_destroy(loader->pool);
+    pthread_mutex_destroy(&loader->mutex);
+    pthread_cond_destroy(&loader->cvar);
+    HGL_RITA_FREE(loader);
+}
+
+static inline int hgl_rita_assets_map_internal_(const char *path, HglRitaAssetSource *src)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "[hgl_rita_assets] Error: Failed to open `%s`.\n", path);
+        return -1;
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || sb.st_size == 0) {
+        fprintf(stderr, "[hgl_rita_assets] Error: `%s` is empty or not a regular file.\n", path);
+        close(fd);
+        return -1;
+    }
+
+    void *data = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "[hgl_rita_assets] Error: Failed to mmap `%s`.\n", path);
+        return -1;
+    }
+
+    /* start reading the file in the background, before a worker gets around to it */
+    madvise(data, sb.st_size, MADV_WILLNEED);
+
+    size_t path_len = strlen(path);
+    src->data      = data;
+    src->size      = sb.st_size;
+    src->is_mapped = true;
+    src->path      = HGL_RITA_ALLOC(path_len + 1);
+    assert(src->path != NULL);
+    memcpy(src->path, path, path_len + 1);
+    return 0;
+}
+
+static inline void hgl_rita_assets_unmap_internal_(HglRitaAssetSource *src)
+{
+    if (src->is_mapped) {
+        munmap((void *) src->data, src->size);
+    }
+    if (src->path != NULL) {
+        HGL_RITA_FREE(src->path);
+    }
+    src->data = NULL;
+    src->path = NULL;
+}
+
+static inline void hgl_rita_assets_begin_internal_(HglRitaAssetLoader *loader)
+{
+    pthread_mutex_lock(&loader->mutex);
+    while (loader->n_in_flight >= loader->max_in_flight) {
+        pthread_cond_wait(&loader->cvar, &loader->mutex);
+    }
+    loader->n_in_flight++;
+    pthread_mutex_unlock(&loader->mutex);
+}
+
+static inline void hgl_rita_assets_end_internal_(HglRitaAssetLoader *loader, bool failed)
+{
+    pthread_mutex_lock(&loader->mutex);
+    loader->n_in_flight--;
+    loader->n_failed += failed;
+    pthread_cond_broadcast(&loader->cvar);
+    pthread_mutex_unlock(&loader->mutex);
+}
+
+static inline void hgl_rita_assets_texture_job_internal_(void *arg)
+{
+    HglRitaAssetTextureJob *job = arg;
+    HglRitaAssetLoader *loader = job->loader;
+    HglRitaTexture *tex = job->tex;
+
+    /* decoded straight into the buffer that becomes the texture's data */
+    int n_channels;
+    memset(tex, 0, sizeof(*tex));
+    assert((job->src.size <= INT32_MAX) && "stb_image can't decode images this large");
+    tex->data.rgba8 = (HglRitaColor *) stbi_load_from_memory(job->src.data, (int) job->src.size,
+                                                             &tex->width, &tex->height,
+                                                             &n_channels, 4);
+    bool failed = (tex->data.rgba8 == NULL);
+    if (failed) {
+        fprintf(stderr, "[hgl_rita_assets] Error: Failed to decode `%s`: %s.\n",
+                (job->src.path != NULL) ? job->src.path : "<memory>", stbi_failure_reason());
+        memset(tex, 0, sizeof(*tex));
+    } else {
+        tex->stride = tex->width;
+        tex->format = HGL_RITA_RGBA8;
+        if (loader->flip_textures) {
+            hgl_rita_texture_flip_vertically(tex);
+        }
+    }
+
+    hgl_rita_assets_unmap_internal_(&job->src);
+    HGL_RITA_FREE(job);
+    hgl_rita_assets_end_internal_(loader, failed);
+}
+
+static inline void hgl_rita_assets_obj_begin_job_internal_(void *arg)
+{
+    HglRitaAssetObjJob *obj = arg;
+    const char *data = (const char *) obj->src.data;
+    const char *end = data + obj->src.size;
+
+    size_t n_chunks = obj->src.size / HGL_RITA_ASSETS_CHUNK_SIZE;
+    n_chunks = max(n_chunks, 1);
+    n_chunks = min(n_chunks, (size_t) obj->loader->n_workers);
+    obj->n_chunks = (int) n_chunks;
+    obj->chunks = HGL_RITA_ALLOC(n_chunks * sizeof(HglRitaAssetObjChunk));
+    assert(obj->chunks != NULL);
+    memset(obj->chunks, 0, n_chunks * sizeof(HglRitaAssetObjChunk));
+
+    /* every line belongs to the chunk it starts in */
+    const char *begin = data;
+    for (int i = 0; i < obj->n_chunks; i++) {
+        const char *split = data + (obj->src.size * (i + 1)) / n_chunks;
+        if (i == obj->n_chunks - 1) {
+            split = end;
+        } else if (split > begin) {
+            split = hgl_rita_assets_next_line_internal_(split - 1, end);
+        } else {
+            split = begin;
+        }
+        obj->chunks[i].obj   = obj;
+        obj->chunks[i].begin = begin;
+        obj->chunks[i].end   = split;
+        begin = split;
+    }
+
+    obj->phase = HGL_RITA_ASSETS_OBJ_COUNT;
+    hgl_rita_assets_obj_enqueue_internal_(obj);
+}
+
+static inline void hgl_rita_assets_obj_chunk_job_internal_(void *arg)
+{
+    HglRitaAssetObjChunk *chunk = arg;
+    HglRitaAssetObjJob *obj = chunk->obj;
+
+    switch (obj->phase) {
+        case HGL_RITA_ASSETS_OBJ_COUNT:    hgl_rita_assets_obj_count_internal_(chunk); break;
+        case HGL_RITA_ASSETS_OBJ_ATTRIBS:  hgl_rita_assets_obj_attribs_internal_(chunk); break;
+        case HGL_RITA_ASSETS_OBJ_FACES:    hgl_rita_assets_obj_faces_internal_(chunk); break;
+        case HGL_RITA_ASSETS_OBJ_TANGENTS: hgl_rita_assets_obj_tangents_internal_(chunk); break;
+    }
+
+    if (atomic_fetch_sub(&obj->n_remaining, 1) == 1) {
+        hgl_rita_assets_obj_advance_internal_(obj);
+    }
+}
+
+static inline void hgl_rita_assets_obj_advance_internal_(HglRitaAssetObjJob *obj)
+{
+    switch (obj->phase) {
+        case HGL_RITA_ASSETS_OBJ_COUNT: {
+            const char *mtllib = NULL;
+            const char *usemtl = NULL;
+            for (int i = 0; i < obj->n_chunks; i++) {
+                HglRitaAssetObjChunk *chunk = &obj->chunks[i];
+                chunk->v_base   = obj->n_v;
+                chunk->vt_base  = obj->n_vt;
+                chunk->vn_base  = obj->n_vn;
+                chunk->tri_base = obj->n_tris;
+                obj->n_v    += chunk->n_v;
+                obj->n_vt   += chunk->n_vt;
+                obj->n_vn   += chunk->n_vn;
+                obj->n_tris += chunk->n_tris;
+                mtllib = (chunk->mtllib != NULL) ? chunk->mtllib : mtllib;
+                usemtl = (chunk->usemtl != NULL) ? chunk->usemtl : usemtl;
+            }
+
+            obj->positions = HGL_RITA_ALLOC((obj->n_v + 1) * sizeof(Vec3));
+            obj->texcoords = HGL_RITA_ALLOC((obj->n_vt + 1) * sizeof(Vec2));
+            obj->normals   = HGL_RITA_ALLOC((obj->n_vn + 1) * sizeof(Vec3));
+            assert((obj->positions != NULL) && (obj->texcoords != NULL) && (obj->normals != NULL));
+            obj->positions[0] = vec3_make(0.0f, 0.0f, 0.0f); // stands in for invalid indices
+            obj->texcoords[0] = vec2_make(0.0f, 0.0f);
+            obj->normals[0]   = vec3_make(0.0f, 0.0f, 0.0f);
+#ifndef HGL_RITA_SIMPLE
+            obj->face_tangents  = HGL_RITA_ALLOC((obj->n_tris + 1) * sizeof(Vec3));
+            obj->normal_indices = HGL_RITA_ALLOC((3 * obj->n_tris + 1) * sizeof(int));
+            obj->tangents       = HGL_RITA_ALLOC((obj->n_vn + 1) * sizeof(Vec3));
+            assert((obj->face_tangents != NULL) && (obj->normal_indices != NULL) && (obj->tangents != NULL));
+#endif
+            hgl_rita_buf_reserve_exact(obj->vbuf, 3 * obj->n_tris);
+            assert((obj->n_tris == 0) || (obj->vbuf->arr != NULL));
+
+            obj->color = HGL_RITA_WHITE;
+            if (mtllib != NULL && obj->src.path != NULL) {
+                obj->color = hgl_rita_assets_obj_material_color_internal_(obj, mtllib, usemtl);
+            }
+
+            obj->phase = HGL_RITA_ASSETS_OBJ_ATTRIBS;
+        } break;
+
+        case HGL_RITA_ASSETS_OBJ_ATTRIBS: {
+            obj->phase = HGL_RITA_ASSETS_OBJ_FACES;
+        } break;
+
+        case HGL_RITA_ASSETS_OBJ_FACES: {
+#ifdef HGL_RITA_SIMPLE
+            hgl_rita_assets_obj_finish_internal_(obj);
+            return;
+#else
+            /* sum the tangents of all faces that share a normal */
+            memset(obj->tangents, 0, (obj->n_vn + 1) * sizeof(Vec3));
+            for (int i = 0; i < obj->n_tris; i++) {
+                for (int j = 0; j < 3; j++) {
+                    int n_idx = obj->normal_indices[3*i + j];
+                    if (n_idx >= 0) {
+                        obj->tangents[n_idx] = vec3_add(obj->tangents[n_idx], obj->face_tangents[i]);
+                    }
+                }
+            }
+            obj->phase = HGL_RITA_ASSETS_OBJ_TANGENTS;
+#endif
+        } break;
+
+        case HGL_RITA_ASSETS_OBJ_TANGENTS: {
+            hgl_rita_assets_obj_finish_internal_(obj);
+            return;
+        } break;
+    }
+
+    hgl_rita_assets_obj_enqueue_internal_(obj);
+}
+
+static inline void hgl_rita_assets_obj_enqueue_internal_(HglRitaAssetObjJob *obj)
+{
+    /*
+     * Once the first chunk is enqueued, the last chunk of the phase may finish the OBJ (and free `obj`)
+     * before this loop is done. So only locals may be touched after the store.
+     */
+    int n_chunks = obj->n_chunks;
+    HglWorkerPool *pool = obj->loader->pool;
+    HglRitaAssetObjChunk *chunks = obj->chunks;
+    atomic_store(&obj->n_remaining, n_chunks);
+    for (int i = 0; i < n_chunks; i++) {
+        hgl_worker_pool_add_job(pool, hgl_rita_assets_obj_chunk_job_internal_, &chunks[i]);
+    }
+}
+
+static inline void hgl_rita_assets_obj_finish_internal_(HglRitaAssetObjJob *obj)
+{
+    HglRitaAssetLoader *loader = obj->loader;
+    bool failed = (atomic_load(&obj->err) != 0);
+
+    if (failed) {
+        fprintf(stderr, "[hgl_rita_assets] Error: `%s` contains faces with invalid vertex indices.\n",
+                (obj->src.path != NULL) ? obj->src.path : "<memory>");
+        obj->vbuf->length = 0;
+    } else {
+        obj->vbuf->length = 3 * obj->n_tris;
+        if (obj->ibuf != NULL) {
+            /* weld the vertex soup & reorder it for vertex cache efficiency */
+            hgl_rita_mesh_optimize(obj->vbuf, obj->ibuf);
+        }
+    }
+
+    hgl_rita_assets_unmap_internal_(&obj->src);
+    HGL_RITA_FREE(obj->positions);
+    HGL_RITA_FREE(obj->texcoords);
+    HGL_RITA_FREE(obj->normals);
+#ifndef HGL_RITA_SIMPLE
+    HGL_RITA_FREE(obj->face_tangents);
+    HGL_RITA_FREE(obj->normal_indices);
+    HGL_RITA_FREE(obj->tangents);
+#endif
+    HGL_RITA_FREE(obj->chunks);
+    HGL_RITA_FREE(obj);
+    hgl_rita_assets_end_internal_(loader, failed);
+}
+
+static inline void hgl_rita_assets_obj_count_internal_(HglRitaAssetObjChunk *chunk)
+{
+    const char *end = chunk->end;
+    for (const char *p = chunk->begin; p < end; p = hgl_rita_assets_next_line_internal_(p, end)) {
+        p = hgl_rita_assets_skip_space_internal_(p, end);
+        if (end - p < 2) {
+            continue;
+        }
+        if (p[0] == 'v') {
+            if (p[1] == ' ' || p[1] == '\t') {
+                chunk->n_v++;
+            } else if (p[1] == 't') {
+                chunk->n_vt++;
+            } else if (p[1] == 'n') {
+                chunk->n_vn++;
+            }
+        } else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            int n_corners = hgl_rita_assets_count_corners_internal_(p + 1, end);
+            chunk->n_tris += max(n_corners - 2, 0);
+        } else if ((end - p > 7) && (memcmp(p, "usemtl", 6) == 0) && (p[6] == ' ' || p[6] == '\t')) {
+            chunk->usemtl = hgl_rita_assets_skip_space_internal_(p + 6, end);
+        } else if ((end - p > 7) && (memcmp(p, "mtllib", 6) == 0) && (p[6] == ' ' || p[6] == '\t')) {
+            chunk->mtllib = hgl_rita_assets_skip_space_internal_(p + 6, end);
+        }
+    }
+}
+
+static inline void hgl_rita_assets_obj_attribs_internal_(HglRitaAssetObjChunk *chunk)
+{
+    HglRitaAssetObjJob *obj = chunk->obj;
+    Vec3 *positions = &obj->positions[chunk->v_base + 1]; // OBJ indices are 1-based
+    Vec2 *texcoords = &obj->texcoords[chunk->vt_base + 1];
+    Vec3 *normals   = &obj->normals[chunk->vn_base + 1];
+
+    const char *end = chunk->end;
+    for (const char *p = chunk->begin; p < end; p = hgl_rita_assets_next_line_internal_(p, end)) {
+        p = hgl_rita_assets_skip_space_internal_(p, end);
+        if (end - p < 2 || p[0] != 'v') {
+            continue;
+        }
+        if (p[1] == ' ' || p[1] == '\t') {
+            Vec3 *v = positions++;
+            p = hgl_rita_assets_parse_float_internal_(p + 1, end, &v->x);
+            p = hgl_rita_assets_parse_float_internal_(p, end, &v->y);
+            p = hgl_rita_assets_parse_float_internal_(p, end, &v->z);
+        } else if (p[1] == 't') {
+            Vec2 *vt = texcoords++;
+            p = hgl_rita_assets_parse_float_internal_(p + 2, end, &vt->x);
+            p = hgl_rita_assets_parse_float_internal_(p, end, &vt->y);
+        } else if (p[1] == 'n') {
+            Vec3 *vn = normals++;
+            p = hgl_rita_assets_parse_float_internal_(p + 2, end, &vn->x);
+            p = hgl_rita_assets_parse_float_internal_(p, end, &vn->y);
+            p = hgl_rita_assets_parse_float_internal_(p, end, &vn->z);
+        }
+    }
+}
+
+static inline void hgl_rita_assets_obj_faces_internal_(HglRitaAssetObjChunk *chunk)
+{
+    HglRitaAssetObjJob *obj = chunk->obj;
+    HglRitaVertex *out = &obj->vbuf->arr[3 * chunk->tri_base];
+#ifndef HGL_RITA_SIMPLE
+    Vec3 *face_tangents = &obj->face_tangents[chunk->tri_base];
+    int *normal_indices = &obj->normal_indices[3 * chunk->tri_base];
+#endif
+
+    /* the number of attributes declared so far, for resolving negative (relative) indices */
+    int n_v  = chunk->v_base;
+    int n_vt = chunk->vt_base;
+    int n_vn = chunk->vn_base;
+
+    const char *end = chunk->end;
+    for (const char *p = chunk->begin; p < end; p = hgl_rita_assets_next_line_internal_(p, end)) {
+        p = hgl_rita_assets_skip_space_internal_(p, end);
+        if (end - p < 2) {
+            continue;
+        }
+        if (p[0] == 'v') {
+            n_v  += (p[1] == ' ' || p[1] == '\t');
+            n_vt += (p[1] == 't');
+            n_vn += (p[1] == 'n');
+            continue;
+        }
+        if (p[0] != 'f' || (p[1] != ' ' && p[1] != '\t')) {
+            continue;
+        }
+
+        /* fan triangulation: (0, 1, 2), (0, 2, 3), ... */
+        HglRitaVertex corners[3];
+        int corner_normals[3];
+        int n_corners = 0;
+        p = hgl_rita_assets_skip_space_internal_(p + 1, end);
+        while (p < end && *p != '\n' && *p != '\r' && *p != '#') {
+            int v_idx = 0, vt_idx = 0, vn_idx = 0;
+            p = hgl_rita_assets_parse_int_internal_(p, end, &v_idx);
+            if (p < end && *p == '/') {
+                p++;
+                if (p < end && *p != '/') {
+                    p = hgl_rita_assets_parse_int_internal_(p, end, &vt_idx);
+                }
+                if (p < end && *p == '/') {
+                    p = hgl_rita_assets_parse_int_internal_(p + 1, end, &vn_idx);
+                }
+            }
+            while (p < end && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') {
+                p++; // skip anything unexpected, so that the corner count agrees with phase 1
+            }
+            p = hgl_rita_assets_skip_space_internal_(p, end);
+
+            v_idx  = (v_idx  < 0) ? n_v  + v_idx  + 1 : v_idx;
+            vt_idx = (vt_idx < 0) ? n_vt + vt_idx + 1 : vt_idx;
+            vn_idx = (vn_idx < 0) ? n_vn + vn_idx + 1 : vn_idx;
+            if (v_idx <= 0 || v_idx > obj->n_v || vt_idx < 0 || vt_idx > obj->n_vt ||
+                vn_idx < 0 || vn_idx > obj->n_vn) {
+                atomic_store(&obj->err, 1);
+                v_idx = vt_idx = vn_idx = 0;
+            }
+
+            HglRitaVertex v = {0};
+            v.pos    = vec4_make(obj->positions[v_idx].x, obj->positions[v_idx].y, obj->positions[v_idx].z, 1.0f);
+            v.uv     = (vt_idx != 0) ? obj->texcoords[vt_idx] : vec2_make(0.0f, 0.0f);
+            v.normal = (vn_idx != 0) ? obj->normals[vn_idx] : vec3_make(0.0f, 0.0f, 0.0f);
+            v.color  = obj->color;
+
+            int slot = min(n_corners, 2);
+            corners[slot] = v;
+            corner_normals[slot] = (vn_idx != 0) ? vn_idx : -1;
+            if (++n_corners < 3) {
+                continue;
+            }
+
+            out[0] = corners[0];
+            out[1] = corners[1];
+            out[2] = corners[2];
+            out += 3;
+#ifndef HGL_RITA_SIMPLE
+            Vec3 e1 = vec3_sub(corners[1].pos.xyz, corners[0].pos.xyz);
+            Vec3 e2 = vec3_sub(corners[2].pos.xyz, corners[0].pos.xyz);
+            float s1 = corners[1].uv.x - corners[0].uv.x;
+            float s2 = corners[2].uv.x - corners[0].uv.x;
+            float t1 = corners[1].uv.y - corners[0].uv.y;
+            float t2 = corners[2].uv.y - corners[0].uv.y;
+            float det = s1 * t2 - s2 * t1;
+            Vec3 tan = vec3_make(0.0f, 0.0f, 0.0f);
+            if (det != 0.0f) {
+                tan = vec3_mul_scalar(vec3_sub(vec3_mul_scalar(e1, t2), vec3_mul_scalar(e2, t1)), 1.0f / det);
+            }
+            *face_tangents++ = tan;
+            *normal_indices++ = corner_normals[0];
+            *normal_indices++ = corner_normals[1];
+            *normal_indices++ = corner_normals[2];
+#endif
+            corners[1] = corners[2];
+            corner_normals[1] = corner_normals[2];
+        }
+    }
+}
+
+static inline void hgl_rita_assets_obj_tangents_internal_(HglRitaAssetObjChunk *chunk)
+{
+#ifdef HGL_RITA_SIMPLE
+    (void) chunk;
+#else
+    HglRitaAssetObjJob *obj = chunk->obj;
+    int begin = 3 * chunk->tri_base;
+    int end = begin + 3 * chunk->n_tris;
+    for (int i = begin; i < end; i++) {
+        int n_idx = obj->normal_indices[i];
+        if (n_idx < 0) {
+            continue;
+        }
+
+        /* Gram-Schmidt */
+        HglRitaVertex *v = &obj->vbuf->arr[i];
+        Vec3 tan = obj->tangents[n_idx];
+        tan = vec3_sub(tan, vec3_mul_scalar(v->normal, vec3_dot(v->normal, tan)));
+        float len = vec3_len(tan);
+        v->tangent = (len > 0.0f) ? vec3_mul_scalar(tan, 1.0f / len) : vec3_make(0.0f, 0.0f, 0.0f);
+    }
+#endif
+}
+
+static inline HglRitaColor hgl_rita_assets_obj_material_color_internal_(HglRitaAssetObjJob *obj,
+                                                                        const char *mtllib,
+                                                                        const char *usemtl)
+{
+    HglRitaColor color = HGL_RITA_WHITE;
+    const char *obj_end = (const char *) obj->src.data + obj->src.size;
+
+    /* the material library path is relative to the directory of the OBJ file */
+    char path[4096];
+    const char *slash = strrchr(obj->src.path, '/');
+    int dir_len = (slash != NULL) ? (int) (slash - obj->src.path + 1) : 0;
+    int name_len = 0;
+    while (mtllib + name_len < obj_end && mtllib[name_len] != '\n' && mtllib[name_len] != '\r') {
+        name_len++;
+    }
+    while (name_len > 0 && (mtllib[name_len - 1] == ' ' || mtllib[name_len - 1] == '\t')) {
+        name_len--;
+    }
+    if (dir_len + name_len + 1 > (int) sizeof(path)) {
+        return color;
+    }
+    memcpy(path, obj->src.path, dir_len);
+    memcpy(path + dir_len, mtllib, name_len);
+    path[dir_len + name_len] = '\0';
+
+    HglRitaAssetSource mtl;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return color; // a missing material library isn't an error
+    }
+    close(fd);
+    if (hgl_rita_assets_map_internal_(path, &mtl) != 0) {
+        return color;
+    }
+
+    int usemtl_len = 0;
+    if (usemtl != NULL) {
+        while (usemtl + usemtl_len < obj_end && usemtl[usemtl_len] != '\n' &&
+               usemtl[usemtl_len] != '\r' && usemtl[usemtl_len] != ' ' && usemtl[usemtl_len] != '\t') {
+            usemtl_len++;
+        }
+    }
+
+    /* use the Kd of material `usemtl`, or of the last material if no material was used */
+    const char *end = (const char *) mtl.data + mtl.size;
+    bool in_material = (usemtl == NULL);
+    for (const char *p = (const char *) mtl.data; p < end; p = hgl_rita_assets_next_line_internal_(p, end)) {
+        p = hgl_rita_assets_skip_space_internal_(p, end);
+        if ((end - p > 7) && (memcmp(p, "newmtl", 6) == 0) && (p[6] == ' ' || p[6] == '\t')) {
+            const char *name = hgl_rita_assets_skip_space_internal_(p + 6, end);
+            in_material = (usemtl == NULL) ||
+                          ((end - name >= usemtl_len) && (memcmp(name, usemtl, usemtl_len) == 0) &&
+                           (end - name == usemtl_len || isspace((unsigned char) name[usemtl_len])));
+        } else if (in_material && (end - p > 3) && p[0] == 'K' && p[1] == 'd' && (p[2] == ' ' || p[2] == '\t')) {
+            float kd[3];
+            p = hgl_rita_assets_parse_float_internal_(p + 2, end, &kd[0]);
+            p = hgl_rita_assets_parse_float_internal_(p, end, &kd[1]);
+            p = hgl_rita_assets_parse_float_internal_(p, end, &kd[2]);
+            color = (HglRitaColor) {
+                .r = kd[0] * 255,
+                .g = kd[1] * 255,
+                .b = kd[2] * 255,
+                .a = 255,
+            };
+        }
+    }
+
+    hgl_rita_assets_unmap_internal_(&mtl);
+    return color;
+}
+
+static inline const char *hgl_rita_assets_next_line_internal_(const char *p, const char *end)
+{
+    const char *nl = memchr(p, '\n', end - p);
+    return (nl != NULL) ? nl + 1 : end;
+}
+
+static inline const char *hgl_rita_assets_skip_space_internal_(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    return p;
+}
+
+static inline const char *hgl_rita_assets_parse_float_internal_(const char *p, const char *end, float *out)
+{
+    static const double pow10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+
+    p = hgl_rita_assets_skip_space_internal_(p, end);
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p++ == '-');
+    }
+
+    /* up to 19 significant digits fit in the mantissa. The rest only move the decimal point. */
+    uint64_t mantissa = 0;
+    int n_digits = 0;
+    int exponent = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        if (n_digits < 19) {
+            mantissa = 10 * mantissa + (*p - '0');
+            n_digits += (mantissa != 0);
+        } else {
+            exponent++;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+            if (n_digits < 19) {
+                mantissa = 10 * mantissa + (*p - '0');
+                n_digits += (mantissa != 0);
+                exponent--;
+            }
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        int e = 0;
+        p = hgl_rita_assets_parse_int_internal_(p + 1, end, &e);
+        exponent += e;
+    }
+
+    double value = (double) mantissa;
+    while (exponent > 22) {
+        value *= 1e22;
+        exponent -= 22;
+    }
+    while (exponent < -22) {
+        value /= 1e22;
+        exponent += 22;
+    }
+    value = (exponent >= 0) ? value * pow10[exponent] : value / pow10[-exponent];
+
+    *out = (float) (negative ? -value : value);
+    return p;
+}
+
+static inline const char *hgl_rita_assets_parse_int_internal_(const char *p, const char *end, int *out)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p++ == '-');
+    }
+    int value = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        value = 10 * value + (*p - '0');
+    }
+    *out = negative ? -value : value;
+    return p;
+}
+
+static inline int hgl_rita_assets_count_corners_internal_(const char *p, const char *end)
+{
+    int n_corners = 0;
+    p = hgl_rita_assets_skip_space_internal_(p, end);
+    while (p < end && *p != '\n' && *p != '\r' && *p != '#') {
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') {
+            p++;
+        }
+        p = hgl_rita_assets_skip_space_internal_(p, end);
+        n_corners++;
+    }
+    return n_corners;
+}
+
+#endif /* HGL_RITA_IMPLEMENTATION */
@@ -30,6 +30,14 @@
  *
  * hgl_rita_shaders.h contains a collection of ready-to-use shaders for hgl_rita.h.
  *
+ * Some of the fragment shaders also come in a batch variant (suffixed with _BATCH), which shades
+ * up to HGL_RITA_FRAG_BATCH_SIZE fragments per call. The batch variants transpose the fragments
+ * into arrays of floats (one per attribute) and do the lighting math on all lanes at once, in
+ * loops that the compiler can vectorize. They produce the same result as their regular
+ * counterparts, give or take rounding. Bind them using `hgl_rita_bind_frag_shader_batch()`:
+ *
+ *     hgl_rita_bind_frag_shader_batch(HGL_RITA_BLINN_PHONG_BATCH);
+ *
  * USAGE:
  *
  * See `hgl_rita.h`
@@ -71,6 +79,23 @@ static inline HglRitaColor HGL_RITA_DITHER_4X4_1BPP(const HglRitaContext *ctx, c
 static inline HglRitaColor HGL_RITA_DITHER_4X4_2BPP(const HglRitaContext *ctx, const HglRitaFragment *in);
 static inline HglRitaColor HGL_RITA_DITHER_4X4_3BPP(const HglRitaContext *ctx, const HglRitaFragment *in);
 
+/* batch fragment shaders */
+static inline void HGL_RITA_LAMBERT_DIFFUSE_BATCH(const HglRitaContext *ctx, const HglRitaFragment *in, HglRitaColor *out, int n);
+#ifndef HGL_RITA_SIMPLE
+static inline void HGL_RITA_PHONG_BATCH(const HglRitaContext *ctx, const HglRitaFragment *in, HglRitaColor *out, int n);
+static inline void HGL_RITA_BLINN_PHONG_BATCH(const HglRitaContext *ctx, const HglRitaFragment *in, HglRitaColor *out, int n);
+static inline void HGL_RITA_GOOCH_BATCH(const HglRitaContext *ctx, const HglRitaFragment *in, HglRitaColor *out, int n);
+#endif
+static inline void HGL_RITA_FOG_BATCH(const HglRitaContext *ctx, const HglRitaFragment *in, HglRitaColor *out, int n);
+static inline void HGL_RITA_DITHER_4X4_1BPP_BATCH(const HglRitaContext *ctx, const HglRitaFragment *in, HglRitaColor *out, int n);
+static inline void HGL_RITA_DITHER_4X4_2BPP_BATCH(const HglRitaContext *ctx, const HglRitaFragment *in, HglRitaColor *out, int n);
+static inline void HGL_RITA_DITHER_4X4_3BPP_BATCH(const HglRitaContext *ctx, const HglRitaFragment *in, HglRitaColor *out, int n);
+
+/* internal functions */
+static inline float hgl_rita_shaders_powi_internal_(float x, int e);                         /* x^e for a (constant) integer `e` >= 0. Unlike powf, this vectorizes. */
+static inline void hgl_rita_shaders_dither_batch_internal_(const HglRitaFragment *in, HglRitaColor *out, int n,
+                                                           float color_depth, float spread, float bias); /* Batched 4x4 bayer dithering */
+
 #endif /* HGL_RITA_SHADERS_H */
 
 #ifdef HGL_RITA_IMPLEMENTATION
@@ -126,7 +151,7 @@ static inline HglRitaVertex HGL_RITA_VERTEX_DIRECTIONAL_LIGHT_SHADER(const HglRi
     out.uv      = in->uv;
     out.color   = in->color;
 
-    Vec3 n = mat3_mul_vec3(ctx->tform.normals, in->normal);
+    Vec3 n = vec3_normalize(mat3_mul_vec3(ctx->tform.normals, in->normal));
     float light = 0.2f + 0.8f*clamp(0, 1, vec3_dot(n, vec3_normalize(vec3_make(1,1,1))));
     out.color = hgl_rita_color_mul_scalar(out.color, light);
     out.color.a = 255;
@@ -193,14 +218,14 @@ static inline HglRitaColor HGL_RITA_PHONG(const HglRitaContext *ctx, const HglRi
     Vec3 N  = in->world_normal;
 
     float shinyness = 0.5f;
-    float specular_exponent = 25.0f;
+    int specular_exponent = 25;
 
     HglRitaColor diffuse_color = in->color;
     HglRitaColor specular_color = HGL_RITA_WHITE;
 
     diffuse_color = hgl_rita_sample_unit_uv(HGL_RITA_TEX_DIFFUSE, in->uv);
     float diffuse_light = clamp(0.1f, 1.0f, fmaxf(0, vec3_dot(N, L))); // Lambertian
-    float specular_light = powf(fmaxf(0, vec3_dot(vec3_reflect(IV, N), L)), specular_exponent); // Phong
+    float specular_light = hgl_rita_shaders_powi_internal_(fmaxf(0, vec3_dot(vec3_reflect(IV, N), L)), specular_exponent); // Phong
 
     diffuse_color.r *= diffuse_light;
     diffuse_color.g *= diffuse_light;
@@ -221,14 +246,14 @@ static inline HglRitaColor HGL_RITA_BLINN_PHONG(const HglRitaContext *ctx, const
     Vec3 H = vec3_normalize(vec3_add(L, V)); // half vector (Blinn-Phong)
 
     float shinyness = 0.5f;
-    float specular_exponent = 70.0f;
+    int specular_exponent = 70;
 
     HglRitaColor diffuse_color = in->color;
     HglRitaColor specular_color = HGL_RITA_WHITE;
 
     diffuse_color = hgl_rita_sample_unit_uv(HGL_RITA_TEX_DIFFUSE, in->uv);
     float diffuse_light = clamp(0.1f, 1.0f, fmaxf(0, vec3_dot(N, L))); // Lambertian
-    float specular_light = powf(fmaxf(0, vec3_dot(H, N)), specular_exponent); // Blinn-Phong
+    float specular_light = hgl_rita_shaders_powi_internal_(fmaxf(0, vec3_dot(H, N)), specular_exponent); // Blinn-Phong
 
     diffuse_color.r *= diffuse_light;
     diffuse_color.g *= diffuse_light;
@@ -250,7 +275,7 @@ static inline HglRitaColor HGL_RITA_GOOCH(const HglRitaContext *ctx, const HglRi
     HglRitaColor cool_color = {  0,  60, 240, 255};
     HglRitaColor warm_color = {250, 140,  20, 255};
     float diffuse_light = vec3_dot(N, L) * 0.5f + 0.5f; // Lambertian
-    float specular_light = powf(fmaxf(0, vec3_dot(vec3_reflect(IV, N), L)), 15.0f); // Phong
+    float specular_light = hgl_rita_shaders_powi_internal_(fmaxf(0, vec3_dot(vec3_reflect(IV, N), L)), 15); // Phong
     return hgl_rita_color_add(hgl_rita_color_lerp(cool_color, warm_color, diffuse_light),
                               hgl_rita_color_mul_scalar(HGL_RITA_WHITE, specular_light));
 }
@@ -280,7 +305,7 @@ static inline HglRitaColor HGL_RITA_MONOCHROME(const HglRitaContext *ctx, const
 static inline HglRitaColor HGL_RITA_FOG(const HglRitaContext *ctx, const HglRitaFragment *in)
 {
     (void) ctx;
-    return hgl_rita_color_lerp(in->color, HGL_RITA_LIGHT_GRAY, powf(in->inv_z, 40));
+    return hgl_rita_color_lerp(in->color, HGL_RITA_LIGHT_GRAY, hgl_rita_shaders_powi_internal_(in->inv_z, 40));
 }
 
 static inline HglRitaColor HGL_RITA_DEPTH_BASED_BORDERS(const HglRitaContext *ctx, const HglRitaFragment *in)
@@ -393,4 +418,273 @@ static inline HglRitaColor HGL_RITA_DITHER_4X4_3BPP(const HglRitaContext *ctx, c
     };
 }
 
+/*--- Batch fragment shaders ------------------------------------------------------------*/
+
+#define HGL_RITA_N_LANES_ HGL_RITA_FRAG_BATCH_SIZE
+
+/* Lanes past `n` repeat lane 0, so the lane loops can always run over the full batch */
+#define HGL_RITA_LANE_(in, i, n) (&(in)[((i) < (n)) ? (i) : 0])
+
+static inline void HGL_RITA_LAMBERT_DIFFUSE_BATCH(const HglRitaContext *ctx, const HglRitaFragment *in, HglRitaColor *out, int n)
+{
+    (void) ctx;
+    Vec3 L = vec3_normalize(vec3_make(1,1,1));
+    float nx[HGL_RITA_N_LANES_], ny[HGL_RITA_N_LANES_], nz[HGL_RITA_N_LANES_];
+    float light[HGL_RITA_N_LANES_];
+
+    for (int i = 0; i < HGL_RITA_N_LANES_; i++) {
+        const HglRitaFragment *f = HGL_RITA_LANE_(in, i, n);
+        nx[i] = f->world_normal.x;
+        ny[i] = f->world_normal.y;
+        nz[i] = f->world_normal.z;
+    }
+
+    for (int i = 0; i < HGL_RITA_N_LANES_; i++) {
+        float d = nx[i]*L.x + ny[i]*L.y + nz[i]*L.z;
+        light[i] = 0.2f + 0.8f*fminf(fmaxf(d, 0.0f), 1.0f);
+    }
+
+    bool textured = (hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_DIFFUSE] != NULL);
+    for (int i = 0; i < n; i++) {
+        HglRitaColor color = in[i].color;
+        if (textured) {
+            color = hgl_rita_color_mul(color, hgl_rita_sample_unit_uv(HGL_RITA_TEX_DIFFUSE, in[i].uv));
+        }
+        color.r *= light[i];
+        color.g *= light[i];
+        color.b *= light[i];
+        out[i] = color;
+    }
+}
+
+#ifndef HGL_RITA_SIMPLE
+static inline void HGL_RITA_PHONG_BATCH(const HglRitaContext *ctx, const HglRitaFragment *in, HglRitaColor *out, int n)
+{
+    Vec3 L = vec3_normalize(vec3_make(1,1,1)); // light vector
+    Vec3 C = ctx->tform.camera.position;
+    float shinyness = 0.5f;
+
+    float nx[HGL_RITA_N_LANES_], ny[HGL_RITA_N_LANES_], nz[HGL_RITA_N_LANES_];
+    float vx[HGL_RITA_N_LANES_], vy[HGL_RITA_N_LANES_], vz[HGL_RITA_N_LANES_];
+    float diffuse_light[HGL_RITA_N_LANES_];
+    float specular_light[HGL_RITA_N_LANES_];
+
+    for (int i = 0; i < HGL_RITA_N_LANES_; i++) {
+        const HglRitaFragment *f = HGL_RITA_LANE_(in, i, n);
+        nx[i] = f->world_normal.x;
+        ny[i] = f->world_normal.y;
+        nz[i] = f->world_normal.z;
+        vx[i] = f->world_pos.x - C.x;
+        vy[i] = f->world_pos.y - C.y;
+        vz[i] = f->world_pos.z - C.z;
+    }
+
+    for (int i = 0; i < HGL_RITA_N_LANES_; i++) {
+        /* inverse view vector */
+        float ilen = 1.0f / sqrtf(vx[i]*vx[i] + vy[i]*vy[i] + vz[i]*vz[i]);
+        float ivx = vx[i]*ilen;
+        float ivy = vy[i]*ilen;
+        float ivz = vz[i]*ilen;
+
+        /* reflect about N */
+        float d = 2.0f*(ivx*nx[i] + ivy*ny[i] + ivz*nz[i]);
+        float rx = ivx - nx[i]*d;
+        float ry = ivy - ny[i]*d;
+        float rz = ivz - nz[i]*d;
+
+        float n_dot_l = nx[i]*L.x + ny[i]*L.y + nz[i]*L.z;
+        float r_dot_l = rx*L.x + ry*L.y + rz*L.z;
+        diffuse_light[i]  = fminf(fmaxf(n_dot_l, 0.1f), 1.0f); // Lambertian
+        specular_light[i] = 255.0f*shinyness*hgl_rita_shaders_powi_internal_(fmaxf(0.0f, r_dot_l), 25); // Phong
+    }
+
+    for (int i = 0; i < n; i++) {
+        HglRitaColor diffuse_color = hgl_rita_sample_unit_uv(HGL_RITA_TEX_DIFFUSE, in[i].uv);
+        diffuse_color.r *= diffuse_light[i];
+        diffuse_color.g *= diffuse_light[i];
+        diffuse_color.b *= diffuse_light[i];
+        uint8_t specular = specular_light[i];
+        out[i] = hgl_rita_color_add(diffuse_color, (HglRitaColor){specular, specular, specular, 255});
+    }
+}
+
+static inline void HGL_RITA_BLINN_PHONG_BATCH(const HglRitaContext *ctx, const HglRitaFragment *in, HglRitaColor *out, int n)
+{
+    Vec3 L = vec3_normalize(vec3_make(1,1,1));
+    Vec3 C = ctx->tform.camera.position;
+    float shinyness = 0.5f;
+
+    float nx[HGL_RITA_N_LANES_], ny[HGL_RITA_N_LANES_], nz[HGL_RITA_N_LANES_];
+    float vx[HGL_RITA_N_LANES_], vy[HGL_RITA_N_LANES_], vz[HGL_RITA_N_LANES_];
+    float diffuse_light[HGL_RITA_N_LANES_];
+    float specular_light[HGL_RITA_N_LANES_];
+
+    for (int i = 0; i < HGL_RITA_N_LANES_; i++) {
+        const HglRitaFragment *f = HGL_RITA_LANE_(in, i, n);
+        nx[i] = f->world_normal.x;
+        ny[i] = f->world_normal.y;
+        nz[i] = f->world_normal.z;
+        vx[i] = C.x - f->world_pos.x;
+        vy[i] = C.y - f->world_pos.y;
+        vz[i] = C.z - f->world_pos.z;
+    }
+
+    for (int i = 0; i < HGL_RITA_N_LANES_; i++) {
+        /* view vector */
+        float ilen = 1.0f / sqrtf(vx[i]*vx[i] + vy[i]*vy[i] + vz[i]*vz[i]);
+        float hx = L.x + vx[i]*ilen;
+        float hy = L.y + vy[i]*ilen;
+        float hz = L.z + vz[i]*ilen;
+
+        /* half vector (Blinn-Phong) */
+        float hilen = 1.0f / sqrtf(hx*hx + hy*hy + hz*hz);
+        hx *= hilen;
+        hy *= hilen;
+        hz *= hilen;
+
+        float n_dot_l = nx[i]*L.x + ny[i]*L.y + nz[i]*L.z;
+        float h_dot_n = hx*nx[i] + hy*ny[i] + hz*nz[i];
+        diffuse_light[i]  = fminf(fmaxf(n_dot_l, 0.1f), 1.0f); // Lambertian
+        specular_light[i] = 255.0f*shinyness*hgl_rita_shaders_powi_internal_(fmaxf(0.0f, h_dot_n), 70); // Blinn-Phong
+    }
+
+    for (int i = 0; i < n; i++) {
+        HglRitaColor diffuse_color = hgl_rita_sample_unit_uv(HGL_RITA_TEX_DIFFUSE, in[i].uv);
+        diffuse_color.r *= diffuse_light[i];
+        diffuse_color.g *= diffuse_light[i];
+        diffuse_color.b *= diffuse_light[i];
+        uint8_t specular = specular_light[i];
+        out[i] = hgl_rita_color_add(diffuse_color, (HglRitaColor){specular, specular, specular, 255});
+    }
+}
+
+static inline void HGL_RITA_GOOCH_BATCH(const HglRitaContext *ctx, const HglRitaFragment *in, HglRitaColor *out, int n)
+{
+    Vec3 L = vec3_normalize(vec3_make(1,1,1)); // light vector
+    Vec3 C = ctx->tform.camera.position;
+
+    HglRitaColor cool_color = {  0,  60, 240, 255};
+    HglRitaColor warm_color = {250, 140,  20, 255};
+
+    float nx[HGL_RITA_N_LANES_], ny[HGL_RITA_N_LANES_], nz[HGL_RITA_N_LANES_];
+    float vx[HGL_RITA_N_LANES_], vy[HGL_RITA_N_LANES_], vz[HGL_RITA_N_LANES_];
+    float diffuse_light[HGL_RITA_N_LANES_];
+    float specular_light[HGL_RITA_N_LANES_];
+
+    for (int i = 0; i < HGL_RITA_N_LANES_; i++) {
+        const HglRitaFragment *f = HGL_RITA_LANE_(in, i, n);
+        nx[i] = f->world_normal.x;
+        ny[i] = f->world_normal.y;
+        nz[i] = f->world_normal.z;
+        vx[i] = f->world_pos.x - C.x;
+        vy[i] = f->world_pos.y - C.y;
+        vz[i] = f->world_pos.z - C.z;
+    }
+
+    for (int i = 0; i < HGL_RITA_N_LANES_; i++) {
+        float ilen = 1.0f / sqrtf(vx[i]*vx[i] + vy[i]*vy[i] + vz[i]*vz[i]);
+        float ivx = vx[i]*ilen;
+        float ivy = vy[i]*ilen;
+        float ivz = vz[i]*ilen;
+        float d = 2.0f*(ivx*nx[i] + ivy*ny[i] + ivz*nz[i]);
+        float r_dot_l = (ivx - nx[i]*d)*L.x + (ivy - ny[i]*d)*L.y + (ivz - nz[i]*d)*L.z;
+        diffuse_light[i]  = (nx[i]*L.x + ny[i]*L.y + nz[i]*L.z) * 0.5f + 0.5f; // Lambertian
+        specular_light[i] = 255.0f*hgl_rita_shaders_powi_internal_(fmaxf(0.0f, r_dot_l), 15); // Phong
+    }
+
+    for (int i = 0; i < n; i++) {
+        uint8_t specular = fminf(specular_light[i], 255.0f);
+        out[i] = hgl_rita_color_add(hgl_rita_color_lerp(cool_color, warm_color, diffuse_light[i]),
+                                    (HglRitaColor){specular, specular, specular, specular});
+    }
+}
+#endif
+
+static inline void HGL_RITA_FOG_BATCH(const HglRitaContext *ctx, const HglRitaFragment *in, HglRitaColor *out, int n)
+{
+    (void) ctx;
+    float t[HGL_RITA_N_LANES_];
+    for (int i = 0; i < HGL_RITA_N_LANES_; i++) {
+        t[i] = HGL_RITA_LANE_(in, i, n)->inv_z;
+    }
+    for (int i = 0; i < HGL_RITA_N_LANES_; i++) {
+        t[i] = hgl_rita_shaders_powi_internal_(t[i], 40);
+    }
+    for (int i = 0; i < n; i++) {
+        out[i] = hgl_rita_color_lerp(in[i].color, HGL_RITA_LIGHT_GRAY, t[i]);
+    }
+}
+
+static inline void HGL_RITA_DITHER_4X4_1BPP_BATCH(const HglRitaContext *ctx, const HglRitaFragment *in, HglRitaColor *out, int n)
+{
+    (void) ctx;
+    hgl_rita_shaders_dither_batch_internal_(in, out, n, 1.0f, 1.0f, -0.1f);
+}
+
+static inline void HGL_RITA_DITHER_4X4_2BPP_BATCH(const HglRitaContext *ctx, const HglRitaFragment *in, HglRitaColor *out, int n)
+{
+    (void) ctx;
+    hgl_rita_shaders_dither_batch_internal_(in, out, n, 2.0f, 0.7f, -0.2f);
+}
+
+static inline void HGL_RITA_DITHER_4X4_3BPP_BATCH(const HglRitaContext *ctx, const HglRitaFragment *in, HglRitaColor *out, int n)
+{
+    (void) ctx;
+    hgl_rita_shaders_dither_batch_internal_(in, out, n, 3.0f, 0.7f, -0.2f);
+}
+
+static inline float hgl_rita_shaders_powi_internal_(float x, int e)
+{
+    float result = 1.0f;
+    while (e > 0) {
+        if (e & 1) result *= x;
+        x *= x;
+        e >>= 1;
+    }
+    return result;
+}
+
+static inline void hgl_rita_shaders_dither_batch_internal_(const HglRitaFragment *in, HglRitaColor *out, int n,
+                                                           float color_depth, float spread, float bias)
+{
+    const float bayer4x4[4][4] = {
+        {0,   8,  2, 10},
+        {12,  4, 14,  6},
+        {3,  11,  1,  9},
+        {15,  7, 13,  5},
+    };
+    int n_colors = powf(2, color_depth);
+    float levels = (float) (n_colors - 1);
+
+    float r[HGL_RITA_N_LANES_], g[HGL_RITA_N_LANES_], b[HGL_RITA_N_LANES_], M[HGL_RITA_N_LANES_];
+    for (int i = 0; i < HGL_RITA_N_LANES_; i++) {
+        const HglRitaFragment *f = HGL_RITA_LANE_(in, i, n);
+        r[i] = f->color.r;
+        g[i] = f->color.g;
+        b[i] = f->color.b;
+        M[i] = (1.0f/16.0f)*bayer4x4[f->y & 3][f->x & 3] - 0.5f;
+    }
+
+    for (int i = 0; i < HGL_RITA_N_LANES_; i++) {
+        r[i] = fminf(fmaxf(r[i]/255.0f + spread*M[i] + bias, 0.0f), 1.0f);
+        g[i] = fminf(fmaxf(g[i]/255.0f + spread*M[i] + bias, 0.0f), 1.0f);
+        b[i] = fminf(fmaxf(b[i]/255.0f + spread*M[i] + bias, 0.0f), 1.0f);
+        r[i] = floorf(r[i] * levels + 0.5f) / levels;
+        g[i] = floorf(g[i] * levels + 0.5f) / levels;
+        b[i] = floorf(b[i] * levels + 0.5f) / levels;
+    }
+
+    for (int i = 0; i < n; i++) {
+        out[i] = (HglRitaColor) {
+            .r = 255 * r[i],
+            .g = 255 * g[i],
+            .b = 255 * b[i],
+            .a = 255,
+        };
+    }
+}
+
+#undef HGL_RITA_LANE_
+#undef HGL_RITA_N_LANES_
+
 #endif
@@ -0,0 +1,297 @@
+
+/**
+ * LICENSE:
+ *
+ * MIT License
+ *
+ * Copyright (c) 2025 Henrik A. Glass
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * MIT License
+ *
+ *
+ * ABOUT:
+ *
+ * hgl_rita_stream.h implements a headless output stage for hgl_rita.h. Finished
+ * frames are streamed to a file or a pipe as raw RGBA8 frames or netpbm (PAM/PPM)
+ * frames, without the need for a display.
+ *
+ * The stream owns two color framebuffers. After a call to `hgl_rita_stream_submit()`
+ * the finished framebuffer is handed off to a writer thread, and the other
+ * framebuffer is bound as the current HGL_RITA_TEX_FRAME_BUFFER. Thus frame N is
+ * written while frame N+1 is rendered by the tile threads. For the raw and PAM
+ * formats the framebuffer memory is written as-is, i.e. no format conversion or
+ * intermediate copy takes place.
+ *
+ *
+ * USAGE:
+ *
+ * hgl_rita_stream.h depends on hgl_rita.h and hgl_io.h. Include it like this:
+ *
+ *     #define HGL_IO_IMPLEMENTATION
+ *     #include "hgl_io.h"
+ *     #define HGL_RITA_IMPLEMENTATION
+ *     #include "hgl_rita.h"
+ *     #include "hgl_rita_stream.h"
+ *
+ * `path` may be a regular file path, "-" for stdout, or a shell command prefixed
+ * with '|' to which the frames are piped. E.g.:
+ *
+ *     HglRitaStream *stream = hgl_rita_stream_open("|ffmpeg -y -f pam_pipe -i - out.mp4",
+ *                                                  HGL_RITA_STREAM_PAM, WIDTH, HEIGHT);
+ *     hgl_rita_bind_texture(HGL_RITA_TEX_DEPTH_BUFFER, &fb_depth);
+ *     for (int i = 0; i < n_frames; i++) {
+ *         hgl_rita_clear(HGL_RITA_COLOR | HGL_RITA_DEPTH);
+ *         hgl_rita_draw(HGL_RITA_TRIANGLES);
+ *         hgl_rita_stream_submit(stream);
+ *     }
+ *     hgl_rita_stream_close(stream);
+ *
+ * Note: Don't rebind HGL_RITA_TEX_FRAME_BUFFER while a stream is open. If you need
+ *       to access the framebuffer currently being rendered to (e.g. as the source
+ *       texture of a blit), use `hgl_rita_stream_framebuffer()`.
+ *
+ *
+ * EXAMPLES:
+ *
+ * See examples/rita_headless.c
+ *
+ *
+ * AUTHOR: Henrik A. Glass
+ *
+ */
+
+#ifndef HGL_RITA_STREAM_H
+#define HGL_RITA_STREAM_H
+
+#ifndef HGL_IO_H
+#  error "hgl_rita_stream.h requires hgl_io.h to be included first"
+#endif
+
+#include <stdio.h>
+#include <pthread.h>
+
+typedef enum
+{
+    HGL_RITA_STREAM_RAW_RGBA, /* Headerless RGBA8 frames back to back (e.g. `ffmpeg -f rawvideo -pix_fmt rgba -s WxH -i -`). Zero-copy. */
+    HGL_RITA_STREAM_PAM,      /* Netpbm P7 (RGB_ALPHA) frames (e.g. `ffmpeg -f pam_pipe -i -`). Zero-copy. */
+    HGL_RITA_STREAM_PPM,      /* Netpbm P6 frames. The alpha channel is dropped, which requires a conversion on the writer thread. */
+} HglRitaStreamFormat;
+
+typedef struct
+{
+    FILE *fp;
+    bool is_pipe;
+    HglRitaStreamFormat format;
+    HglRitaTexture fb[2];
+    int back;                /* Index of the framebuffer currently being rendered to */
+    pthread_t writer;
+    pthread_mutex_t mutex;
+    pthread_cond_t cvar;
+    HglRitaTexture *pending; /* Framebuffer owned by the writer thread. NULL when the writer is idle */
+    bool terminate;
+    int err;
+    uint64_t n_frames;
+} HglRitaStream;
+
+static inline HglRitaStream *hgl_rita_stream_open(const char *path, HglRitaStreamFormat format,
+                                                  int width, int height);    /* Opens a stream to `path` ("-" for stdout, "|cmd" to pipe to `cmd`), creates two framebuffers of size `width` x `height`, and binds one of them. Returns NULL on error. */
+static inline void hgl_rita_stream_submit(HglRitaStream *stream);            /* Waits for the current frame to finish rendering, hands it off to the writer thread, and binds the other framebuffer. */
+static inline HglRitaTexture *hgl_rita_stream_framebuffer(HglRitaStream *stream); /* Returns the framebuffer currently being rendered to. */
+static inline uint64_t hgl_rita_stream_n_frames(HglRitaStream *stream);      /* Returns the number of frames written so far. */
+static inline int hgl_rita_stream_close(HglRitaStream *stream);              /* Flushes any pending frame, closes the stream, and frees its framebuffers. Returns -1 if any write failed, 0 otherwise. */
+
+static inline void *hgl_rita_stream_writer_thread_internal_(void *arg);      /* Main loop of the writer thread. Writes each handed-off framebuffer to the stream. */
+static inline int hgl_rita_stream_write_frame_internal_(HglRitaStream *stream, HglRitaTexture *tex); /* Writes a single frame `tex` to the stream in the selected format. Returns -1 on error, 0 otherwise. */
+
+#endif /* HGL_RITA_STREAM_H */
+
+#ifdef HGL_RITA_IMPLEMENTATION
+
+static inline HglRitaStream *hgl_rita_stream_open(const char *path, HglRitaStreamFormat format,
+                                                  int width, int height)
+{
+    HglRitaStream *stream = HGL_RITA_ALLOC(sizeof(HglRitaStream));
+    if (stream == NULL) {
+        fprintf(stderr, "[hgl_rita_stream_open] Error: call to HGL_RITA_ALLOC returned NULL.\n");
+        return NULL;
+    }
+    memset(stream, 0, sizeof(*stream));
+    stream->format = format;
+
+    if (strcmp(path, "-") == 0) {
+        stream->fp = stdout;
+    } else if (path[0] == '|') {
+        stream->fp = popen(path + 1, "w");
+        stream->is_pipe = true;
+    } else {
+        stream->fp = fopen(path, "wb");
+    }
+
+    if (stream->fp == NULL) {
+        fprintf(stderr, "[hgl_rita_stream_open] Error: errno=%s\n", strerror(errno));
+        HGL_RITA_FREE(stream);
+        return NULL;
+    }
+
+    stream->fb[0] = hgl_rita_texture_make(width, height, HGL_RITA_RGBA8);
+    stream->fb[1] = hgl_rita_texture_make(width, height, HGL_RITA_RGBA8);
+    stream->back  = 0;
+
+    pthread_mutex_init(&stream->mutex, NULL);
+    pthread_cond_init(&stream->cvar, NULL);
+    pthread_create(&stream->writer, NULL, hgl_rita_stream_writer_thread_internal_, stream);
+
+    hgl_rita_bind_texture(HGL_RITA_TEX_FRAME_BUFFER, &stream->fb[stream->back]);
+    return stream;
+}
+
+static inline void hgl_rita_stream_submit(HglRitaStream *stream)
+{
+    /* wait until frame N has been rendered */
+    hgl_rita_finish();
+
+    /* wait until the writer is done with frame N - 1, then hand off frame N */
+    pthread_mutex_lock(&stream->mutex);
+    while (stream->pending != NULL) {
+        pthread_cond_wait(&stream->cvar, &stream->mutex);
+    }
+    stream->pending = &stream->fb[stream->back];
+    pthread_cond_broadcast(&stream->cvar);
+    pthread_mutex_unlock(&stream->mutex);
+
+    /* render frame N + 1 into the other framebuffer (no respawn, same size) */
+    stream->back ^= 1;
+    hgl_rita_bind_texture(HGL_RITA_TEX_FRAME_BUFFER, &stream->fb[stream->back]);
+}
+
+static inline HglRitaTexture *hgl_rita_stream_framebuffer(HglRitaStream *stream)
+{
+    return &stream->fb[stream->back];
+}
+
+static inline uint64_t hgl_rita_stream_n_frames(HglRitaStream *stream)
+{
+    pthread_mutex_lock(&stream->mutex);
+    uint64_t n_frames = stream->n_frames;
+    pthread_mutex_unlock(&stream->mutex);
+    return n_frames;
+}
+
+static inline int hgl_rita_stream_close(HglRitaStream *stream)
+{
+    hgl_rita_finish();
+
+    /* let the writer drain the last frame, then terminate it */
+    pthread_mutex_lock(&stream->mutex);
+    stream->terminate = true;
+    pthread_cond_broadcast(&stream->cvar);
+    pthread_mutex_unlock(&stream->mutex);
+    pthread_join(stream->writer, NULL);
+
+    int err = stream->err;
+    if (stream->is_pipe) {
+        if (pclose(stream->fp) != 0) err = -1;
+    } else if (stream->fp == stdout) {
+        if (fflush(stream->fp) != 0) err = -1;
+    } else {
+        if (fclose(stream->fp) != 0) err = -1;
+    }
+
+    /* don't leave a dangling framebuffer bound */
+    if (hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER] == &stream->fb[stream->back]) {
+        hgl_rita_ctx__.tex_unit[HGL_RITA_TEX_FRAME_BUFFER] = NULL;
+    }
+
+    pthread_cond_destroy(&stream->cvar);
+    pthread_mutex_destroy(&stream->mutex);
+    hgl_rita_texture_destroy(&stream->fb[0]);
+    hgl_rita_texture_destroy(&stream->fb[1]);
+    HGL_RITA_FREE(stream);
+    return err;
+}
+
+static inline void *hgl_rita_stream_writer_thread_internal_(void *arg)
+{
+    HglRitaStream *stream = (HglRitaStream *) arg;
+
+    pthread_mutex_lock(&stream->mutex);
+    while (true) {
+        while ((stream->pending == NULL) && !stream->terminate) {
+            pthread_cond_wait(&stream->cvar, &stream->mutex);
+        }
+        if (stream->pending == NULL) {
+            break; // terminate & drained
+        }
+
+        /* write outside the lock, so the render thread can queue up the next frame */
+        HglRitaTexture *tex = stream->pending;
+        pthread_mutex_unlock(&stream->mutex);
+        int err = hgl_rita_stream_write_frame_internal_(stream, tex);
+        pthread_mutex_lock(&stream->mutex);
+
+        if (err != 0) {
+            stream->err = -1;
+        }
+        stream->n_frames++;
+        stream->pending = NULL;
+        pthread_cond_broadcast(&stream->cvar);
+    }
+    pthread_mutex_unlock(&stream->mutex);
+
+    return NULL;
+}
+
+static inline int hgl_rita_stream_write_frame_internal_(HglRitaStream *stream, HglRitaTexture *tex)
+{
+    assert(tex->stride == tex->width);
+
+    HglImage image = (HglImage) {
+        .data   = (uint8_t *) tex->data.rgba8,
+        .width  = (size_t) tex->width,
+        .height = (size_t) tex->height,
+        .format = HGL_IO_PIXEL_FORMAT_RGBA8,
+    };
+
+    int err = 0;
+    switch (stream->format) {
+        case HGL_RITA_STREAM_RAW_RGBA: {
+            size_t n_pixels = image.width * image.height;
+            if (fwrite(image.data, sizeof(HglRitaColor), n_pixels, stream->fp) != n_pixels) {
+                err = -1;
+            }
+        } break;
+        case HGL_RITA_STREAM_PAM: {
+            err = hgl_io_image_fwrite_pam(stream->fp, &image);
+        } break;
+        case HGL_RITA_STREAM_PPM: {
+            err = hgl_io_image_fwrite_netpbm(stream->fp, &image);
+        } break;
+    }
+
+    /* push the frame down the pipe, so consumers don't stall on a partial frame */
+    if (fflush(stream->fp) != 0) {
+        err = -1;
+    }
+
+    return err;
+}
+
+#endif /* HGL_RITA_IMPLEMENTATION */
+
@@ -43,6 +43,73 @@
  *
  *     #include "hglm_aliases.h"
  *
+ * If HGLM_USE_SIMD is defined, SSE/AVX intrinsics are used where possible. When
+ * compiled with AVX and FMA enabled (e.g. -mavx2 -mfma or -march=native),
+ * `hglm_mat_mul_mat` uses an 8-wide FMA micro-kernel.
+ *
+ * The `_array` and `_soa` functions (e.g. `hglm_mat4_mul_vec4_array`) operate
+ * on whole arrays of vectors, in AoS and SoA (HglmVec3SoA/HglmVec4SoA) layout
+ * respectively. With HGLM_USE_SIMD and AVX enabled, 8 vectors are processed at
+ * a time.
+ *
+ * `hglm_frustum_make_from_mat4` extracts the 6 planes of a view frustum from a
+ * (projection * view) matrix. The `_soa` culling tests (e.g. `hglm_frustum_test_aabb_soa`)
+ * test whole arrays of AABBs or spheres against a frustum, or AABBs against a ray, and
+ * write the results as a bitmask (read with `hglm_mask_test`), 8 volumes per iteration
+ * with AVX.
+ *
+ * HglmQuat is a unit quaternion (x, y, z = vector part, w = scalar part) for
+ * rotations. `hglm_quat_make_rotation(angle, axis)` rotates the same way as
+ * `hglm_mat4_make_rotation(angle, axis)`. `hglm_skin_linear_array` and
+ * `hglm_skin_dualquat_array` skin whole vertex arrays with up to 4 joints per
+ * vertex, given per-joint matrices or dual quaternions respectively.
+ *
+ * If HGLM_USE_DISPATCH is defined (x86 only), `hglm_mat_mul_mat` and the batch
+ * functions pick between scalar, SSE4, AVX2 and AVX-512 implementations at
+ * runtime, based on what the CPU supports (see `hglm_cpu_level`). No -m flags
+ * are needed, so the same binary runs on any x86 machine. For testing and
+ * benchmarking, `hglm_cpu_level_set` lowers the level that is used.
+ *
+ * The `hglm_fast_` functions (e.g. `hglm_fast_sin`, `hglm_fast_pow`) are
+ * polynomial approximations of their libm counterparts, with the error bounds
+ * documented next to each prototype. The scalar versions are plain C, so they
+ * inline and auto-vectorize in loops (exp, exp2 and pow only with -ffast-math).
+ * The `_array` versions process 8 values at a time with AVX2 (compile-time or
+ * HGLM_USE_DISPATCH). If HGLM_USE_FAST_MATH is defined, the vector normalize
+ * and slerp functions use them as well.
+ *
+ * Arbitrary size matrices (HglmMat) are allocated with HGLM_ALLOC/HGLM_FREE by
+ * `hglm_mat_make`, or through a HglmMatAllocator by `hglm_mat_make_with`. E.g. to
+ * place temporaries in an hgl_alloc.h arena (`free` is left NULL, since arenas are
+ * reset all at once with `hgl_free_all`):
+ *
+ *     static void *arena_alloc(void *ctx, size_t size) { return hgl_alloc(ctx, size); }
+ *     HglmMatAllocator a = {.alloc = arena_alloc, .free = NULL, .ctx = &arena};
+ *     HglmMat tmp = hglm_mat_make_with(64, 64, &a);
+ *
+ * `hglm_mat_view(m, row, col, M, N)` returns the MxN submatrix of `m` starting at
+ * (row, col). Views share the storage of `m` (rows are `m.stride` floats apart),
+ * and work as input or output to all the `hglm_mat_` functions. `hglm_mat_make_from`
+ * wraps existing storage in the same way. Calling `hglm_mat_free` on a view or on
+ * wrapped storage does nothing. A `stride` of 0 means N (tightly packed rows), so
+ * brace-initialized matrices like `(HglmMat){.data = buf, .M = 2, .N = 3}` work too.
+ *
+ * `hglm_mat_lu` (partial pivoting) and `hglm_mat_cholesky` factor a square HglmMat
+ * in place, and `hglm_mat_lu_solve`/`hglm_mat_cholesky_solve` then solve for any
+ * number of right-hand sides (the columns of `b`, overwritten with the solution).
+ * Both are blocked, so most of the work runs through the `hglm_mat_mul_mat` kernels.
+ * They return non-zero if the matrix is singular or not positive definite.
+ *
+ * HglmSpMat is a sparse matrix in compressed sparse row (CSR) format, built from
+ * (row, col, value) triplets with `hglm_spmat_make_from_triplets`. Its transpose
+ * (`hglm_spmat_transpose`) doubles as the CSC format of the original matrix.
+ * `hglm_spmat_mul_vec` gathers 8 nonzeros at a time with AVX2 (compile-time or
+ * HGLM_USE_DISPATCH).
+ *
+ * If HGLM_USE_THREADS is defined, large products in `hglm_mat_mul_mat` (and in the
+ * factorizations), `hglm_spmat_mul_vec` and `hglm_spmat_mul_mat` are split by rows
+ * across one thread per processor. Requires pthreads (-lpthread).
+ *
  *
  * EXAMPLE:
  *
@@ -70,6 +137,7 @@
 #define HGLM_H
 
 #include <math.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include <assert.h> // DEBUG
@@ -92,6 +160,54 @@
 #   include <immintrin.h>
 #endif
 
+#ifdef HGLM_USE_THREADS
+#   include <pthread.h>
+#   include <sys/sysinfo.h>
+#endif
+
+#if defined(HGLM_USE_DISPATCH) && (defined(__x86_64__) || defined(__i386__))
+#   include <immintrin.h>
+#   define HGLM_DISPATCH_
+#endif
+
+/* 8/16-wide paths: picked at runtime with HGLM_USE_DISPATCH, or at compile time with HGLM_USE_SIMD + AVX(-512F) */
+#if defined(HGLM_DISPATCH_)
+#   define HGLM_X8_
+#   define HGLM_X16_
+#   define HGLM_X8_ENABLED_    (hglm_cpu_level() >= HGLM_CPU_AVX2)
+#   define HGLM_TARGET_SSE4_   __attribute__ ((target("sse4.1")))
+#   define HGLM_TARGET_AVX2_   __attribute__ ((target("avx2,fma")))
+#   define HGLM_TARGET_AVX512_ __attribute__ ((target("avx512f,avx2,fma")))
+#elif defined(HGLM_USE_SIMD) && defined(__AVX__)
+#   define HGLM_X8_
+#   define HGLM_X8_ENABLED_    1
+#   define HGLM_TARGET_AVX2_
+#   ifdef __AVX512F__
+#       define HGLM_X16_
+#       define HGLM_TARGET_AVX512_
+#   endif
+#endif
+
+/* the 8-wide `hglm_fast_` paths need 256-bit integer ops as well, i.e. AVX2 */
+#if defined(HGLM_X8_) && (defined(HGLM_DISPATCH_) || defined(__AVX2__))
+#   define HGLM_FAST_X8_
+#endif
+
+/* ... and the 8-wide sparse matrix-vector product needs AVX2 gathers */
+#if defined(HGLM_X8_) && (defined(HGLM_DISPATCH_) || defined(__AVX2__))
+#   define HGLM_GATHER_X8_
+#endif
+
+/* Blocking parameters of `hglm_mat_mul_mat`. MC must be a multiple of MR, and NC of NR. */
+#define HGLM_GEMM_MR 6
+#define HGLM_GEMM_NR 16
+#define HGLM_GEMM_MC 96
+#define HGLM_GEMM_KC 256
+#define HGLM_GEMM_NC 2048
+
+/* Panel width of the blocked LU and Cholesky factorizations & triangular solves */
+#define HGLM_FACTOR_NB 128
+
 #define HGLM_MAT2_IDENTITY ((HglmMat2) {   \
     .m00 = 1.0f, .m01 = 0.0f,              \
     .m10 = 0.0f, .m11 = 1.0f,})
@@ -241,6 +357,40 @@ typedef struct __attribute__ ((aligned(16)))
     };
 } HglmMat4;
 
+typedef union __attribute__ ((aligned(16)))
+{
+    struct {
+        union {
+            struct {
+                float x;
+                float y;
+                float z;
+            };
+            HglmVec3 xyz;
+        };
+        float w;
+    };
+    HglmVec4 xyzw;
+#ifdef HGLM_USE_SIMD
+    __m128 v;
+#endif
+    float f[4];
+} HglmQuat;
+
+/* rotation followed by translation. dual = 0.5 * (t, 0) * real */
+typedef struct
+{
+    HglmQuat real;
+    HglmQuat dual;
+} HglmDualQuat;
+
+typedef struct
+{
+    void *(*alloc)(void *ctx, size_t size);
+    void (*free)(void *ctx, void *ptr); /* may be NULL, e.g. for arenas */
+    void *ctx;
+} HglmMatAllocator;
+
 typedef struct
 {
     float *data;
@@ -252,8 +402,69 @@ typedef struct
         uint32_t N;
         uint32_t cols;
     };
+    uint32_t stride; /* distance between the starts of two rows, in floats (>= N). 0 means N */
+    const HglmMatAllocator *allocator; /* NULL ==> HGLM_ALLOC/HGLM_FREE */
 } HglmMat;
 
+/* Compressed sparse row (CSR) matrix. Row i holds values[row_ptr[i]..row_ptr[i+1]-1] */
+typedef struct
+{
+    float *values;
+    uint32_t *col_idx;
+    uint32_t *row_ptr; /* M + 1 entries */
+    union {
+        uint32_t M;
+        uint32_t rows;
+    };
+    union {
+        uint32_t N;
+        uint32_t cols;
+    };
+    uint32_t nnz;
+    const HglmMatAllocator *allocator; /* NULL ==> HGLM_ALLOC/HGLM_FREE */
+} HglmSpMat;
+
+typedef struct
+{
+    float *x;
+    float *y;
+    float *z;
+} HglmVec3SoA;
+
+typedef struct
+{
+    float *x;
+    float *y;
+    float *z;
+    float *w;
+} HglmVec4SoA;
+
+/* The plane dot(n, p) + d = 0. `n` points into the positive ("inside") half-space */
+typedef struct
+{
+    HglmVec3 n;
+    float d;
+} HglmPlane;
+
+typedef struct
+{
+    HglmPlane planes[6]; /* left, right, bottom, top, near, far */
+} HglmFrustum;
+
+typedef struct
+{
+    HglmVec3 min;
+    HglmVec3 max;
+} HglmAABB;
+
+typedef enum
+{
+    HGLM_CPU_SCALAR = 0,
+    HGLM_CPU_SSE4,
+    HGLM_CPU_AVX2,   /* + FMA */
+    HGLM_CPU_AVX512, /* AVX-512F */
+} HglmCpuLevel;
+
 static HGL_INLINE HglmIVec2 hglm_ivec2_make(int x, int y);
 static HGL_INLINE HglmIVec2 hglm_ivec2_add(HglmIVec2 a, HglmIVec2 b);
 static HGL_INLINE HglmIVec2 hglm_ivec2_sub(HglmIVec2 a, HglmIVec2 b);
@@ -324,6 +535,9 @@ __attribute__ ((const, unused)) static HGL_INLINE HglmMat3 hglm_mat3_make_identi
 __attribute__ ((const, unused)) static HGL_INLINE HglmMat3 hglm_mat3_make_from_mat4(HglmMat4 mat4);
 __attribute__ ((const, unused)) static HGL_INLINE HglmMat3 hglm_mat3_transpose(HglmMat3 m);
 __attribute__ ((const, unused)) static HGL_INLINE HglmVec3 hglm_mat3_mul_vec3(HglmMat3 m, HglmVec3 v);
+__attribute__ ((const, unused)) static HGL_INLINE float hglm_mat3_determinant(HglmMat3 m);
+__attribute__ ((const, unused)) static HGL_INLINE HglmMat3 hglm_mat3_inverse(HglmMat3 m);
+__attribute__ ((const, unused)) static HGL_INLINE HglmMat3 hglm_mat3_inverse_transpose(HglmMat3 m); // normal matrix
 
 __attribute__ ((const, unused)) static HGL_INLINE HglmMat4 hglm_mat4_make(HglmVec4 c0, HglmVec4 c1, HglmVec4 c2, HglmVec4 c3);
 __attribute__ ((const, unused)) static HGL_INLINE HglmMat4 hglm_mat4_make_zero(void);
@@ -345,10 +559,77 @@ __attribute__ ((const, unused)) static HGL_INLINE HglmMat4 hglm_mat4_scale(HglmM
 __attribute__ ((const, unused)) static HGL_INLINE HglmMat4 hglm_mat4_rotate(HglmMat4 m, float angle, HglmVec3 axis);
 __attribute__ ((const, unused)) static HGL_INLINE HglmMat4 hglm_mat4_translate(HglmMat4 m, HglmVec3 v);
 __attribute__ ((const, unused)) static HGL_INLINE HglmVec4 hglm_mat4_perspective_project(HglmMat4 proj, HglmVec4 v);
+__attribute__ ((const, unused)) static HGL_INLINE float hglm_mat4_determinant(HglmMat4 m);
+__attribute__ ((const, unused)) static HGL_INLINE HglmMat4 hglm_mat4_inverse(HglmMat4 m);
+__attribute__ ((const, unused)) static HGL_INLINE HglmMat4 hglm_mat4_inverse_affine(HglmMat4 m); // bottom row must be (0, 0, 0, 1)
+static HGL_INLINE void hglm_mat4_decompose_trs(HglmMat4 m, HglmVec3 *translation, HglmMat3 *rotation, HglmVec3 *scale);
+__attribute__ ((const, unused)) static HGL_INLINE HglmMat4 hglm_mat4_make_trs(HglmVec3 translation, HglmQuat rotation, HglmVec3 scale);
+
+static HGL_INLINE HglmQuat hglm_quat_make(float x, float y, float z, float w);
+static HGL_INLINE HglmQuat hglm_quat_make_identity(void);
+static HGL_INLINE HglmQuat hglm_quat_make_rotation(float angle, HglmVec3 axis); // `axis` must be normalized
+static HGL_INLINE HglmQuat hglm_quat_make_from_mat3(HglmMat3 m); // `m` must be a rotation matrix
+static HGL_INLINE HglmQuat hglm_quat_mul(HglmQuat a, HglmQuat b); // rotates by b, then a
+static HGL_INLINE HglmQuat hglm_quat_conjugate(HglmQuat q);
+static HGL_INLINE HglmQuat hglm_quat_inverse(HglmQuat q);
+static HGL_INLINE float hglm_quat_dot(HglmQuat a, HglmQuat b);
+static HGL_INLINE HglmQuat hglm_quat_normalize(HglmQuat q);
+static HGL_INLINE HglmVec3 hglm_quat_rotate_vec3(HglmQuat q, HglmVec3 v);
+static HGL_INLINE HglmQuat hglm_quat_nlerp(HglmQuat a, HglmQuat b, float t); // shortest path
+static HGL_INLINE HglmQuat hglm_quat_slerp(HglmQuat a, HglmQuat b, float t); // shortest path
+static HGL_INLINE HglmMat3 hglm_quat_to_mat3(HglmQuat q);
+static HGL_INLINE HglmMat4 hglm_quat_to_mat4(HglmQuat q);
+static HGL_INLINE HglmDualQuat hglm_dualquat_make(HglmQuat rotation, HglmVec3 translation);
+static HGL_INLINE HglmVec3 hglm_dualquat_transform_point3(HglmDualQuat dq, HglmVec3 p); // dq must be normalized
+
+static HGL_INLINE void hglm_skin_linear_array(HglmVec3 *out_pos, HglmVec3 *out_normal,
+                                              const HglmVec3 *pos, const HglmVec3 *normal,
+                                              const HglmIVec4 *joints, const HglmVec4 *weights,
+                                              const HglmMat4 *joint_matrices, size_t n);
+static HGL_INLINE void hglm_skin_dualquat_array(HglmVec3 *out_pos, HglmVec3 *out_normal,
+                                                const HglmVec3 *pos, const HglmVec3 *normal,
+                                                const HglmIVec4 *joints, const HglmVec4 *weights,
+                                                const HglmDualQuat *joint_dqs, size_t n);
+
+static HGL_INLINE HglmCpuLevel hglm_cpu_level(void); // detected on first call
+static HGL_INLINE void hglm_cpu_level_set(HglmCpuLevel level); // clamped to what the CPU supports
+
+static HGL_INLINE void hglm_mat4_mul_vec4_array(HglmVec4 *out, HglmMat4 m, const HglmVec4 *in, size_t n);
+static HGL_INLINE void hglm_mat4_mul_mat4_array(HglmMat4 *out, HglmMat4 m, const HglmMat4 *in, size_t n);
+static HGL_INLINE void hglm_mat4_transform_point3_array(HglmVec3 *out, HglmMat4 m, const HglmVec3 *in, size_t n); // w = 1
+static HGL_INLINE void hglm_mat4_transform_dir3_array(HglmVec3 *out, HglmMat4 m, const HglmVec3 *in, size_t n); // w = 0
+static HGL_INLINE void hglm_mat4_perspective_project_array(HglmVec4 *out, HglmMat4 proj, const HglmVec4 *in, size_t n);
+static HGL_INLINE void hglm_vec3_normalize_array(HglmVec3 *out, const HglmVec3 *in, size_t n);
+static HGL_INLINE void hglm_vec4_normalize_array(HglmVec4 *out, const HglmVec4 *in, size_t n);
+static HGL_INLINE void hglm_vec3_dot_array(float *out, const HglmVec3 *a, const HglmVec3 *b, size_t n);
+static HGL_INLINE void hglm_vec4_dot_array(float *out, const HglmVec4 *a, const HglmVec4 *b, size_t n);
+static HGL_INLINE void hglm_mat4_mul_vec4_soa(HglmVec4SoA out, HglmMat4 m, HglmVec4SoA in, size_t n);
+static HGL_INLINE void hglm_mat4_transform_point3_soa(HglmVec3SoA out, HglmMat4 m, HglmVec3SoA in, size_t n); // w = 1
+static HGL_INLINE void hglm_mat4_transform_dir3_soa(HglmVec3SoA out, HglmMat4 m, HglmVec3SoA in, size_t n); // w = 0
+static HGL_INLINE void hglm_mat4_perspective_project_soa(HglmVec4SoA out, HglmMat4 proj, HglmVec4SoA in, size_t n);
+static HGL_INLINE void hglm_vec3_normalize_soa(HglmVec3SoA out, HglmVec3SoA in, size_t n);
+static HGL_INLINE void hglm_vec3_dot_soa(float *out, HglmVec3SoA a, HglmVec3SoA b, size_t n);
+
+static HGL_INLINE HglmPlane hglm_plane_make(HglmVec3 normal, HglmVec3 point);
+static HGL_INLINE float hglm_plane_distance(HglmPlane p, HglmVec3 point);
+static HGL_INLINE HglmFrustum hglm_frustum_make_from_mat4(HglmMat4 m); // e.g. m = proj * view
+static HGL_INLINE int hglm_frustum_test_aabb(HglmFrustum f, HglmAABB box);
+static HGL_INLINE int hglm_frustum_test_sphere(HglmFrustum f, HglmVec3 center, float radius);
+static HGL_INLINE int hglm_ray_test_aabb(HglmVec3 origin, HglmVec3 dir, float t_max, HglmAABB box);
+static HGL_INLINE void hglm_frustum_test_aabb_soa(uint8_t *mask, HglmFrustum f, HglmVec3SoA min,
+                                                  HglmVec3SoA max, size_t n);
+static HGL_INLINE void hglm_frustum_test_sphere_soa(uint8_t *mask, HglmFrustum f, HglmVec3SoA center,
+                                                    const float *radius, size_t n);
+static HGL_INLINE void hglm_ray_test_aabb_soa(uint8_t *mask, HglmVec3 origin, HglmVec3 dir, float t_max,
+                                              HglmVec3SoA min, HglmVec3SoA max, size_t n);
 
 static HGL_INLINE HglmMat hglm_mat_make(uint32_t M /* rows */, uint32_t N /* cols */);
+static HGL_INLINE HglmMat hglm_mat_make_with(uint32_t M, uint32_t N, const HglmMatAllocator *allocator);
+static HGL_INLINE HglmMat hglm_mat_make_from(float *data, uint32_t M, uint32_t N, uint32_t stride);
 static HGL_INLINE HglmMat hglm_mat_make_identity(uint32_t N);
+static HGL_INLINE HglmMat hglm_mat_view(HglmMat m, uint32_t row, uint32_t col, uint32_t M, uint32_t N);
 static HGL_INLINE void hglm_mat_free(HglmMat m);
+static HGL_INLINE void hglm_mat_copy(HglmMat dst, HglmMat src);
 static HGL_INLINE void hglm_mat_fill(HglmMat m, float value);
 static HGL_INLINE void hglm_mat_add(HglmMat res, HglmMat a, HglmMat b);
 static HGL_INLINE void hglm_mat_sub(HglmMat res, HglmMat a, HglmMat b);
@@ -356,6 +637,21 @@ static HGL_INLINE void hglm_mat_mul_scalar(HglmMat m, float s);
 static HGL_INLINE void hglm_mat_mul_mat(HglmMat res, HglmMat a, HglmMat b);
 static HGL_INLINE void hglm_mat_transpose_in_place(HglmMat m);
 static HGL_INLINE void hglm_mat_transpose(HglmMat res, HglmMat m);
+static HGL_INLINE void hglm_mat_solve_lower(HglmMat l, HglmMat b, int unit_diagonal);
+static HGL_INLINE void hglm_mat_solve_upper(HglmMat u, HglmMat b, int unit_diagonal);
+static HGL_INLINE int hglm_mat_lu(HglmMat a, uint32_t *piv);
+static HGL_INLINE void hglm_mat_lu_solve(HglmMat lu, const uint32_t *piv, HglmMat b);
+static HGL_INLINE int hglm_mat_cholesky(HglmMat a);
+static HGL_INLINE void hglm_mat_cholesky_solve(HglmMat l, HglmMat b);
+
+static HGL_INLINE HglmSpMat hglm_spmat_make_from_triplets(uint32_t M, uint32_t N, const uint32_t *rows,
+                                                          const uint32_t *cols, const float *values,
+                                                          uint32_t count, const HglmMatAllocator *allocator);
+static HGL_INLINE void hglm_spmat_free(HglmSpMat m);
+static HGL_INLINE HglmSpMat hglm_spmat_transpose(HglmSpMat m, const HglmMatAllocator *allocator);
+static HGL_INLINE void hglm_spmat_to_mat(HglmMat res, HglmSpMat m);
+static HGL_INLINE void hglm_spmat_mul_vec(float *res, HglmSpMat a, const float *x);
+static HGL_INLINE void hglm_spmat_mul_mat(HglmMat res, HglmSpMat a, HglmMat b);
 
 static HGL_INLINE float hglm_pid(float error, float last_error, float *i, 
                                  float Kp, float Ki, float Kd, float dt);
@@ -372,6 +668,29 @@ static HGL_INLINE HglmVec4 hglm_bezier3(float t);
 static HGL_INLINE HglmVec4 hglm_hermite3(float t);
 static HGL_INLINE float hglm_perlin3D(float x, float y, float z);
 
+static HGL_INLINE float hglm_fast_rsqrt(float x);                 // x > 0. relative error < 5e-6
+static HGL_INLINE float hglm_fast_sin(float x);                   // |x| <= 8192. absolute error < 1.5e-7
+static HGL_INLINE float hglm_fast_cos(float x);                   // |x| <= 8192. absolute error < 1.5e-7
+static HGL_INLINE void hglm_fast_sincos(float x, float *s, float *c);
+static HGL_INLINE float hglm_fast_exp2(float x);                  // relative error < 2e-7 in [-126, 127.5]. 0 below -126.5
+static HGL_INLINE float hglm_fast_exp(float x);                   // relative error < 2e-7 in [-87.3, 88.3]. 0 below -87.7
+static HGL_INLINE float hglm_fast_log2(float x);                  // x > 0 (normal). absolute error < 1.5e-7 * max(1, |log2(x)|)
+static HGL_INLINE float hglm_fast_pow(float x, float y);          // x >= 0. relative error < 3e-7 * max(1, |y*log2(x)|)
+static HGL_INLINE void hglm_fast_rsqrt_array(float *out, const float *in, size_t n);
+static HGL_INLINE void hglm_fast_sin_array(float *out, const float *in, size_t n);
+static HGL_INLINE void hglm_fast_cos_array(float *out, const float *in, size_t n);
+static HGL_INLINE void hglm_fast_sincos_array(float *s, float *c, const float *in, size_t n);
+static HGL_INLINE void hglm_fast_exp2_array(float *out, const float *in, size_t n);
+static HGL_INLINE void hglm_fast_exp_array(float *out, const float *in, size_t n);
+static HGL_INLINE void hglm_fast_log2_array(float *out, const float *in, size_t n);
+static HGL_INLINE void hglm_fast_pow_array(float *out, const float *x, float y, size_t n);
+
+#ifdef HGLM_USE_FAST_MATH
+#   define HGLM_SINF_ hglm_fast_sin
+#else
+#   define HGLM_SINF_ sinf
+#endif
+
 /* ========== HglmIVec2 ======================================================*/
 
 #define hglm_ivec2_print(v) (printf("%s = {%d, %d}\n", #v , (v).x, (v).y))
@@ -478,7 +797,11 @@ static HGL_INLINE float hglm_vec2_len(HglmVec2 v)
 
 static HGL_INLINE HglmVec2 hglm_vec2_normalize(HglmVec2 v)
 {
+#ifdef HGLM_USE_FAST_MATH
+    float ilen = hglm_fast_rsqrt(v.x * v.x + v.y * v.y);
+#else
     float ilen = 1.0f / hglm_vec2_len(v);
+#endif
     return (HglmVec2) {.x = v.x * ilen, .y = v.y * ilen};
 }
 
@@ -519,8 +842,8 @@ static HGL_INLINE HglmVec2 hglm_vec2_slerp(HglmVec2 a, HglmVec2 b, float t)
 {
     float omega = acosf(hglm_vec2_dot(a, b));
     return hglm_vec2_add(
-        hglm_vec2_mul_scalar(a, sinf((1.0f - t)*omega)/sinf(omega)),
-        hglm_vec2_mul_scalar(b, sinf(t*omega)/sinf(omega))
+        hglm_vec2_mul_scalar(a, HGLM_SINF_((1.0f - t)*omega)/HGLM_SINF_(omega)),
+        hglm_vec2_mul_scalar(b, HGLM_SINF_(t*omega)/HGLM_SINF_(omega))
     );
 }
 
@@ -583,7 +906,11 @@ static HGL_INLINE float hglm_vec3_len(HglmVec3 v)
 
 static HGL_INLINE HglmVec3 hglm_vec3_normalize(HglmVec3 v)
 {
+#ifdef HGLM_USE_FAST_MATH
+    float ilen = hglm_fast_rsqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+#else
     float ilen = 1.0f / hglm_vec3_len(v);
+#endif
     return (HglmVec3) {.x = v.x * ilen, .y = v.y * ilen, .z = v.z * ilen};
 }
 
@@ -633,8 +960,8 @@ static HGL_INLINE HglmVec3 hglm_vec3_slerp(HglmVec3 a, HglmVec3 b, float t)
 {
     float omega = acosf(hglm_vec3_dot(a, b));
     return hglm_vec3_add(
-        hglm_vec3_mul_scalar(a, sinf((1.0f - t)*omega)/sinf(omega)),
-        hglm_vec3_mul_scalar(b, sinf(t*omega)/sinf(omega))
+        hglm_vec3_mul_scalar(a, HGLM_SINF_((1.0f - t)*omega)/HGLM_SINF_(omega)),
+        hglm_vec3_mul_scalar(b, HGLM_SINF_(t*omega)/HGLM_SINF_(omega))
     );
 }
 
@@ -724,7 +1051,9 @@ static HGL_INLINE float hglm_vec4_len(HglmVec4 v)
 
 static HGL_INLINE HglmVec4 hglm_vec4_normalize(HglmVec4 v)
 {
-#ifdef HGLM_USE_SIMD
+#if defined(HGLM_USE_FAST_MATH)
+    return hglm_vec4_mul_scalar(v, hglm_fast_rsqrt(hglm_vec4_dot(v, v)));
+#elif defined(HGLM_USE_SIMD)
     float rlen = 1.0f / hglm_vec4_len(v);
     __m128 vrlen = _mm_broadcast_ss(&rlen);
     return (HglmVec4) {.v = _mm_mul_ps(v.v, vrlen)};
@@ -880,6 +1209,30 @@ __attribute__ ((const, unused)) static HGL_INLINE HglmVec3 hglm_mat3_mul_vec3(Hg
     };
 }
 
+__attribute__ ((const, unused)) static HGL_INLINE float hglm_mat3_determinant(HglmMat3 m)
+{
+    return hglm_vec3_dot(m.c0, hglm_vec3_cross(m.c1, m.c2));
+}
+
+/* The rows of m^-1 are (c1 x c2), (c2 x c0), and (c0 x c1), divided by det(m). */
+__attribute__ ((const, unused)) static HGL_INLINE HglmMat3 hglm_mat3_inverse_transpose(HglmMat3 m)
+{
+    HglmVec3 r0 = hglm_vec3_cross(m.c1, m.c2);
+    HglmVec3 r1 = hglm_vec3_cross(m.c2, m.c0);
+    HglmVec3 r2 = hglm_vec3_cross(m.c0, m.c1);
+    float idet = 1.0f / hglm_vec3_dot(m.c0, r0);
+    return (HglmMat3) {
+        .c0 = hglm_vec3_mul_scalar(r0, idet),
+        .c1 = hglm_vec3_mul_scalar(r1, idet),
+        .c2 = hglm_vec3_mul_scalar(r2, idet),
+    };
+}
+
+__attribute__ ((const, unused)) static HGL_INLINE HglmMat3 hglm_mat3_inverse(HglmMat3 m)
+{
+    return hglm_mat3_transpose(hglm_mat3_inverse_transpose(m));
+}
+
 
 /* ========== HglmMat4 =======================================================*/
 
@@ -1352,212 +1705,2401 @@ static HGL_INLINE HglmVec4 hglm_mat4_perspective_project(HglmMat4 proj, HglmVec4
     return u;
 }
 
-
-/* ========== Arbitrary size Matrix funtions =================================*/
-
-#define hglm_mat_at(m, y, x) ((m).data[(y)*(m).N + (x)])
-#define hglm_mat_print(m) \
-    do { \
-        printf("%s = \n", #m ); \
-        for (uint32_t row = 0; row < (m).M; row++) {\
-            printf("  | "); \
-            for (uint32_t col = 0; col < (m).N; col++) {\
-                printf("%16f ", (double) hglm_mat_at((m), row, col)); \
-            } \
-            printf(" |\n"); \
-        } \
-    } while(0)
-
-static HGL_INLINE HglmMat hglm_mat_make(uint32_t M /* rows */, uint32_t N /* cols */)
+#ifdef HGLM_USE_SIMD
+/* 2x2 matrix helpers for `hglm_mat4_inverse`. A 2x2 matrix is packed as (m00, m01, m10, m11). */
+static inline __m128 hglm_mat2_mul_internal_(__m128 a, __m128 b) /* a * b */
 {
-    HglmMat m = {
-        .data = HGLM_ALLOC(M * N * sizeof(*m.data)),
-        .M = M,
-        .N = N,
-    };
-    assert(m.data != NULL);
-    return m;
+    return _mm_add_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 3, 0))),
+                      _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)),
+                                 _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
 }
 
-static HGL_INLINE HglmMat hglm_mat_make_identity(uint32_t N)
+static inline __m128 hglm_mat2_adj_mul_internal_(__m128 a, __m128 b) /* adj(a) * b */
 {
-    HglmMat m = hglm_mat_make(N, N);
-    hglm_mat_fill(m, 0);
-    for (uint32_t i = 0; i < N; i++) {
-        hglm_mat_at(m, i, i) = 1.0f;
-    }
-    return m;
+    return _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 3, 3)), b),
+                      _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 1, 1)),
+                                 _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2))));
 }
 
-static HGL_INLINE void hglm_mat_free(HglmMat m)
+static inline __m128 hglm_mat2_mul_adj_internal_(__m128 a, __m128 b) /* a * adj(b) */
 {
-    HGLM_FREE(m.data);
+    return _mm_sub_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 3, 0, 3))),
+                      _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)),
+                                 _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
 }
 
-static HGL_INLINE void hglm_mat_fill(HglmMat m, float value)
+static inline __m128 hglm_cross_internal_(__m128 a, __m128 b) /* a.xyz x b.xyz, w = 0 */
 {
-    for (uint32_t row = 0; row < m.M; row++) {
-        for (uint32_t col = 0; col < m.N; col++) {
-            hglm_mat_at(m, row, col) = value;
-        }
-    }
+    __m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+    return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
 }
+#endif
 
-static HGL_INLINE void hglm_mat_add(HglmMat res, HglmMat a, HglmMat b)
+/*
+ * Determinant and inverse of a general 4x4 matrix, using the 2x2 sub-determinants
+ * of the upper and lower halves. `m` must be invertible.
+ */
+__attribute__ ((const, unused))
+static HGL_INLINE float hglm_mat4_determinant(HglmMat4 m)
 {
-    assert(a.M == b.M);
-    assert(a.N == b.N);
-    assert(res.N == a.N);
-    assert(res.M == a.M);
-    for (uint32_t row = 0; row < res.M; row++) {
-        for (uint32_t col = 0; col < res.N; col++) {
-            hglm_mat_at(res, row, col) = hglm_mat_at(a, row, col) + hglm_mat_at(b, row, col);
-        }
-    }
+    const float *a = m.f;
+    float s0 = a[0]*a[5]  - a[4]*a[1];
+    float s1 = a[0]*a[6]  - a[4]*a[2];
+    float s2 = a[0]*a[7]  - a[4]*a[3];
+    float s3 = a[1]*a[6]  - a[5]*a[2];
+    float s4 = a[1]*a[7]  - a[5]*a[3];
+    float s5 = a[2]*a[7]  - a[6]*a[3];
+    float c5 = a[10]*a[15] - a[14]*a[11];
+    float c4 = a[9]*a[15]  - a[13]*a[11];
+    float c3 = a[9]*a[14]  - a[13]*a[10];
+    float c2 = a[8]*a[15]  - a[12]*a[11];
+    float c1 = a[8]*a[14]  - a[12]*a[10];
+    float c0 = a[8]*a[13]  - a[12]*a[9];
+    return s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
 }
 
-static HGL_INLINE void hglm_mat_sub(HglmMat res, HglmMat a, HglmMat b)
+__attribute__ ((const, unused))
+static HGL_INLINE HglmMat4 hglm_mat4_inverse(HglmMat4 m)
 {
-    assert(a.M == b.M);
-    assert(a.N == b.N);
-    assert(res.N == a.N);
-    assert(res.M == a.M);
-    for (uint32_t row = 0; row < res.M; row++) {
-        for (uint32_t col = 0; col < res.N; col++) {
-            hglm_mat_at(res, row, col) = hglm_mat_at(a, row, col) - hglm_mat_at(b, row, col);
-        }
-    }
+#ifdef HGLM_USE_SIMD
+    /* 2x2 blocks of m^T (inv(m^T) = inv(m)^T, so the column-major layout works out) */
+    __m128 A = _mm_movelh_ps(m.c0.v, m.c1.v);
+    __m128 B = _mm_movehl_ps(m.c1.v, m.c0.v);
+    __m128 C = _mm_movelh_ps(m.c2.v, m.c3.v);
+    __m128 D = _mm_movehl_ps(m.c3.v, m.c2.v);
+
+    /* (|A|, |B|, |C|, |D|) */
+    __m128 det_sub = _mm_sub_ps(
+        _mm_mul_ps(_mm_shuffle_ps(m.c0.v, m.c2.v, _MM_SHUFFLE(2, 0, 2, 0)),
+                   _mm_shuffle_ps(m.c1.v, m.c3.v, _MM_SHUFFLE(3, 1, 3, 1))),
+        _mm_mul_ps(_mm_shuffle_ps(m.c0.v, m.c2.v, _MM_SHUFFLE(3, 1, 3, 1)),
+                   _mm_shuffle_ps(m.c1.v, m.c3.v, _MM_SHUFFLE(2, 0, 2, 0))));
+    __m128 det_a = _mm_shuffle_ps(det_sub, det_sub, _MM_SHUFFLE(0, 0, 0, 0));
+    __m128 det_b = _mm_shuffle_ps(det_sub, det_sub, _MM_SHUFFLE(1, 1, 1, 1));
+    __m128 det_c = _mm_shuffle_ps(det_sub, det_sub, _MM_SHUFFLE(2, 2, 2, 2));
+    __m128 det_d = _mm_shuffle_ps(det_sub, det_sub, _MM_SHUFFLE(3, 3, 3, 3));
+
+    /* inv(m) = 1/|m| * [X Y; Z W] */
+    __m128 d_c = hglm_mat2_adj_mul_internal_(D, C);
+    __m128 a_b = hglm_mat2_adj_mul_internal_(A, B);
+    __m128 X = _mm_sub_ps(_mm_mul_ps(det_d, A), hglm_mat2_mul_internal_(B, d_c));
+    __m128 W = _mm_sub_ps(_mm_mul_ps(det_a, D), hglm_mat2_mul_internal_(C, a_b));
+    __m128 Y = _mm_sub_ps(_mm_mul_ps(det_b, C), hglm_mat2_mul_adj_internal_(D, a_b));
+    __m128 Z = _mm_sub_ps(_mm_mul_ps(det_c, B), hglm_mat2_mul_adj_internal_(A, d_c));
+
+    /* |m| = |A||D| + |B||C| - tr(adj(A)B adj(D)C) */
+    __m128 det = _mm_add_ps(_mm_mul_ps(det_a, det_d), _mm_mul_ps(det_b, det_c));
+    __m128 tr = _mm_mul_ps(a_b, _mm_shuffle_ps(d_c, d_c, _MM_SHUFFLE(3, 1, 2, 0)));
+    tr = _mm_add_ps(tr, _mm_shuffle_ps(tr, tr, _MM_SHUFFLE(2, 3, 0, 1)));
+    tr = _mm_add_ps(tr, _mm_shuffle_ps(tr, tr, _MM_SHUFFLE(1, 0, 3, 2)));
+    det = _mm_sub_ps(det, tr);
+
+    __m128 rdet = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det);
+    X = _mm_mul_ps(X, rdet);
+    Y = _mm_mul_ps(Y, rdet);
+    Z = _mm_mul_ps(Z, rdet);
+    W = _mm_mul_ps(W, rdet);
+
+    /* adjugate shuffle + store */
+    HglmMat4 r;
+    r.c0.v = _mm_shuffle_ps(X, Y, _MM_SHUFFLE(1, 3, 1, 3));
+    r.c1.v = _mm_shuffle_ps(X, Y, _MM_SHUFFLE(0, 2, 0, 2));
+    r.c2.v = _mm_shuffle_ps(Z, W, _MM_SHUFFLE(1, 3, 1, 3));
+    r.c3.v = _mm_shuffle_ps(Z, W, _MM_SHUFFLE(0, 2, 0, 2));
+    return r;
+#else
+    const float *a = m.f;
+    float s0 = a[0]*a[5]  - a[4]*a[1];
+    float s1 = a[0]*a[6]  - a[4]*a[2];
+    float s2 = a[0]*a[7]  - a[4]*a[3];
+    float s3 = a[1]*a[6]  - a[5]*a[2];
+    float s4 = a[1]*a[7]  - a[5]*a[3];
+    float s5 = a[2]*a[7]  - a[6]*a[3];
+    float c5 = a[10]*a[15] - a[14]*a[11];
+    float c4 = a[9]*a[15]  - a[13]*a[11];
+    float c3 = a[9]*a[14]  - a[13]*a[10];
+    float c2 = a[8]*a[15]  - a[12]*a[11];
+    float c1 = a[8]*a[14]  - a[12]*a[10];
+    float c0 = a[8]*a[13]  - a[12]*a[9];
+    float idet = 1.0f / (s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0);
+    HglmMat4 r;
+    r.f[0]  = ( a[5]*c5  - a[6]*c4  + a[7]*c3)  * idet;
+    r.f[1]  = (-a[1]*c5  + a[2]*c4  - a[3]*c3)  * idet;
+    r.f[2]  = ( a[13]*s5 - a[14]*s4 + a[15]*s3) * idet;
+    r.f[3]  = (-a[9]*s5  + a[10]*s4 - a[11]*s3) * idet;
+    r.f[4]  = (-a[4]*c5  + a[6]*c2  - a[7]*c1)  * idet;
+    r.f[5]  = ( a[0]*c5  - a[2]*c2  + a[3]*c1)  * idet;
+    r.f[6]  = (-a[12]*s5 + a[14]*s2 - a[15]*s1) * idet;
+    r.f[7]  = ( a[8]*s5  - a[10]*s2 + a[11]*s1) * idet;
+    r.f[8]  = ( a[4]*c4  - a[5]*c2  + a[7]*c0)  * idet;
+    r.f[9]  = (-a[0]*c4  + a[1]*c2  - a[3]*c0)  * idet;
+    r.f[10] = ( a[12]*s4 - a[13]*s2 + a[15]*s0) * idet;
+    r.f[11] = (-a[8]*s4  + a[9]*s2  - a[11]*s0) * idet;
+    r.f[12] = (-a[4]*c3  + a[5]*c1  - a[6]*c0)  * idet;
+    r.f[13] = ( a[0]*c3  - a[1]*c1  + a[2]*c0)  * idet;
+    r.f[14] = (-a[12]*s3 + a[13]*s1 - a[14]*s0) * idet;
+    r.f[15] = ( a[8]*s3  - a[9]*s1  + a[10]*s0) * idet;
+    return r;
+#endif
 }
 
-static HGL_INLINE void hglm_mat_mul_scalar(HglmMat m, float s)
+/*
+ * Inverse of an affine transform (bottom row = (0, 0, 0, 1), e.g. any combination
+ * of translations, rotations, and scales): inv([M t; 0 1]) = [inv(M) -inv(M)t; 0 1].
+ */
+__attribute__ ((const, unused))
+static HGL_INLINE HglmMat4 hglm_mat4_inverse_affine(HglmMat4 m)
 {
-    for (uint32_t row = 0; row < m.M; row++) {
-        for (uint32_t col = 0; col < m.N; col++) {
-            hglm_mat_at(m, row, col) *= s;
-        }
-    }
+#ifdef HGLM_USE_SIMD
+    /* rows of inv(M) * det(M) */
+    __m128 r0 = hglm_cross_internal_(m.c1.v, m.c2.v);
+    __m128 r1 = hglm_cross_internal_(m.c2.v, m.c0.v);
+    __m128 r2 = hglm_cross_internal_(m.c0.v, m.c1.v);
+    __m128 r3 = _mm_setzero_ps();
+    __m128 idet = _mm_div_ps(_mm_set1_ps(1.0f), _mm_dp_ps(m.c0.v, r0, 0x7F));
+    r0 = _mm_mul_ps(r0, idet);
+    r1 = _mm_mul_ps(r1, idet);
+    r2 = _mm_mul_ps(r2, idet);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    HglmMat4 r;
+    r.c0.v = r0;
+    r.c1.v = r1;
+    r.c2.v = r2;
+    __m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r0, _mm_set1_ps(m.c3.x)),
+                                     _mm_mul_ps(r1, _mm_set1_ps(m.c3.y))),
+                                     _mm_mul_ps(r2, _mm_set1_ps(m.c3.z)));
+    r.c3.v = _mm_sub_ps(_mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f), t);
+    return r;
+#else
+    HglmMat3 inv = hglm_mat3_inverse(hglm_mat3_make_from_mat4(m));
+    HglmVec3 t = hglm_mat3_mul_vec3(inv, m.c3.xyz);
+    return (HglmMat4) {
+        .c0 = {.x = inv.c0.x, .y = inv.c0.y, .z = inv.c0.z, .w = 0.0f},
+        .c1 = {.x = inv.c1.x, .y = inv.c1.y, .z = inv.c1.z, .w = 0.0f},
+        .c2 = {.x = inv.c2.x, .y = inv.c2.y, .z = inv.c2.z, .w = 0.0f},
+        .c3 = {.x = -t.x,     .y = -t.y,     .z = -t.z,     .w = 1.0f},
+    };
+#endif
 }
 
-static HGL_INLINE void hglm_mat_mul_mat(HglmMat res, HglmMat a, HglmMat b)
+/*
+ * Splits `m` = T * R * S into a translation, a rotation matrix, and a (per-axis)
+ * scale. Assumes no shear or projection. A mirroring `m` gets a negative x scale.
+ */
+static HGL_INLINE void hglm_mat4_decompose_trs(HglmMat4 m, HglmVec3 *translation, HglmMat3 *rotation, HglmVec3 *scale)
 {
-    /* AxB x BxC ==> AxC*/
-    assert(a.N == b.M);
-    assert(res.M == a.M);
-    assert(res.N == b.N);
-    assert(res.data != a.data);
-    assert(res.data != b.data);
-    for (uint32_t row = 0; row < res.M; row++) {
-        for (uint32_t col = 0; col < res.N; col++) {
-            hglm_mat_at(res, row, col) = 0.0f;
-            for (uint32_t i = 0; i < res.N; i++) {
-                hglm_mat_at(res, row, col) += hglm_mat_at(a, row, i) * hglm_mat_at(b, i, col);
-            }
-        }
+    HglmMat3 m3 = hglm_mat3_make_from_mat4(m);
+    HglmVec3 s = hglm_vec3_make(hglm_vec3_len(m3.c0), hglm_vec3_len(m3.c1), hglm_vec3_len(m3.c2));
+    if (hglm_mat3_determinant(m3) < 0.0f) {
+        s.x = -s.x;
     }
+    *translation = m.c3.xyz;
+    *rotation = (HglmMat3) {
+        .c0 = hglm_vec3_mul_scalar(m3.c0, 1.0f / s.x),
+        .c1 = hglm_vec3_mul_scalar(m3.c1, 1.0f / s.y),
+        .c2 = hglm_vec3_mul_scalar(m3.c2, 1.0f / s.z),
+    };
+    *scale = s;
 }
 
-static HGL_INLINE void hglm_mat_transpose_in_place(HglmMat m)
+static HGL_INLINE HglmMat4 hglm_mat4_make_trs(HglmVec3 translation, HglmQuat rotation, HglmVec3 scale)
 {
-    assert((m.M == m.N) && "In-place transpose only supports square matrices");
-    for (uint32_t row = 0; row < m.M - 1; row++) {
-        for (uint32_t col = row + 1; col < m.N; col++) {
-            float temp = hglm_mat_at(m, row, col);
-            hglm_mat_at(m, row, col) = hglm_mat_at(m, col, row);
-            hglm_mat_at(m, col, row) = temp;
-        }
-    }
+    HglmMat3 r = hglm_quat_to_mat3(rotation);
+    return (HglmMat4) {
+        .c0 = {.x = r.m00 * scale.x, .y = r.m10 * scale.x, .z = r.m20 * scale.x, .w = 0.0f},
+        .c1 = {.x = r.m01 * scale.y, .y = r.m11 * scale.y, .z = r.m21 * scale.y, .w = 0.0f},
+        .c2 = {.x = r.m02 * scale.z, .y = r.m12 * scale.z, .z = r.m22 * scale.z, .w = 0.0f},
+        .c3 = {.x = translation.x,   .y = translation.y,   .z = translation.z,   .w = 1.0f},
+    };
 }
 
-static HGL_INLINE void hglm_mat_transpose(HglmMat res, HglmMat m)
-{
-    assert(res.M == m.N);
-    assert(res.N == m.M);
-    for (uint32_t row = 0; row < res.M; row++) {
-        for (uint32_t col = 0; col < res.N; col++) {
-            hglm_mat_at(res, row, col) = hglm_mat_at(m, col, row);
-        }
-    }
-}
 
+/* ========== HglmQuat =======================================================*/
 
-/* ========== scalar & misc. math functions ==================================*/
+#define hglm_quat_print(q) (printf("%s = {%f, %f, %f, %f}\n", #q , \
+                            (double)(q).x, (double)(q).y, (double)(q).z, (double)(q).w))
 
-static HGL_INLINE float hglm_pid(float error, float last_error, float *i, 
-                                 float Kp, float Ki, float Kd, float dt)
+static HGL_INLINE HglmQuat hglm_quat_make(float x, float y, float z, float w)
 {
-    *i += error * dt;
-    float d = (error - last_error) / dt;
-    float p = error;
-
-    return Kp*p + Ki*(*i) + Kd*d;
+    return (HglmQuat) {.xyzw = hglm_vec4_make(x, y, z, w)};
 }
 
-static HGL_INLINE float hglm_lerp(float a, float b, float t)
+static HGL_INLINE HglmQuat hglm_quat_make_identity(void)
 {
-    return (1.0f - t) * a + t * b; // value
+    return hglm_quat_make(0.0f, 0.0f, 0.0f, 1.0f);
 }
 
-static HGL_INLINE float hglm_ilerp(float a, float b, float value)
+static HGL_INLINE HglmQuat hglm_quat_make_rotation(float angle, HglmVec3 axis)
 {
-    return (value - a) / (b - a); // t
+    float s = sinf(0.5f * angle);
+    return hglm_quat_make(axis.x * s, axis.y * s, axis.z * s, cosf(0.5f * angle));
 }
 
-static HGL_INLINE float hglm_clamp(float min, float max, float value)
+static HGL_INLINE HglmQuat hglm_quat_make_from_mat3(HglmMat3 m)
 {
-    //return fminf(fmaxf(min, value), max);
-    if (value < min) return min;
-    if (value > max) return max;
-    return value;
+    /* Shepperd's method: divide by the largest of 4w^2, 4x^2, 4y^2, 4z^2 */
+    float tr = m.m00 + m.m11 + m.m22;
+    HglmQuat q;
+    if (tr > 0.0f) {
+        float s = 2.0f * sqrtf(1.0f + tr);
+        q = hglm_quat_make((m.m21 - m.m12) / s, (m.m02 - m.m20) / s, (m.m10 - m.m01) / s, 0.25f * s);
+    } else if (m.m00 > m.m11 && m.m00 > m.m22) {
+        float s = 2.0f * sqrtf(1.0f + m.m00 - m.m11 - m.m22);
+        q = hglm_quat_make(0.25f * s, (m.m01 + m.m10) / s, (m.m02 + m.m20) / s, (m.m21 - m.m12) / s);
+    } else if (m.m11 > m.m22) {
+        float s = 2.0f * sqrtf(1.0f + m.m11 - m.m00 - m.m22);
+        q = hglm_quat_make((m.m01 + m.m10) / s, 0.25f * s, (m.m12 + m.m21) / s, (m.m02 - m.m20) / s);
+    } else {
+        float s = 2.0f * sqrtf(1.0f + m.m22 - m.m00 - m.m11);
+        q = hglm_quat_make((m.m02 + m.m20) / s, (m.m12 + m.m21) / s, 0.25f * s, (m.m10 - m.m01) / s);
+    }
+    return hglm_quat_normalize(q);
 }
 
-static HGL_INLINE float hglm_remap(float in_min,
-                                   float in_max,
-                                   float out_min,
-                                   float out_max,
-                                   float value)
+static HGL_INLINE HglmQuat hglm_quat_mul(HglmQuat a, HglmQuat b)
 {
-    float t = hglm_ilerp(in_min, in_max, value);
-    return hglm_lerp(out_min, out_max, t);
+#ifdef HGLM_USE_SIMD
+    /* a.w*b + a.x*(bw, -bz, by, -bx) + a.y*(bz, bw, -bx, -by) + a.z*(-by, bx, bw, -bz) */
+    __m128 b1 = _mm_xor_ps(_mm_shuffle_ps(b.v, b.v, _MM_SHUFFLE(0, 1, 2, 3)), _mm_set_ps(-0.0f, 0.0f, -0.0f, 0.0f));
+    __m128 b2 = _mm_xor_ps(_mm_shuffle_ps(b.v, b.v, _MM_SHUFFLE(1, 0, 3, 2)), _mm_set_ps(-0.0f, -0.0f, 0.0f, 0.0f));
+    __m128 b3 = _mm_xor_ps(_mm_shuffle_ps(b.v, b.v, _MM_SHUFFLE(2, 3, 0, 1)), _mm_set_ps(-0.0f, 0.0f, 0.0f, -0.0f));
+    __m128 r = _mm_mul_ps(_mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(3, 3, 3, 3)), b.v);
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(0, 0, 0, 0)), b1));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(1, 1, 1, 1)), b2));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(2, 2, 2, 2)), b3));
+    return (HglmQuat) {.v = r};
+#else
+    return (HglmQuat) {
+        .x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+        .y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+        .z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+        .w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+    };
+#endif
 }
 
-static HGL_INLINE float hglm_smoothstep(float t)
+static HGL_INLINE HglmQuat hglm_quat_conjugate(HglmQuat q)
 {
-    return t * t * (3.0f - 2.0f * t);
+#ifdef HGLM_USE_SIMD
+    return (HglmQuat) {.v = _mm_xor_ps(q.v, _mm_set_ps(0.0f, -0.0f, -0.0f, -0.0f))};
+#else
+    return hglm_quat_make(-q.x, -q.y, -q.z, q.w);
+#endif
 }
 
-static HGL_INLINE float hglm_smootherstep(float t)
+static HGL_INLINE HglmQuat hglm_quat_inverse(HglmQuat q)
 {
-    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+    HglmQuat c = hglm_quat_conjugate(q);
+    return (HglmQuat) {.xyzw = hglm_vec4_mul_scalar(c.xyzw, 1.0f / hglm_quat_dot(q, q))};
 }
 
-static HGL_INLINE float hglm_sinstep(float t)
+static HGL_INLINE float hglm_quat_dot(HglmQuat a, HglmQuat b)
 {
-    return -0.5f * cosf(t * (float)HGLM_PI) + 0.5f;
+    return hglm_vec4_dot(a.xyzw, b.xyzw);
 }
 
-static HGL_INLINE float hglm_lerpsmooth(float a, float b, float dt, float omega)
+static HGL_INLINE HglmQuat hglm_quat_normalize(HglmQuat q)
 {
-    return b + (a - b) * exp2f(-dt/omega);
+    return (HglmQuat) {.xyzw = hglm_vec4_normalize(q.xyzw)};
 }
 
-static HGL_INLINE float hglm_smoothmin_quadratic(float a, float b, float k)
+static HGL_INLINE HglmVec3 hglm_quat_rotate_vec3(HglmQuat q, HglmVec3 v)
 {
-    k *= 4.0f;
-    float h = fmaxf(k - fabsf(a - b), 0.0) / k;
-    return fminf(a, b) - h*h*k*0.25f;
+    /* v + w*t + u x t, where u = q.xyz and t = 2 * (u x v) */
+    HglmVec3 t = hglm_vec3_mul_scalar(hglm_vec3_cross(q.xyz, v), 2.0f);
+    return hglm_vec3_add(hglm_vec3_add(v, hglm_vec3_mul_scalar(t, q.w)), hglm_vec3_cross(q.xyz, t));
 }
 
-static HGL_INLINE float hglm_smoothmin_sigmoid(float a, float b, float k)
+static HGL_INLINE HglmQuat hglm_quat_nlerp(HglmQuat a, HglmQuat b, float t)
 {
-    k *= logf(2.0);
-    float x = b - a;
-    return a + x / (1.0f - exp2f(x / k));
+    float tb = (hglm_quat_dot(a, b) < 0.0f) ? -t : t;
+    HglmVec4 r = hglm_vec4_add(hglm_vec4_mul_scalar(a.xyzw, 1.0f - t), hglm_vec4_mul_scalar(b.xyzw, tb));
+    return (HglmQuat) {.xyzw = hglm_vec4_normalize(r)};
 }
 
-static HGL_INLINE HglmVec4 hglm_bezier3(float t)
+static HGL_INLINE HglmQuat hglm_quat_slerp(HglmQuat a, HglmQuat b, float t)
 {
-    HglmMat4 bezier3 = ((HglmMat4) {.m00 =  1.0f, .m01 =  0.0f, .m02 =  0.0f, .m03 =  0.0f,
-                                    .m10 = -3.0f, .m11 =  3.0f, .m12 =  0.0f, .m13 =  0.0f,
+    float d = hglm_quat_dot(a, b);
+    float sign = 1.0f;
+    if (d < 0.0f) {
+        d = -d;
+        sign = -1.0f;
+    }
+    if (d > 0.9995f) {
+        /* sin(omega) ~ 0. nlerp is indistinguishable here */
+        return hglm_quat_nlerp(a, b, t);
+    }
+    float omega = acosf(d);
+    float isin = 1.0f / HGLM_SINF_(omega);
+    float wa = HGLM_SINF_((1.0f - t) * omega) * isin;
+    float wb = HGLM_SINF_(t * omega) * isin * sign;
+    return (HglmQuat) {.xyzw = hglm_vec4_add(hglm_vec4_mul_scalar(a.xyzw, wa), hglm_vec4_mul_scalar(b.xyzw, wb))};
+}
+
+static HGL_INLINE HglmMat3 hglm_quat_to_mat3(HglmQuat q)
+{
+    float x2 = q.x + q.x, y2 = q.y + q.y, z2 = q.z + q.z;
+    float xx = q.x * x2, yy = q.y * y2, zz = q.z * z2;
+    float xy = q.x * y2, xz = q.x * z2, yz = q.y * z2;
+    float wx = q.w * x2, wy = q.w * y2, wz = q.w * z2;
+    return (HglmMat3) {
+        .m00 = 1.0f - (yy + zz), .m01 = xy - wz,          .m02 = xz + wy,
+        .m10 = xy + wz,          .m11 = 1.0f - (xx + zz), .m12 = yz - wx,
+        .m20 = xz - wy,          .m21 = yz + wx,          .m22 = 1.0f - (xx + yy),
+    };
+}
+
+static HGL_INLINE HglmMat4 hglm_quat_to_mat4(HglmQuat q)
+{
+    HglmMat3 m = hglm_quat_to_mat3(q);
+    return (HglmMat4) {
+        .c0 = {.x = m.m00, .y = m.m10, .z = m.m20, .w = 0.0f},
+        .c1 = {.x = m.m01, .y = m.m11, .z = m.m21, .w = 0.0f},
+        .c2 = {.x = m.m02, .y = m.m12, .z = m.m22, .w = 0.0f},
+        .c3 = {.x = 0.0f,  .y = 0.0f,  .z = 0.0f,  .w = 1.0f},
+    };
+}
+
+static HGL_INLINE HglmDualQuat hglm_dualquat_make(HglmQuat rotation, HglmVec3 translation)
+{
+    HglmQuat t = hglm_quat_make(0.5f * translation.x, 0.5f * translation.y, 0.5f * translation.z, 0.0f);
+    return (HglmDualQuat) {.real = rotation, .dual = hglm_quat_mul(t, rotation)};
+}
+
+static HGL_INLINE HglmVec3 hglm_dualquat_transform_point3(HglmDualQuat dq, HglmVec3 p)
+{
+    /* translation = 2 * (r.w*d.xyz - d.w*r.xyz + r.xyz x d.xyz) */
+    HglmQuat r = dq.real;
+    HglmQuat d = dq.dual;
+    HglmVec3 t = hglm_vec3_sub(hglm_vec3_mul_scalar(d.xyz, r.w), hglm_vec3_mul_scalar(r.xyz, d.w));
+    t = hglm_vec3_mul_scalar(hglm_vec3_add(t, hglm_vec3_cross(r.xyz, d.xyz)), 2.0f);
+    return hglm_vec3_add(hglm_quat_rotate_vec3(r, p), t);
+}
+
+
+/* ========== Skinning =======================================================*/
+
+/*
+ * Each vertex `i` is influenced by the joints `joints[i].x..w` with weights
+ * `weights[i].x..w` (which should sum to 1; unused slots get weight 0). The
+ * joint transforms are blended first, and the blend is then applied to the
+ * position (and normal). `normal` and `out_normal` may be NULL. Normals are
+ * renormalized, which is correct as long as the joints have no non-uniform
+ * scale. `out_pos` and `out_normal` may be the same arrays as `pos` and
+ * `normal`.
+ *
+ * Linear blend skinning blends matrices, which is fast, but volume collapses
+ * at strongly twisted joints ("candy wrapper"). Dual quaternion skinning
+ * blends rigid transforms, which avoids that, but can't do scaling.
+ */
+
+static HGL_INLINE void hglm_skin_linear_array(HglmVec3 *out_pos, HglmVec3 *out_normal,
+                                              const HglmVec3 *pos, const HglmVec3 *normal,
+                                              const HglmIVec4 *joints, const HglmVec4 *weights,
+                                              const HglmMat4 *joint_matrices, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        const HglmIVec4 j = joints[i];
+        const HglmVec4 w = weights[i];
+        const HglmMat4 *m0 = &joint_matrices[j.x];
+        const HglmMat4 *m1 = &joint_matrices[j.y];
+        const HglmMat4 *m2 = &joint_matrices[j.z];
+        const HglmMat4 *m3 = &joint_matrices[j.w];
+        HglmMat4 m;
+#ifdef HGLM_USE_SIMD
+        const __m128 w0 = _mm_shuffle_ps(w.v, w.v, _MM_SHUFFLE(0, 0, 0, 0));
+        const __m128 w1 = _mm_shuffle_ps(w.v, w.v, _MM_SHUFFLE(1, 1, 1, 1));
+        const __m128 w2 = _mm_shuffle_ps(w.v, w.v, _MM_SHUFFLE(2, 2, 2, 2));
+        const __m128 w3 = _mm_shuffle_ps(w.v, w.v, _MM_SHUFFLE(3, 3, 3, 3));
+        for (int c = 0; c < 16; c += 4) {
+            __m128 col = _mm_mul_ps(w0, _mm_load_ps(&m0->f[c]));
+            col = _mm_add_ps(col, _mm_mul_ps(w1, _mm_load_ps(&m1->f[c])));
+            col = _mm_add_ps(col, _mm_mul_ps(w2, _mm_load_ps(&m2->f[c])));
+            col = _mm_add_ps(col, _mm_mul_ps(w3, _mm_load_ps(&m3->f[c])));
+            _mm_store_ps(&m.f[c], col);
+        }
+#else
+        for (int k = 0; k < 16; k++) {
+            m.f[k] = w.x * m0->f[k] + w.y * m1->f[k] + w.z * m2->f[k] + w.w * m3->f[k];
+        }
+#endif
+        const HglmVec3 p = pos[i];
+        out_pos[i] = hglm_mat4_mul_vec4(m, hglm_vec4_make(p.x, p.y, p.z, 1.0f)).xyz;
+        if (normal != NULL && out_normal != NULL) {
+            const HglmVec3 nv = normal[i];
+            out_normal[i] = hglm_vec3_normalize(hglm_mat4_mul_vec4(m, hglm_vec4_make(nv.x, nv.y, nv.z, 0.0f)).xyz);
+        }
+    }
+}
+
+static HGL_INLINE void hglm_skin_dualquat_array(HglmVec3 *out_pos, HglmVec3 *out_normal,
+                                                const HglmVec3 *pos, const HglmVec3 *normal,
+                                                const HglmIVec4 *joints, const HglmVec4 *weights,
+                                                const HglmDualQuat *joint_dqs, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        const HglmIVec4 j = joints[i];
+        const HglmVec4 w = weights[i];
+        const HglmDualQuat *dq[4] = {&joint_dqs[j.x], &joint_dqs[j.y], &joint_dqs[j.z], &joint_dqs[j.w]};
+
+        /* q and -q are the same rotation: flip to the hemisphere of the first joint before blending */
+#ifdef HGLM_USE_SIMD
+        const __m128 r0 = dq[0]->real.v;
+        __m128 real = _mm_mul_ps(_mm_shuffle_ps(w.v, w.v, _MM_SHUFFLE(0, 0, 0, 0)), r0);
+        __m128 dual = _mm_mul_ps(_mm_shuffle_ps(w.v, w.v, _MM_SHUFFLE(0, 0, 0, 0)), dq[0]->dual.v);
+        for (int k = 1; k < 4; k++) {
+            __m128 sign = _mm_and_ps(_mm_dp_ps(r0, dq[k]->real.v, 0xFF), _mm_set1_ps(-0.0f));
+            __m128 wk = _mm_xor_ps(_mm_set1_ps(w.f[k]), sign);
+            real = _mm_add_ps(real, _mm_mul_ps(wk, dq[k]->real.v));
+            dual = _mm_add_ps(dual, _mm_mul_ps(wk, dq[k]->dual.v));
+        }
+        __m128 ilen = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_dp_ps(real, real, 0xFF)));
+        real = _mm_mul_ps(real, ilen);
+        dual = _mm_mul_ps(dual, ilen);
+
+        /* see hglm_dualquat_transform_point3 and hglm_quat_rotate_vec3 */
+        const __m128 rw = _mm_shuffle_ps(real, real, _MM_SHUFFLE(3, 3, 3, 3));
+        const __m128 dw = _mm_shuffle_ps(dual, dual, _MM_SHUFFLE(3, 3, 3, 3));
+        __m128 t = _mm_sub_ps(_mm_mul_ps(rw, dual), _mm_mul_ps(dw, real));
+        t = _mm_add_ps(t, hglm_cross_internal_(real, dual));
+        t = _mm_add_ps(t, t);
+
+        HglmVec4 p = {.v = _mm_set_ps(0.0f, pos[i].z, pos[i].y, pos[i].x)};
+        __m128 tp = hglm_cross_internal_(real, p.v);
+        tp = _mm_add_ps(tp, tp);
+        p.v = _mm_add_ps(_mm_add_ps(p.v, t), _mm_add_ps(_mm_mul_ps(rw, tp), hglm_cross_internal_(real, tp)));
+        out_pos[i] = p.xyz;
+        if (normal != NULL && out_normal != NULL) {
+            HglmVec4 nv = {.v = _mm_set_ps(0.0f, normal[i].z, normal[i].y, normal[i].x)};
+            __m128 tn = hglm_cross_internal_(real, nv.v);
+            tn = _mm_add_ps(tn, tn);
+            nv.v = _mm_add_ps(nv.v, _mm_add_ps(_mm_mul_ps(rw, tn), hglm_cross_internal_(real, tn)));
+            out_normal[i] = nv.xyz;
+        }
+#else
+        HglmVec4 real = hglm_vec4_mul_scalar(dq[0]->real.xyzw, w.x);
+        HglmVec4 dual = hglm_vec4_mul_scalar(dq[0]->dual.xyzw, w.x);
+        for (int k = 1; k < 4; k++) {
+            float wk = copysignf(w.f[k], hglm_vec4_dot(dq[0]->real.xyzw, dq[k]->real.xyzw));
+            real = hglm_vec4_add(real, hglm_vec4_mul_scalar(dq[k]->real.xyzw, wk));
+            dual = hglm_vec4_add(dual, hglm_vec4_mul_scalar(dq[k]->dual.xyzw, wk));
+        }
+
+        float ilen = 1.0f / hglm_vec4_len(real);
+        HglmDualQuat b = {
+            .real = {.xyzw = hglm_vec4_mul_scalar(real, ilen)},
+            .dual = {.xyzw = hglm_vec4_mul_scalar(dual, ilen)},
+        };
+        out_pos[i] = hglm_dualquat_transform_point3(b, pos[i]);
+        if (normal != NULL && out_normal != NULL) {
+            out_normal[i] = hglm_quat_rotate_vec3(b.real, normal[i]);
+        }
+#endif
+    }
+}
+
+
+/* ========== CPU feature detection ==========================================*/
+
+/* -1 until detected. Like everything in hglm.h, this is per translation unit. */
+static int hglm_cpu_level_internal_ = -1;
+
+static inline HglmCpuLevel hglm_cpu_detect_internal_(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    int avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if (avx2 && __builtin_cpu_supports("avx512f")) return HGLM_CPU_AVX512;
+    if (avx2) return HGLM_CPU_AVX2;
+    if (__builtin_cpu_supports("sse4.1")) return HGLM_CPU_SSE4;
+#endif
+    return HGLM_CPU_SCALAR;
+}
+
+static HGL_INLINE HglmCpuLevel hglm_cpu_level(void)
+{
+    int level = __atomic_load_n(&hglm_cpu_level_internal_, __ATOMIC_RELAXED);
+    if (level < 0) {
+        level = hglm_cpu_detect_internal_();
+        __atomic_store_n(&hglm_cpu_level_internal_, level, __ATOMIC_RELAXED);
+    }
+    return (HglmCpuLevel) level;
+}
+
+static HGL_INLINE void hglm_cpu_level_set(HglmCpuLevel level)
+{
+    HglmCpuLevel max = hglm_cpu_detect_internal_();
+    __atomic_store_n(&hglm_cpu_level_internal_, (level < max) ? level : max, __ATOMIC_RELAXED);
+}
+
+/* ========== Batch (array) functions =======================================*/
+
+/*
+ * The `_array` functions operate on `n` consecutive (AoS) vectors, the `_soa`
+ * functions on `n` vectors stored as one array per component. With AVX, 8
+ * vectors are processed at a time. `out` may be the same array as `in`.
+ */
+
+#ifdef HGLM_X8_
+
+static inline HGLM_TARGET_AVX2_ __m256 hglm_madd8_internal_(__m256 a, __m256 b, __m256 c)
+{
+#if defined(__FMA__) || defined(HGLM_DISPATCH_)
+    return _mm256_fmadd_ps(a, b, c);
+#else
+    return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+
+/* Broadcasts the 16 elements of `m` (column-major) into `mb` */
+static inline HGLM_TARGET_AVX2_ void hglm_mat4_broadcast8_internal_(__m256 mb[16], const HglmMat4 *m)
+{
+    for (int i = 0; i < 16; i++) {
+        mb[i] = _mm256_broadcast_ss(&m->f[i]);
+    }
+}
+
+/* v = m * v for 8 vectors in SoA form (v[0] = x0..x7, v[1] = y0..y7, etc.) */
+static inline HGLM_TARGET_AVX2_ void hglm_mat4_mul_x8_internal_(const __m256 mb[16], __m256 v[4])
+{
+    __m256 r[4];
+    for (int i = 0; i < 4; i++) {
+        r[i] = _mm256_mul_ps(mb[12 + i], v[3]);
+        r[i] = hglm_madd8_internal_(mb[8 + i], v[2], r[i]);
+        r[i] = hglm_madd8_internal_(mb[4 + i], v[1], r[i]);
+        r[i] = hglm_madd8_internal_(mb[0 + i], v[0], r[i]);
+    }
+    v[0] = r[0]; v[1] = r[1]; v[2] = r[2]; v[3] = r[3];
+}
+
+/* 4x4 transpose within each 128-bit lane */
+static inline HGLM_TARGET_AVX2_ void hglm_transpose4x8_internal_(__m256 v[4])
+{
+    __m256 t0 = _mm256_unpacklo_ps(v[0], v[1]);
+    __m256 t1 = _mm256_unpackhi_ps(v[0], v[1]);
+    __m256 t2 = _mm256_unpacklo_ps(v[2], v[3]);
+    __m256 t3 = _mm256_unpackhi_ps(v[2], v[3]);
+    v[0] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    v[1] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    v[2] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    v[3] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+/* Loads p[0..7] into v as SoA */
+static inline HGLM_TARGET_AVX2_ void hglm_vec4_load8_internal_(__m256 v[4], const HglmVec4 *p)
+{
+    for (int i = 0; i < 4; i++) {
+        v[i] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_load_ps(p[i].f)), _mm_load_ps(p[i + 4].f), 1);
+    }
+    hglm_transpose4x8_internal_(v);
+}
+
+/* Stores v (SoA) to p[0..7] */
+static inline HGLM_TARGET_AVX2_ void hglm_vec4_store8_internal_(HglmVec4 *p, __m256 v[4])
+{
+    hglm_transpose4x8_internal_(v);
+    for (int i = 0; i < 4; i++) {
+        _mm_store_ps(p[i].f,     _mm256_castps256_ps128(v[i]));
+        _mm_store_ps(p[i + 4].f, _mm256_extractf128_ps(v[i], 1));
+    }
+}
+
+/* Loads p[0..7] into v as SoA. See Intel's "3D Vector Normalization Using 256-Bit Intel AVX" */
+static inline HGLM_TARGET_AVX2_ void hglm_vec3_load8_internal_(__m256 v[3], const HglmVec3 *p)
+{
+    const float *f = &p[0].x;
+    __m256 m03 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&f[0])), _mm_loadu_ps(&f[12]), 1);
+    __m256 m14 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&f[4])), _mm_loadu_ps(&f[16]), 1);
+    __m256 m25 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&f[8])), _mm_loadu_ps(&f[20]), 1);
+    __m256 xy  = _mm256_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2));
+    __m256 yz  = _mm256_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1));
+    v[0] = _mm256_shuffle_ps(m03, xy, _MM_SHUFFLE(2, 0, 3, 0));
+    v[1] = _mm256_shuffle_ps(yz,  xy, _MM_SHUFFLE(3, 1, 2, 0));
+    v[2] = _mm256_shuffle_ps(yz, m25, _MM_SHUFFLE(3, 0, 3, 1));
+}
+
+/* Stores v (SoA) to p[0..7] */
+static inline HGLM_TARGET_AVX2_ void hglm_vec3_store8_internal_(HglmVec3 *p, const __m256 v[3])
+{
+    float *f = &p[0].x;
+    __m256 xy  = _mm256_shuffle_ps(v[0], v[1], _MM_SHUFFLE(2, 0, 2, 0));
+    __m256 yz  = _mm256_shuffle_ps(v[1], v[2], _MM_SHUFFLE(3, 1, 3, 1));
+    __m256 zx  = _mm256_shuffle_ps(v[2], v[0], _MM_SHUFFLE(3, 1, 2, 0));
+    __m256 m03 = _mm256_shuffle_ps(xy, zx, _MM_SHUFFLE(2, 0, 2, 0));
+    __m256 m14 = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+    __m256 m25 = _mm256_shuffle_ps(zx, yz, _MM_SHUFFLE(3, 1, 3, 1));
+    _mm_storeu_ps(&f[0],  _mm256_castps256_ps128(m03));
+    _mm_storeu_ps(&f[4],  _mm256_castps256_ps128(m14));
+    _mm_storeu_ps(&f[8],  _mm256_castps256_ps128(m25));
+    _mm_storeu_ps(&f[12], _mm256_extractf128_ps(m03, 1));
+    _mm_storeu_ps(&f[16], _mm256_extractf128_ps(m14, 1));
+    _mm_storeu_ps(&f[20], _mm256_extractf128_ps(m25, 1));
+}
+
+enum
+{
+    HGLM_BATCH_MUL_,        /* v = m * v                          */
+    HGLM_BATCH_POINT_,      /* v = m * (v.xyz, 1)                 */
+    HGLM_BATCH_DIR_,        /* v = m * (v.xyz, 0)                 */
+    HGLM_BATCH_PROJECT_,    /* v = m * v, followed by x,y,z /= w  */
+    HGLM_BATCH_NORMALIZE3_, /* v.xyz /= |v.xyz|                   */
+    HGLM_BATCH_NORMALIZE4_, /* v /= |v|                           */
+};
+
+/* Applies `op` to 8 vectors in SoA form */
+static inline HGLM_TARGET_AVX2_ void hglm_batch_op8_internal_(__m256 v[4], const __m256 mb[16], int op)
+{
+    switch (op) {
+        case HGLM_BATCH_POINT_: v[3] = _mm256_set1_ps(1.0f); hglm_mat4_mul_x8_internal_(mb, v); break;
+        case HGLM_BATCH_DIR_:   v[3] = _mm256_setzero_ps();  hglm_mat4_mul_x8_internal_(mb, v); break;
+        case HGLM_BATCH_MUL_:   hglm_mat4_mul_x8_internal_(mb, v); break;
+        case HGLM_BATCH_PROJECT_: {
+            hglm_mat4_mul_x8_internal_(mb, v);
+            v[0] = _mm256_div_ps(v[0], v[3]);
+            v[1] = _mm256_div_ps(v[1], v[3]);
+            v[2] = _mm256_div_ps(v[2], v[3]);
+        } break;
+        case HGLM_BATCH_NORMALIZE3_:
+        case HGLM_BATCH_NORMALIZE4_: {
+            int n_comps = (op == HGLM_BATCH_NORMALIZE4_) ? 4 : 3;
+            __m256 len2 = _mm256_mul_ps(v[0], v[0]);
+            for (int i = 1; i < n_comps; i++) {
+                len2 = hglm_madd8_internal_(v[i], v[i], len2);
+            }
+            __m256 ilen = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(len2));
+            for (int i = 0; i < n_comps; i++) {
+                v[i] = _mm256_mul_ps(v[i], ilen);
+            }
+        } break;
+    }
+}
+
+/* The 8-wide loops below return how many of the `n` vectors they processed (a multiple of 8) */
+static inline HGLM_TARGET_AVX2_ size_t hglm_vec4_array_x8_internal_(HglmVec4 *out, const HglmMat4 *m,
+                                                                    const HglmVec4 *in, size_t n, int op)
+{
+    __m256 mb[16];
+    hglm_mat4_broadcast8_internal_(mb, m);
+    size_t i = 0;
+    for (; i < (n & ~(size_t) 7); i += 8) {
+        __m256 v[4];
+        hglm_vec4_load8_internal_(v, &in[i]);
+        hglm_batch_op8_internal_(v, mb, op);
+        hglm_vec4_store8_internal_(&out[i], v);
+    }
+    return i;
+}
+
+static inline HGLM_TARGET_AVX2_ size_t hglm_vec3_array_x8_internal_(HglmVec3 *out, const HglmMat4 *m,
+                                                                    const HglmVec3 *in, size_t n, int op)
+{
+    __m256 mb[16];
+    hglm_mat4_broadcast8_internal_(mb, m);
+    size_t i = 0;
+    for (; i < (n & ~(size_t) 7); i += 8) {
+        __m256 v[4];
+        hglm_vec3_load8_internal_(v, &in[i]);
+        v[3] = _mm256_setzero_ps();
+        hglm_batch_op8_internal_(v, mb, op);
+        hglm_vec3_store8_internal_(&out[i], v);
+    }
+    return i;
+}
+
+static inline HGLM_TARGET_AVX2_ size_t hglm_soa_x8_internal_(HglmVec4SoA out, const HglmMat4 *m,
+                                                             HglmVec4SoA in, size_t n, int op)
+{
+    __m256 mb[16];
+    hglm_mat4_broadcast8_internal_(mb, m);
+    size_t i = 0;
+    for (; i < (n & ~(size_t) 7); i += 8) {
+        __m256 v[4] = {
+            _mm256_loadu_ps(&in.x[i]), _mm256_loadu_ps(&in.y[i]), _mm256_loadu_ps(&in.z[i]),
+            (in.w != NULL) ? _mm256_loadu_ps(&in.w[i]) : _mm256_setzero_ps(),
+        };
+        hglm_batch_op8_internal_(v, mb, op);
+        _mm256_storeu_ps(&out.x[i], v[0]);
+        _mm256_storeu_ps(&out.y[i], v[1]);
+        _mm256_storeu_ps(&out.z[i], v[2]);
+        if (out.w != NULL) _mm256_storeu_ps(&out.w[i], v[3]);
+    }
+    return i;
+}
+
+static inline HGLM_TARGET_AVX2_ size_t hglm_vec3_dot_array_x8_internal_(float *out, const HglmVec3 *a,
+                                                                        const HglmVec3 *b, size_t n)
+{
+    size_t i = 0;
+    for (; i < (n & ~(size_t) 7); i += 8) {
+        __m256 va[3], vb[3];
+        hglm_vec3_load8_internal_(va, &a[i]);
+        hglm_vec3_load8_internal_(vb, &b[i]);
+        __m256 d = _mm256_mul_ps(va[0], vb[0]);
+        d = hglm_madd8_internal_(va[1], vb[1], d);
+        d = hglm_madd8_internal_(va[2], vb[2], d);
+        _mm256_storeu_ps(&out[i], d);
+    }
+    return i;
+}
+
+static inline HGLM_TARGET_AVX2_ size_t hglm_vec4_dot_array_x8_internal_(float *out, const HglmVec4 *a,
+                                                                        const HglmVec4 *b, size_t n)
+{
+    size_t i = 0;
+    for (; i < (n & ~(size_t) 7); i += 8) {
+        __m256 va[4], vb[4];
+        hglm_vec4_load8_internal_(va, &a[i]);
+        hglm_vec4_load8_internal_(vb, &b[i]);
+        __m256 d = _mm256_mul_ps(va[0], vb[0]);
+        d = hglm_madd8_internal_(va[1], vb[1], d);
+        d = hglm_madd8_internal_(va[2], vb[2], d);
+        d = hglm_madd8_internal_(va[3], vb[3], d);
+        _mm256_storeu_ps(&out[i], d);
+    }
+    return i;
+}
+
+static inline HGLM_TARGET_AVX2_ size_t hglm_vec3_dot_soa_x8_internal_(float *out, HglmVec3SoA a,
+                                                                      HglmVec3SoA b, size_t n)
+{
+    size_t i = 0;
+    for (; i < (n & ~(size_t) 7); i += 8) {
+        __m256 d = _mm256_mul_ps(_mm256_loadu_ps(&a.x[i]), _mm256_loadu_ps(&b.x[i]));
+        d = hglm_madd8_internal_(_mm256_loadu_ps(&a.y[i]), _mm256_loadu_ps(&b.y[i]), d);
+        d = hglm_madd8_internal_(_mm256_loadu_ps(&a.z[i]), _mm256_loadu_ps(&b.z[i]), d);
+        _mm256_storeu_ps(&out[i], d);
+    }
+    return i;
+}
+
+#endif /* HGLM_X8_ */
+
+static HGL_INLINE void hglm_mat4_mul_vec4_array(HglmVec4 *out, HglmMat4 m, const HglmVec4 *in, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_X8_
+    if (HGLM_X8_ENABLED_) i = hglm_vec4_array_x8_internal_(out, &m, in, n, HGLM_BATCH_MUL_);
+#endif
+    for (; i < n; i++) {
+        out[i] = hglm_mat4_mul_vec4(m, in[i]);
+    }
+}
+
+static HGL_INLINE void hglm_mat4_mul_mat4_array(HglmMat4 *out, HglmMat4 m, const HglmMat4 *in, size_t n)
+{
+    /* m * in[i] is m times each column of in[i], and the columns of consecutive HglmMat4s are consecutive HglmVec4s */
+    hglm_mat4_mul_vec4_array(&out[0].c0, m, &in[0].c0, 4*n);
+}
+
+static HGL_INLINE void hglm_mat4_transform_point3_array(HglmVec3 *out, HglmMat4 m, const HglmVec3 *in, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_X8_
+    if (HGLM_X8_ENABLED_) i = hglm_vec3_array_x8_internal_(out, &m, in, n, HGLM_BATCH_POINT_);
+#endif
+    for (; i < n; i++) {
+        out[i] = hglm_mat4_mul_vec4(m, hglm_vec4_make(in[i].x, in[i].y, in[i].z, 1.0f)).xyz;
+    }
+}
+
+static HGL_INLINE void hglm_mat4_transform_dir3_array(HglmVec3 *out, HglmMat4 m, const HglmVec3 *in, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_X8_
+    if (HGLM_X8_ENABLED_) i = hglm_vec3_array_x8_internal_(out, &m, in, n, HGLM_BATCH_DIR_);
+#endif
+    for (; i < n; i++) {
+        out[i] = hglm_mat4_mul_vec4(m, hglm_vec4_make(in[i].x, in[i].y, in[i].z, 0.0f)).xyz;
+    }
+}
+
+static HGL_INLINE void hglm_mat4_perspective_project_array(HglmVec4 *out, HglmMat4 proj, const HglmVec4 *in, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_X8_
+    if (HGLM_X8_ENABLED_) i = hglm_vec4_array_x8_internal_(out, &proj, in, n, HGLM_BATCH_PROJECT_);
+#endif
+    for (; i < n; i++) {
+        out[i] = hglm_mat4_perspective_project(proj, in[i]);
+    }
+}
+
+static HGL_INLINE void hglm_vec3_normalize_array(HglmVec3 *out, const HglmVec3 *in, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_X8_
+    if (HGLM_X8_ENABLED_) i = hglm_vec3_array_x8_internal_(out, &HGLM_MAT4_IDENTITY, in, n, HGLM_BATCH_NORMALIZE3_);
+#endif
+    for (; i < n; i++) {
+        out[i] = hglm_vec3_normalize(in[i]);
+    }
+}
+
+static HGL_INLINE void hglm_vec4_normalize_array(HglmVec4 *out, const HglmVec4 *in, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_X8_
+    if (HGLM_X8_ENABLED_) i = hglm_vec4_array_x8_internal_(out, &HGLM_MAT4_IDENTITY, in, n, HGLM_BATCH_NORMALIZE4_);
+#endif
+    for (; i < n; i++) {
+        out[i] = hglm_vec4_normalize(in[i]);
+    }
+}
+
+static HGL_INLINE void hglm_vec3_dot_array(float *out, const HglmVec3 *a, const HglmVec3 *b, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_X8_
+    if (HGLM_X8_ENABLED_) i = hglm_vec3_dot_array_x8_internal_(out, a, b, n);
+#endif
+    for (; i < n; i++) {
+        out[i] = hglm_vec3_dot(a[i], b[i]);
+    }
+}
+
+static HGL_INLINE void hglm_vec4_dot_array(float *out, const HglmVec4 *a, const HglmVec4 *b, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_X8_
+    if (HGLM_X8_ENABLED_) i = hglm_vec4_dot_array_x8_internal_(out, a, b, n);
+#endif
+    for (; i < n; i++) {
+        out[i] = hglm_vec4_dot(a[i], b[i]);
+    }
+}
+
+static HGL_INLINE void hglm_mat4_mul_vec4_soa(HglmVec4SoA out, HglmMat4 m, HglmVec4SoA in, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_X8_
+    if (HGLM_X8_ENABLED_) i = hglm_soa_x8_internal_(out, &m, in, n, HGLM_BATCH_MUL_);
+#endif
+    for (; i < n; i++) {
+        HglmVec4 u = hglm_mat4_mul_vec4(m, hglm_vec4_make(in.x[i], in.y[i], in.z[i], in.w[i]));
+        out.x[i] = u.x;
+        out.y[i] = u.y;
+        out.z[i] = u.z;
+        out.w[i] = u.w;
+    }
+}
+
+static HGL_INLINE void hglm_mat4_transform_point3_soa(HglmVec3SoA out, HglmMat4 m, HglmVec3SoA in, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_X8_
+    if (HGLM_X8_ENABLED_) {
+        HglmVec4SoA out4 = {.x = out.x, .y = out.y, .z = out.z, .w = NULL};
+        HglmVec4SoA in4  = {.x = in.x,  .y = in.y,  .z = in.z,  .w = NULL};
+        i = hglm_soa_x8_internal_(out4, &m, in4, n, HGLM_BATCH_POINT_);
+    }
+#endif
+    for (; i < n; i++) {
+        HglmVec4 u = hglm_mat4_mul_vec4(m, hglm_vec4_make(in.x[i], in.y[i], in.z[i], 1.0f));
+        out.x[i] = u.x;
+        out.y[i] = u.y;
+        out.z[i] = u.z;
+    }
+}
+
+static HGL_INLINE void hglm_mat4_transform_dir3_soa(HglmVec3SoA out, HglmMat4 m, HglmVec3SoA in, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_X8_
+    if (HGLM_X8_ENABLED_) {
+        HglmVec4SoA out4 = {.x = out.x, .y = out.y, .z = out.z, .w = NULL};
+        HglmVec4SoA in4  = {.x = in.x,  .y = in.y,  .z = in.z,  .w = NULL};
+        i = hglm_soa_x8_internal_(out4, &m, in4, n, HGLM_BATCH_DIR_);
+    }
+#endif
+    for (; i < n; i++) {
+        HglmVec4 u = hglm_mat4_mul_vec4(m, hglm_vec4_make(in.x[i], in.y[i], in.z[i], 0.0f));
+        out.x[i] = u.x;
+        out.y[i] = u.y;
+        out.z[i] = u.z;
+    }
+}
+
+static HGL_INLINE void hglm_mat4_perspective_project_soa(HglmVec4SoA out, HglmMat4 proj, HglmVec4SoA in, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_X8_
+    if (HGLM_X8_ENABLED_) i = hglm_soa_x8_internal_(out, &proj, in, n, HGLM_BATCH_PROJECT_);
+#endif
+    for (; i < n; i++) {
+        HglmVec4 u = hglm_mat4_perspective_project(proj, hglm_vec4_make(in.x[i], in.y[i], in.z[i], in.w[i]));
+        out.x[i] = u.x;
+        out.y[i] = u.y;
+        out.z[i] = u.z;
+        out.w[i] = u.w;
+    }
+}
+
+static HGL_INLINE void hglm_vec3_normalize_soa(HglmVec3SoA out, HglmVec3SoA in, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_X8_
+    if (HGLM_X8_ENABLED_) {
+        HglmVec4SoA out4 = {.x = out.x, .y = out.y, .z = out.z, .w = NULL};
+        HglmVec4SoA in4  = {.x = in.x,  .y = in.y,  .z = in.z,  .w = NULL};
+        i = hglm_soa_x8_internal_(out4, &HGLM_MAT4_IDENTITY, in4, n, HGLM_BATCH_NORMALIZE3_);
+    }
+#endif
+    for (; i < n; i++) {
+        HglmVec3 u = hglm_vec3_normalize(hglm_vec3_make(in.x[i], in.y[i], in.z[i]));
+        out.x[i] = u.x;
+        out.y[i] = u.y;
+        out.z[i] = u.z;
+    }
+}
+
+static HGL_INLINE void hglm_vec3_dot_soa(float *out, HglmVec3SoA a, HglmVec3SoA b, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_X8_
+    if (HGLM_X8_ENABLED_) i = hglm_vec3_dot_soa_x8_internal_(out, a, b, n);
+#endif
+    for (; i < n; i++) {
+        out[i] = a.x[i] * b.x[i] + a.y[i] * b.y[i] + a.z[i] * b.z[i];
+    }
+}
+
+/* ========== Bounding volumes & culling =====================================*/
+
+/*
+ * The batch tests write one bit per volume to `mask` (bit i & 7 of byte i >> 3), set if
+ * the volume is (at least partially) inside the frustum, or hit by the ray. `mask` must
+ * hold (n + 7) / 8 bytes. With AVX, 8 volumes are tested at a time, one byte per iteration.
+ */
+
+#define hglm_mask_test(mask, i) (((mask)[(i) >> 3] >> ((i) & 7)) & 1)
+
+static inline void hglm_mask_set_internal_(uint8_t *mask, size_t i, int bit)
+{
+    uint8_t b = (uint8_t) (1u << (i & 7));
+    mask[i >> 3] = bit ? (mask[i >> 3] | b) : (mask[i >> 3] & (uint8_t) ~b);
+}
+
+static HGL_INLINE HglmPlane hglm_plane_make(HglmVec3 normal, HglmVec3 point)
+{
+    HglmVec3 n = hglm_vec3_normalize(normal);
+    return (HglmPlane) {.n = n, .d = -hglm_vec3_dot(n, point)};
+}
+
+static HGL_INLINE float hglm_plane_distance(HglmPlane p, HglmVec3 point)
+{
+    return hglm_vec3_dot(p.n, point) + p.d;
+}
+
+/*
+ * Gribb-Hartmann: each plane is the sum or difference of the last row of `m` and one
+ * of the others, for clip space -w <= x, y, z <= w (as `hglm_mat4_make_perspective`).
+ * The planes are normalized, so `hglm_plane_distance` gives the actual distance.
+ */
+static HGL_INLINE HglmFrustum hglm_frustum_make_from_mat4(HglmMat4 m)
+{
+    const float r[4][4] = {
+        {m.m00, m.m01, m.m02, m.m03},
+        {m.m10, m.m11, m.m12, m.m13},
+        {m.m20, m.m21, m.m22, m.m23},
+        {m.m30, m.m31, m.m32, m.m33},
+    };
+    HglmFrustum f;
+    for (int i = 0; i < 6; i++) {
+        float s = (i & 1) ? -1.0f : 1.0f;
+        const float *ri = r[i >> 1];
+        HglmVec3 n = hglm_vec3_make(r[3][0] + s*ri[0], r[3][1] + s*ri[1], r[3][2] + s*ri[2]);
+        float inv_len = 1.0f / hglm_vec3_len(n);
+        f.planes[i] = (HglmPlane) {.n = hglm_vec3_mul_scalar(n, inv_len), .d = (r[3][3] + s*ri[3]) * inv_len};
+    }
+    return f;
+}
+
+/*
+ * (a.x*b.x + a.y*b.y) + a.z*b.z, rounded after every operation, like `hglm_dot8_internal_`. The
+ * volatile temporaries keep the compiler from contracting it into FMAs, which GCC does by default
+ * in the GNU C modes (-ffp-contract=fast).
+ */
+static HGL_INLINE float hglm_dot3_unfused_internal_(float ax, float ay, float az, float bx, float by, float bz)
+{
+    volatile float x = ax*bx;
+    volatile float y = ay*by;
+    volatile float z = az*bz;
+    volatile float xy = x + y;
+    return xy + z;
+}
+
+static HGL_INLINE int hglm_frustum_test_aabb(HglmFrustum f, HglmAABB box)
+{
+    HglmVec3 c = hglm_vec3_mul_scalar(hglm_vec3_add(box.min, box.max), 0.5f);
+    HglmVec3 e = hglm_vec3_mul_scalar(hglm_vec3_sub(box.max, box.min), 0.5f);
+    for (int i = 0; i < 6; i++) {
+        HglmPlane p = f.planes[i];
+        float s = hglm_dot3_unfused_internal_(p.n.x, p.n.y, p.n.z, c.x, c.y, c.z);
+        float r = hglm_dot3_unfused_internal_(fabsf(p.n.x), fabsf(p.n.y), fabsf(p.n.z), e.x, e.y, e.z);
+        if ((s + p.d) + r < 0.0f) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static HGL_INLINE int hglm_frustum_test_sphere(HglmFrustum f, HglmVec3 center, float radius)
+{
+    for (int i = 0; i < 6; i++) {
+        HglmPlane p = f.planes[i];
+        float s = hglm_dot3_unfused_internal_(p.n.x, p.n.y, p.n.z, center.x, center.y, center.z);
+        if ((s + p.d) + radius < 0.0f) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Slab test: hit if the ray origin + t*dir enters the box for some t in [0, t_max] */
+static HGL_INLINE int hglm_ray_test_aabb(HglmVec3 origin, HglmVec3 dir, float t_max, HglmAABB box)
+{
+    const float o[3]    = {origin.x, origin.y, origin.z};
+    const float d[3]    = {dir.x, dir.y, dir.z};
+    const float bmin[3] = {box.min.x, box.min.y, box.min.z};
+    const float bmax[3] = {box.max.x, box.max.y, box.max.z};
+    float t0 = 0.0f;
+    float t1 = t_max;
+    for (int i = 0; i < 3; i++) {
+        float inv = 1.0f / d[i];
+        float ta = (bmin[i] - o[i]) * inv;
+        float tb = (bmax[i] - o[i]) * inv;
+        float tn = (ta < tb) ? ta : tb;
+        float tf = (ta > tb) ? ta : tb;
+        t0 = (tn > t0) ? tn : t0;
+        t1 = (tf < t1) ? tf : t1;
+    }
+    return t0 <= t1;
+}
+
+#ifdef HGLM_X8_
+/*
+ * The culling kernels round exactly like `hglm_frustum_test_aabb` and `hglm_frustum_test_sphere`
+ * (unfused, same order), so a volume touching a plane gets the same result on both paths. GCC
+ * contracts vector intrinsics too, so the empty asm hides the products from it. Reassociation
+ * (-ffast-math) still breaks this, on both paths.
+ */
+static inline HGLM_TARGET_AVX2_ __m256 hglm_dot8_internal_(__m256 ax, __m256 ay, __m256 az,
+                                                          __m256 bx, __m256 by, __m256 bz)
+{
+    __m256 x = _mm256_mul_ps(ax, bx);
+    __m256 y = _mm256_mul_ps(ay, by);
+    __m256 z = _mm256_mul_ps(az, bz);
+    __asm__ ("" : "+x" (x), "+x" (y), "+x" (z));
+    return _mm256_add_ps(_mm256_add_ps(x, y), z);
+}
+
+static inline HGLM_TARGET_AVX2_ size_t hglm_frustum_aabb_x8_internal_(uint8_t *mask, const HglmFrustum *f,
+                                                                      HglmVec3SoA bmin, HglmVec3SoA bmax,
+                                                                      size_t n)
+{
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    size_t i = 0;
+    for (; i < (n & ~(size_t) 7); i += 8) {
+        __m256 min_x = _mm256_loadu_ps(&bmin.x[i]), max_x = _mm256_loadu_ps(&bmax.x[i]);
+        __m256 min_y = _mm256_loadu_ps(&bmin.y[i]), max_y = _mm256_loadu_ps(&bmax.y[i]);
+        __m256 min_z = _mm256_loadu_ps(&bmin.z[i]), max_z = _mm256_loadu_ps(&bmax.z[i]);
+        __m256 cx = _mm256_mul_ps(_mm256_add_ps(min_x, max_x), half);
+        __m256 cy = _mm256_mul_ps(_mm256_add_ps(min_y, max_y), half);
+        __m256 cz = _mm256_mul_ps(_mm256_add_ps(min_z, max_z), half);
+        __m256 ex = _mm256_mul_ps(_mm256_sub_ps(max_x, min_x), half);
+        __m256 ey = _mm256_mul_ps(_mm256_sub_ps(max_y, min_y), half);
+        __m256 ez = _mm256_mul_ps(_mm256_sub_ps(max_z, min_z), half);
+        __m256 outside = _mm256_setzero_ps();
+        for (int p = 0; p < 6; p++) {
+            const HglmPlane *pl = &f->planes[p];
+            __m256 nx = _mm256_set1_ps(pl->n.x);
+            __m256 ny = _mm256_set1_ps(pl->n.y);
+            __m256 nz = _mm256_set1_ps(pl->n.z);
+            __m256 s = hglm_dot8_internal_(nx, ny, nz, cx, cy, cz);
+            __m256 r = hglm_dot8_internal_(_mm256_andnot_ps(sign, nx), _mm256_andnot_ps(sign, ny),
+                                           _mm256_andnot_ps(sign, nz), ex, ey, ez);
+            s = _mm256_add_ps(_mm256_add_ps(s, _mm256_set1_ps(pl->d)), r);
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(s, _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
+        mask[i >> 3] = (uint8_t) ~_mm256_movemask_ps(outside);
+    }
+    return i;
+}
+
+static inline HGLM_TARGET_AVX2_ size_t hglm_frustum_sphere_x8_internal_(uint8_t *mask, const HglmFrustum *f,
+                                                                        HglmVec3SoA center, const float *radius,
+                                                                        size_t n)
+{
+    size_t i = 0;
+    for (; i < (n & ~(size_t) 7); i += 8) {
+        __m256 cx = _mm256_loadu_ps(&center.x[i]);
+        __m256 cy = _mm256_loadu_ps(&center.y[i]);
+        __m256 cz = _mm256_loadu_ps(&center.z[i]);
+        __m256 r  = _mm256_loadu_ps(&radius[i]);
+        __m256 outside = _mm256_setzero_ps();
+        for (int p = 0; p < 6; p++) {
+            const HglmPlane *pl = &f->planes[p];
+            __m256 s = hglm_dot8_internal_(_mm256_set1_ps(pl->n.x), _mm256_set1_ps(pl->n.y),
+                                           _mm256_set1_ps(pl->n.z), cx, cy, cz);
+            s = _mm256_add_ps(_mm256_add_ps(s, _mm256_set1_ps(pl->d)), r);
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(s, _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
+        mask[i >> 3] = (uint8_t) ~_mm256_movemask_ps(outside);
+    }
+    return i;
+}
+
+static inline HGLM_TARGET_AVX2_ size_t hglm_ray_aabb_x8_internal_(uint8_t *mask, HglmVec3 origin, HglmVec3 dir,
+                                                                  float t_max, HglmVec3SoA bmin,
+                                                                  HglmVec3SoA bmax, size_t n)
+{
+    const __m256 ox = _mm256_set1_ps(origin.x), ix = _mm256_set1_ps(1.0f / dir.x);
+    const __m256 oy = _mm256_set1_ps(origin.y), iy = _mm256_set1_ps(1.0f / dir.y);
+    const __m256 oz = _mm256_set1_ps(origin.z), iz = _mm256_set1_ps(1.0f / dir.z);
+    size_t i = 0;
+    for (; i < (n & ~(size_t) 7); i += 8) {
+        __m256 t0 = _mm256_setzero_ps();
+        __m256 t1 = _mm256_set1_ps(t_max);
+        __m256 ta, tb;
+        ta = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&bmin.x[i]), ox), ix);
+        tb = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&bmax.x[i]), ox), ix);
+        t0 = _mm256_max_ps(_mm256_min_ps(ta, tb), t0);
+        t1 = _mm256_min_ps(_mm256_max_ps(ta, tb), t1);
+        ta = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&bmin.y[i]), oy), iy);
+        tb = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&bmax.y[i]), oy), iy);
+        t0 = _mm256_max_ps(_mm256_min_ps(ta, tb), t0);
+        t1 = _mm256_min_ps(_mm256_max_ps(ta, tb), t1);
+        ta = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&bmin.z[i]), oz), iz);
+        tb = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&bmax.z[i]), oz), iz);
+        t0 = _mm256_max_ps(_mm256_min_ps(ta, tb), t0);
+        t1 = _mm256_min_ps(_mm256_max_ps(ta, tb), t1);
+        mask[i >> 3] = (uint8_t) _mm256_movemask_ps(_mm256_cmp_ps(t0, t1, _CMP_LE_OQ));
+    }
+    return i;
+}
+#endif /* HGLM_X8_ */
+
+static HGL_INLINE void hglm_frustum_test_aabb_soa(uint8_t *mask, HglmFrustum f, HglmVec3SoA min,
+                                                  HglmVec3SoA max, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_X8_
+    if (HGLM_X8_ENABLED_) i = hglm_frustum_aabb_x8_internal_(mask, &f, min, max, n);
+#endif
+    for (; i < n; i++) {
+        HglmAABB box = {
+            .min = hglm_vec3_make(min.x[i], min.y[i], min.z[i]),
+            .max = hglm_vec3_make(max.x[i], max.y[i], max.z[i]),
+        };
+        hglm_mask_set_internal_(mask, i, hglm_frustum_test_aabb(f, box));
+    }
+}
+
+static HGL_INLINE void hglm_frustum_test_sphere_soa(uint8_t *mask, HglmFrustum f, HglmVec3SoA center,
+                                                    const float *radius, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_X8_
+    if (HGLM_X8_ENABLED_) i = hglm_frustum_sphere_x8_internal_(mask, &f, center, radius, n);
+#endif
+    for (; i < n; i++) {
+        HglmVec3 c = hglm_vec3_make(center.x[i], center.y[i], center.z[i]);
+        hglm_mask_set_internal_(mask, i, hglm_frustum_test_sphere(f, c, radius[i]));
+    }
+}
+
+static HGL_INLINE void hglm_ray_test_aabb_soa(uint8_t *mask, HglmVec3 origin, HglmVec3 dir, float t_max,
+                                              HglmVec3SoA min, HglmVec3SoA max, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_X8_
+    if (HGLM_X8_ENABLED_) i = hglm_ray_aabb_x8_internal_(mask, origin, dir, t_max, min, max, n);
+#endif
+    for (; i < n; i++) {
+        HglmAABB box = {
+            .min = hglm_vec3_make(min.x[i], min.y[i], min.z[i]),
+            .max = hglm_vec3_make(max.x[i], max.y[i], max.z[i]),
+        };
+        hglm_mask_set_internal_(mask, i, hglm_ray_test_aabb(origin, dir, t_max, box));
+    }
+}
+
+/* ========== Arbitrary size Matrix funtions =================================*/
+
+#define HGLM_MAT_STRIDE_(m) ((m).stride != 0 ? (m).stride : (m).N)
+#define hglm_mat_at(m, y, x) ((m).data[(size_t)(y)*HGLM_MAT_STRIDE_(m) + (x)])
+#define hglm_mat_print(m) \
+    do { \
+        printf("%s = \n", #m ); \
+        for (uint32_t row = 0; row < (m).M; row++) {\
+            printf("  | "); \
+            for (uint32_t col = 0; col < (m).N; col++) {\
+                printf("%16f ", (double) hglm_mat_at((m), row, col)); \
+            } \
+            printf(" |\n"); \
+        } \
+    } while(0)
+
+/* Views and wrapped storage point here, so `hglm_mat_free` leaves their data alone */
+static const HglmMatAllocator hglm_mat_borrowed_internal_ __attribute__ ((unused)) = {0};
+
+static HGL_INLINE HglmMat hglm_mat_make(uint32_t M /* rows */, uint32_t N /* cols */)
+{
+    HglmMat m = {
+        .data = HGLM_ALLOC((size_t) M * N * sizeof(*m.data)),
+        .M = M,
+        .N = N,
+        .stride = N,
+        .allocator = NULL,
+    };
+    assert(m.data != NULL);
+    return m;
+}
+
+static HGL_INLINE HglmMat hglm_mat_make_with(uint32_t M, uint32_t N, const HglmMatAllocator *allocator)
+{
+    if (allocator == NULL) {
+        return hglm_mat_make(M, N);
+    }
+    HglmMat m = {
+        .data = allocator->alloc(allocator->ctx, (size_t) M * N * sizeof(*m.data)),
+        .M = M,
+        .N = N,
+        .stride = N,
+        .allocator = allocator,
+    };
+    assert(m.data != NULL);
+    return m;
+}
+
+static HGL_INLINE HglmMat hglm_mat_make_from(float *data, uint32_t M, uint32_t N, uint32_t stride)
+{
+    assert(stride == 0 || stride >= N);
+    return (HglmMat) {
+        .data = data,
+        .M = M,
+        .N = N,
+        .stride = stride,
+        .allocator = &hglm_mat_borrowed_internal_,
+    };
+}
+
+static HGL_INLINE HglmMat hglm_mat_make_identity(uint32_t N)
+{
+    HglmMat m = hglm_mat_make(N, N);
+    hglm_mat_fill(m, 0);
+    for (uint32_t i = 0; i < N; i++) {
+        hglm_mat_at(m, i, i) = 1.0f;
+    }
+    return m;
+}
+
+static HGL_INLINE HglmMat hglm_mat_view(HglmMat m, uint32_t row, uint32_t col, uint32_t M, uint32_t N)
+{
+    assert(row + M <= m.M);
+    assert(col + N <= m.N);
+    return hglm_mat_make_from(&hglm_mat_at(m, row, col), M, N, HGLM_MAT_STRIDE_(m));
+}
+
+static HGL_INLINE void hglm_mat_free(HglmMat m)
+{
+    if (m.allocator == NULL) {
+        HGLM_FREE(m.data);
+    } else if (m.allocator->free != NULL) {
+        m.allocator->free(m.allocator->ctx, m.data);
+    }
+}
+
+static HGL_INLINE void hglm_mat_copy(HglmMat dst, HglmMat src)
+{
+    assert(dst.M == src.M);
+    assert(dst.N == src.N);
+    for (uint32_t row = 0; row < dst.M; row++) {
+        for (uint32_t col = 0; col < dst.N; col++) {
+            hglm_mat_at(dst, row, col) = hglm_mat_at(src, row, col);
+        }
+    }
+}
+
+static HGL_INLINE void hglm_mat_fill(HglmMat m, float value)
+{
+    for (uint32_t row = 0; row < m.M; row++) {
+        for (uint32_t col = 0; col < m.N; col++) {
+            hglm_mat_at(m, row, col) = value;
+        }
+    }
+}
+
+static HGL_INLINE void hglm_mat_add(HglmMat res, HglmMat a, HglmMat b)
+{
+    assert(a.M == b.M);
+    assert(a.N == b.N);
+    assert(res.N == a.N);
+    assert(res.M == a.M);
+    for (uint32_t row = 0; row < res.M; row++) {
+        for (uint32_t col = 0; col < res.N; col++) {
+            hglm_mat_at(res, row, col) = hglm_mat_at(a, row, col) + hglm_mat_at(b, row, col);
+        }
+    }
+}
+
+static HGL_INLINE void hglm_mat_sub(HglmMat res, HglmMat a, HglmMat b)
+{
+    assert(a.M == b.M);
+    assert(a.N == b.N);
+    assert(res.N == a.N);
+    assert(res.M == a.M);
+    for (uint32_t row = 0; row < res.M; row++) {
+        for (uint32_t col = 0; col < res.N; col++) {
+            hglm_mat_at(res, row, col) = hglm_mat_at(a, row, col) - hglm_mat_at(b, row, col);
+        }
+    }
+}
+
+static HGL_INLINE void hglm_mat_mul_scalar(HglmMat m, float s)
+{
+    for (uint32_t row = 0; row < m.M; row++) {
+        for (uint32_t col = 0; col < m.N; col++) {
+            hglm_mat_at(m, row, col) *= s;
+        }
+    }
+}
+
+/*
+ * C = alpha * A * B (+ C if `accumulate`), where A is MxK, B is KxN, and C is MxN, all
+ * row-major with the given leading dimensions. Goto-style: B is packed into KCxNC panels
+ * of NR-wide column slivers, A into MCxKC blocks of MR-tall row slivers, and an MRxNR
+ * micro-kernel runs over the packed data with all of its accumulators in registers.
+ */
+static inline void hglm_gemm_pack_a_internal_(float *dst, const float *a, uint32_t lda,
+                                              uint32_t mc, uint32_t kc, float alpha)
+{
+    for (uint32_t i = 0; i < mc; i += HGLM_GEMM_MR) {
+        for (uint32_t k = 0; k < kc; k++) {
+            for (uint32_t r = 0; r < HGLM_GEMM_MR; r++) {
+                *dst++ = (i + r < mc) ? alpha * a[(i + r)*lda + k] : 0.0f;
+            }
+        }
+    }
+}
+
+static inline void hglm_gemm_pack_b_internal_(float *dst, const float *b, uint32_t ldb,
+                                              uint32_t kc, uint32_t nc)
+{
+    for (uint32_t j = 0; j < nc; j += HGLM_GEMM_NR) {
+        uint32_t n = (nc - j < HGLM_GEMM_NR) ? nc - j : HGLM_GEMM_NR;
+        for (uint32_t k = 0; k < kc; k++) {
+            const float *row = &b[k*ldb + j];
+            uint32_t c = 0;
+            for (; c < n; c++) *dst++ = row[c];
+            for (; c < HGLM_GEMM_NR; c++) *dst++ = 0.0f;
+        }
+    }
+}
+
+/* Writes the MRxNR tile `acc` to C[m x n], adding to C if `accumulate` */
+static inline void hglm_gemm_store_internal_(float *c, uint32_t ldc, float acc[HGLM_GEMM_MR][HGLM_GEMM_NR],
+                                             uint32_t m, uint32_t n, int accumulate)
+{
+    for (uint32_t r = 0; r < m; r++) {
+        for (uint32_t j = 0; j < n; j++) {
+            c[r*ldc + j] = accumulate ? c[r*ldc + j] + acc[r][j] : acc[r][j];
+        }
+    }
+}
+
+/*
+ * Micro-kernels: C[m x n] (+)= a_pack[MR x kc] * b_pack[kc x NR]. `m` <= MR and `n` <= NR
+ * at the edges of C. All of them take the same packed layout, so the one that matches the
+ * CPU can be picked at runtime.
+ */
+typedef void (*HglmGemmKernel)(uint32_t kc, const float *a, const float *b, float *c, uint32_t ldc,
+                               uint32_t m, uint32_t n, int accumulate);
+
+static inline void hglm_gemm_kernel_generic_internal_(uint32_t kc, const float *a, const float *b,
+                                                      float *c, uint32_t ldc,
+                                                      uint32_t m, uint32_t n, int accumulate)
+{
+    float acc[HGLM_GEMM_MR][HGLM_GEMM_NR];
+
+    /* one row of the tile at a time, so that the compiler can keep it in (vector) registers */
+    for (uint32_t r = 0; r < HGLM_GEMM_MR; r++) {
+        float row[HGLM_GEMM_NR] = {0};
+        const float *ak = &a[r];
+        const float *bk = b;
+        for (uint32_t k = 0; k < kc; k++) {
+            for (uint32_t j = 0; j < HGLM_GEMM_NR; j++) {
+                row[j] += *ak * bk[j];
+            }
+            ak += HGLM_GEMM_MR;
+            bk += HGLM_GEMM_NR;
+        }
+        for (uint32_t j = 0; j < HGLM_GEMM_NR; j++) {
+            acc[r][j] = row[j];
+        }
+    }
+    hglm_gemm_store_internal_(c, ldc, acc, m, n, accumulate);
+}
+
+#ifdef HGLM_DISPATCH_
+/* 4-wide SSE: 3 rows x 4 vectors of accumulators at a time, to stay within 16 registers */
+static inline HGLM_TARGET_SSE4_ void hglm_gemm_kernel_x4_internal_(uint32_t kc, const float *a, const float *b,
+                                                                   float *c, uint32_t ldc,
+                                                                   uint32_t m, uint32_t n, int accumulate)
+{
+    float acc[HGLM_GEMM_MR][HGLM_GEMM_NR] __attribute__ ((aligned(16)));
+    for (uint32_t h = 0; h < HGLM_GEMM_MR; h += 3) {
+        __m128 c00 = _mm_setzero_ps(), c01 = _mm_setzero_ps(), c02 = _mm_setzero_ps(), c03 = _mm_setzero_ps();
+        __m128 c10 = _mm_setzero_ps(), c11 = _mm_setzero_ps(), c12 = _mm_setzero_ps(), c13 = _mm_setzero_ps();
+        __m128 c20 = _mm_setzero_ps(), c21 = _mm_setzero_ps(), c22 = _mm_setzero_ps(), c23 = _mm_setzero_ps();
+        const float *ak = &a[h];
+        const float *bk = b;
+        for (uint32_t k = 0; k < kc; k++) {
+            __m128 b0 = _mm_load_ps(&bk[0]);
+            __m128 b1 = _mm_load_ps(&bk[4]);
+            __m128 b2 = _mm_load_ps(&bk[8]);
+            __m128 b3 = _mm_load_ps(&bk[12]);
+            __m128 a0 = _mm_set1_ps(ak[0]);
+            __m128 a1 = _mm_set1_ps(ak[1]);
+            __m128 a2 = _mm_set1_ps(ak[2]);
+            c00 = _mm_add_ps(c00, _mm_mul_ps(a0, b0)); c01 = _mm_add_ps(c01, _mm_mul_ps(a0, b1));
+            c02 = _mm_add_ps(c02, _mm_mul_ps(a0, b2)); c03 = _mm_add_ps(c03, _mm_mul_ps(a0, b3));
+            c10 = _mm_add_ps(c10, _mm_mul_ps(a1, b0)); c11 = _mm_add_ps(c11, _mm_mul_ps(a1, b1));
+            c12 = _mm_add_ps(c12, _mm_mul_ps(a1, b2)); c13 = _mm_add_ps(c13, _mm_mul_ps(a1, b3));
+            c20 = _mm_add_ps(c20, _mm_mul_ps(a2, b0)); c21 = _mm_add_ps(c21, _mm_mul_ps(a2, b1));
+            c22 = _mm_add_ps(c22, _mm_mul_ps(a2, b2)); c23 = _mm_add_ps(c23, _mm_mul_ps(a2, b3));
+            ak += HGLM_GEMM_MR;
+            bk += HGLM_GEMM_NR;
+        }
+        _mm_store_ps(&acc[h + 0][0], c00); _mm_store_ps(&acc[h + 0][4], c01);
+        _mm_store_ps(&acc[h + 0][8], c02); _mm_store_ps(&acc[h + 0][12], c03);
+        _mm_store_ps(&acc[h + 1][0], c10); _mm_store_ps(&acc[h + 1][4], c11);
+        _mm_store_ps(&acc[h + 1][8], c12); _mm_store_ps(&acc[h + 1][12], c13);
+        _mm_store_ps(&acc[h + 2][0], c20); _mm_store_ps(&acc[h + 2][4], c21);
+        _mm_store_ps(&acc[h + 2][8], c22); _mm_store_ps(&acc[h + 2][12], c23);
+    }
+    hglm_gemm_store_internal_(c, ldc, acc, m, n, accumulate);
+}
+#endif
+
+#ifdef HGLM_X8_
+/* 8-wide AVX: 6 rows x 2 vectors of accumulators */
+static inline HGLM_TARGET_AVX2_ void hglm_gemm_kernel_x8_internal_(uint32_t kc, const float *a, const float *b,
+                                                                   float *c, uint32_t ldc,
+                                                                   uint32_t m, uint32_t n, int accumulate)
+{
+    float acc[HGLM_GEMM_MR][HGLM_GEMM_NR] __attribute__ ((aligned(32)));
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+    for (uint32_t k = 0; k < kc; k++) {
+        __m256 b0 = _mm256_loadu_ps(&b[0]);
+        __m256 b1 = _mm256_loadu_ps(&b[8]);
+        __m256 ak;
+        ak = _mm256_broadcast_ss(&a[0]); c00 = hglm_madd8_internal_(ak, b0, c00); c01 = hglm_madd8_internal_(ak, b1, c01);
+        ak = _mm256_broadcast_ss(&a[1]); c10 = hglm_madd8_internal_(ak, b0, c10); c11 = hglm_madd8_internal_(ak, b1, c11);
+        ak = _mm256_broadcast_ss(&a[2]); c20 = hglm_madd8_internal_(ak, b0, c20); c21 = hglm_madd8_internal_(ak, b1, c21);
+        ak = _mm256_broadcast_ss(&a[3]); c30 = hglm_madd8_internal_(ak, b0, c30); c31 = hglm_madd8_internal_(ak, b1, c31);
+        ak = _mm256_broadcast_ss(&a[4]); c40 = hglm_madd8_internal_(ak, b0, c40); c41 = hglm_madd8_internal_(ak, b1, c41);
+        ak = _mm256_broadcast_ss(&a[5]); c50 = hglm_madd8_internal_(ak, b0, c50); c51 = hglm_madd8_internal_(ak, b1, c51);
+        a += HGLM_GEMM_MR;
+        b += HGLM_GEMM_NR;
+    }
+    if (m == HGLM_GEMM_MR && n == HGLM_GEMM_NR) {
+        /* full tile: straight to C */
+        __m256 rows[HGLM_GEMM_MR][2] = {{c00, c01}, {c10, c11}, {c20, c21},
+                                        {c30, c31}, {c40, c41}, {c50, c51}};
+        for (uint32_t r = 0; r < HGLM_GEMM_MR; r++) {
+            float *cr = &c[r*ldc];
+            if (accumulate) {
+                rows[r][0] = _mm256_add_ps(rows[r][0], _mm256_loadu_ps(&cr[0]));
+                rows[r][1] = _mm256_add_ps(rows[r][1], _mm256_loadu_ps(&cr[8]));
+            }
+            _mm256_storeu_ps(&cr[0], rows[r][0]);
+            _mm256_storeu_ps(&cr[8], rows[r][1]);
+        }
+        return;
+    }
+    _mm256_store_ps(&acc[0][0], c00); _mm256_store_ps(&acc[0][8], c01);
+    _mm256_store_ps(&acc[1][0], c10); _mm256_store_ps(&acc[1][8], c11);
+    _mm256_store_ps(&acc[2][0], c20); _mm256_store_ps(&acc[2][8], c21);
+    _mm256_store_ps(&acc[3][0], c30); _mm256_store_ps(&acc[3][8], c31);
+    _mm256_store_ps(&acc[4][0], c40); _mm256_store_ps(&acc[4][8], c41);
+    _mm256_store_ps(&acc[5][0], c50); _mm256_store_ps(&acc[5][8], c51);
+    hglm_gemm_store_internal_(c, ldc, acc, m, n, accumulate);
+}
+#endif
+
+#ifdef HGLM_X16_
+/* 16-wide AVX-512: one vector per row, with k unrolled by 2 to hide the FMA latency */
+static inline HGLM_TARGET_AVX512_ void hglm_gemm_kernel_x16_internal_(uint32_t kc, const float *a, const float *b,
+                                                                      float *c, uint32_t ldc,
+                                                                      uint32_t m, uint32_t n, int accumulate)
+{
+    float acc[HGLM_GEMM_MR][HGLM_GEMM_NR] __attribute__ ((aligned(64)));
+    __m512 c0 = _mm512_setzero_ps(), d0 = _mm512_setzero_ps();
+    __m512 c1 = _mm512_setzero_ps(), d1 = _mm512_setzero_ps();
+    __m512 c2 = _mm512_setzero_ps(), d2 = _mm512_setzero_ps();
+    __m512 c3 = _mm512_setzero_ps(), d3 = _mm512_setzero_ps();
+    __m512 c4 = _mm512_setzero_ps(), d4 = _mm512_setzero_ps();
+    __m512 c5 = _mm512_setzero_ps(), d5 = _mm512_setzero_ps();
+    uint32_t k = 0;
+    for (; k + 2 <= kc; k += 2) {
+        __m512 b0 = _mm512_load_ps(&b[0]);
+        __m512 b1 = _mm512_load_ps(&b[HGLM_GEMM_NR]);
+        c0 = _mm512_fmadd_ps(_mm512_set1_ps(a[0]), b0, c0); d0 = _mm512_fmadd_ps(_mm512_set1_ps(a[HGLM_GEMM_MR + 0]), b1, d0);
+        c1 = _mm512_fmadd_ps(_mm512_set1_ps(a[1]), b0, c1); d1 = _mm512_fmadd_ps(_mm512_set1_ps(a[HGLM_GEMM_MR + 1]), b1, d1);
+        c2 = _mm512_fmadd_ps(_mm512_set1_ps(a[2]), b0, c2); d2 = _mm512_fmadd_ps(_mm512_set1_ps(a[HGLM_GEMM_MR + 2]), b1, d2);
+        c3 = _mm512_fmadd_ps(_mm512_set1_ps(a[3]), b0, c3); d3 = _mm512_fmadd_ps(_mm512_set1_ps(a[HGLM_GEMM_MR + 3]), b1, d3);
+        c4 = _mm512_fmadd_ps(_mm512_set1_ps(a[4]), b0, c4); d4 = _mm512_fmadd_ps(_mm512_set1_ps(a[HGLM_GEMM_MR + 4]), b1, d4);
+        c5 = _mm512_fmadd_ps(_mm512_set1_ps(a[5]), b0, c5); d5 = _mm512_fmadd_ps(_mm512_set1_ps(a[HGLM_GEMM_MR + 5]), b1, d5);
+        a += 2*HGLM_GEMM_MR;
+        b += 2*HGLM_GEMM_NR;
+    }
+    if (k < kc) {
+        __m512 b0 = _mm512_load_ps(&b[0]);
+        c0 = _mm512_fmadd_ps(_mm512_set1_ps(a[0]), b0, c0);
+        c1 = _mm512_fmadd_ps(_mm512_set1_ps(a[1]), b0, c1);
+        c2 = _mm512_fmadd_ps(_mm512_set1_ps(a[2]), b0, c2);
+        c3 = _mm512_fmadd_ps(_mm512_set1_ps(a[3]), b0, c3);
+        c4 = _mm512_fmadd_ps(_mm512_set1_ps(a[4]), b0, c4);
+        c5 = _mm512_fmadd_ps(_mm512_set1_ps(a[5]), b0, c5);
+    }
+    __m512 rows[HGLM_GEMM_MR] = {
+        _mm512_add_ps(c0, d0), _mm512_add_ps(c1, d1), _mm512_add_ps(c2, d2),
+        _mm512_add_ps(c3, d3), _mm512_add_ps(c4, d4), _mm512_add_ps(c5, d5),
+    };
+    if (m == HGLM_GEMM_MR && n == HGLM_GEMM_NR) {
+        /* full tile: straight to C */
+        for (uint32_t r = 0; r < HGLM_GEMM_MR; r++) {
+            float *cr = &c[r*ldc];
+            if (accumulate) {
+                rows[r] = _mm512_add_ps(rows[r], _mm512_loadu_ps(cr));
+            }
+            _mm512_storeu_ps(cr, rows[r]);
+        }
+        return;
+    }
+    for (uint32_t r = 0; r < HGLM_GEMM_MR; r++) {
+        _mm512_store_ps(&acc[r][0], rows[r]);
+    }
+    hglm_gemm_store_internal_(c, ldc, acc, m, n, accumulate);
+}
+#endif
+
+static inline HglmGemmKernel hglm_gemm_kernel_select_internal_(void)
+{
+#if defined(HGLM_DISPATCH_)
+    switch (hglm_cpu_level()) {
+        case HGLM_CPU_AVX512: return hglm_gemm_kernel_x16_internal_;
+        case HGLM_CPU_AVX2:   return hglm_gemm_kernel_x8_internal_;
+        case HGLM_CPU_SSE4:   return hglm_gemm_kernel_x4_internal_;
+        default:              return hglm_gemm_kernel_generic_internal_;
+    }
+#elif defined(HGLM_X16_)
+    return hglm_gemm_kernel_x16_internal_;
+#elif defined(HGLM_X8_)
+    return hglm_gemm_kernel_x8_internal_;
+#else
+    return hglm_gemm_kernel_generic_internal_;
+#endif
+}
+
+static inline void hglm_gemm_internal_(uint32_t M, uint32_t N, uint32_t K,
+                                       const float *a, uint32_t lda,
+                                       const float *b, uint32_t ldb,
+                                       float *c, uint32_t ldc,
+                                       float alpha, int accumulate)
+{
+    if (K == 0) {
+        for (uint32_t i = 0; i < M && !accumulate; i++) {
+            for (uint32_t j = 0; j < N; j++) {
+                c[i*ldc + j] = 0.0f;
+            }
+        }
+        return;
+    }
+
+    /* small products aren't worth packing: plain i-k-j loops, unit stride over B and C */
+    if ((uint64_t) M * N * K <= 32*32*32) {
+        for (uint32_t i = 0; i < M; i++) {
+            float *ci = &c[i*ldc];
+            for (uint32_t j = 0; j < N && !accumulate; j++) {
+                ci[j] = 0.0f;
+            }
+            for (uint32_t k = 0; k < K; k++) {
+                float aik = alpha * a[i*lda + k];
+                const float *bk = &b[k*ldb];
+                for (uint32_t j = 0; j < N; j++) {
+                    ci[j] += aik * bk[j];
+                }
+            }
+        }
+        return;
+    }
+
+    /* packing buffers, aligned to 64 bytes */
+    uint32_t kc_max = (K < HGLM_GEMM_KC) ? K : HGLM_GEMM_KC;
+    uint32_t nc_max = (N < HGLM_GEMM_NC) ? (N + HGLM_GEMM_NR - 1) / HGLM_GEMM_NR * HGLM_GEMM_NR : HGLM_GEMM_NC;
+    size_t a_size = (size_t) HGLM_GEMM_MC * kc_max;
+    size_t b_size = (size_t) kc_max * nc_max;
+    void *mem = HGLM_ALLOC((a_size + b_size) * sizeof(float) + 64);
+    assert(mem != NULL);
+    float *a_pack = (float *) (((uintptr_t) mem + 63) & ~(uintptr_t) 63);
+    float *b_pack = a_pack + a_size;
+    HglmGemmKernel kernel = hglm_gemm_kernel_select_internal_();
+
+    for (uint32_t jc = 0; jc < N; jc += HGLM_GEMM_NC) {
+        uint32_t nc = (N - jc < HGLM_GEMM_NC) ? N - jc : HGLM_GEMM_NC;
+        for (uint32_t pc = 0; pc < K; pc += HGLM_GEMM_KC) {
+            uint32_t kc = (K - pc < HGLM_GEMM_KC) ? K - pc : HGLM_GEMM_KC;
+            hglm_gemm_pack_b_internal_(b_pack, &b[pc*ldb + jc], ldb, kc, nc);
+            for (uint32_t ic = 0; ic < M; ic += HGLM_GEMM_MC) {
+                uint32_t mc = (M - ic < HGLM_GEMM_MC) ? M - ic : HGLM_GEMM_MC;
+                hglm_gemm_pack_a_internal_(a_pack, &a[ic*lda + pc], lda, mc, kc, alpha);
+                for (uint32_t jr = 0; jr < nc; jr += HGLM_GEMM_NR) {
+                    uint32_t n = (nc - jr < HGLM_GEMM_NR) ? nc - jr : HGLM_GEMM_NR;
+                    for (uint32_t ir = 0; ir < mc; ir += HGLM_GEMM_MR) {
+                        uint32_t m = (mc - ir < HGLM_GEMM_MR) ? mc - ir : HGLM_GEMM_MR;
+                        kernel(kc, &a_pack[ir*kc], &b_pack[jr*kc],
+                               &c[(ic + ir)*ldc + jc + jr], ldc, m, n, accumulate || pc != 0);
+                    }
+                }
+            }
+        }
+    }
+
+    HGLM_FREE(mem);
+}
+
+#ifdef HGLM_USE_THREADS
+typedef struct
+{
+    uint32_t M, N, K;
+    const float *a; uint32_t lda;
+    const float *b; uint32_t ldb;
+    float *c; uint32_t ldc;
+    float alpha; int accumulate;
+} HglmGemmJob;
+
+static inline void *hglm_gemm_thread_internal_(void *arg)
+{
+    HglmGemmJob *job = arg;
+    hglm_gemm_internal_(job->M, job->N, job->K, job->a, job->lda, job->b, job->ldb, job->c, job->ldc,
+                        job->alpha, job->accumulate);
+    return NULL;
+}
+#endif
+
+/* Splits the rows of C into one band per thread (if HGLM_USE_THREADS is defined and the product is large enough). */
+static inline void hglm_gemm_parallel_internal_(uint32_t M, uint32_t N, uint32_t K,
+                                                const float *a, uint32_t lda,
+                                                const float *b, uint32_t ldb,
+                                                float *c, uint32_t ldc,
+                                                float alpha, int accumulate)
+{
+#ifdef HGLM_USE_THREADS
+    enum {MAX_THREADS = 64};
+    int n_threads = get_nprocs();
+    n_threads = (n_threads > MAX_THREADS) ? MAX_THREADS : n_threads;
+    uint32_t n_bands = (M + HGLM_GEMM_MC - 1) / HGLM_GEMM_MC;
+    n_threads = ((uint32_t) n_threads > n_bands) ? (int) n_bands : n_threads;
+    if (n_threads > 1 && (uint64_t) M * N * K >= 128*128*128) {
+        pthread_t threads[MAX_THREADS];
+        HglmGemmJob jobs[MAX_THREADS];
+        int spawned[MAX_THREADS];
+        uint32_t bands_per_thread = (n_bands + n_threads - 1) / n_threads;
+        uint32_t row = 0;
+        for (int t = 0; t < n_threads; t++) {
+            uint32_t rows = bands_per_thread * HGLM_GEMM_MC;
+            rows = (M - row < rows) ? M - row : rows;
+            jobs[t] = (HglmGemmJob) {
+                .M = rows, .N = N, .K = K,
+                .a = &a[row*lda], .lda = lda,
+                .b = b, .ldb = ldb,
+                .c = &c[row*ldc], .ldc = ldc,
+                .alpha = alpha, .accumulate = accumulate,
+            };
+            row += rows;
+            /* the calling thread takes the first band itself */
+            spawned[t] = (t > 0) && (rows > 0) &&
+                         (pthread_create(&threads[t], NULL, hglm_gemm_thread_internal_, &jobs[t]) == 0);
+        }
+        for (int t = 0; t < n_threads; t++) {
+            if (!spawned[t] && jobs[t].M > 0) {
+                hglm_gemm_thread_internal_(&jobs[t]);
+            }
+        }
+        for (int t = 0; t < n_threads; t++) {
+            if (spawned[t]) {
+                pthread_join(threads[t], NULL);
+            }
+        }
+        return;
+    }
+#endif
+    hglm_gemm_internal_(M, N, K, a, lda, b, ldb, c, ldc, alpha, accumulate);
+}
+
+static HGL_INLINE void hglm_mat_mul_mat(HglmMat res, HglmMat a, HglmMat b)
+{
+    /* AxB x BxC ==> AxC*/
+    assert(a.N == b.M);
+    assert(res.M == a.M);
+    assert(res.N == b.N);
+    assert(res.data != a.data);
+    assert(res.data != b.data);
+    hglm_gemm_parallel_internal_(res.M, res.N, a.N, a.data, HGLM_MAT_STRIDE_(a), b.data, HGLM_MAT_STRIDE_(b),
+                                 res.data, HGLM_MAT_STRIDE_(res), 1.0f, 0);
+}
+
+static HGL_INLINE void hglm_mat_transpose_in_place(HglmMat m)
+{
+    assert((m.M == m.N) && "In-place transpose only supports square matrices");
+    for (uint32_t row = 0; row < m.M - 1; row++) {
+        for (uint32_t col = row + 1; col < m.N; col++) {
+            float temp = hglm_mat_at(m, row, col);
+            hglm_mat_at(m, row, col) = hglm_mat_at(m, col, row);
+            hglm_mat_at(m, col, row) = temp;
+        }
+    }
+}
+
+static HGL_INLINE void hglm_mat_transpose(HglmMat res, HglmMat m)
+{
+    assert(res.M == m.N);
+    assert(res.N == m.M);
+    for (uint32_t row = 0; row < res.M; row++) {
+        for (uint32_t col = 0; col < res.N; col++) {
+            hglm_mat_at(res, row, col) = hglm_mat_at(m, col, row);
+        }
+    }
+}
+
+/*
+ * Blocked factorizations & triangular solves. Each step factors an NB-wide panel, then
+ * updates the trailing matrix with one large (threaded) GEMM, so almost all of the
+ * O(n^3) work runs in the `hglm_mat_mul_mat` micro-kernels.
+ */
+
+/* B[r0..r1) := L[r0..r1, r0..r1)^-1 * B[r0..r1), with the rows above already eliminated */
+static inline void hglm_trsm_lower_block_internal_(HglmMat l, HglmMat b, uint32_t r0, uint32_t r1,
+                                                   int unit_diagonal)
+{
+    for (uint32_t r = r0; r < r1; r++) {
+        float *br = &hglm_mat_at(b, r, 0);
+        for (uint32_t k = r0; k < r; k++) {
+            float lrk = hglm_mat_at(l, r, k);
+            const float *bk = &hglm_mat_at(b, k, 0);
+            for (uint32_t j = 0; j < b.N; j++) {
+                br[j] -= lrk * bk[j];
+            }
+        }
+        if (!unit_diagonal) {
+            float inv = 1.0f / hglm_mat_at(l, r, r);
+            for (uint32_t j = 0; j < b.N; j++) {
+                br[j] *= inv;
+            }
+        }
+    }
+}
+
+/* B[r0..r1) := U[r0..r1, r0..r1)^-1 * B[r0..r1), with the rows below already eliminated */
+static inline void hglm_trsm_upper_block_internal_(HglmMat u, HglmMat b, uint32_t r0, uint32_t r1,
+                                                   int unit_diagonal)
+{
+    for (uint32_t r = r1; r-- > r0;) {
+        float *br = &hglm_mat_at(b, r, 0);
+        for (uint32_t k = r + 1; k < r1; k++) {
+            float urk = hglm_mat_at(u, r, k);
+            const float *bk = &hglm_mat_at(b, k, 0);
+            for (uint32_t j = 0; j < b.N; j++) {
+                br[j] -= urk * bk[j];
+            }
+        }
+        if (!unit_diagonal) {
+            float inv = 1.0f / hglm_mat_at(u, r, r);
+            for (uint32_t j = 0; j < b.N; j++) {
+                br[j] *= inv;
+            }
+        }
+    }
+}
+
+static HGL_INLINE void hglm_mat_solve_lower(HglmMat l, HglmMat b, int unit_diagonal)
+{
+    assert(l.M == l.N);
+    assert(b.M == l.N);
+    const uint32_t n = l.N;
+    for (uint32_t i = 0; i < n; i += HGLM_FACTOR_NB) {
+        uint32_t i1 = (n - i < HGLM_FACTOR_NB) ? n : i + HGLM_FACTOR_NB;
+        hglm_trsm_lower_block_internal_(l, b, i, i1, unit_diagonal);
+        /* B[i1..n) -= L[i1..n, i..i1) * B[i..i1) */
+        hglm_gemm_parallel_internal_(n - i1, b.N, i1 - i, &hglm_mat_at(l, i1, i), HGLM_MAT_STRIDE_(l),
+                                     &hglm_mat_at(b, i, 0), HGLM_MAT_STRIDE_(b),
+                                     &hglm_mat_at(b, i1, 0), HGLM_MAT_STRIDE_(b), -1.0f, 1);
+    }
+}
+
+static HGL_INLINE void hglm_mat_solve_upper(HglmMat u, HglmMat b, int unit_diagonal)
+{
+    assert(u.M == u.N);
+    assert(b.M == u.N);
+    const uint32_t n = u.N;
+    for (uint32_t i1 = n; i1 > 0;) {
+        uint32_t i = (i1 < HGLM_FACTOR_NB) ? 0 : i1 - HGLM_FACTOR_NB;
+        hglm_trsm_upper_block_internal_(u, b, i, i1, unit_diagonal);
+        /* B[0..i) -= U[0..i, i..i1) * B[i..i1) */
+        hglm_gemm_parallel_internal_(i, b.N, i1 - i, &hglm_mat_at(u, 0, i), HGLM_MAT_STRIDE_(u),
+                                     &hglm_mat_at(b, i, 0), HGLM_MAT_STRIDE_(b),
+                                     &hglm_mat_at(b, 0, 0), HGLM_MAT_STRIDE_(b), -1.0f, 1);
+        i1 = i;
+    }
+}
+
+/*
+ * Factors the panel A[j..n, j..j1) in place, recursively: the left half is factored
+ * first, then the right half is updated with a GEMM and factored in turn. Only narrow
+ * slivers are done column by column. Pivoting swaps whole rows, so L and the trailing
+ * matrix follow along.
+ */
+static inline int hglm_lu_panel_internal_(HglmMat a, uint32_t *piv, uint32_t j, uint32_t j1)
+{
+    const uint32_t n = a.N;
+    int err = 0;
+    if (j1 - j > 16) {
+        uint32_t mid = j + (j1 - j) / 2;
+        err |= hglm_lu_panel_internal_(a, piv, j, mid);
+        hglm_trsm_lower_block_internal_(hglm_mat_view(a, j, j, mid - j, mid - j),
+                                        hglm_mat_view(a, j, mid, mid - j, j1 - mid), 0, mid - j, 1);
+        hglm_gemm_parallel_internal_(n - mid, j1 - mid, mid - j, &hglm_mat_at(a, mid, j), HGLM_MAT_STRIDE_(a),
+                                     &hglm_mat_at(a, j, mid), HGLM_MAT_STRIDE_(a),
+                                     &hglm_mat_at(a, mid, mid), HGLM_MAT_STRIDE_(a), -1.0f, 1);
+        err |= hglm_lu_panel_internal_(a, piv, mid, j1);
+        return err;
+    }
+    uint32_t p = j;
+    float max = -1.0f; // < 0: the pivot of column k hasn't been searched for yet
+    for (uint32_t k = j; k < j1; k++) {
+        if (max < 0.0f) {
+            p = k;
+            max = fabsf(hglm_mat_at(a, k, k));
+            for (uint32_t i = k + 1; i < n; i++) {
+                float v = fabsf(hglm_mat_at(a, i, k));
+                if (v > max) {
+                    max = v;
+                    p = i;
+                }
+            }
+        }
+        piv[k] = p;
+        if (p != k) {
+            float *rk = &hglm_mat_at(a, k, 0);
+            float *rp = &hglm_mat_at(a, p, 0);
+            for (uint32_t c = 0; c < n; c++) {
+                float tmp = rk[c];
+                rk[c] = rp[c];
+                rp[c] = tmp;
+            }
+        }
+        if (max == 0.0f) {
+            err = -1; // singular. Keep going, like LAPACK
+            max = -1.0f;
+            continue;
+        }
+        /* eliminate, and search for the pivot of the next column on the way */
+        float inv = 1.0f / hglm_mat_at(a, k, k);
+        const float *rk = &hglm_mat_at(a, k, 0);
+        p = k + 1;
+        max = -1.0f;
+        for (uint32_t i = k + 1; i < n; i++) {
+            float *ri = &hglm_mat_at(a, i, 0);
+            float lik = ri[k] * inv;
+            ri[k] = lik;
+            for (uint32_t c = k + 1; c < j1; c++) {
+                ri[c] -= lik * rk[c];
+            }
+            if (k + 1 < j1 && fabsf(ri[k + 1]) > max) {
+                max = fabsf(ri[k + 1]);
+                p = i;
+            }
+        }
+    }
+    return err;
+}
+
+static HGL_INLINE int hglm_mat_lu(HglmMat a, uint32_t *piv)
+{
+    assert(a.M == a.N);
+    const uint32_t n = a.N;
+    int err = 0;
+    for (uint32_t j = 0; j < n; j += HGLM_FACTOR_NB) {
+        uint32_t j1 = (n - j < HGLM_FACTOR_NB) ? n : j + HGLM_FACTOR_NB;
+        err |= hglm_lu_panel_internal_(a, piv, j, j1);
+        if (j1 == n) {
+            break;
+        }
+
+        /* U[j..j1, j1..n) = L[j..j1, j..j1)^-1 * A[j..j1, j1..n) */
+        hglm_trsm_lower_block_internal_(hglm_mat_view(a, j, j, j1 - j, j1 - j),
+                                        hglm_mat_view(a, j, j1, j1 - j, n - j1), 0, j1 - j, 1);
+
+        /* A[j1..n, j1..n) -= L[j1..n, j..j1) * U[j..j1, j1..n) */
+        hglm_gemm_parallel_internal_(n - j1, n - j1, j1 - j, &hglm_mat_at(a, j1, j), HGLM_MAT_STRIDE_(a),
+                                     &hglm_mat_at(a, j, j1), HGLM_MAT_STRIDE_(a),
+                                     &hglm_mat_at(a, j1, j1), HGLM_MAT_STRIDE_(a), -1.0f, 1);
+    }
+    return err;
+}
+
+static HGL_INLINE void hglm_mat_lu_solve(HglmMat lu, const uint32_t *piv, HglmMat b)
+{
+    assert(lu.M == lu.N);
+    assert(b.M == lu.N);
+    for (uint32_t k = 0; k < b.M; k++) {
+        if (piv[k] != k) {
+            float *rk = &hglm_mat_at(b, k, 0);
+            float *rp = &hglm_mat_at(b, piv[k], 0);
+            for (uint32_t c = 0; c < b.N; c++) {
+                float tmp = rk[c];
+                rk[c] = rp[c];
+                rp[c] = tmp;
+            }
+        }
+    }
+    hglm_mat_solve_lower(lu, b, 1);
+    hglm_mat_solve_upper(lu, b, 0);
+}
+
+static HGL_INLINE int hglm_mat_cholesky(HglmMat a)
+{
+    assert(a.M == a.N);
+    const uint32_t n = a.N;
+    for (uint32_t j = 0; j < n; j += HGLM_FACTOR_NB) {
+        uint32_t j1 = (n - j < HGLM_FACTOR_NB) ? n : j + HGLM_FACTOR_NB;
+
+        /* diagonal block: A11 = L11 * L11^T */
+        for (uint32_t k = j; k < j1; k++) {
+            const float *rk = &hglm_mat_at(a, k, 0);
+            float d = rk[k];
+            for (uint32_t m = j; m < k; m++) {
+                d -= rk[m] * rk[m];
+            }
+            if (!(d > 0.0f)) {
+                return -1; // not positive definite
+            }
+            float lkk = sqrtf(d);
+            float inv = 1.0f / lkk;
+            hglm_mat_at(a, k, k) = lkk;
+            for (uint32_t i = k + 1; i < j1; i++) {
+                float *ri = &hglm_mat_at(a, i, 0);
+                float s = ri[k];
+                for (uint32_t m = j; m < k; m++) {
+                    s -= ri[m] * rk[m];
+                }
+                ri[k] = s * inv;
+                hglm_mat_at(a, k, i) = ri[k];
+            }
+        }
+
+        if (j1 == n) {
+            break;
+        }
+
+        /* L21^T = L11^-1 * A21^T, solved in the upper triangle (row-wise) and mirrored back */
+        for (uint32_t k = j; k < j1; k++) {
+            for (uint32_t i = j1; i < n; i++) {
+                hglm_mat_at(a, k, i) = hglm_mat_at(a, i, k);
+            }
+        }
+        hglm_trsm_lower_block_internal_(hglm_mat_view(a, j, j, j1 - j, j1 - j),
+                                        hglm_mat_view(a, j, j1, j1 - j, n - j1), 0, j1 - j, 0);
+        for (uint32_t i = j1; i < n; i++) {
+            for (uint32_t k = j; k < j1; k++) {
+                hglm_mat_at(a, i, k) = hglm_mat_at(a, k, i);
+            }
+        }
+
+        /*
+         * A22 -= L21 * L21^T. Only the lower triangle is needed, so go in bands of rows
+         * and skip everything right of each band's diagonal block.
+         */
+        for (uint32_t r = j1; r < n; r += 4*HGLM_GEMM_MC) {
+            uint32_t r1 = (n - r < 4*HGLM_GEMM_MC) ? n : r + 4*HGLM_GEMM_MC;
+            hglm_gemm_parallel_internal_(r1 - r, r1 - j1, j1 - j, &hglm_mat_at(a, r, j), HGLM_MAT_STRIDE_(a),
+                                         &hglm_mat_at(a, j, j1), HGLM_MAT_STRIDE_(a),
+                                         &hglm_mat_at(a, r, j1), HGLM_MAT_STRIDE_(a), -1.0f, 1);
+        }
+    }
+    return 0;
+}
+
+static HGL_INLINE void hglm_mat_cholesky_solve(HglmMat l, HglmMat b)
+{
+    /* `hglm_mat_cholesky` leaves L^T in the upper triangle */
+    hglm_mat_solve_lower(l, b, 0);
+    hglm_mat_solve_upper(l, b, 0);
+}
+
+
+/* ========== Sparse (CSR) Matrix functions ==================================*/
+
+/* values, col_idx and row_ptr share a single allocation */
+static inline HglmSpMat hglm_spmat_alloc_internal_(uint32_t M, uint32_t N, uint32_t nnz,
+                                                   const HglmMatAllocator *allocator)
+{
+    size_t size = ((size_t) 2 * nnz + M + 1) * sizeof(uint32_t);
+    void *mem = (allocator == NULL) ? HGLM_ALLOC(size) : allocator->alloc(allocator->ctx, size);
+    assert(mem != NULL);
+    HglmSpMat m = {
+        .values    = (float *) mem,
+        .col_idx   = (uint32_t *) mem + nnz,
+        .row_ptr   = (uint32_t *) mem + 2 * (size_t) nnz,
+        .M         = M,
+        .N         = N,
+        .nnz       = nnz,
+        .allocator = allocator,
+    };
+    return m;
+}
+
+/*
+ * Duplicate (row, col) entries are summed. Two stable counting sorts (by column,
+ * then by row) leave every row sorted by column in O(count + M + N).
+ */
+static HGL_INLINE HglmSpMat hglm_spmat_make_from_triplets(uint32_t M, uint32_t N, const uint32_t *rows,
+                                                          const uint32_t *cols, const float *values,
+                                                          uint32_t count, const HglmMatAllocator *allocator)
+{
+    HglmSpMat m = hglm_spmat_alloc_internal_(M, N, count, allocator);
+    uint32_t *tmp = HGLM_ALLOC(((size_t) count + N + 1) * sizeof(uint32_t));
+    assert(tmp != NULL);
+    uint32_t *col_ptr = tmp;
+    uint32_t *order   = tmp + N + 1;
+
+    /* sort the triplets by column */
+    for (uint32_t j = 0; j <= N; j++) col_ptr[j] = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        assert(rows[i] < M && cols[i] < N);
+        col_ptr[cols[i] + 1]++;
+    }
+    for (uint32_t j = 0; j < N; j++) col_ptr[j + 1] += col_ptr[j];
+    for (uint32_t i = 0; i < count; i++) order[col_ptr[cols[i]]++] = i;
+
+    /* ... then by row. `row_ptr[r]` is used as the insertion cursor of row r */
+    for (uint32_t r = 0; r <= M; r++) m.row_ptr[r] = 0;
+    for (uint32_t i = 0; i < count; i++) m.row_ptr[rows[i] + 1]++;
+    for (uint32_t r = 0; r < M; r++) m.row_ptr[r + 1] += m.row_ptr[r];
+    for (uint32_t k = 0; k < count; k++) {
+        uint32_t i = order[k];
+        uint32_t dst = m.row_ptr[rows[i]]++;
+        m.values[dst]  = values[i];
+        m.col_idx[dst] = cols[i];
+    }
+    HGLM_FREE(tmp);
+
+    /* the cursors now hold the end of each row. Restore the row starts while merging duplicates */
+    uint32_t w = 0;
+    uint32_t start = 0;
+    for (uint32_t r = 0; r < M; r++) {
+        uint32_t end = m.row_ptr[r];
+        m.row_ptr[r] = w;
+        for (uint32_t k = start; k < end; k++) {
+            if (w > m.row_ptr[r] && m.col_idx[w - 1] == m.col_idx[k]) {
+                m.values[w - 1] += m.values[k];
+            } else {
+                m.values[w]  = m.values[k];
+                m.col_idx[w] = m.col_idx[k];
+                w++;
+            }
+        }
+        start = end;
+    }
+    m.row_ptr[M] = w;
+    m.nnz = w;
+    return m;
+}
+
+static HGL_INLINE void hglm_spmat_free(HglmSpMat m)
+{
+    if (m.allocator == NULL) {
+        HGLM_FREE(m.values);
+    } else if (m.allocator->free != NULL) {
+        m.allocator->free(m.allocator->ctx, m.values);
+    }
+}
+
+/* CSR of the transpose, i.e. the CSC representation of `m` */
+static HGL_INLINE HglmSpMat hglm_spmat_transpose(HglmSpMat m, const HglmMatAllocator *allocator)
+{
+    HglmSpMat t = hglm_spmat_alloc_internal_(m.N, m.M, m.nnz, allocator);
+    for (uint32_t r = 0; r <= t.M; r++) t.row_ptr[r] = 0;
+    for (uint32_t k = 0; k < m.nnz; k++) t.row_ptr[m.col_idx[k] + 1]++;
+    for (uint32_t r = 0; r < t.M; r++) t.row_ptr[r + 1] += t.row_ptr[r];
+    for (uint32_t row = 0; row < m.M; row++) {
+        for (uint32_t k = m.row_ptr[row]; k < m.row_ptr[row + 1]; k++) {
+            uint32_t dst = t.row_ptr[m.col_idx[k]]++;
+            t.values[dst]  = m.values[k];
+            t.col_idx[dst] = row;
+        }
+    }
+    for (uint32_t r = t.M; r > 0; r--) t.row_ptr[r] = t.row_ptr[r - 1];
+    t.row_ptr[0] = 0;
+    return t;
+}
+
+static HGL_INLINE void hglm_spmat_to_mat(HglmMat res, HglmSpMat m)
+{
+    assert(res.M == m.M);
+    assert(res.N == m.N);
+    hglm_mat_fill(res, 0.0f);
+    for (uint32_t row = 0; row < m.M; row++) {
+        for (uint32_t k = m.row_ptr[row]; k < m.row_ptr[row + 1]; k++) {
+            hglm_mat_at(res, row, m.col_idx[k]) += m.values[k];
+        }
+    }
+}
+
+#ifdef HGLM_GATHER_X8_
+static inline HGLM_TARGET_AVX2_ void hglm_spmv_x8_internal_(float *res, const HglmSpMat *a, const float *x,
+                                                            uint32_t row0, uint32_t row1)
+{
+    for (uint32_t row = row0; row < row1; row++) {
+        uint32_t k   = a->row_ptr[row];
+        uint32_t end = a->row_ptr[row + 1];
+        __m256 acc = _mm256_setzero_ps();
+        for (; k + 8 <= end; k += 8) {
+            __m256i idx = _mm256_loadu_si256((const __m256i *) &a->col_idx[k]);
+            __m256 xv   = _mm256_i32gather_ps(x, idx, 4);
+            acc = hglm_madd8_internal_(_mm256_loadu_ps(&a->values[k]), xv, acc);
+        }
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 0x55));
+        float sum = _mm_cvtss_f32(s);
+        for (; k < end; k++) {
+            sum += a->values[k] * x[a->col_idx[k]];
+        }
+        res[row] = sum;
+    }
+}
+#endif
+
+/* rows [row0, row1) of res = a * x */
+static inline void hglm_spmv_internal_(float *res, const HglmSpMat *a, const float *x,
+                                       uint32_t row0, uint32_t row1)
+{
+#ifdef HGLM_GATHER_X8_
+    if (HGLM_X8_ENABLED_) {
+        hglm_spmv_x8_internal_(res, a, x, row0, row1);
+        return;
+    }
+#endif
+    for (uint32_t row = row0; row < row1; row++) {
+        float sum = 0.0f;
+        for (uint32_t k = a->row_ptr[row]; k < a->row_ptr[row + 1]; k++) {
+            sum += a->values[k] * x[a->col_idx[k]];
+        }
+        res[row] = sum;
+    }
+}
+
+/* rows [row0, row1) of res = a * b. The inner loop runs along rows of b, so it vectorizes */
+static inline void hglm_spmm_internal_(HglmMat res, const HglmSpMat *a, HglmMat b,
+                                       uint32_t row0, uint32_t row1)
+{
+    for (uint32_t row = row0; row < row1; row++) {
+        float *r = &hglm_mat_at(res, row, 0);
+        for (uint32_t col = 0; col < res.N; col++) {
+            r[col] = 0.0f;
+        }
+        for (uint32_t k = a->row_ptr[row]; k < a->row_ptr[row + 1]; k++) {
+            float v = a->values[k];
+            const float *br = &hglm_mat_at(b, a->col_idx[k], 0);
+            for (uint32_t col = 0; col < res.N; col++) {
+                r[col] += v * br[col];
+            }
+        }
+    }
+}
+
+typedef struct
+{
+    const HglmSpMat *a;
+    const float *x;     /* x != NULL ==> res = a * x   */
+    float *res;
+    HglmMat b;          /* x == NULL ==> res_mat = a * b */
+    HglmMat res_mat;
+    uint32_t row0, row1;
+} HglmSpMatJob;
+
+static inline void *hglm_spmat_thread_internal_(void *arg)
+{
+    HglmSpMatJob *job = arg;
+    if (job->x != NULL) {
+        hglm_spmv_internal_(job->res, job->a, job->x, job->row0, job->row1);
+    } else {
+        hglm_spmm_internal_(job->res_mat, job->a, job->b, job->row0, job->row1);
+    }
+    return NULL;
+}
+
+/*
+ * Splits the rows of `job.a` into one band per thread, with about the same number of
+ * nonzeros in each band (if HGLM_USE_THREADS is defined and there's enough work).
+ */
+static inline void hglm_spmat_parallel_internal_(HglmSpMatJob job, uint64_t work)
+{
+#ifdef HGLM_USE_THREADS
+    enum {MAX_THREADS = 64};
+    const HglmSpMat *a = job.a;
+    int n_threads = get_nprocs();
+    n_threads = (n_threads > MAX_THREADS) ? MAX_THREADS : n_threads;
+    n_threads = ((uint32_t) n_threads > a->M) ? (int) a->M : n_threads;
+    if (n_threads > 1 && work >= (1u << 18)) {
+        pthread_t threads[MAX_THREADS];
+        HglmSpMatJob jobs[MAX_THREADS];
+        int spawned[MAX_THREADS];
+        uint32_t row = 0;
+        for (int t = 0; t < n_threads; t++) {
+            /* band t ends at the first row that starts past its share of the nonzeros */
+            uint64_t target = (uint64_t) a->nnz * (uint64_t) (t + 1) / (uint64_t) n_threads;
+            uint32_t lo = row, hi = a->M;
+            while (lo < hi) {
+                uint32_t mid = lo + (hi - lo) / 2;
+                if (a->row_ptr[mid] < target) lo = mid + 1; else hi = mid;
+            }
+            jobs[t] = job;
+            jobs[t].row0 = row;
+            jobs[t].row1 = (t == n_threads - 1) ? a->M : lo;
+            row = jobs[t].row1;
+            /* the calling thread takes the first band itself */
+            spawned[t] = (t > 0) && (jobs[t].row1 > jobs[t].row0) &&
+                         (pthread_create(&threads[t], NULL, hglm_spmat_thread_internal_, &jobs[t]) == 0);
+        }
+        for (int t = 0; t < n_threads; t++) {
+            if (!spawned[t] && jobs[t].row1 > jobs[t].row0) {
+                hglm_spmat_thread_internal_(&jobs[t]);
+            }
+        }
+        for (int t = 0; t < n_threads; t++) {
+            if (spawned[t]) {
+                pthread_join(threads[t], NULL);
+            }
+        }
+        return;
+    }
+#else
+    (void) work;
+#endif
+    job.row0 = 0;
+    job.row1 = job.a->M;
+    hglm_spmat_thread_internal_(&job);
+}
+
+static HGL_INLINE void hglm_spmat_mul_vec(float *res, HglmSpMat a, const float *x)
+{
+    /* MxN x N ==> M */
+    assert(res != x);
+    hglm_spmat_parallel_internal_((HglmSpMatJob) {.a = &a, .x = x, .res = res}, a.nnz);
+}
+
+static HGL_INLINE void hglm_spmat_mul_mat(HglmMat res, HglmSpMat a, HglmMat b)
+{
+    /* AxB x BxC ==> AxC*/
+    assert(a.N == b.M);
+    assert(res.M == a.M);
+    assert(res.N == b.N);
+    assert(res.data != b.data);
+    hglm_spmat_parallel_internal_((HglmSpMatJob) {.a = &a, .b = b, .res_mat = res},
+                                  (uint64_t) a.nnz * b.N);
+}
+
+
+/* ========== scalar & misc. math functions ==================================*/
+
+static HGL_INLINE float hglm_pid(float error, float last_error, float *i, 
+                                 float Kp, float Ki, float Kd, float dt)
+{
+    *i += error * dt;
+    float d = (error - last_error) / dt;
+    float p = error;
+
+    return Kp*p + Ki*(*i) + Kd*d;
+}
+
+static HGL_INLINE float hglm_lerp(float a, float b, float t)
+{
+    return (1.0f - t) * a + t * b; // value
+}
+
+static HGL_INLINE float hglm_ilerp(float a, float b, float value)
+{
+    return (value - a) / (b - a); // t
+}
+
+static HGL_INLINE float hglm_clamp(float min, float max, float value)
+{
+    //return fminf(fmaxf(min, value), max);
+    if (value < min) return min;
+    if (value > max) return max;
+    return value;
+}
+
+static HGL_INLINE float hglm_remap(float in_min,
+                                   float in_max,
+                                   float out_min,
+                                   float out_max,
+                                   float value)
+{
+    float t = hglm_ilerp(in_min, in_max, value);
+    return hglm_lerp(out_min, out_max, t);
+}
+
+static HGL_INLINE float hglm_smoothstep(float t)
+{
+    return t * t * (3.0f - 2.0f * t);
+}
+
+static HGL_INLINE float hglm_smootherstep(float t)
+{
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+static HGL_INLINE float hglm_sinstep(float t)
+{
+    return -0.5f * cosf(t * (float)HGLM_PI) + 0.5f;
+}
+
+static HGL_INLINE float hglm_lerpsmooth(float a, float b, float dt, float omega)
+{
+    return b + (a - b) * exp2f(-dt/omega);
+}
+
+static HGL_INLINE float hglm_smoothmin_quadratic(float a, float b, float k)
+{
+    k *= 4.0f;
+    float h = fmaxf(k - fabsf(a - b), 0.0) / k;
+    return fminf(a, b) - h*h*k*0.25f;
+}
+
+static HGL_INLINE float hglm_smoothmin_sigmoid(float a, float b, float k)
+{
+    k *= logf(2.0);
+    float x = b - a;
+    return a + x / (1.0f - exp2f(x / k));
+}
+
+static HGL_INLINE HglmVec4 hglm_bezier3(float t)
+{
+    HglmMat4 bezier3 = ((HglmMat4) {.m00 =  1.0f, .m01 =  0.0f, .m02 =  0.0f, .m03 =  0.0f,
+                                    .m10 = -3.0f, .m11 =  3.0f, .m12 =  0.0f, .m13 =  0.0f,
                                     .m20 =  3.0f, .m21 = -6.0f, .m22 =  3.0f, .m23 =  0.0f,
                                     .m30 = -1.0f, .m31 =  3.0f, .m32 = -3.0f, .m33 =  1.0f});
     HglmVec4 ts = (HglmVec4) {.x = 1.0f, .y = t, .z = t*t, .w = t*t*t};
@@ -1639,6 +4181,379 @@ static HGL_INLINE float hglm_perlin3D(float x, float y, float z)
                                                 hglm_grad(P[BB+1], x - 1, y - 1, z - 1), u), v), w);
 }
 
+
+/* ========== Approximate math functions =====================================*/
+
+/*
+ * Sin/cos reduce the argument by multiples of pi/2 (Cody-Waite, 3 parts) and
+ * use minimax polynomials on [-pi/4, pi/4]. Exp/exp2 reduce by ln2 and scale
+ * by building the exponent bits directly. Log2 splits off the exponent bits
+ * and evaluates ln(m) for m in [sqrt(2)/2, sqrt(2)). The coefficients are the
+ * ones from Cephes' single precision sinf/cosf/expf/logf.
+ *
+ * The error bounds in the prototypes hold for both the scalar and the _array
+ * versions. -ffast-math may re-associate the argument reductions and lose
+ * some of that precision.
+ */
+
+static inline float hglm_f32_from_bits_internal_(uint32_t u)
+{
+    union { uint32_t u; float f; } b = {.u = u};
+    return b.f;
+}
+
+static inline uint32_t hglm_f32_to_bits_internal_(float f)
+{
+    union { float f; uint32_t u; } b = {.f = f};
+    return b.u;
+}
+
+/* round to nearest (ties away from zero), without libm */
+static inline int hglm_round_internal_(float x)
+{
+    return (int) (x + copysignf(0.5f, x));
+}
+
+/* `y` if `keep`, otherwise 0. Without a branch, so that loops calling the fast_ functions still vectorize */
+static inline float hglm_select_or_zero_internal_(int keep, float y)
+{
+    return hglm_f32_from_bits_internal_(hglm_f32_to_bits_internal_(y) & (0u - (uint32_t) keep));
+}
+
+/* e^r for |r| <= ln(2)/2 */
+static inline float hglm_exp_poly_internal_(float r)
+{
+    float p = 1.9875691500e-4f;
+    p = p * r + 1.3981999507e-3f;
+    p = p * r + 8.3334519073e-3f;
+    p = p * r + 4.1665795894e-2f;
+    p = p * r + 1.6666665459e-1f;
+    p = p * r + 5.0000001201e-1f;
+    return p * r * r + r + 1.0f;
+}
+
+static HGL_INLINE float hglm_fast_rsqrt(float x)
+{
+    float y = hglm_f32_from_bits_internal_(0x5f375a86u - (hglm_f32_to_bits_internal_(x) >> 1));
+    y = y * (1.5f - 0.5f * x * y * y);
+    y = y * (1.5f - 0.5f * x * y * y);
+    return y;
+}
+
+static HGL_INLINE void hglm_fast_sincos(float x, float *s, float *c)
+{
+    int q = hglm_round_internal_(x * 0.63661977236f); // 2/pi
+    float fq = (float) q;
+    float r = x - fq * 1.5703125f;
+    r = r - fq * 4.837512969970703125e-4f;
+    r = r - fq * 7.54978995489188216e-8f;
+    float r2 = r * r;
+
+    float ps = -1.9515295891e-4f;
+    ps = ps * r2 + 8.3321608736e-3f;
+    ps = ps * r2 - 1.6666654611e-1f;
+    ps = ps * r2 * r + r;
+
+    float pc = 2.443315711809948e-5f;
+    pc = pc * r2 - 1.388731625493765e-3f;
+    pc = pc * r2 + 4.166664568298827e-2f;
+    pc = pc * r2 * r2 - 0.5f * r2 + 1.0f;
+
+    /* quadrant q & 3: (sin, cos) = (ps, pc), (pc, -ps), (-ps, -pc), (-pc, ps) */
+    float sv = (q & 1) ? pc : ps;
+    float cv = (q & 1) ? ps : pc;
+    *s = (q & 2) ? -sv : sv;
+    *c = ((q + 1) & 2) ? -cv : cv;
+}
+
+static HGL_INLINE float hglm_fast_sin(float x)
+{
+    float s, c;
+    hglm_fast_sincos(x, &s, &c);
+    return s;
+}
+
+static HGL_INLINE float hglm_fast_cos(float x)
+{
+    float s, c;
+    hglm_fast_sincos(x, &s, &c);
+    return c;
+}
+
+static HGL_INLINE float hglm_fast_exp2(float x)
+{
+    /* n = -127 gives a zero scale, which flushes what would be subnormal results to 0 */
+    x = (x > -127.0f) ? x : -127.0f; // not fminf/fmaxf: those are libm calls without -ffast-math
+    x = (x < 127.49f) ? x : 127.49f;
+    int n = hglm_round_internal_(x);
+    float y = hglm_exp_poly_internal_((x - (float) n) * 0.69314718056f);
+    return y * hglm_f32_from_bits_internal_((uint32_t) (n + 127) << 23);
+}
+
+static HGL_INLINE float hglm_fast_exp(float x)
+{
+    x = (x > -88.0f) ? x : -88.0f; // see hglm_fast_exp2
+    x = (x < 88.37f) ? x : 88.37f;
+    int n = hglm_round_internal_(x * 1.44269504089f); // log2(e)
+    float fn = (float) n;
+    float r = x - fn * 0.693359375f;
+    r = r - fn * -2.12194440e-4f;
+    float y = hglm_exp_poly_internal_(r);
+    return y * hglm_f32_from_bits_internal_((uint32_t) (n + 127) << 23);
+}
+
+static HGL_INLINE float hglm_fast_log2(float x)
+{
+    uint32_t u = hglm_f32_to_bits_internal_(x);
+    int e = (int) (u >> 23) - 127;
+    float m = hglm_f32_from_bits_internal_((u & 0x007fffffu) | 0x3f800000u); // [1, 2)
+    if (m > 1.41421356237f) {
+        m *= 0.5f;
+        e += 1;
+    }
+    float r = m - 1.0f;
+    float r2 = r * r;
+    float p = 7.0376836292e-2f;
+    p = p * r - 1.1514610310e-1f;
+    p = p * r + 1.1676998740e-1f;
+    p = p * r - 1.2420140846e-1f;
+    p = p * r + 1.4249322787e-1f;
+    p = p * r - 1.6668057665e-1f;
+    p = p * r + 2.0000714765e-1f;
+    p = p * r - 2.4999993993e-1f;
+    p = p * r + 3.3333331174e-1f;
+    float ln = p * r * r2 - 0.5f * r2 + r;
+    return ln * 1.44269504089f + (float) e;
+}
+
+static HGL_INLINE float hglm_fast_pow(float x, float y)
+{
+    return hglm_select_or_zero_internal_(x > 0.0f, hglm_fast_exp2(y * hglm_fast_log2(x)));
+}
+
+#ifdef HGLM_FAST_X8_
+
+enum
+{
+    HGLM_FAST_RSQRT_,
+    HGLM_FAST_SIN_,
+    HGLM_FAST_COS_,
+    HGLM_FAST_SINCOS_,
+    HGLM_FAST_EXP2_,
+    HGLM_FAST_EXP_,
+    HGLM_FAST_LOG2_,
+    HGLM_FAST_POW_,
+};
+
+static inline HGLM_TARGET_AVX2_ __m256 hglm_fast_rsqrt8_internal_(__m256 x)
+{
+    /* rsqrtps (rel. error <= 1.5*2^-12) + one Newton-Raphson step */
+    __m256 y = _mm256_rsqrt_ps(x);
+    __m256 t = _mm256_mul_ps(_mm256_mul_ps(x, y), y);
+    return _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), y), _mm256_sub_ps(_mm256_set1_ps(3.0f), t));
+}
+
+static inline HGLM_TARGET_AVX2_ void hglm_fast_sincos8_internal_(__m256 x, __m256 *s, __m256 *c)
+{
+    __m256 fq = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(0.63661977236f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256i q = _mm256_cvtps_epi32(fq);
+    __m256 r = hglm_madd8_internal_(fq, _mm256_set1_ps(-1.5703125f), x);
+    r = hglm_madd8_internal_(fq, _mm256_set1_ps(-4.837512969970703125e-4f), r);
+    r = hglm_madd8_internal_(fq, _mm256_set1_ps(-7.54978995489188216e-8f), r);
+    __m256 r2 = _mm256_mul_ps(r, r);
+
+    __m256 ps = _mm256_set1_ps(-1.9515295891e-4f);
+    ps = hglm_madd8_internal_(ps, r2, _mm256_set1_ps(8.3321608736e-3f));
+    ps = hglm_madd8_internal_(ps, r2, _mm256_set1_ps(-1.6666654611e-1f));
+    ps = hglm_madd8_internal_(_mm256_mul_ps(ps, r2), r, r);
+
+    __m256 pc = _mm256_set1_ps(2.443315711809948e-5f);
+    pc = hglm_madd8_internal_(pc, r2, _mm256_set1_ps(-1.388731625493765e-3f));
+    pc = hglm_madd8_internal_(pc, r2, _mm256_set1_ps(4.166664568298827e-2f));
+    pc = hglm_madd8_internal_(pc, r2, _mm256_set1_ps(-0.5f));
+    pc = hglm_madd8_internal_(pc, r2, _mm256_set1_ps(1.0f));
+
+    /* see hglm_fast_sincos */
+    __m256 swap   = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+    __m256 sign_s = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(q, _mm256_set1_epi32(2)), 30));
+    __m256 sign_c = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(q, _mm256_set1_epi32(1)),
+                                                                           _mm256_set1_epi32(2)), 30));
+    *s = _mm256_xor_ps(_mm256_blendv_ps(ps, pc, swap), sign_s);
+    *c = _mm256_xor_ps(_mm256_blendv_ps(pc, ps, swap), sign_c);
+}
+
+/* e^r * 2^n */
+static inline HGLM_TARGET_AVX2_ __m256 hglm_exp_poly8_internal_(__m256 r, __m256 fn)
+{
+    __m256 p = _mm256_set1_ps(1.9875691500e-4f);
+    p = hglm_madd8_internal_(p, r, _mm256_set1_ps(1.3981999507e-3f));
+    p = hglm_madd8_internal_(p, r, _mm256_set1_ps(8.3334519073e-3f));
+    p = hglm_madd8_internal_(p, r, _mm256_set1_ps(4.1665795894e-2f));
+    p = hglm_madd8_internal_(p, r, _mm256_set1_ps(1.6666665459e-1f));
+    p = hglm_madd8_internal_(p, r, _mm256_set1_ps(5.0000001201e-1f));
+    p = hglm_madd8_internal_(_mm256_mul_ps(p, r), r, _mm256_add_ps(r, _mm256_set1_ps(1.0f)));
+    __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(fn), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(e));
+}
+
+static inline HGLM_TARGET_AVX2_ __m256 hglm_fast_exp28_internal_(__m256 x)
+{
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-127.0f)), _mm256_set1_ps(127.49f));
+    __m256 fn = _mm256_round_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    return hglm_exp_poly8_internal_(_mm256_mul_ps(_mm256_sub_ps(x, fn), _mm256_set1_ps(0.69314718056f)), fn);
+}
+
+static inline HGLM_TARGET_AVX2_ __m256 hglm_fast_exp8_internal_(__m256 x)
+{
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-88.0f)), _mm256_set1_ps(88.37f));
+    __m256 fn = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504089f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r  = hglm_madd8_internal_(fn, _mm256_set1_ps(-0.693359375f), x);
+    r = hglm_madd8_internal_(fn, _mm256_set1_ps(2.12194440e-4f), r);
+    return hglm_exp_poly8_internal_(r, fn);
+}
+
+static inline HGLM_TARGET_AVX2_ __m256 hglm_fast_log28_internal_(__m256 x)
+{
+    __m256i u = _mm256_castps_si256(x);
+    __m256 e  = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(u, 23), _mm256_set1_epi32(127)));
+    __m256 m  = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(u, _mm256_set1_epi32(0x007fffff)),
+                                                    _mm256_set1_epi32(0x3f800000)));
+    __m256 big = _mm256_cmp_ps(m, _mm256_set1_ps(1.41421356237f), _CMP_GT_OQ);
+    m = _mm256_blendv_ps(m, _mm256_mul_ps(m, _mm256_set1_ps(0.5f)), big);
+    e = _mm256_add_ps(e, _mm256_and_ps(big, _mm256_set1_ps(1.0f)));
+
+    __m256 r  = _mm256_sub_ps(m, _mm256_set1_ps(1.0f));
+    __m256 r2 = _mm256_mul_ps(r, r);
+    __m256 p  = _mm256_set1_ps(7.0376836292e-2f);
+    p = hglm_madd8_internal_(p, r, _mm256_set1_ps(-1.1514610310e-1f));
+    p = hglm_madd8_internal_(p, r, _mm256_set1_ps(1.1676998740e-1f));
+    p = hglm_madd8_internal_(p, r, _mm256_set1_ps(-1.2420140846e-1f));
+    p = hglm_madd8_internal_(p, r, _mm256_set1_ps(1.4249322787e-1f));
+    p = hglm_madd8_internal_(p, r, _mm256_set1_ps(-1.6668057665e-1f));
+    p = hglm_madd8_internal_(p, r, _mm256_set1_ps(2.0000714765e-1f));
+    p = hglm_madd8_internal_(p, r, _mm256_set1_ps(-2.4999993993e-1f));
+    p = hglm_madd8_internal_(p, r, _mm256_set1_ps(3.3333331174e-1f));
+    __m256 ln = hglm_madd8_internal_(_mm256_mul_ps(p, r), r2, hglm_madd8_internal_(r2, _mm256_set1_ps(-0.5f), r));
+    return hglm_madd8_internal_(ln, _mm256_set1_ps(1.44269504089f), e);
+}
+
+/* Returns how many of the `n` values were processed (a multiple of 8) */
+static inline HGLM_TARGET_AVX2_ size_t hglm_fast_x8_internal_(float *out, float *out2, const float *in,
+                                                              float y, size_t n, int op)
+{
+    size_t i = 0;
+    for (; i < (n & ~(size_t) 7); i += 8) {
+        __m256 x = _mm256_loadu_ps(&in[i]);
+        __m256 r, r2;
+        switch (op) {
+            case HGLM_FAST_RSQRT_:  r = hglm_fast_rsqrt8_internal_(x); break;
+            case HGLM_FAST_SIN_:    hglm_fast_sincos8_internal_(x, &r, &r2); break;
+            case HGLM_FAST_COS_:    hglm_fast_sincos8_internal_(x, &r2, &r); break;
+            case HGLM_FAST_SINCOS_: hglm_fast_sincos8_internal_(x, &r, &r2); _mm256_storeu_ps(&out2[i], r2); break;
+            case HGLM_FAST_EXP2_:   r = hglm_fast_exp28_internal_(x); break;
+            case HGLM_FAST_EXP_:    r = hglm_fast_exp8_internal_(x); break;
+            case HGLM_FAST_LOG2_:   r = hglm_fast_log28_internal_(x); break;
+            case HGLM_FAST_POW_:
+            default: {
+                r = hglm_fast_exp28_internal_(_mm256_mul_ps(_mm256_set1_ps(y), hglm_fast_log28_internal_(x)));
+                r = _mm256_and_ps(r, _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GT_OQ));
+            } break;
+        }
+        _mm256_storeu_ps(&out[i], r);
+    }
+    return i;
+}
+
+#endif /* HGLM_FAST_X8_ */
+
+static HGL_INLINE void hglm_fast_rsqrt_array(float *out, const float *in, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_FAST_X8_
+    if (HGLM_X8_ENABLED_) i = hglm_fast_x8_internal_(out, NULL, in, 0.0f, n, HGLM_FAST_RSQRT_);
+#endif
+    for (; i < n; i++) {
+        out[i] = hglm_fast_rsqrt(in[i]);
+    }
+}
+
+static HGL_INLINE void hglm_fast_sin_array(float *out, const float *in, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_FAST_X8_
+    if (HGLM_X8_ENABLED_) i = hglm_fast_x8_internal_(out, NULL, in, 0.0f, n, HGLM_FAST_SIN_);
+#endif
+    for (; i < n; i++) {
+        out[i] = hglm_fast_sin(in[i]);
+    }
+}
+
+static HGL_INLINE void hglm_fast_cos_array(float *out, const float *in, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_FAST_X8_
+    if (HGLM_X8_ENABLED_) i = hglm_fast_x8_internal_(out, NULL, in, 0.0f, n, HGLM_FAST_COS_);
+#endif
+    for (; i < n; i++) {
+        out[i] = hglm_fast_cos(in[i]);
+    }
+}
+
+static HGL_INLINE void hglm_fast_sincos_array(float *s, float *c, const float *in, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_FAST_X8_
+    if (HGLM_X8_ENABLED_) i = hglm_fast_x8_internal_(s, c, in, 0.0f, n, HGLM_FAST_SINCOS_);
+#endif
+    for (; i < n; i++) {
+        hglm_fast_sincos(in[i], &s[i], &c[i]);
+    }
+}
+
+static HGL_INLINE void hglm_fast_exp2_array(float *out, const float *in, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_FAST_X8_
+    if (HGLM_X8_ENABLED_) i = hglm_fast_x8_internal_(out, NULL, in, 0.0f, n, HGLM_FAST_EXP2_);
+#endif
+    for (; i < n; i++) {
+        out[i] = hglm_fast_exp2(in[i]);
+    }
+}
+
+static HGL_INLINE void hglm_fast_exp_array(float *out, const float *in, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_FAST_X8_
+    if (HGLM_X8_ENABLED_) i = hglm_fast_x8_internal_(out, NULL, in, 0.0f, n, HGLM_FAST_EXP_);
+#endif
+    for (; i < n; i++) {
+        out[i] = hglm_fast_exp(in[i]);
+    }
+}
+
+static HGL_INLINE void hglm_fast_log2_array(float *out, const float *in, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_FAST_X8_
+    if (HGLM_X8_ENABLED_) i = hglm_fast_x8_internal_(out, NULL, in, 0.0f, n, HGLM_FAST_LOG2_);
+#endif
+    for (; i < n; i++) {
+        out[i] = hglm_fast_log2(in[i]);
+    }
+}
+
+static HGL_INLINE void hglm_fast_pow_array(float *out, const float *x, float y, size_t n)
+{
+    size_t i = 0;
+#ifdef HGLM_FAST_X8_
+    if (HGLM_X8_ENABLED_) i = hglm_fast_x8_internal_(out, NULL, x, y, n, HGLM_FAST_POW_);
+#endif
+    for (; i < n; i++) {
+        out[i] = hglm_fast_pow(x[i], y);
+    }
+}
+
 #endif /* HGLM_H */
 
 #ifdef HGLM_STRIP_PREFIX
@@ -1676,6 +4591,16 @@ typedef HglmMat2   Mat2;
 typedef HglmMat3   Mat3;
 typedef HglmMat4   Mat4;
 typedef HglmMat    Mat;
+typedef HglmMatAllocator MatAllocator;
+typedef HglmSpMat  SpMat;
+typedef HglmVec3SoA Vec3SoA;
+typedef HglmVec4SoA Vec4SoA;
+typedef HglmPlane  Plane;
+typedef HglmFrustum Frustum;
+typedef HglmAABB   AABB;
+typedef HglmQuat   Quat;
+typedef HglmDualQuat DualQuat;
+typedef HglmCpuLevel CpuLevel;
 
 #define ivec2_print              hglm_ivec2_print
 #define ivec2_make               hglm_ivec2_make
@@ -1753,6 +4678,9 @@ typedef HglmMat    Mat;
 #define mat3_make_from_mat4      hglm_mat3_make_from_mat4
 #define mat3_transpose           hglm_mat3_transpose
 #define mat3_mul_vec3            hglm_mat3_mul_vec3
+#define mat3_determinant         hglm_mat3_determinant
+#define mat3_inverse             hglm_mat3_inverse
+#define mat3_inverse_transpose   hglm_mat3_inverse_transpose
 
 #define mat4_print               hglm_mat4_print
 #define mat4_make                hglm_mat4_make
@@ -1775,12 +4703,71 @@ typedef HglmMat    Mat;
 #define mat4_rotate              hglm_mat4_rotate
 #define mat4_translate           hglm_mat4_translate
 #define mat4_perspective_project hglm_mat4_perspective_project
+#define mat4_determinant         hglm_mat4_determinant
+#define mat4_inverse             hglm_mat4_inverse
+#define mat4_inverse_affine      hglm_mat4_inverse_affine
+#define mat4_decompose_trs       hglm_mat4_decompose_trs
+#define mat4_make_trs            hglm_mat4_make_trs
+
+#define quat_print               hglm_quat_print
+#define quat_make                hglm_quat_make
+#define quat_make_identity       hglm_quat_make_identity
+#define quat_make_rotation       hglm_quat_make_rotation
+#define quat_make_from_mat3      hglm_quat_make_from_mat3
+#define quat_mul                 hglm_quat_mul
+#define quat_conjugate           hglm_quat_conjugate
+#define quat_inverse             hglm_quat_inverse
+#define quat_dot                 hglm_quat_dot
+#define quat_normalize           hglm_quat_normalize
+#define quat_rotate_vec3         hglm_quat_rotate_vec3
+#define quat_nlerp               hglm_quat_nlerp
+#define quat_slerp               hglm_quat_slerp
+#define quat_to_mat3             hglm_quat_to_mat3
+#define quat_to_mat4             hglm_quat_to_mat4
+#define dualquat_make            hglm_dualquat_make
+#define dualquat_transform_point3 hglm_dualquat_transform_point3
+#define skin_linear_array        hglm_skin_linear_array
+#define skin_dualquat_array      hglm_skin_dualquat_array
+
+#define cpu_level                       hglm_cpu_level
+#define cpu_level_set                   hglm_cpu_level_set
+
+#define mat4_mul_vec4_array             hglm_mat4_mul_vec4_array
+#define mat4_mul_mat4_array             hglm_mat4_mul_mat4_array
+#define mat4_transform_point3_array     hglm_mat4_transform_point3_array
+#define mat4_transform_dir3_array       hglm_mat4_transform_dir3_array
+#define mat4_perspective_project_array  hglm_mat4_perspective_project_array
+#define vec3_normalize_array            hglm_vec3_normalize_array
+#define vec4_normalize_array            hglm_vec4_normalize_array
+#define vec3_dot_array                  hglm_vec3_dot_array
+#define vec4_dot_array                  hglm_vec4_dot_array
+#define mat4_mul_vec4_soa               hglm_mat4_mul_vec4_soa
+#define mat4_transform_point3_soa       hglm_mat4_transform_point3_soa
+#define mat4_transform_dir3_soa         hglm_mat4_transform_dir3_soa
+#define mat4_perspective_project_soa    hglm_mat4_perspective_project_soa
+#define vec3_normalize_soa              hglm_vec3_normalize_soa
+#define vec3_dot_soa                    hglm_vec3_dot_soa
+
+#define mask_test                       hglm_mask_test
+#define plane_make                      hglm_plane_make
+#define plane_distance                  hglm_plane_distance
+#define frustum_make_from_mat4          hglm_frustum_make_from_mat4
+#define frustum_test_aabb               hglm_frustum_test_aabb
+#define frustum_test_sphere             hglm_frustum_test_sphere
+#define ray_test_aabb                   hglm_ray_test_aabb
+#define frustum_test_aabb_soa           hglm_frustum_test_aabb_soa
+#define frustum_test_sphere_soa         hglm_frustum_test_sphere_soa
+#define ray_test_aabb_soa               hglm_ray_test_aabb_soa
 
 #define mat_print                hglm_mat_print
 #define mat_at                   hglm_mat_at
 #define mat_make                 hglm_mat_make
+#define mat_make_with            hglm_mat_make_with
+#define mat_make_from            hglm_mat_make_from
 #define mat_make_identity        hglm_mat_make_identity
+#define mat_view                 hglm_mat_view
 #define mat_free                 hglm_mat_free
+#define mat_copy                 hglm_mat_copy
 #define mat_fill                 hglm_mat_fill
 #define mat_add                  hglm_mat_add
 #define mat_sub                  hglm_mat_sub
@@ -1788,6 +4775,18 @@ typedef HglmMat    Mat;
 #define mat_mul_mat              hglm_mat_mul_mat
 #define mat_transpose_in_place   hglm_mat_transpose_in_place
 #define mat_transpose            hglm_mat_transpose
+#define mat_solve_lower          hglm_mat_solve_lower
+#define mat_solve_upper          hglm_mat_solve_upper
+#define mat_lu                   hglm_mat_lu
+#define mat_lu_solve             hglm_mat_lu_solve
+#define mat_cholesky             hglm_mat_cholesky
+#define mat_cholesky_solve       hglm_mat_cholesky_solve
+#define spmat_make_from_triplets hglm_spmat_make_from_triplets
+#define spmat_free               hglm_spmat_free
+#define spmat_transpose          hglm_spmat_transpose
+#define spmat_to_mat             hglm_spmat_to_mat
+#define spmat_mul_vec            hglm_spmat_mul_vec
+#define spmat_mul_mat            hglm_spmat_mul_mat
 
 #define pid                      hglm_pid
 #define lerp                     hglm_lerp
@@ -1804,6 +4803,23 @@ typedef HglmMat    Mat;
 #define hermite3                 hglm_hermite3
 #define perlin3D                 hglm_perlin3D
 
+#define fast_rsqrt               hglm_fast_rsqrt
+#define fast_sin                 hglm_fast_sin
+#define fast_cos                 hglm_fast_cos
+#define fast_sincos              hglm_fast_sincos
+#define fast_exp2                hglm_fast_exp2
+#define fast_exp                 hglm_fast_exp
+#define fast_log2                hglm_fast_log2
+#define fast_pow                 hglm_fast_pow
+#define fast_rsqrt_array         hglm_fast_rsqrt_array
+#define fast_sin_array           hglm_fast_sin_array
+#define fast_cos_array           hglm_fast_cos_array
+#define fast_sincos_array        hglm_fast_sincos_array
+#define fast_exp2_array          hglm_fast_exp2_array
+#define fast_exp_array           hglm_fast_exp_array
+#define fast_log2_array          hglm_fast_log2_array
+#define fast_pow_array           hglm_fast_pow_array
+
 #endif /* HGLM_STRIP_PREFIX */
 
 
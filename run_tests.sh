@@ -0,0 +1,33 @@
+#!/bin/bash
+/root/repo/build/test/test_fft &&
+/root/repo/build/test/test_hglm_simd &&
+/root/repo/build/test/test_da &&
+/root/repo/build/test/test_worker_pool &&
+/root/repo/build/test/test_waitgroup &&
+/root/repo/build/test/test_buffered_chan &&
+/root/repo/build/test/test_barrier &&
+/root/repo/build/test/test_hglm_avx2 &&
+/root/repo/build/test/test_serialize &&
+/root/repo/build/test/test_mem &&
+/root/repo/build/test/test_float &&
+/root/repo/build/test/test_tq &&
+/root/repo/build/test/test_memdbg &&
+/root/repo/build/test/test_hglm &&
+/root/repo/build/test/test_hglm_dispatch &&
+/root/repo/build/test/test_htable &&
+/root/repo/build/test/test_q &&
+/root/repo/build/test/test_rbtree &&
+/root/repo/build/test/test_alloc &&
+/root/repo/build/test/test_rle &&
+/root/repo/build/test/test_chan &&
+/root/repo/build/test/test_flags &&
+/root/repo/build/test/test_ini &&
+/root/repo/build/test/test_string &&
+/root/repo/build/test/test_hset &&
+/root/repo/build/test/test_base64 &&
+/root/repo/build/test/test_fft_simd &&
+/root/repo/build/test/test_rita &&
+/root/repo/build/test/test_sockets &&
+/root/repo/build/test/test_cmd &&
+/root/repo/build/test/test_hamming &&
+exit 0;
@@ -1,6 +1,9 @@
 
 #include "hgl_test.h"
 
+#define HGL_ALLOC_IMPLEMENTATION
+#include "hgl_alloc.h"
+
 #define HGLM_STRIP_PREFIX
 #include "hglm.h"
 
@@ -105,3 +108,748 @@ TEST(test_vec2)
                                      vec2_make(1,0), 1.0f), vec2_make(1, 0)));
 }
 
+
+TEST(test_mat_mul_mat)
+{
+    /* non-square: 2x3 * 3x4 */
+    Mat a = mat_make(2, 3);
+    Mat b = mat_make(3, 4);
+    Mat c = mat_make(2, 4);
+    for (uint32_t i = 0; i < 6; i++) a.data[i] = (float)(i + 1);
+    for (uint32_t i = 0; i < 12; i++) b.data[i] = (float)(i + 1);
+    mat_mul_mat(c, a, b);
+    const float expected[] = { 38,  44,  50,  56,
+                               83, 98, 113, 128};
+    for (uint32_t i = 0; i < 8; i++) {
+        ASSERT(float_eq(c.data[i], expected[i]));
+    }
+    mat_free(a);
+    mat_free(b);
+    mat_free(c);
+
+    /* large enough to be blocked, with partial blocks along every dimension */
+    const uint32_t M = 151, K = 263, N = 77;
+    a = mat_make(M, K);
+    b = mat_make(K, N);
+    c = mat_make(M, N);
+    for (uint32_t i = 0; i < M*K; i++) a.data[i] = (float)((i * 7919) % 101) / 50.0f - 1.0f;
+    for (uint32_t i = 0; i < K*N; i++) b.data[i] = (float)((i * 104729) % 103) / 51.0f - 1.0f;
+    mat_mul_mat(c, a, b);
+    for (uint32_t row = 0; row < M; row++) {
+        for (uint32_t col = 0; col < N; col++) {
+            double sum = 0.0;
+            for (uint32_t i = 0; i < K; i++) {
+                sum += (double) mat_at(a, row, i) * (double) mat_at(b, i, col);
+            }
+            ASSERT(fabs((double) mat_at(c, row, col) - sum) < 1e-3);
+        }
+    }
+    mat_free(a);
+    mat_free(b);
+    mat_free(c);
+}
+
+static void *arena_alloc(void *ctx, size_t size)
+{
+    return hgl_alloc(ctx, size);
+}
+
+TEST(test_mat_alloc_and_views)
+{
+    HglAllocator arena = HGL_ALLOC_BUMP_ARENA_INITIALIZER(64 * 1024);
+    MatAllocator a = {.alloc = arena_alloc, .free = NULL, .ctx = &arena};
+
+    const uint32_t M = 37, K = 29, N = 41;
+    Mat big = mat_make_with(M + 5, K + 7, &a);
+    Mat b   = mat_make_with(K, N, &a);
+    Mat c   = mat_make_with(M + 3, N + 2, &a);
+    ASSERT(big.stride == K + 7);
+    for (uint32_t row = 0; row < big.M; row++) {
+        for (uint32_t col = 0; col < big.N; col++) {
+            mat_at(big, row, col) = (float)((row * 31 + col * 7) % 17) / 8.0f - 1.0f;
+        }
+    }
+    for (uint32_t i = 0; i < K*N; i++) b.data[i] = (float)((i * 104729) % 103) / 51.0f - 1.0f;
+    mat_fill(c, -42.0f);
+
+    /* strided views as both input and output */
+    Mat av = mat_view(big, 3, 5, M, K);
+    Mat cv = mat_view(c, 2, 1, M, N);
+    ASSERT(av.stride == big.stride && &mat_at(av, 0, 0) == &mat_at(big, 3, 5));
+    mat_mul_mat(cv, av, b);
+    for (uint32_t row = 0; row < c.M; row++) {
+        for (uint32_t col = 0; col < c.N; col++) {
+            if (row < 2 || row >= 2 + M || col < 1 || col >= 1 + N) {
+                ASSERT(mat_at(c, row, col) == -42.0f); // untouched outside the view
+                continue;
+            }
+            double sum = 0.0;
+            for (uint32_t i = 0; i < K; i++) {
+                sum += (double) mat_at(big, row - 2 + 3, i + 5) * (double) mat_at(b, i, col - 1);
+            }
+            ASSERT(fabs((double) mat_at(c, row, col) - sum) < 1e-3);
+        }
+    }
+
+    /* views of views, copy and elementwise ops */
+    Mat vv = mat_view(cv, 1, 2, 4, 3);
+    Mat t  = mat_make_with(4, 3, &a);
+    mat_copy(t, vv);
+    mat_add(vv, vv, t);
+    for (uint32_t row = 0; row < 4; row++) {
+        for (uint32_t col = 0; col < 3; col++) {
+            ASSERT(float_eq(mat_at(c, row + 3, col + 3), 2.0f * mat_at(t, row, col)));
+        }
+    }
+
+    /* wrapped storage */
+    float storage[2][4] = {{1, 2, 3, 4}, {5, 6, 7, 8}};
+    Mat w = mat_make_from(&storage[0][1], 2, 2, 4);
+    mat_mul_scalar(w, 10.0f);
+    ASSERT(storage[0][0] == 1 && storage[0][1] == 20 && storage[1][2] == 70 && storage[1][3] == 8);
+
+    /* brace-initialized: stride 0 means tightly packed */
+    float ad[2*3] = {1, 2, 3, 4, 5, 6};
+    float bd[3*2] = {1, 2, 3, 4, 5, 6};
+    float cd[2*2] = {0};
+    Mat ab = {.data = ad, .M = 2, .N = 3};
+    Mat bb = {.data = bd, .M = 3, .N = 2};
+    Mat cb = {.data = cd, .M = 2, .N = 2};
+    ASSERT(mat_at(ab, 1, 0) == 4 && mat_at(ab, 1, 2) == 6 && mat_at(bb, 2, 1) == 6);
+    mat_mul_mat(cb, ab, bb);
+    ASSERT(float_eq(cd[0], 22) && float_eq(cd[1], 28) && float_eq(cd[2], 49) && float_eq(cd[3], 64));
+    Mat abv = mat_view(ab, 1, 1, 1, 2);
+    ASSERT(abv.stride == 3 && mat_at(abv, 0, 0) == 5 && mat_at(abv, 0, 1) == 6);
+
+    /* none of these free anything */
+    mat_free(w);
+    mat_free(vv);
+    mat_free(big);
+    hgl_free_all(&arena);
+    hgl_alloc_destroy(&arena);
+}
+
+TEST(test_mat_solve)
+{
+    /* bigger than a few panels, and not a multiple of the panel width */
+    const uint32_t n = 3*HGLM_FACTOR_NB + 29, nrhs = 3;
+    Mat a   = mat_make(n, n);
+    Mat lu  = mat_make(n, n);
+    Mat x   = mat_make(n, nrhs);
+    Mat b   = mat_make(n, nrhs);
+    Mat ax  = mat_make(n, nrhs);
+    uint32_t *piv = malloc(n * sizeof(*piv));
+    uint32_t seed = 777;
+    for (uint32_t i = 0; i < n*n; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        a.data[i] = (float)(seed >> 8) / (float)(1u << 23) - 1.0f;
+    }
+    for (uint32_t i = 0; i < n*nrhs; i++) b.data[i] = (float)((i * 104729) % 103) / 51.0f - 1.0f;
+
+    /* LU with partial pivoting: A x = b */
+    mat_copy(lu, a);
+    mat_copy(x, b);
+    ASSERT(mat_lu(lu, piv) == 0);
+    mat_lu_solve(lu, piv, x);
+    mat_mul_mat(ax, a, x);
+    for (uint32_t i = 0; i < n*nrhs; i++) ASSERT(fabsf(ax.data[i] - b.data[i]) < 1e-3f);
+
+    /* Cholesky: S = A A^T + n I is symmetric positive definite */
+    Mat at = mat_make(n, n);
+    Mat sp = mat_make(n, n);
+    mat_transpose(at, a);
+    mat_mul_mat(sp, a, at);
+    for (uint32_t i = 0; i < n; i++) mat_at(sp, i, i) += (float) n;
+    mat_copy(lu, sp);
+    mat_copy(x, b);
+    ASSERT(mat_cholesky(lu) == 0);
+    for (uint32_t row = 0; row < n; row++) {
+        for (uint32_t col = 0; col < row; col++) {
+            ASSERT(mat_at(lu, row, col) == mat_at(lu, col, row)); // L^T in the upper triangle
+        }
+    }
+    mat_cholesky_solve(lu, x);
+    mat_mul_mat(ax, sp, x);
+    for (uint32_t i = 0; i < n*nrhs; i++) ASSERT(fabsf(ax.data[i] - b.data[i]) < 1e-3f);
+
+    /* L L^T == S */
+    Mat l = mat_make(n, n);
+    for (uint32_t row = 0; row < n; row++) {
+        for (uint32_t col = 0; col < n; col++) {
+            mat_at(l, row, col) = (col <= row) ? mat_at(lu, row, col) : 0.0f;
+        }
+    }
+    mat_transpose(at, l);
+    mat_mul_mat(a, l, at);
+    for (uint32_t i = 0; i < n*n; i++) ASSERT(fabsf(a.data[i] - sp.data[i]) < 1e-2f);
+
+    /* failures */
+    mat_fill(lu, 1.0f);
+    ASSERT(mat_lu(lu, piv) != 0);
+    mat_fill(lu, 1.0f);
+    mat_at(lu, 5, 5) = -1.0f;
+    ASSERT(mat_cholesky(lu) != 0);
+
+    free(piv);
+    mat_free(a);
+    mat_free(lu);
+    mat_free(x);
+    mat_free(b);
+    mat_free(ax);
+    mat_free(at);
+    mat_free(sp);
+    mat_free(l);
+}
+
+TEST(test_spmat)
+{
+    /* random triplets with duplicates, plus one dense row so the 8-wide path gets a long row */
+    enum { M = 203, N = 157, COUNT = 3000 + N };
+    static uint32_t ri[COUNT], ci[COUNT];
+    static float v[COUNT], x[N], y[M], yt[N], xt[M];
+    uint32_t seed = 12345;
+    for (int i = 0; i < COUNT; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        ri[i] = (i < N) ? 17 : (seed >> 8) % M;
+        ci[i] = (i < N) ? (uint32_t) i : (seed >> 4) % N;
+        v[i]  = (float)((seed >> 12) % 201) / 100.0f - 1.0f;
+    }
+    for (int i = 0; i < N; i++) x[i] = sinf((float) i);
+    for (int i = 0; i < M; i++) xt[i] = cosf((float) i);
+
+    SpMat a = spmat_make_from_triplets(M, N, ri, ci, v, COUNT, NULL);
+    ASSERT(a.nnz < COUNT && a.row_ptr[M] == a.nnz);
+    for (uint32_t row = 0; row < M; row++) {
+        for (uint32_t k = a.row_ptr[row] + 1; k < a.row_ptr[row + 1]; k++) {
+            ASSERT(a.col_idx[k - 1] < a.col_idx[k]); // sorted, duplicates merged
+        }
+    }
+
+    Mat d = mat_make(M, N);
+    mat_fill(d, 0.0f);
+    for (int i = 0; i < COUNT; i++) mat_at(d, ri[i], ci[i]) += v[i];
+    Mat ad = mat_make(M, N);
+    spmat_to_mat(ad, a);
+    for (uint32_t i = 0; i < M*N; i++) ASSERT(float_eq(ad.data[i], d.data[i]));
+
+    spmat_mul_vec(y, a, x);
+    for (uint32_t row = 0; row < M; row++) {
+        float sum = 0.0f;
+        for (uint32_t col = 0; col < N; col++) sum += mat_at(d, row, col) * x[col];
+        ASSERT(fabsf(y[row] - sum) < 1e-3f);
+    }
+
+    SpMat t = spmat_transpose(a, NULL);
+    ASSERT(t.M == N && t.N == M && t.nnz == a.nnz);
+    spmat_mul_vec(yt, t, xt);
+    for (uint32_t col = 0; col < N; col++) {
+        float sum = 0.0f;
+        for (uint32_t row = 0; row < M; row++) sum += mat_at(d, row, col) * xt[row];
+        ASSERT(fabsf(yt[col] - sum) < 1e-3f);
+    }
+
+    /* sparse x dense, into a view */
+    const uint32_t K = 19;
+    Mat b = mat_make(N, K);
+    Mat c = mat_make(M + 1, K + 2);
+    Mat cd = mat_make(M, K);
+    for (uint32_t i = 0; i < N*K; i++) b.data[i] = (float)((i * 7919) % 101) / 50.0f - 1.0f;
+    spmat_mul_mat(mat_view(c, 1, 2, M, K), a, b);
+    mat_mul_mat(cd, d, b);
+    for (uint32_t row = 0; row < M; row++) {
+        for (uint32_t col = 0; col < K; col++) {
+            ASSERT(fabsf(mat_at(c, row + 1, col + 2) - mat_at(cd, row, col)) < 1e-3f);
+        }
+    }
+
+    spmat_free(a);
+    spmat_free(t);
+    mat_free(d);
+    mat_free(ad);
+    mat_free(b);
+    mat_free(c);
+    mat_free(cd);
+}
+
+TEST(test_batch)
+{
+    /* not a multiple of 8, so both the 8-wide path and the tail are covered */
+    enum { N = 37 };
+    static Vec3 p3[N], q3[N], r3[N];
+    static Vec4 p4[N], q4[N], r4[N];
+    static float x[N], y[N], z[N], w[N], ox[N], oy[N], oz[N], ow[N], d[N];
+    Vec3SoA soa3     = {.x = x,  .y = y,  .z = z};
+    Vec3SoA out_soa3 = {.x = ox, .y = oy, .z = oz};
+    Vec4SoA soa4     = {.x = x,  .y = y,  .z = z,  .w = w};
+    Vec4SoA out_soa4 = {.x = ox, .y = oy, .z = oz, .w = ow};
+    for (int i = 0; i < N; i++) {
+        p3[i] = vec3_make(sinf((float)i), cosf(1.7f*(float)i), 0.5f + (float)(i % 5));
+        q3[i] = vec3_make(0.3f*(float)i - 4.0f, 1.0f, sinf(0.3f*(float)i));
+        p4[i] = vec4_make(p3[i].x, p3[i].y, p3[i].z, 1.0f + 0.1f*(float)(i % 7));
+        q4[i] = vec4_make(q3[i].x, q3[i].y, q3[i].z, -0.5f);
+        x[i] = p4[i].x; y[i] = p4[i].y; z[i] = p4[i].z; w[i] = p4[i].w;
+    }
+    Mat4 m = mat4_rotate(mat4_make_translation(vec3_make(1, -2, 3)), 0.7f, vec3_normalize(vec3_make(1, 2, 3)));
+    Mat4 proj = mat4_make_perspective(1.0f, 1.5f, 0.1f, 100.0f);
+
+    mat4_mul_vec4_array(r4, m, p4, N);
+    for (int i = 0; i < N; i++) ASSERT(vec4_eq(r4[i], mat4_mul_vec4(m, p4[i])));
+
+    mat4_transform_point3_array(r3, m, p3, N);
+    for (int i = 0; i < N; i++) ASSERT(vec3_eq(r3[i], mat4_mul_vec4(m, vec4_make(p3[i].x, p3[i].y, p3[i].z, 1)).xyz));
+
+    mat4_transform_dir3_array(r3, m, p3, N);
+    for (int i = 0; i < N; i++) ASSERT(vec3_eq(r3[i], mat4_mul_vec4(m, vec4_make(p3[i].x, p3[i].y, p3[i].z, 0)).xyz));
+
+    mat4_perspective_project_array(r4, proj, p4, N);
+    for (int i = 0; i < N; i++) ASSERT(vec4_eq(r4[i], mat4_perspective_project(proj, p4[i])));
+
+    vec3_normalize_array(r3, q3, N);
+    for (int i = 0; i < N; i++) ASSERT(vec3_eq(r3[i], vec3_normalize(q3[i])));
+
+    vec4_normalize_array(r4, q4, N);
+    for (int i = 0; i < N; i++) ASSERT(vec4_eq(r4[i], vec4_normalize(q4[i])));
+
+    vec3_dot_array(d, p3, q3, N);
+    for (int i = 0; i < N; i++) ASSERT(float_eq(d[i], vec3_dot(p3[i], q3[i])));
+
+    vec4_dot_array(d, p4, q4, N);
+    for (int i = 0; i < N; i++) ASSERT(float_eq(d[i], vec4_dot(p4[i], q4[i])));
+
+    mat4_mul_vec4_soa(out_soa4, m, soa4, N);
+    for (int i = 0; i < N; i++) ASSERT(vec4_eq(vec4_make(ox[i], oy[i], oz[i], ow[i]), mat4_mul_vec4(m, p4[i])));
+
+    mat4_transform_point3_soa(out_soa3, m, soa3, N);
+    for (int i = 0; i < N; i++) ASSERT(vec3_eq(vec3_make(ox[i], oy[i], oz[i]), mat4_mul_vec4(m, vec4_make(x[i], y[i], z[i], 1)).xyz));
+
+    mat4_transform_dir3_soa(out_soa3, m, soa3, N);
+    for (int i = 0; i < N; i++) ASSERT(vec3_eq(vec3_make(ox[i], oy[i], oz[i]), mat4_mul_vec4(m, vec4_make(x[i], y[i], z[i], 0)).xyz));
+
+    mat4_perspective_project_soa(out_soa4, proj, soa4, N);
+    for (int i = 0; i < N; i++) ASSERT(vec4_eq(vec4_make(ox[i], oy[i], oz[i], ow[i]), mat4_perspective_project(proj, p4[i])));
+
+    vec3_normalize_soa(out_soa3, soa3, N);
+    for (int i = 0; i < N; i++) ASSERT(vec3_eq(vec3_make(ox[i], oy[i], oz[i]), vec3_normalize(p3[i])));
+
+    vec3_dot_soa(d, soa3, soa3, N);
+    for (int i = 0; i < N; i++) ASSERT(float_eq(d[i], vec3_dot(p3[i], p3[i])));
+
+    /* in place */
+    vec3_normalize_array(q3, q3, N);
+    for (int i = 0; i < N; i++) ASSERT(float_eq(vec3_len(q3[i]), 1.0f));
+}
+
+TEST(test_culling)
+{
+    /* not a multiple of 8, so both the 8-wide path and the tail are covered */
+    enum { N = 203 };
+    static float min_x[N], min_y[N], min_z[N], max_x[N], max_y[N], max_z[N], radius[N];
+    static uint8_t mask[(N + 7) / 8], mask2[(N + 7) / 8];
+    Vec3SoA min = {.x = min_x, .y = min_y, .z = min_z};
+    Vec3SoA max = {.x = max_x, .y = max_y, .z = max_z};
+
+    Mat4 view = mat4_look_at(vec3_make(1, 2, 3), vec3_make(0, 0, -10), vec3_make(0, 1, 0));
+    Mat4 proj = mat4_make_perspective(1.0f, 1.5f, 0.5f, 50.0f);
+    Mat4 vp   = mat4_mul_mat4(proj, view);
+    Frustum f = frustum_make_from_mat4(vp);
+
+    /* points (spheres with radius 0) agree with clip space, away from the planes */
+    uint32_t seed = 99;
+    for (int i = 0; i < 2000; i++) {
+        float c[3];
+        for (int k = 0; k < 3; k++) {
+            seed = seed * 1664525u + 1013904223u;
+            c[k] = (float)(seed >> 8) / (float)(1u << 24) * 120.0f - 60.0f;
+        }
+        Vec3 p = vec3_make(c[0], c[1], c[2]);
+        Vec4 clip = mat4_mul_vec4(vp, vec4_make(p.x, p.y, p.z, 1.0f));
+        int inside = fabsf(clip.x) <= clip.w && fabsf(clip.y) <= clip.w && fabsf(clip.z) <= clip.w;
+        float margin = 1e-3f;
+        for (int k = 0; k < 6; k++) margin = fminf(margin, fabsf(plane_distance(f.planes[k], p)));
+        if (margin < 1e-3f) continue;
+        ASSERT(frustum_test_sphere(f, p, 0.0f) == inside);
+    }
+
+    /* batch == scalar */
+    for (int i = 0; i < N; i++) {
+        float c[3], e[3];
+        for (int k = 0; k < 3; k++) {
+            seed = seed * 1664525u + 1013904223u;
+            c[k] = (float)(seed >> 8) / (float)(1u << 24) * 120.0f - 60.0f;
+            e[k] = 0.1f + (float)((seed >> 4) % 50) / 10.0f;
+        }
+        min_x[i] = c[0] - e[0]; max_x[i] = c[0] + e[0];
+        min_y[i] = c[1] - e[1]; max_y[i] = c[1] + e[1];
+        min_z[i] = c[2] - e[2]; max_z[i] = c[2] + e[2];
+        radius[i] = e[0];
+    }
+    Vec3SoA center = {.x = min_x, .y = min_y, .z = min_z};
+    int n_visible = 0;
+
+    memset(mask, 0xAA, sizeof(mask));
+    frustum_test_aabb_soa(mask, f, min, max, N);
+    for (int i = 0; i < N; i++) {
+        AABB box = {vec3_make(min_x[i], min_y[i], min_z[i]), vec3_make(max_x[i], max_y[i], max_z[i])};
+        ASSERT((int) mask_test(mask, i) == frustum_test_aabb(f, box));
+        n_visible += mask_test(mask, i);
+    }
+    ASSERT(n_visible > 0 && n_visible < N);
+
+    memset(mask, 0x55, sizeof(mask));
+    frustum_test_sphere_soa(mask, f, center, radius, N);
+    for (int i = 0; i < N; i++) {
+        ASSERT((int) mask_test(mask, i) == frustum_test_sphere(f, vec3_make(min_x[i], min_y[i], min_z[i]), radius[i]));
+    }
+
+    Vec3 o = vec3_make(0, 0, 0);
+    Vec3 d = vec3_normalize(vec3_make(0.3f, -0.2f, -1.0f));
+    memset(mask2, 0xFF, sizeof(mask2));
+    ray_test_aabb_soa(mask2, o, d, 100.0f, min, max, N);
+    n_visible = 0;
+    for (int i = 0; i < N; i++) {
+        AABB box = {vec3_make(min_x[i], min_y[i], min_z[i]), vec3_make(max_x[i], max_y[i], max_z[i])};
+        ASSERT((int) mask_test(mask2, i) == ray_test_aabb(o, d, 100.0f, box));
+        n_visible += mask_test(mask2, i);
+    }
+    ASSERT(n_visible < N);
+
+    /* known cases */
+    AABB front  = {vec3_make(-1, -1, -11), vec3_make(1, 1, -9)};
+    AABB behind = {vec3_make(-1, -1, 9), vec3_make(1, 1, 11)};
+    ASSERT(frustum_test_aabb(f, front));
+    ASSERT(!frustum_test_aabb(f, behind));
+    ASSERT(ray_test_aabb(o, vec3_make(0, 0, -1), 100.0f, front));
+    ASSERT(!ray_test_aabb(o, vec3_make(0, 0, -1), 5.0f, front));
+    ASSERT(!ray_test_aabb(o, vec3_make(0, 0, -1), 100.0f, behind));
+    ASSERT(ray_test_aabb(o, vec3_make(0, 0, 1), 100.0f, behind));
+}
+
+TEST(test_culling_on_plane)
+{
+    /* volumes touching a plane, where rounding decides the result. Batch and scalar must agree */
+    enum { N = 65536 };
+    static float min_x[N], min_y[N], min_z[N], max_x[N], max_y[N], max_z[N];
+    static float c_x[N], c_y[N], c_z[N], radius[N];
+    static uint8_t mask[N / 8];
+    Vec3SoA min    = {.x = min_x, .y = min_y, .z = min_z};
+    Vec3SoA max    = {.x = max_x, .y = max_y, .z = max_z};
+    Vec3SoA center = {.x = c_x, .y = c_y, .z = c_z};
+
+    Mat4 view = mat4_look_at(vec3_make(1, 2, 3), vec3_make(0, 0, -10), vec3_make(0, 1, 0));
+    Mat4 proj = mat4_make_perspective(1.0f, 1.5f, 0.5f, 50.0f);
+    Frustum f = frustum_make_from_mat4(mat4_mul_mat4(proj, view));
+
+    uint32_t seed = 1234;
+    for (int i = 0; i < N; i++) {
+        float c[4];
+        for (int k = 0; k < 4; k++) {
+            seed = seed * 1664525u + 1013904223u;
+            c[k] = (float)(seed >> 8) / (float)(1u << 24);
+        }
+        Plane pl = f.planes[i % 6];
+        Vec3 p   = vec3_make(120.0f*c[0] - 60.0f, 120.0f*c[1] - 60.0f, 120.0f*c[2] - 60.0f);
+        Vec3 e   = vec3_make(5.0f*c[3], 3.0f*c[3], 4.0f*c[3]);
+        float r  = fabsf(pl.n.x)*e.x + fabsf(pl.n.y)*e.y + fabsf(pl.n.z)*e.z;
+
+        /* move p onto the plane, then back by the extent along the normal */
+        p = vec3_sub(p, vec3_mul_scalar(pl.n, plane_distance(pl, p) + r));
+        min_x[i] = p.x - e.x; max_x[i] = p.x + e.x;
+        min_y[i] = p.y - e.y; max_y[i] = p.y + e.y;
+        min_z[i] = p.z - e.z; max_z[i] = p.z + e.z;
+        c_x[i] = p.x; c_y[i] = p.y; c_z[i] = p.z;
+        radius[i] = r;
+    }
+
+    frustum_test_aabb_soa(mask, f, min, max, N);
+    for (int i = 0; i < N; i++) {
+        AABB box = {vec3_make(min_x[i], min_y[i], min_z[i]), vec3_make(max_x[i], max_y[i], max_z[i])};
+        ASSERT((int) mask_test(mask, i) == frustum_test_aabb(f, box));
+    }
+
+    frustum_test_sphere_soa(mask, f, center, radius, N);
+    for (int i = 0; i < N; i++) {
+        ASSERT((int) mask_test(mask, i) == frustum_test_sphere(f, vec3_make(c_x[i], c_y[i], c_z[i]), radius[i]));
+    }
+
+    /* exactly on an axis aligned plane: touching is inside, on both paths */
+    Frustum box_f;
+    for (int k = 0; k < 6; k++) {
+        float n[3] = {0};
+        n[k >> 1] = (k & 1) ? -1.0f : 1.0f;
+        box_f.planes[k] = (Plane) {.n = vec3_make(n[0], n[1], n[2]), .d = 1.0f};
+    }
+    for (int i = 0; i < 16; i++) {
+        float s = (float) i / 16.0f;
+        min_x[i] = 1.0f;        max_x[i] = 1.0f + s; /* touches x = 1 */
+        min_y[i] = -s;          max_y[i] = s;
+        min_z[i] = -1.0f - s;   max_z[i] = -1.0f;    /* touches z = -1 */
+        c_x[i] = -1.0f - s; c_y[i] = 0.0f; c_z[i] = 0.0f;
+        radius[i] = s;                               /* touches x = -1 */
+    }
+    for (int i = 16; i < 24; i++) {
+        min_x[i] = 1.0f + 0x1p-20f; max_x[i] = 2.0f;
+        min_y[i] = min_z[i] = 0.0f; max_y[i] = max_z[i] = 0.0f;
+        c_x[i] = -2.0f; c_y[i] = c_z[i] = 0.0f;
+        radius[i] = 1.0f - 0x1p-20f;
+    }
+    frustum_test_aabb_soa(mask, box_f, min, max, 24);
+    ASSERT(mask[0] == 0xFF && mask[1] == 0xFF && mask[2] == 0x00);
+    frustum_test_sphere_soa(mask, box_f, center, radius, 24);
+    ASSERT(mask[0] == 0xFF && mask[1] == 0xFF && mask[2] == 0x00);
+}
+
+TEST(test_cpu_dispatch)
+{
+    /* every level up to what this CPU supports must give the same results */
+    const uint32_t M = 67, K = 45, N = 53;
+    Mat a = mat_make(M, K);
+    Mat b = mat_make(K, N);
+    Mat c = mat_make(M, N);
+    for (uint32_t i = 0; i < M*K; i++) a.data[i] = (float)((i * 7919) % 101) / 50.0f - 1.0f;
+    for (uint32_t i = 0; i < K*N; i++) b.data[i] = (float)((i * 104729) % 103) / 51.0f - 1.0f;
+
+    enum { NV = 21 };
+    static Vec4 v[NV], r[NV];
+    static Mat4 ms[NV], rs[NV];
+    Mat4 m = mat4_rotate(mat4_make_translation(vec3_make(1, -2, 3)), 0.7f, vec3_normalize(vec3_make(1, 2, 3)));
+    for (int i = 0; i < NV; i++) {
+        v[i]  = vec4_make((float)i, cosf((float)i), 1.0f, 0.5f);
+        ms[i] = mat4_make_rotation(0.1f*(float)i, vec3_normalize(vec3_make(1, (float)i, 1)));
+    }
+
+    CpuLevel max = cpu_level();
+    for (int level = HGLM_CPU_SCALAR; level <= (int)max; level++) {
+        cpu_level_set((CpuLevel) level);
+        ASSERT(cpu_level() == (CpuLevel) level);
+
+        mat_mul_mat(c, a, b);
+        for (uint32_t row = 0; row < M; row++) {
+            for (uint32_t col = 0; col < N; col++) {
+                double sum = 0.0;
+                for (uint32_t i = 0; i < K; i++) {
+                    sum += (double) mat_at(a, row, i) * (double) mat_at(b, i, col);
+                }
+                ASSERT(fabs((double) mat_at(c, row, col) - sum) < 1e-3);
+            }
+        }
+
+        mat4_mul_vec4_array(r, m, v, NV);
+        for (int i = 0; i < NV; i++) ASSERT(vec4_eq(r[i], mat4_mul_vec4(m, v[i])));
+
+        mat4_mul_mat4_array(rs, m, ms, NV);
+        for (int i = 0; i < NV; i++) {
+            Mat4 e = mat4_mul_mat4(m, ms[i]);
+            for (int j = 0; j < 16; j++) ASSERT(float_eq(rs[i].f[j], e.f[j]));
+        }
+    }
+
+    /* can't go above what the CPU supports */
+    cpu_level_set(HGLM_CPU_AVX512);
+    ASSERT(cpu_level() == max);
+
+    mat_free(a);
+    mat_free(b);
+    mat_free(c);
+}
+
+TEST(test_mat_inverse)
+{
+    Mat4 trs = mat4_scale(mat4_rotate(mat4_make_translation(vec3_make(1, -2, 3)), 0.7f,
+                                      vec3_normalize(vec3_make(1, 2, 3))), vec3_make(2.0f, 0.5f, 3.0f));
+    Mat4 general = trs;
+    general.c0.w = 0.3f;
+    general.c2.w = -0.2f;
+    general.c3.w = 2.0f;
+    const Mat4 ms[] = {trs, general, mat4_make_perspective(1.0f, 1.5f, 0.1f, 100.0f)};
+
+    for (size_t i = 0; i < sizeof(ms)/sizeof(ms[0]); i++) {
+        Mat4 id = mat4_mul_mat4(ms[i], mat4_inverse(ms[i]));
+        Mat4 e = mat4_make_identity();
+        for (int j = 0; j < 16; j++) ASSERT(float_eq(id.f[j], e.f[j]));
+    }
+
+    /* the affine fast path agrees with the general inverse */
+    Mat4 inv = mat4_inverse(trs);
+    Mat4 inv_affine = mat4_inverse_affine(trs);
+    for (int j = 0; j < 16; j++) ASSERT(float_eq(inv.f[j], inv_affine.f[j]));
+
+    /* det(TRS) = product of the scales */
+    ASSERT(fabsf(mat4_determinant(trs) - 3.0f) < 1e-4f);
+    ASSERT(fabsf(mat3_determinant(mat3_make_from_mat4(trs)) - 3.0f) < 1e-4f);
+
+    /* normal matrix == transpose of the inverse */
+    Mat3 m3 = mat3_make_from_mat4(general);
+    Mat3 n = mat3_inverse_transpose(m3);
+    Mat3 it = mat3_transpose(mat3_inverse(m3));
+    for (int j = 0; j < 9; j++) ASSERT(float_eq(n.f[j], it.f[j]));
+    ASSERT(vec3_eq(mat3_mul_vec3(m3, mat3_mul_vec3(mat3_inverse(m3), vec3_make(1, 2, 3))), vec3_make(1, 2, 3)));
+
+    /* decompose (incl. a mirrored matrix) */
+    Vec3 t, s;
+    Mat3 r;
+    mat4_decompose_trs(trs, &t, &r, &s);
+    ASSERT(vec3_eq(t, vec3_make(1, -2, 3)));
+    ASSERT(vec3_eq(s, vec3_make(2.0f, 0.5f, 3.0f)));
+    Mat3 r_expected = mat3_make_from_mat4(mat4_make_rotation(0.7f, vec3_normalize(vec3_make(1, 2, 3))));
+    for (int j = 0; j < 9; j++) ASSERT(float_eq(r.f[j], r_expected.f[j]));
+
+    mat4_decompose_trs(mat4_scale(trs, vec3_make(-1, 1, 1)), &t, &r, &s);
+    ASSERT(vec3_eq(s, vec3_make(-2.0f, 0.5f, 3.0f)));
+    for (int j = 0; j < 9; j++) ASSERT(float_eq(r.f[j], r_expected.f[j]));
+}
+
+TEST(test_fast_math)
+{
+    /* the documented error bounds, at every cpu level */
+    enum { N = 1003 };
+    static float x[N], r[N], r2[N];
+
+    CpuLevel max = cpu_level();
+    for (int level = HGLM_CPU_SCALAR; level <= (int)max; level++) {
+        cpu_level_set((CpuLevel) level);
+
+        for (int i = 0; i < N; i++) x[i] = -8192.0f + 16384.0f * (float)i / (N - 1);
+        fast_sincos_array(r, r2, x, N);
+        for (int i = 0; i < N; i++) {
+            ASSERT(fabs(fast_sin(x[i]) - sin((double)x[i])) < 1.5e-7);
+            ASSERT(fabs(fast_cos(x[i]) - cos((double)x[i])) < 1.5e-7);
+            ASSERT(fabs(r[i] - sin((double)x[i])) < 1.5e-7);
+            ASSERT(fabs(r2[i] - cos((double)x[i])) < 1.5e-7);
+        }
+
+        for (int i = 0; i < N; i++) x[i] = -87.3f + 175.6f * (float)i / (N - 1);
+        fast_exp_array(r, x, N);
+        fast_exp2_array(r2, x, N);
+        for (int i = 0; i < N; i++) {
+            double e = exp((double)x[i]), e2 = exp2((double)x[i]);
+            ASSERT(fabs(fast_exp(x[i]) - e) < 2e-7 * e);
+            ASSERT(fabs(fast_exp2(x[i]) - e2) < 2e-7 * e2);
+            ASSERT(fabs(r[i] - e) < 2e-7 * e);
+            ASSERT(fabs(r2[i] - e2) < 2e-7 * e2);
+        }
+
+        for (int i = 0; i < N; i++) x[i] = (float)exp2(-120.0 + 240.0 * i / (N - 1));
+        fast_log2_array(r, x, N);
+        fast_rsqrt_array(r2, x, N);
+        for (int i = 0; i < N; i++) {
+            double l = log2((double)x[i]), rs = 1.0 / sqrt((double)x[i]);
+            ASSERT(fabs(fast_log2(x[i]) - l) < 1.5e-7 * fmax(1.0, fabs(l)));
+            ASSERT(fabs(r[i] - l) < 1.5e-7 * fmax(1.0, fabs(l)));
+            ASSERT(fabs(fast_rsqrt(x[i]) - rs) < 5e-6 * rs);
+            ASSERT(fabs(r2[i] - rs) < 5e-6 * rs);
+        }
+
+        for (int i = 0; i < N; i++) x[i] = (float)i / (N - 1);
+        fast_pow_array(r, x, 25.0f, N);
+        ASSERT(r[0] == 0.0f && fast_pow(0.0f, 25.0f) == 0.0f);
+        for (int i = 1; i < N; i++) {
+            double p = pow((double)x[i], 25.0);
+            if (p < 1e-37) continue; // below FLT_MIN
+            double bound = 3e-7 * fmax(1.0, fabs(25.0 * log2((double)x[i]))) * p;
+            ASSERT(fabs(fast_pow(x[i], 25.0f) - p) <= bound);
+            ASSERT(fabs(r[i] - p) <= bound);
+        }
+    }
+    cpu_level_set(max);
+}
+
+bool quat_eq_rotation(Quat a, Quat b)
+{
+    /* q and -q are the same rotation */
+    return fabsf(fabsf(quat_dot(a, b)) - 1.0f) < 1e-5f;
+}
+
+TEST(test_quat)
+{
+    Vec3 axis = vec3_normalize(vec3_make(1, 2, 3));
+    Quat q = quat_make_rotation(0.7f, axis);
+    Mat4 r = mat4_make_rotation(0.7f, axis);
+
+    /* same convention as mat4_make_rotation */
+    Mat4 qm = quat_to_mat4(q);
+    for (int j = 0; j < 16; j++) ASSERT(float_eq(qm.f[j], r.f[j]));
+    Vec3 v = vec3_make(0.5f, -1.0f, 2.0f);
+    ASSERT(vec3_eq(quat_rotate_vec3(q, v), mat4_mul_vec4(r, vec4_make(v.x, v.y, v.z, 0.0f)).xyz));
+
+    /* quat_mul composes like mat4_mul_mat4 */
+    Quat q2 = quat_make_rotation(-1.3f, vec3_normalize(vec3_make(-2, 0.5f, 1)));
+    Mat4 m12 = mat4_mul_mat4(r, quat_to_mat4(q2));
+    Mat4 q12 = quat_to_mat4(quat_mul(q, q2));
+    for (int j = 0; j < 16; j++) ASSERT(float_eq(m12.f[j], q12.f[j]));
+    ASSERT(quat_eq_rotation(quat_mul(q, quat_inverse(q)), quat_make_identity()));
+    ASSERT(quat_eq_rotation(quat_inverse(q), quat_conjugate(q)));
+
+    /* mat3 -> quat for every branch (incl. 180 degree rotations) */
+    const Quat qs[] = {
+        q, q2, quat_make_rotation(3.14159265f, vec3_make(1, 0, 0)), quat_make_rotation(3.14159265f, vec3_make(0, 1, 0)),
+        quat_make_rotation(3.14159265f, vec3_make(0, 0, 1)), quat_make_rotation(3.0f, axis),
+    };
+    for (size_t i = 0; i < sizeof(qs)/sizeof(qs[0]); i++) {
+        ASSERT(quat_eq_rotation(quat_make_from_mat3(quat_to_mat3(qs[i])), qs[i]));
+    }
+
+    /* slerp halfway == half the rotation. Also via the "long way round" representation -b */
+    Quat a = quat_make_identity();
+    Quat b = quat_make_rotation(2.0f, axis);
+    Quat half = quat_make_rotation(1.0f, axis);
+    ASSERT(quat_eq_rotation(quat_slerp(a, b, 0.5f), half));
+    ASSERT(quat_eq_rotation(quat_slerp(a, quat_make(-b.x, -b.y, -b.z, -b.w), 0.5f), half));
+    ASSERT(quat_eq_rotation(quat_slerp(a, b, 0.25f), quat_make_rotation(0.5f, axis)));
+    ASSERT(quat_eq_rotation(quat_nlerp(a, b, 0.5f), half));
+    ASSERT(float_eq(quat_dot(quat_nlerp(a, b, 0.3f), quat_nlerp(a, b, 0.3f)), 1.0f));
+
+    /* TRS */
+    Mat4 trs = mat4_make_trs(vec3_make(1, -2, 3), q, vec3_make(2.0f, 0.5f, 3.0f));
+    Mat4 trs_expected = mat4_scale(mat4_rotate(mat4_make_translation(vec3_make(1, -2, 3)), 0.7f, axis),
+                                   vec3_make(2.0f, 0.5f, 3.0f));
+    for (int j = 0; j < 16; j++) ASSERT(float_eq(trs.f[j], trs_expected.f[j]));
+
+    /* dual quaternion == rotate, then translate */
+    DualQuat dq = dualquat_make(q, vec3_make(1, -2, 3));
+    ASSERT(vec3_eq(dualquat_transform_point3(dq, v), vec3_add(quat_rotate_vec3(q, v), vec3_make(1, -2, 3))));
+}
+
+TEST(test_skinning)
+{
+    enum { NV = 9 };
+    Vec3 axis = vec3_normalize(vec3_make(1, 2, 3));
+    Quat rq[2] = {quat_make_rotation(0.7f, axis), quat_make_rotation(0.7f, axis)};
+    Vec3 t[2]  = {vec3_make(1, -2, 3), vec3_make(-4, 0, 1)};
+    Mat4 jm[3];
+    DualQuat jdq[3];
+    for (int k = 0; k < 2; k++) {
+        jm[k]  = mat4_make_trs(t[k], rq[k], vec3_make(1, 1, 1));
+        jdq[k] = dualquat_make(rq[k], t[k]);
+    }
+    /* joint 2: the same transform as joint 0, but with -q */
+    jm[2]  = jm[0];
+    jdq[2] = (DualQuat) {.real = quat_make(-rq[0].x, -rq[0].y, -rq[0].z, -rq[0].w),
+                         .dual = quat_make(-jdq[0].dual.x, -jdq[0].dual.y, -jdq[0].dual.z, -jdq[0].dual.w)};
+
+    Vec3 pos[NV], nrm[NV], out_pos[NV], out_nrm[NV], dq_pos[NV], dq_nrm[NV];
+    IVec4 joints[NV];
+    Vec4 weights[NV];
+    for (int i = 0; i < NV; i++) {
+        pos[i]     = vec3_make((float)i, 1.0f - (float)i, 0.5f * (float)i);
+        nrm[i]     = vec3_normalize(vec3_make(1.0f, (float)i, -1.0f));
+        float wt   = (float)i / (NV - 1);
+        joints[i]  = (IVec4) {.x = 0, .y = 1, .z = 2, .w = 0};
+        weights[i] = vec4_make((1.0f - wt) * 0.5f, wt, (1.0f - wt) * 0.5f, 0.0f);
+    }
+
+    skin_linear_array(out_pos, out_nrm, pos, nrm, joints, weights, jm, NV);
+    skin_dualquat_array(dq_pos, dq_nrm, pos, nrm, joints, weights, jdq, NV);
+    for (int i = 0; i < NV; i++) {
+        /* same rotation for both joints: translations blend linearly either way */
+        float wt = (float)i / (NV - 1);
+        Vec3 expected = vec3_add(quat_rotate_vec3(rq[0], pos[i]), vec3_lerp(t[0], t[1], wt));
+        ASSERT(vec3_eq(out_pos[i], expected));
+        ASSERT(vec3_eq(dq_pos[i], expected));
+        ASSERT(vec3_eq(out_nrm[i], quat_rotate_vec3(rq[0], nrm[i])));
+        ASSERT(vec3_eq(dq_nrm[i], quat_rotate_vec3(rq[0], nrm[i])));
+    }
+
+    /* NULL normals, in place */
+    skin_dualquat_array(pos, NULL, pos, NULL, joints, weights, jdq, NV);
+    for (int i = 0; i < NV; i++) ASSERT(vec3_eq(pos[i], dq_pos[i]));
+}
@@ -0,0 +1,410 @@
+#define _DEFAULT_SOURCE
+#include "hgl_test.h"
+
+#define HGL_RITA_IMPLEMENTATION
+#define HGL_RITA_COLLECT_STATS
+#include "hgl_rita.h"
+#include "hgl_rita_shaders.h"
+
+#define WIDTH  (128)
+#define HEIGHT (128)
+
+static HglRitaTexture fb_color;
+static HglRitaTexture fb_depth;
+static HglRitaTexture white;
+static HglRitaVertexBuffer vbuf;
+
+/* pixel coordinates to NDC. See `hgl_rita_use_viewport()` */
+static void push_vertex(float x, float y, HglRitaColor color)
+{
+    hgl_rita_buf_push(&vbuf, (HglRitaVertex){
+        .pos = vec4_make(2.0f*x/WIDTH - 1.0f, 1.0f - 2.0f*y/HEIGHT, 0.5f, 1.0f),
+        .color = color,
+    });
+}
+
+/* Run in the test process, since the tile threads don't survive the fork */
+static void setup(void)
+{
+    hgl_rita_init();
+    hgl_rita_use_clear_color(HGL_RITA_BLACK);
+    hgl_rita_use_tile_config((HglRitaTileConfig){.tile_size_x = 64, .tile_size_y = 64, .op_queue_capacity = 256});
+
+    fb_color = hgl_rita_texture_make(WIDTH, HEIGHT, HGL_RITA_RGBA8);
+    fb_depth = hgl_rita_texture_make(WIDTH, HEIGHT, HGL_RITA_R32);
+    hgl_rita_bind_texture(HGL_RITA_TEX_FRAME_BUFFER, &fb_color);
+    hgl_rita_bind_texture(HGL_RITA_TEX_DEPTH_BUFFER, &fb_depth);
+    hgl_rita_use_viewport(WIDTH, HEIGHT);
+
+    white = hgl_rita_texture_make(4, 4, HGL_RITA_RGBA8);
+    for (int i = 0; i < 16; i++) {
+        white.data.rgba8[i] = HGL_RITA_WHITE;
+    }
+
+    hgl_rita_disable(HGL_RITA_BACKFACE_CULLING | HGL_RITA_DEPTH_TESTING | HGL_RITA_DEPTH_BUFFER_WRITING);
+    hgl_rita_use_vertex_buffer_mode(HGL_RITA_ARRAY);
+    hgl_rita_bind_buffer(HGL_RITA_VERTEX_BUFFER, &vbuf);
+}
+
+static void teardown(void)
+{
+    hgl_rita_final();
+    hgl_rita_texture_destroy(&fb_color);
+    hgl_rita_texture_destroy(&fb_depth);
+    hgl_rita_texture_destroy(&white);
+    hgl_rita_buf_destroy(&vbuf);
+}
+
+TEST(test_msaa_over_blit, .setup = setup, .teardown = teardown)
+{
+    hgl_rita_enable(HGL_RITA_MSAA);
+    hgl_rita_clear(HGL_RITA_COLOR | HGL_RITA_DEPTH);
+    hgl_rita_blit(0, 0, WIDTH, HEIGHT, &white, HGL_RITA_REPLACE, HGL_RITA_EVERYWHERE, HGL_RITA_BOXCOORD, NULL);
+
+    /* the right edge is vertical, on the first column of the second tile */
+    push_vertex(10.0f, 10.0f, HGL_RITA_RED);
+    push_vertex(64.0f, 10.0f, HGL_RITA_RED);
+    push_vertex(64.0f, 110.0f, HGL_RITA_RED);
+    hgl_rita_draw(HGL_RITA_TRIANGLES);
+    hgl_rita_finish();
+
+    /* edge pixels are a mix of red and the blitted white, never of the clear color. N.B. interpolated red may be 254 */
+    int n_red = 0, n_mixed = 0;
+    for (int i = 0; i < WIDTH*HEIGHT; i++) {
+        HglRitaColor c = fb_color.data.rgba8[i];
+        ASSERT(c.r >= 254 && c.g == c.b);
+        n_red += (c.g == 0);
+        n_mixed += (c.g > 0 && c.g < 255);
+    }
+    ASSERT(n_red > 1000);
+    ASSERT(n_mixed > 100);
+
+    /* the samples left of the pixel positions of column 64 are covered, so that tile must get the triangle too */
+    for (int y = 20; y < 100; y++) {
+        HglRitaColor c = fb_color.data.rgba8[y*WIDTH + 64];
+        ASSERT(c.g > 0 && c.g < 255);
+    }
+}
+
+TEST(test_msaa_depth_buffer, .setup = setup, .teardown = teardown)
+{
+    hgl_rita_enable(HGL_RITA_MSAA | HGL_RITA_DEPTH_TESTING);
+    hgl_rita_clear(HGL_RITA_COLOR | HGL_RITA_DEPTH);
+    hgl_rita_blit(0, 0, WIDTH, HEIGHT, &white, HGL_RITA_REPLACE, HGL_RITA_EVERYWHERE, HGL_RITA_BOXCOORD, NULL);
+    hgl_rita_finish();
+
+    /* the left half of the depth buffer is in front of the triangle */
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH/2; x++) {
+            fb_depth.data.r32[y*WIDTH + x] = 0.0f;
+        }
+    }
+
+    push_vertex(0.0f, 0.0f, HGL_RITA_RED);
+    push_vertex(WIDTH, 0.0f, HGL_RITA_RED);
+    push_vertex(0.0f, HEIGHT, HGL_RITA_RED);
+    hgl_rita_draw(HGL_RITA_TRIANGLES);
+    hgl_rita_finish();
+
+    /* pixels well inside the triangle */
+    for (int y = 1; y < HEIGHT; y++) {
+        for (int x = 1; x + y < HEIGHT - 8; x++) {
+            HglRitaColor c = fb_color.data.rgba8[y*WIDTH + x];
+            if (x < WIDTH/2) {
+                ASSERT(hgl_rita_color_eq(c, HGL_RITA_WHITE));
+            } else {
+                ASSERT(c.r >= 254 && c.g == 0 && c.b == 0);
+            }
+        }
+    }
+}
+
+TEST(test_batch_shaders, .setup = setup, .teardown = teardown)
+{
+    static const struct {
+        HglRitaFragShaderFunc scalar;
+        HglRitaFragShaderBatchFunc batch;
+    } shaders[] = {
+        {HGL_RITA_LAMBERT_DIFFUSE,  HGL_RITA_LAMBERT_DIFFUSE_BATCH},
+        {HGL_RITA_PHONG,            HGL_RITA_PHONG_BATCH},
+        {HGL_RITA_BLINN_PHONG,      HGL_RITA_BLINN_PHONG_BATCH},
+        {HGL_RITA_GOOCH,            HGL_RITA_GOOCH_BATCH},
+        {HGL_RITA_FOG,              HGL_RITA_FOG_BATCH},
+        {HGL_RITA_DITHER_4X4_1BPP,  HGL_RITA_DITHER_4X4_1BPP_BATCH},
+        {HGL_RITA_DITHER_4X4_2BPP,  HGL_RITA_DITHER_4X4_2BPP_BATCH},
+        {HGL_RITA_DITHER_4X4_3BPP,  HGL_RITA_DITHER_4X4_3BPP_BATCH},
+    };
+    enum { N = 4096 };
+    static HglRitaFragment frags[N];
+    HglRitaColor out[HGL_RITA_FRAG_BATCH_SIZE];
+
+    HglRitaTexture diffuse = hgl_rita_texture_make(4, 4, HGL_RITA_RGBA8);
+    for (int i = 0; i < 16; i++) {
+        diffuse.data.rgba8[i] = (HglRitaColor) {16*i, 255 - 16*i, 80 + 8*i, 255};
+    }
+    hgl_rita_bind_texture(HGL_RITA_TEX_DIFFUSE, &diffuse);
+    hgl_rita_use_camera_view(vec3_make(1, 2, 3), vec3_make(0, 0, -10), vec3_make(0, 1, 0));
+
+    uint32_t seed = 42;
+    for (int i = 0; i < N; i++) {
+        float r[10];
+        for (int k = 0; k < 10; k++) {
+            seed = seed * 1664525u + 1013904223u;
+            r[k] = (float)(seed >> 8) / (float)(1u << 24);
+        }
+        frags[i] = (HglRitaFragment) {
+            .x            = seed % WIDTH,
+            .y            = (seed >> 16) % HEIGHT,
+            .inv_z        = r[0],
+            .uv           = vec2_make(r[1], r[2]),
+            .color        = {255*r[3], 255*r[4], 255*r[5], 255},
+            .world_pos    = vec3_make(20*r[6] - 10, 20*r[7] - 10, 20*r[8] - 20),
+            .world_normal = vec3_normalize(vec3_make(r[9] - 0.5f, r[3] - 0.5f, r[6] - 0.5f)),
+        };
+    }
+
+    /* batch == scalar, give or take rounding. The odd batch sizes cover the padded lanes */
+    for (size_t s = 0; s < sizeof(shaders)/sizeof(shaders[0]); s++) {
+        int n_exact = 0;
+        for (int i = 0; i < N;) {
+            int n = 1 + (i/HGL_RITA_FRAG_BATCH_SIZE) % HGL_RITA_FRAG_BATCH_SIZE;
+            if (n > N - i) n = N - i;
+            shaders[s].batch(&hgl_rita_ctx__, &frags[i], out, n);
+            for (int j = 0; j < n; j++) {
+                HglRitaColor expected = shaders[s].scalar(&hgl_rita_ctx__, &frags[i + j]);
+                ASSERT(abs(out[j].r - expected.r) <= 1);
+                ASSERT(abs(out[j].g - expected.g) <= 1);
+                ASSERT(abs(out[j].b - expected.b) <= 1);
+                ASSERT(abs(out[j].a - expected.a) <= 1);
+                n_exact += hgl_rita_color_eq(out[j], expected);
+            }
+            i += n;
+        }
+        ASSERT(n_exact > N - N/100);
+    }
+
+    hgl_rita_texture_destroy(&diffuse);
+}
+
+static bool is_first_touched(const HglRitaTexture *tex)
+{
+    int n_touched = min(hgl_rita_ctx__.renderer.n_first_touched, 4);
+    for (int i = 0; i < n_touched; i++) {
+        if (hgl_rita_ctx__.renderer.first_touched[i] == tex->data.rgba8) {
+            return true;
+        }
+    }
+    return false;
+}
+
+TEST(test_first_touch_on_respawn, .setup = setup, .teardown = teardown)
+{
+    /* the depth buffer is bound before the tile threads are (re)spawned */
+    hgl_rita_enable(HGL_RITA_THREAD_PINNING);
+    ASSERT(is_first_touched(&fb_color));
+    ASSERT(is_first_touched(&fb_depth));
+
+    hgl_rita_use_tile_config((HglRitaTileConfig){.tile_size_x = 32, .tile_size_y = 32, .op_queue_capacity = 256});
+    ASSERT(is_first_touched(&fb_color));
+    ASSERT(is_first_touched(&fb_depth));
+
+    /* a framebuffer of another size respawns the tile threads. The old depth buffer doesn't fit them */
+    HglRitaTexture small = hgl_rita_texture_make(WIDTH/2, HEIGHT/2, HGL_RITA_RGBA8);
+    hgl_rita_bind_texture(HGL_RITA_TEX_FRAME_BUFFER, &small);
+    ASSERT(is_first_touched(&small));
+    ASSERT(!is_first_touched(&fb_depth));
+    hgl_rita_bind_texture(HGL_RITA_TEX_FRAME_BUFFER, &fb_color);
+    ASSERT(is_first_touched(&fb_color));
+    ASSERT(is_first_touched(&fb_depth));
+
+    hgl_rita_clear(HGL_RITA_COLOR | HGL_RITA_DEPTH);
+    hgl_rita_finish();
+    hgl_rita_disable(HGL_RITA_THREAD_PINNING);
+    hgl_rita_texture_destroy(&small);
+}
+
+TEST(test_compact_attachments, .setup = setup, .teardown = teardown)
+{
+    HglRitaTexture fb_565 = hgl_rita_texture_make(WIDTH, HEIGHT, HGL_RITA_RGB565);
+    HglRitaTexture db_16  = hgl_rita_texture_make(WIDTH, HEIGHT, HGL_RITA_R16);
+    hgl_rita_bind_texture(HGL_RITA_TEX_FRAME_BUFFER, &fb_565);
+    hgl_rita_bind_texture(HGL_RITA_TEX_DEPTH_BUFFER, &db_16);
+
+    hgl_rita_enable(HGL_RITA_DEPTH_TESTING | HGL_RITA_DEPTH_BUFFER_WRITING);
+    hgl_rita_clear(HGL_RITA_COLOR | HGL_RITA_DEPTH);
+    hgl_rita_blit(0, 0, WIDTH, HEIGHT, &white, HGL_RITA_REPLACE, HGL_RITA_EVERYWHERE, HGL_RITA_BOXCOORD, NULL);
+    hgl_rita_finish();
+
+    /* the left half of the depth buffer is in front of the triangle */
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH/2; x++) {
+            db_16.data.r16[y*WIDTH + x] = 0;
+        }
+    }
+
+    push_vertex(0.0f, 0.0f, HGL_RITA_RED);
+    push_vertex(WIDTH, 0.0f, HGL_RITA_RED);
+    push_vertex(0.0f, HEIGHT, HGL_RITA_RED);
+    hgl_rita_draw(HGL_RITA_TRIANGLES);
+    hgl_rita_finish();
+
+    for (int y = 1; y < HEIGHT; y++) {
+        for (int x = 1; x + y < HEIGHT - 8; x++) {
+            int idx = y*WIDTH + x;
+            if (x < WIDTH/2) {
+                ASSERT(fb_565.data.rgb565[idx] == 0xFFFF);
+                ASSERT(db_16.data.r16[idx] == 0);
+            } else {
+                ASSERT(fb_565.data.rgb565[idx] == 0xF800);
+                ASSERT(db_16.data.r16[idx] == UINT16_MAX/2 + 1);
+            }
+        }
+    }
+
+    hgl_rita_bind_texture(HGL_RITA_TEX_FRAME_BUFFER, &fb_color);
+    hgl_rita_bind_texture(HGL_RITA_TEX_DEPTH_BUFFER, &fb_depth);
+    hgl_rita_texture_destroy(&fb_565);
+    hgl_rita_texture_destroy(&db_16);
+}
+
+TEST(test_normals_non_uniform_scale, .setup = setup, .teardown = teardown)
+{
+    /* R_z(30 deg) * S(1, 4, 1) */
+    Mat4 R = mat4_make_rotation(DEG_TO_RAD(30.0f), vec3_make(0, 0, 1));
+    Mat4 S = mat4_make_scale(vec3_make(1, 4, 1));
+    Mat4 M = mat4_mul_mat4(R, S);
+    hgl_rita_use_model_matrix(M);
+
+    /* the surface spanned by `t` and the z axis has the normal `n` */
+    Vec3 n = vec3_normalize(vec3_make(1, 1, 0));
+    Vec3 t = vec3_normalize(vec3_make(1, -1, 0));
+    HglRitaVertex v = {
+        .pos     = vec4_make(0, 0, 0, 1),
+        .normal  = n,
+        .tangent = t,
+    };
+    HglRitaFragment frag = hgl_rita_process_vertex_internal_(&v);
+
+    Vec3 N = frag.world_normal;
+    ASSERT(fabsf(N.x - 0.7194f) < 1e-3f);
+    ASSERT(fabsf(N.y - 0.6946f) < 1e-3f);
+    ASSERT(fabsf(N.z) < 1e-6f);
+
+    /* still perpendicular to the transformed surface, and unit length */
+    Vec3 T_surface = mat3_mul_vec3(mat3_make_from_mat4(M), t);
+    ASSERT(fabsf(vec3_dot(N, vec3_normalize(T_surface))) < 1e-5f);
+    ASSERT(fabsf(vec3_len(N) - 1.0f) < 1e-5f);
+    ASSERT(fabsf(vec3_len(frag.world_tangent) - 1.0f) < 1e-5f);
+}
+
+/* A camera at the origin looking down -z. Side planes at |x| = |y| = -z, near plane at z = -1, far plane at z = -100 */
+static void use_test_camera(void)
+{
+    hgl_rita_use_camera_view(vec3_make(0, 0, 0), vec3_make(0, 0, -1), vec3_make(0, 1, 0));
+    hgl_rita_use_perspective_proj(DEG_TO_RAD(90.0f), 1.0f, 1.0f, 100.0f);
+}
+
+TEST(test_bounds_culling, .setup = setup, .teardown = teardown)
+{
+    use_test_camera();
+    hgl_rita_buf_push(&vbuf, (HglRitaVertex){.pos = vec4_make(-1, -1, -10, 1), .color = HGL_RITA_RED});
+    hgl_rita_buf_push(&vbuf, (HglRitaVertex){.pos = vec4_make( 1, -1, -10, 1), .color = HGL_RITA_RED});
+    hgl_rita_buf_push(&vbuf, (HglRitaVertex){.pos = vec4_make( 0,  1, -10, 1), .color = HGL_RITA_RED});
+
+    const struct {
+        HglRitaBounds bounds;
+        bool z_clipping;
+        bool culled;
+    } cases[] = {
+        /* fully outside a side plane, behind the camera, and beyond the far plane */
+        {hgl_rita_bounds_make_box(vec3_make(-30, -1, -11), vec3_make(-20, 1, -9)),  false, true},
+        {hgl_rita_bounds_make_sphere(vec3_make(0, 30, -10), 5),                     false, true},
+        {hgl_rita_bounds_make_box(vec3_make(-1, -1, 1), vec3_make(1, 1, 5)),        false, true},
+        {hgl_rita_bounds_make_sphere(vec3_make(0, 0, 3), 1),                        true,  true},
+        {hgl_rita_bounds_make_box(vec3_make(-1, -1, -300), vec3_make(1, 1, -200)),  true,  true},
+
+        /* straddling a plane */
+        {hgl_rita_bounds_make_box(vec3_make(-15, -1, -11), vec3_make(-5, 1, -9)),   false, false},
+        {hgl_rita_bounds_make_sphere(vec3_make(0, 10, -10), 1),                     false, false},
+        {hgl_rita_bounds_make_box(vec3_make(-1, -1, -5), vec3_make(1, 1, 5)),       false, false},
+        {hgl_rita_bounds_make_box(vec3_make(-1, -1, -5), vec3_make(1, 1, 5)),       true,  false},
+        {hgl_rita_bounds_make_sphere(vec3_make(0, 0, 0), 2),                        false, false},
+        {hgl_rita_bounds_make_box(vec3_make(-1, -1, -150), vec3_make(1, 1, -50)),   true,  false},
+
+        /* the far plane is only tested with z-clipping */
+        {hgl_rita_bounds_make_box(vec3_make(-1, -1, -300), vec3_make(1, 1, -200)),  false, false},
+    };
+
+    hgl_rita_reset_stats();
+    for (size_t i = 0; i < sizeof(cases)/sizeof(cases[0]); i++) {
+        if (cases[i].z_clipping) {
+            hgl_rita_enable(HGL_RITA_Z_CLIPPING);
+        } else {
+            hgl_rita_disable(HGL_RITA_Z_CLIPPING);
+        }
+        uint64_t n_culled = hgl_rita_get_stats().n_culled_draw_calls;
+        hgl_rita_use_bounds(cases[i].bounds);
+        hgl_rita_draw(HGL_RITA_TRIANGLES);
+        ASSERT(hgl_rita_get_stats().n_culled_draw_calls == n_culled + cases[i].culled);
+    }
+    HglRitaStats stats = hgl_rita_get_stats();
+    ASSERT(stats.n_draw_calls == sizeof(cases)/sizeof(cases[0]));
+
+    hgl_rita_use_bounds((HglRitaBounds){.kind = HGL_RITA_BOUNDS_NONE});
+    hgl_rita_draw(HGL_RITA_TRIANGLES);
+    ASSERT(hgl_rita_get_stats().n_culled_draw_calls == stats.n_culled_draw_calls);
+    hgl_rita_finish();
+}
+
+TEST(test_bvh_culling, .setup = setup, .teardown = teardown)
+{
+    use_test_camera();
+
+    /* a row of boxes across the view, one straddling the near plane, one behind the camera and one beyond the far plane */
+    enum { N_ROW = 41, N = N_ROW + 3 };
+    HglRitaBounds bounds[N];
+    for (int i = 0; i < N_ROW; i++) {
+        float x = -40.0f + 2.0f*i;
+        bounds[i] = hgl_rita_bounds_make_box(vec3_make(x - 0.5f, -0.5f, -10.5f), vec3_make(x + 0.5f, 0.5f, -9.5f));
+    }
+    bounds[N_ROW + 0] = hgl_rita_bounds_make_box(vec3_make(-0.5f, -0.5f, -3.0f), vec3_make(0.5f, 0.5f, 2.0f));
+    bounds[N_ROW + 1] = hgl_rita_bounds_make_sphere(vec3_make(0.0f, 0.0f, 5.0f), 1.0f);
+    bounds[N_ROW + 2] = hgl_rita_bounds_make_box(vec3_make(-0.5f, -0.5f, -501.0f), vec3_make(0.5f, 0.5f, -499.0f));
+    HglRitaBVH bvh = hgl_rita_bvh_make(bounds, N);
+
+    HglRitaIndexBuffer visible = {0};
+    Mat4 vp = mat4_mul_mat4(hgl_rita_ctx__.tform.proj, hgl_rita_ctx__.tform.view);
+    for (int z_clipping = 0; z_clipping < 2; z_clipping++) {
+        if (z_clipping) {
+            hgl_rita_enable(HGL_RITA_Z_CLIPPING);
+        } else {
+            hgl_rita_disable(HGL_RITA_Z_CLIPPING);
+        }
+        hgl_rita_bvh_cull(&bvh, &visible);
+
+        /* exactly the objects that pass the per-object test, each once */
+        bool is_visible[N] = {0};
+        for (int i = 0; i < visible.length; i++) {
+            int obj = visible.arr[i];
+            ASSERT(obj >= 0 && obj < N);
+            ASSERT(!is_visible[obj]);
+            is_visible[obj] = true;
+        }
+        for (int i = 0; i < N; i++) {
+            ASSERT(is_visible[i] == hgl_rita_bounds_visible(bounds[i], vp));
+        }
+
+        /* x in [-10, 10] of the row, i.e. 11 boxes, and the box straddling the near plane */
+        for (int i = 0; i < N_ROW; i++) {
+            float x = -40.0f + 2.0f*i;
+            ASSERT(is_visible[i] == (fabsf(x) <= 10.0f));
+        }
+        ASSERT(is_visible[N_ROW + 0]);
+        ASSERT(!is_visible[N_ROW + 1]);
+        ASSERT(is_visible[N_ROW + 2] == !z_clipping);
+        ASSERT(visible.length == 11 + 1 + !z_clipping);
+    }
+
+    hgl_rita_buf_destroy(&visible);
+    hgl_rita_bvh_destroy(&bvh);
+}
@@ -0,0 +1,159 @@
+#define _DEFAULT_SOURCE
+#include "hgl_test.h"
+
+/* small chunks, so that the test OBJ is split into as many chunks as there are workers */
+#define HGL_RITA_ASSETS_CHUNK_SIZE 256
+
+#define HGL_WORKER_POOL_IMPLEMENTATION
+#include "hgl_worker_pool.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#define HGL_RITA_IMPLEMENTATION
+#include "hgl_rita.h"
+#include "hgl_rita_assets.h"
+#undef STB_IMAGE_IMPLEMENTATION
+#include "rita_helpers.h"
+
+#define GRID_SIZE (32)
+
+static char obj[256 * 1024];
+static size_t obj_size;
+
+/* A GRID_SIZE x GRID_SIZE grid of vertices. Quads (fan triangulated) with negative indices in every other row */
+static void make_grid_obj(void)
+{
+    char *p = obj;
+    char *end = obj + sizeof(obj);
+    for (int y = 0; y < GRID_SIZE; y++) {
+        for (int x = 0; x < GRID_SIZE; x++) {
+            p += snprintf(p, end - p, "v %d.5 %d.25 %d\n", x, y, x - y);
+            p += snprintf(p, end - p, "vt %f %f\n", (float)x / GRID_SIZE, (float)y / GRID_SIZE);
+            p += snprintf(p, end - p, "vn 0 0 1\n");
+        }
+    }
+    int n = GRID_SIZE * GRID_SIZE;
+    for (int y = 0; y < GRID_SIZE - 1; y++) {
+        for (int x = 0; x < GRID_SIZE - 1; x++) {
+            int i[4] = {y*GRID_SIZE + x + 1, y*GRID_SIZE + x + 2, (y + 1)*GRID_SIZE + x + 2, (y + 1)*GRID_SIZE + x + 1};
+            if (y & 1) {
+                for (int k = 0; k < 4; k++) i[k] -= n + 1;
+            }
+            p += snprintf(p, end - p, "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n",
+                          i[0], i[0], i[0], i[1], i[1], i[1], i[2], i[2], i[2], i[3], i[3], i[3]);
+        }
+    }
+    obj_size = p - obj;
+}
+
+static void load(int n_workers, HglRitaVertexBuffer *vbuf, HglRitaIndexBuffer *ibuf)
+{
+    HglRitaAssetLoader *loader = hgl_rita_assets_create(n_workers);
+    ASSERT(loader != NULL);
+    ASSERT(hgl_rita_assets_load_obj_from_memory(loader, obj, obj_size, vbuf, ibuf) == 0);
+    ASSERT(hgl_rita_assets_wait(loader) == 0);
+    hgl_rita_assets_destroy(loader);
+}
+
+static bool vec_eq(const float *a, const float *b, int n)
+{
+    return memcmp(a, b, n * sizeof(float)) == 0;
+}
+
+static bool vertex_eq(HglRitaVertex a, HglRitaVertex b)
+{
+    return vec_eq(&a.pos.x, &b.pos.x, 4) &&
+           vec_eq(&a.normal.x, &b.normal.x, 3) &&
+           vec_eq(&a.tangent.x, &b.tangent.x, 3) &&
+           vec_eq(&a.uv.x, &b.uv.x, 2) &&
+           hgl_rita_color_eq(a.color, b.color);
+}
+
+static bool pos_eq(HglRitaVertex v, float x, float y, float z)
+{
+    return v.pos.x == x && v.pos.y == y && v.pos.z == z && v.pos.w == 1.0f;
+}
+
+TEST(test_obj_chunked)
+{
+    make_grid_obj();
+
+    /* the reference is parsed as a single chunk */
+    HglRitaVertexBuffer ref = {0};
+    load(1, &ref, NULL);
+    ASSERT(ref.length == 3 * 2 * (GRID_SIZE - 1) * (GRID_SIZE - 1));
+
+    /* first triangle of the first quad */
+    ASSERT(pos_eq(ref.arr[0], 0.5f, 0.25f, 0.0f));
+    ASSERT(pos_eq(ref.arr[1], 1.5f, 0.25f, 1.0f));
+    ASSERT(pos_eq(ref.arr[2], 1.5f, 1.25f, 0.0f));
+    ASSERT(ref.arr[0].normal.x == 0.0f && ref.arr[0].normal.y == 0.0f && ref.arr[0].normal.z == 1.0f);
+    ASSERT(hgl_rita_color_eq(ref.arr[0].color, HGL_RITA_WHITE));
+
+    /* a quad of a row using negative indices */
+    int t = 2 * (GRID_SIZE - 1);
+    ASSERT(pos_eq(ref.arr[3*t], 0.5f, 1.25f, -1.0f));
+
+    /* the chunks are finished by whichever worker gets there last. Repeat to give that a chance to go wrong */
+    for (int run = 0; run < 20; run++) {
+        HglRitaVertexBuffer vbuf = {0};
+        load(8, &vbuf, NULL);
+        ASSERT(vbuf.length == ref.length);
+        for (int i = 0; i < ref.length; i++) {
+            ASSERT(vertex_eq(vbuf.arr[i], ref.arr[i]));
+        }
+        hgl_rita_buf_destroy(&vbuf);
+    }
+
+    /* welded */
+    HglRitaVertexBuffer ref_welded = {0};
+    HglRitaIndexBuffer ref_ibuf = {0};
+    load(1, &ref_welded, &ref_ibuf);
+    ASSERT(ref_ibuf.length == ref.length);
+    ASSERT(ref_welded.length == GRID_SIZE * GRID_SIZE);
+
+    HglRitaVertexBuffer vbuf = {0};
+    HglRitaIndexBuffer ibuf = {0};
+    load(8, &vbuf, &ibuf);
+    ASSERT(vbuf.length == ref_welded.length && ibuf.length == ref_ibuf.length);
+    for (int i = 0; i < vbuf.length; i++) {
+        ASSERT(vertex_eq(vbuf.arr[i], ref_welded.arr[i]));
+    }
+    for (int i = 0; i < ibuf.length; i++) {
+        ASSERT(ibuf.arr[i] == ref_ibuf.arr[i]);
+    }
+
+    hgl_rita_buf_destroy(&vbuf);
+    hgl_rita_buf_destroy(&ibuf);
+    hgl_rita_buf_destroy(&ref_welded);
+    hgl_rita_buf_destroy(&ref_ibuf);
+    hgl_rita_buf_destroy(&ref);
+}
+
+TEST(test_obj_matches_fast_obj)
+{
+    /* examples/rita_helpers.h parses with fast_obj, serially */
+    const char *paths[] = {"assets/cube.obj", "assets/teapot.obj", "assets/penger.obj"};
+    for (size_t k = 0; k < sizeof(paths)/sizeof(paths[0]); k++) {
+        MyModel ref = load_model_from_obj(paths[k]);
+
+        HglRitaVertexBuffer vbuf = {0};
+        HglRitaIndexBuffer ibuf = {0};
+        HglRitaAssetLoader *loader = hgl_rita_assets_create(4);
+        ASSERT(hgl_rita_assets_load_obj(loader, paths[k], &vbuf, &ibuf) == 0);
+        ASSERT(hgl_rita_assets_wait(loader) == 0);
+        hgl_rita_assets_destroy(loader);
+
+        ASSERT(vbuf.length == ref.vbuf.length && ibuf.length == ref.ibuf.length);
+        for (int i = 0; i < vbuf.length; i++) {
+            ASSERT(vertex_eq(vbuf.arr[i], ref.vbuf.arr[i]));
+        }
+        for (int i = 0; i < ibuf.length; i++) {
+            ASSERT(ibuf.arr[i] == ref.ibuf.arr[i]);
+        }
+
+        hgl_rita_buf_destroy(&vbuf);
+        hgl_rita_buf_destroy(&ibuf);
+        hgl_rita_buf_destroy(&ref.vbuf);
+        hgl_rita_buf_destroy(&ref.ibuf);
+    }
+}